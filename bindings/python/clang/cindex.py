@@ -1828,6 +1828,21 @@ class Cursor(Structure):
             for descendant in child.walk_preorder():
                 yield descendant
 
+    def flatten(self, include_usrs=False):
+        """Flatten the subtree rooted at this cursor in a single call.
+
+        This is much faster than walk_preorder() on large subtrees, which calls
+        back into Python for each cursor. Computing USRs is comparatively
+        costly, so they are only computed if include_usrs is True.
+
+        Returns a FlattenedCursors, or None if this cursor is invalid.
+        """
+        options = 0x1 if include_usrs else 0x0
+        ptr = conf.lib.clang_flattenCursorSubtree(self, options)
+        if not ptr:
+            return None
+        return FlattenedCursors(ptr, self._tu)
+
     def get_tokens(self):
         """Obtain Token instances formulating that compose this Cursor.
 
@@ -1893,6 +1908,92 @@ class Cursor(Structure):
         res._tu = args[0]._tu
         return res
 
+class _CXFlattenedCursors(Structure):
+    _fields_ = [("num_cursors", c_uint),
+                ("cursors", POINTER(Cursor)),
+                ("kinds", POINTER(c_int)),
+                ("parents", POINTER(c_int)),
+                ("file_indices", POINTER(c_int)),
+                ("start_offsets", POINTER(c_uint)),
+                ("end_offsets", POINTER(c_uint)),
+                ("usr_offsets", POINTER(c_uint)),
+                ("usr_data", POINTER(c_char)),
+                ("usr_data_size", c_uint),
+                ("num_files", c_uint),
+                ("files", POINTER(c_void_p))]
+
+class FlattenedCursors(object):
+    """
+    A cursor subtree flattened into parallel arrays, as returned by
+    Cursor.flatten().
+
+    The cursors are in depth-first preorder, starting with the root of the
+    subtree. The kinds, parents, file_indices, start_offsets, end_offsets and
+    usr_offsets attributes are ctypes arrays with one element per cursor. They
+    view the memory owned by libclang rather than copying it, support the
+    buffer protocol, and remain valid as long as this object is alive.
+
+    The parent of the root is -1, and so is the file index of cursors without
+    a location. Offsets are those of the expansion locations of the start and
+    end of the extent of each cursor.
+    """
+
+    def __init__(self, ptr, tu):
+        assert isinstance(ptr, POINTER(_CXFlattenedCursors)) and ptr
+        self.ptr = self._as_parameter_ = ptr
+        self._tu = tu
+
+        data = ptr.contents
+        count = data.num_cursors
+        def view(array, ctype, length):
+            return cast(array, POINTER(ctype * length)).contents
+        self._cursors = view(data.cursors, Cursor, count)
+        self.kinds = view(data.kinds, c_int, count)
+        self.parents = view(data.parents, c_int, count)
+        self.file_indices = view(data.file_indices, c_int, count)
+        self.start_offsets = view(data.start_offsets, c_uint, count)
+        self.end_offsets = view(data.end_offsets, c_uint, count)
+        self.usr_offsets = view(data.usr_offsets, c_uint, count)
+        self._usr_data = view(data.usr_data, c_char, data.usr_data_size)
+        self._files = view(data.files, c_void_p, data.num_files)
+
+    def from_param(self):
+        return self._as_parameter_
+
+    def __del__(self):
+        conf.lib.clang_disposeFlattenedCursors(self)
+
+    def __len__(self):
+        return len(self.kinds)
+
+    def cursor(self, index):
+        """Return the cursor at the given index."""
+        cursor = Cursor.from_buffer_copy(self._cursors[index])
+        cursor._tu = self._tu
+        return cursor
+
+    def kind(self, index):
+        """Return the CursorKind of the cursor at the given index."""
+        return CursorKind.from_id(self.kinds[index])
+
+    def file(self, index):
+        """Return the File of the cursor at the given index, or None."""
+        file_index = self.file_indices[index]
+        if file_index < 0:
+            return None
+        f = File(cast(self._files[file_index], c_object_p))
+        f._tu = self._tu
+        return f
+
+    def usr(self, index):
+        """Return the USR of the cursor at the given index, which is empty
+        unless USRs were requested."""
+        offset = self.usr_offsets[index]
+        usr = string_at(addressof(self._usr_data) + offset)
+        if sys.version_info[0] == 3:
+            usr = usr.decode("utf8")
+        return usr
+
 class StorageClass(object):
     """
     Describes the storage class of a declaration
@@ -3432,6 +3533,9 @@ functionList = [
   ("clang_disposeDiagnostic",
    [Diagnostic]),
 
+  ("clang_disposeFlattenedCursors",
+   [POINTER(_CXFlattenedCursors)]),
+
   ("clang_disposeIndex",
    [Index]),
 
@@ -3460,6 +3564,10 @@ functionList = [
    [Type, Type],
    bool),
 
+  ("clang_flattenCursorSubtree",
+   [Cursor, c_uint],
+   POINTER(_CXFlattenedCursors)),
+
   ("clang_formatDiagnostic",
    [Diagnostic, c_uint],
    _CXString,
@@ -4161,6 +4269,7 @@ __all__ = [
     'Diagnostic',
     'File',
     'FixIt',
+    'FlattenedCursors',
     'Index',
     'LinkageKind',
     'SourceLocation',
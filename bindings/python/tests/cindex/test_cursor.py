@@ -528,6 +528,28 @@ class TestCursor(unittest.TestCase):
         self.assertEqual(foos[1].get_template_argument_unsigned_value(0), 2 ** 32 - 7)
         self.assertEqual(foos[1].get_template_argument_unsigned_value(2), True)
 
+    def test_flatten(self):
+        tu = get_tu(kInput)
+        f0 = get_cursor(tu, 'f0')
+        flat = f0.flatten(include_usrs=True)
+        walked = list(f0.walk_preorder())
+
+        self.assertEqual(len(flat), len(walked))
+        self.assertEqual(flat.parents[0], -1)
+        for i, cursor in enumerate(walked):
+            self.assertEqual(flat.cursor(i), cursor)
+            self.assertEqual(flat.kind(i), cursor.kind)
+            self.assertEqual(flat.file(i).name, cursor.extent.start.file.name)
+            self.assertEqual(flat.start_offsets[i], cursor.extent.start.offset)
+            self.assertEqual(flat.end_offsets[i], cursor.extent.end.offset)
+            self.assertEqual(flat.usr(i), cursor.get_usr())
+            if i:
+                parent = flat.cursor(flat.parents[i])
+                self.assertIn(cursor, list(parent.get_children()))
+
+        flat = f0.flatten()
+        self.assertEqual(flat.usr(0), '')
+
     def test_referenced(self):
         tu = get_tu('void foo(); void bar() { foo(); }')
         foo = get_cursor(tu, 'foo')
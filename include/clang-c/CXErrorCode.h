@@ -54,7 +54,12 @@ enum CXErrorCode {
   /**
    * \brief An AST deserialization error has occurred.
    */
-  CXError_ASTReadError = 4
+  CXError_ASTReadError = 4,
+
+  /**
+   * \brief The operation was cancelled before it completed.
+   */
+  CXError_Canceled = 5
 };
 
 #ifdef __cplusplus
@@ -32,7 +32,7 @@
  * compatible, thus CINDEX_VERSION_MAJOR is expected to remain stable.
  */
 #define CINDEX_VERSION_MAJOR 0
-#define CINDEX_VERSION_MINOR 45
+#define CINDEX_VERSION_MINOR 48
 
 #define CINDEX_VERSION_ENCODE(major, minor) ( \
       ((major) * 10000)                       \
@@ -343,6 +343,32 @@ CINDEX_LINKAGE unsigned clang_CXIndex_getGlobalOptions(CXIndex);
 CINDEX_LINKAGE void
 clang_CXIndex_setInvocationEmissionPathOption(CXIndex, const char *Path);
 
+/**
+ * \brief Lets the translation units of the process share their precompiled
+ * preambles, across all CXIndex objects.
+ *
+ * A translation unit parsed with CXTranslationUnit_PrecompiledPreamble then
+ * reuses the preamble another translation unit built, as long as it is up to
+ * date, if both have the same command line, main files in the same directory
+ * and the same preamble text. The main files themselves may differ, unless
+ * the preamble uses the name of the main file, e.g. through __BASE_FILE__.
+ *
+ * Preambles are kept in memory up to \p MemoryBudget bytes; beyond that, the
+ * least recently used ones are moved to temporary files, even while a
+ * translation unit uses them. At most \p MaxPreambles preambles are shared;
+ * beyond that, the least recently used ones stop being shared, and are only
+ * kept by the translation units using them.
+ *
+ * \param MemoryBudget The number of bytes of preambles to keep in memory, or
+ * zero to keep them all on disk.
+ *
+ * \param MaxPreambles The number of preambles to keep, or zero to stop
+ * sharing preambles (the default).
+ */
+CINDEX_LINKAGE void
+clang_setSharedPreambleLimits(unsigned long long MemoryBudget,
+                              unsigned MaxPreambles);
+
 /**
  * \defgroup CINDEX_FILES File manipulation routines
  *
@@ -1585,6 +1611,68 @@ CINDEX_LINKAGE int clang_reparseTranslationUnit(CXTranslationUnit TU,
                                           struct CXUnsavedFile *unsaved_files,
                                                 unsigned options);
 
+/**
+ * \brief A reparse or code completion running in the background, started by
+ * \c clang_reparseTranslationUnitAsync() or \c clang_codeCompleteAtAsync().
+ */
+typedef struct CXAsyncOperationImpl *CXAsyncOperation;
+
+/**
+ * \brief Reparse the source files that produced this translation unit in the
+ * background.
+ *
+ * This is the asynchronous variant of \c clang_reparseTranslationUnit(). The
+ * reparse runs on a thread owned by libclang, or, when libclang runs without
+ * threads (e.g. LIBCLANG_NOTHREADS is set), on the first thread that waits for
+ * it. The operations started on the same translation unit run one at a time,
+ * in the order they were started.
+ * The client must not use \p TU itself until the operation has finished, and
+ * must dispose of the operation with \c clang_AsyncOperation_dispose() before
+ * disposing of \p TU.
+ *
+ * The unsaved files are copied, so the client only needs to guarantee their
+ * validity until this function returns.
+ *
+ * \returns The operation, or NULL if the arguments are invalid.
+ */
+CINDEX_LINKAGE CXAsyncOperation
+clang_reparseTranslationUnitAsync(CXTranslationUnit TU,
+                                  unsigned num_unsaved_files,
+                                  struct CXUnsavedFile *unsaved_files,
+                                  unsigned options);
+
+/**
+ * \brief Ask an asynchronous operation to stop as soon as possible.
+ *
+ * Cancellation is cooperative: an operation that hasn't started yet doesn't
+ * start, and a running one stops at the next top-level declaration of the
+ * translation unit. A cancelled reparse leaves the translation unit with
+ * the declarations parsed before it stopped, until it is reparsed again.
+ */
+CINDEX_LINKAGE void clang_AsyncOperation_cancel(CXAsyncOperation Op);
+
+/**
+ * \brief Returns non-zero if the operation has finished, in which case
+ * \c clang_AsyncOperation_wait() returns immediately.
+ */
+CINDEX_LINKAGE unsigned clang_AsyncOperation_isFinished(CXAsyncOperation Op);
+
+/**
+ * \brief Wait for an asynchronous operation to finish.
+ *
+ * \returns The error code of the operation, as described by the
+ * \c CXErrorCode enum: \c CXError_Canceled if it was cancelled before it
+ * completed, or the error code the synchronous variant would have returned.
+ */
+CINDEX_LINKAGE enum CXErrorCode
+clang_AsyncOperation_wait(CXAsyncOperation Op);
+
+/**
+ * \brief Cancel an asynchronous operation if it is still running, wait for it
+ * to finish and free it.
+ */
+CINDEX_LINKAGE void clang_AsyncOperation_dispose(CXAsyncOperation Op);
+
 /**
   * \brief Categorizes how memory is being used by a translation unit.
   */
@@ -3995,6 +4083,117 @@ CINDEX_LINKAGE unsigned clang_visitChildrenWithBlock(CXCursor parent,
 #  endif
 #endif
 
+/**
+ * \brief Flags that control how \c clang_flattenCursorSubtree() flattens a
+ * subtree.
+ */
+enum CXFlattenCursors_Flags {
+  /**
+   * \brief Used to indicate that no special flattening options are needed.
+   */
+  CXFlattenCursors_None = 0x0,
+
+  /**
+   * \brief Compute the USR of each cursor, which is comparatively costly.
+   */
+  CXFlattenCursors_IncludeUSRs = 0x1
+};
+
+/**
+ * \brief A cursor subtree flattened into parallel arrays, one element per
+ * cursor.
+ *
+ * The cursors are in the order \c clang_visitChildren() visits them when
+ * always recursing, preceded by the root of the subtree. All the arrays are
+ * owned by the structure and remain valid until it is freed with
+ * \c clang_disposeFlattenedCursors().
+ */
+typedef struct {
+  /**
+   * \brief The number of cursors in the subtree, including its root.
+   */
+  unsigned NumCursors;
+
+  /**
+   * \brief The cursors themselves.
+   */
+  const CXCursor *Cursors;
+
+  /**
+   * \brief The kind of each cursor.
+   */
+  const enum CXCursorKind *Kinds;
+
+  /**
+   * \brief The index of the parent of each cursor, or -1 for the root.
+   */
+  const int *Parents;
+
+  /**
+   * \brief The index in \c Files of the file containing the expansion
+   * location of the start of the extent of each cursor, or -1 if it has none.
+   */
+  const int *FileIndices;
+
+  /**
+   * \brief The offsets, in that file, of the expansion locations of the start
+   * and end of the extent of each cursor.
+   */
+  const unsigned *StartOffsets;
+  const unsigned *EndOffsets;
+
+  /**
+   * \brief The offset in \c USRData of the null-terminated USR of each
+   * cursor, which is empty when the cursor has no USR or when USRs were not
+   * requested.
+   */
+  const unsigned *USROffsets;
+
+  /**
+   * \brief The USRs of all cursors, each followed by a null character.
+   */
+  const char *USRData;
+
+  /**
+   * \brief The number of bytes in \c USRData.
+   */
+  unsigned USRDataSize;
+
+  /**
+   * \brief The number of distinct files the cursors are in.
+   */
+  unsigned NumFiles;
+
+  /**
+   * \brief The files the cursors are in, indexed by \c FileIndices.
+   */
+  const CXFile *Files;
+} CXFlattenedCursors;
+
+/**
+ * \brief Flatten the subtree rooted at a cursor in a single call.
+ *
+ * This gathers the data that a visitor passed to \c clang_visitChildren()
+ * would typically query for each cursor, without calling back into the
+ * client for each of them. This is much cheaper for clients that cross a
+ * language boundary on each call, such as the Python bindings.
+ *
+ * \param Root The root of the subtree.
+ *
+ * \param Options A bitmask of options, composed of the flags in
+ * \c CXFlattenCursors_Flags.
+ *
+ * \returns The flattened subtree, which must be freed with
+ * \c clang_disposeFlattenedCursors(), or NULL if \p Root is invalid.
+ */
+CINDEX_LINKAGE CXFlattenedCursors *
+clang_flattenCursorSubtree(CXCursor Root, unsigned Options);
+
+/**
+ * \brief Free a subtree flattened by \c clang_flattenCursorSubtree().
+ */
+CINDEX_LINKAGE void clang_disposeFlattenedCursors(CXFlattenedCursors *Cursors);
+
 /**
  * @}
  */
@@ -5368,6 +5567,38 @@ CXCodeCompleteResults *clang_codeCompleteAt(CXTranslationUnit TU,
                                             unsigned num_unsaved_files,
                                             unsigned options);
 
+/**
+ * \brief Perform code completion at a given location in a translation unit in
+ * the background.
+ *
+ * This is the asynchronous variant of \c clang_codeCompleteAt(), with the
+ * same requirements on the translation unit and the unsaved files as
+ * \c clang_reparseTranslationUnitAsync(). Once the operation has finished,
+ * its results are retrieved with
+ * \c clang_AsyncOperation_takeCodeCompleteResults().
+ *
+ * \returns The operation, or NULL if the arguments are invalid.
+ */
+CINDEX_LINKAGE
+CXAsyncOperation clang_codeCompleteAtAsync(CXTranslationUnit TU,
+                                           const char *complete_filename,
+                                           unsigned complete_line,
+                                           unsigned complete_column,
+                                           struct CXUnsavedFile *unsaved_files,
+                                           unsigned num_unsaved_files,
+                                           unsigned options);
+
+/**
+ * \brief Retrieve the results of an asynchronous code completion, waiting
+ * for it to finish if needed.
+ *
+ * \returns The code-completion results, which should eventually be freed
+ * with \c clang_disposeCodeCompleteResults(), or NULL if code completion
+ * failed or was cancelled, or if the results were already retrieved.
+ */
+CINDEX_LINKAGE CXCodeCompleteResults *
+clang_AsyncOperation_takeCodeCompleteResults(CXAsyncOperation Op);
+
 /**
  * \brief Sort the code-completion results in case-insensitive alphabetical 
  * order.
@@ -86,6 +86,8 @@ class BlockExpr;
 class BuiltinTemplateDecl;
 class CharUnits;
 class CXXABI;
+class ConstexprCallCache;
+class ConstexprInterpreter;
 class CXXConstructorDecl;
 class CXXMethodDecl;
 class CXXRecordDecl;
@@ -489,6 +491,10 @@ private:
   ImportDecl *FirstLocalImport = nullptr;
   ImportDecl *LastLocalImport = nullptr;
 
+  /// \brief Incremented whenever a declaration becomes visible to name lookup
+  /// in a namespace.
+  unsigned DeclarationGeneration = 0;
+
   TranslationUnitDecl *TUDecl;
   mutable ExternCContextDecl *ExternCContext = nullptr;
   mutable BuiltinTemplateDecl *MakeIntegerSeqDecl = nullptr;
@@ -939,6 +945,15 @@ public:
   /// parsed or implicitly created within this translation unit.
   void addedLocalImportDecl(ImportDecl *Import);
 
+  /// \brief Notify the AST context that a declaration has become visible to
+  /// name lookup in a namespace.
+  void declarationMadeVisible() { ++DeclarationGeneration; }
+
+  /// \brief Returns a number that changes whenever a declaration becomes
+  /// visible to name lookup in a namespace, so that the results of
+  /// semantic analysis cached by clients can be invalidated.
+  unsigned getDeclarationGeneration() const { return DeclarationGeneration; }
+
   static ImportDecl *getNextLocalImport(ImportDecl *Import) {
     return Import->NextLocalImport;
   }
@@ -2146,6 +2161,14 @@ public:
 
   VTableContextBase *getVTableContext();
 
+  /// \brief Returns the interpreter used to evaluate constexpr calls from
+  /// bytecode when -fconstexpr-bytecode is enabled.
+  ConstexprInterpreter &getConstexprInterpreter();
+
+  /// \brief Returns the cache of constexpr call results used when
+  /// -fconstexpr-cache-size is non-zero.
+  ConstexprCallCache &getConstexprCallCache();
+
   MangleContext *createMangleContext();
 
   void DeepCollectObjCIvars(const ObjCInterfaceDecl *OI, bool leafClass,
@@ -2812,6 +2835,10 @@ private:
 
   std::unique_ptr<VTableContextBase> VTContext;
 
+  std::unique_ptr<ConstexprInterpreter> ConstexprInterp;
+
+  std::unique_ptr<ConstexprCallCache> ConstexprCalls;
+
   void ReleaseDeclContextMaps();
   void ReleaseParentMapEntries();
 
@@ -235,11 +235,17 @@ public:
 
   /// \brief Open the specified file as a MemoryBuffer, returning a new
   /// MemoryBuffer if successful, otherwise returning null.
+  ///
+  /// Large files are memory-mapped unless \p isVolatile is set. If
+  /// \p RequiresNullTerminator is set, the buffer must be followed by a null
+  /// byte, which forces a copy when the file size is a multiple of the page
+  /// size; binary formats that know their length should not ask for it.
   llvm::ErrorOr<std::unique_ptr<llvm::MemoryBuffer>>
   getBufferForFile(const FileEntry *Entry, bool isVolatile = false,
-                   bool ShouldCloseOpenFile = true);
+                   bool ShouldCloseOpenFile = true,
+                   bool RequiresNullTerminator = true);
   llvm::ErrorOr<std::unique_ptr<llvm::MemoryBuffer>>
-  getBufferForFile(StringRef Filename);
+  getBufferForFile(StringRef Filename, bool RequiresNullTerminator = true);
 
   /// \brief Get the 'stat' information for the given \p Path.
   ///
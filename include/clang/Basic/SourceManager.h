@@ -89,6 +89,94 @@ namespace SrcMgr {
     return CK == C_User_ModuleMap || CK == C_System_ModuleMap;
   }
 
+  /// \brief The offsets of the physical source lines of a buffer.
+  ///
+  /// The index is built lazily: it only covers the prefix of the buffer that
+  /// line information has been requested for so far, and is extended on
+  /// demand. Lines are grouped into chunks; each chunk stores the absolute
+  /// offset of its first line, and the remaining lines are stored as ULEB128
+  /// encoded distances from the previous line, which usually take one byte.
+  class LineOffsetIndex {
+    enum { LinesPerChunk = 64 };
+
+    struct Chunk {
+      /// The offset of the first line of the chunk.
+      unsigned FirstLineStart;
+      /// The index in Deltas of the distance to the second line.
+      unsigned FirstDelta;
+    };
+
+    std::vector<Chunk> Chunks;
+    std::vector<uint8_t> Deltas;
+
+    /// The number of lines whose start is known.
+    unsigned NumLines = 0;
+    /// The offset of the last known line.
+    unsigned LastLineStart = 0;
+    /// The offset of the first byte that has not been scanned yet.  The starts
+    /// of all lines at or before it are known.
+    unsigned ScanPos = 0;
+    /// Whether the whole buffer has been scanned.
+    bool Complete = false;
+
+    void addLine(unsigned Offset);
+    void scan(const char *Buf, unsigned Size, unsigned OffsetLimit,
+              unsigned LineLimit);
+
+  public:
+    /// \brief Whether nothing has been indexed yet.
+    bool empty() const { return NumLines == 0; }
+
+    /// \brief Forget everything, e.g. because the buffer changed.
+    void clear();
+
+    /// \brief Whether the line containing \p Offset is known.
+    bool covers(unsigned Offset) const {
+      return NumLines && (Complete || ScanPos >= Offset);
+    }
+
+    /// \brief Whether the start of the 1-based line \p Line, or the fact that
+    /// there is no such line, is known.
+    bool coversLine(unsigned Line) const {
+      return Complete || NumLines >= Line;
+    }
+
+    /// \brief Scan \p Buf until the index covers \p Offset.
+    void extendToOffset(const char *Buf, unsigned Size, unsigned Offset) {
+      if (!covers(Offset))
+        scan(Buf, Size, Offset, ~0U);
+    }
+
+    /// \brief Scan \p Buf until the index covers the 1-based line \p Line.
+    void extendToLine(const char *Buf, unsigned Size, unsigned Line) {
+      if (!NumLines || !coversLine(Line))
+        scan(Buf, Size, ~0U, Line);
+    }
+
+    /// \brief The number of lines whose start is known.  If the index is
+    /// complete, this is the number of lines of the buffer.
+    unsigned getNumKnownLines() const { return NumLines; }
+
+    /// \brief Returns the offset of the start of the 0-based line \p Line,
+    /// which must be known.
+    unsigned getLineStart(unsigned Line) const;
+
+    /// \brief Returns the 1-based number of the line containing \p Offset,
+    /// which must be covered.
+    ///
+    /// \param LineStart If non-null, set to the offset of the start of that
+    /// line.
+    /// \param NextLineStart If non-null, set to the offset of the start of
+    /// the next line, or 0 if that is not known yet.
+    unsigned getLineNumber(unsigned Offset, unsigned *LineStart = nullptr,
+                           unsigned *NextLineStart = nullptr) const;
+
+    /// \brief Returns the number of bytes used by the index.
+    size_t getMemorySize() const {
+      return Chunks.capacity() * sizeof(Chunk) + Deltas.capacity();
+    }
+  };
+
   /// \brief One instance of this struct is kept for every file loaded or used.
   ///
   /// This object owns the MemoryBuffer object.
@@ -123,16 +211,8 @@ namespace SrcMgr {
     /// with the contents of another file.
     const FileEntry *ContentsEntry;
 
-    /// \brief A bump pointer allocated array of offsets for each source line.
-    ///
-    /// This is lazily computed.  This is owned by the SourceManager
-    /// BumpPointerAllocator object.
-    unsigned *SourceLineCache = nullptr;
-
-    /// \brief The number of lines in this ContentCache.
-    ///
-    /// This is only valid if SourceLineCache is non-null.
-    unsigned NumLines = 0;
+    /// \brief The offsets of the source lines, computed lazily.
+    LineOffsetIndex LineOffsets;
 
     /// \brief Indicates whether the buffer itself was provided to override
     /// the actual file contents.
@@ -157,7 +237,7 @@ namespace SrcMgr {
         BufferOverridden(false), IsSystemFile(false), IsTransient(false) {}
     
     /// The copy ctor does not allow copies where source object has either
-    /// a non-NULL Buffer or SourceLineCache.  Ownership of allocated memory
+    /// a non-NULL Buffer or a line index.  Ownership of allocated memory
     /// is not transferred, so this is a logical error.
     ContentCache(const ContentCache &RHS)
       : Buffer(nullptr, false), BufferOverridden(false), IsSystemFile(false),
@@ -166,10 +246,8 @@ namespace SrcMgr {
       ContentsEntry = RHS.ContentsEntry;
 
       assert(RHS.Buffer.getPointer() == nullptr &&
-             RHS.SourceLineCache == nullptr &&
+             RHS.LineOffsets.empty() &&
              "Passed ContentCache object cannot own a buffer.");
-
-      NumLines = RHS.NumLines;
     }
 
     ContentCache &operator=(const ContentCache& RHS) = delete;
@@ -661,8 +739,11 @@ class SourceManager : public RefCountedBase<SourceManager> {
   /// method which is used to speedup getLineNumber calls to nearby locations.
   mutable FileID LastLineNoFileIDQuery;
   mutable SrcMgr::ContentCache *LastLineNoContentCache;
-  mutable unsigned LastLineNoFilePos;
   mutable unsigned LastLineNoResult;
+  /// The offsets of the start of the line LastLineNoResult and of the next
+  /// line, or 0 if the latter is not known.
+  mutable unsigned LastLineNoLineStart;
+  mutable unsigned LastLineNoNextLineStart;
 
   /// \brief The file ID for the main source file of the translation unit.
   FileID MainFileID;
@@ -0,0 +1,93 @@
+//===- TimeTrace.h - Hierarchical compile time profiler ---------*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+/// \file
+/// \brief Defines a low-overhead profiler that records nested time sections
+/// and writes them in the Chrome trace event format, which can be viewed with
+/// chrome://tracing or speedscope.
+///
+/// The profiler is per thread: every thread that wants to record sections has
+/// to initialize its own profiler. When no profiler is active, the cost of a
+/// \c TimeTraceScope is a single load of a thread-local pointer.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_CLANG_BASIC_TIMETRACE_H
+#define LLVM_CLANG_BASIC_TIMETRACE_H
+
+#include "clang/Basic/LLVM.h"
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/Compiler.h"
+#include <string>
+
+namespace clang {
+
+struct TimeTraceProfiler;
+extern LLVM_THREAD_LOCAL TimeTraceProfiler *TimeTraceProfilerInstance;
+
+/// \brief Initialize the time trace profiler of the calling thread.
+///
+/// Sections shorter than \p GranularityInMicroseconds are not written to the
+/// trace, but still contribute to the per-name totals.
+void timeTraceProfilerInitialize(unsigned GranularityInMicroseconds);
+
+/// \brief Destroy the time trace profiler of the calling thread.
+void timeTraceProfilerCleanup();
+
+/// \brief Whether the calling thread has an active time trace profiler.
+inline bool timeTraceProfilerEnabled() {
+  return TimeTraceProfilerInstance != nullptr;
+}
+
+/// \brief Write the recorded sections of the calling thread's profiler to
+/// \p OS as Chrome trace JSON. Sections that are still open are not written.
+void timeTraceProfilerWrite(raw_ostream &OS);
+
+/// \brief Open a time section named \p Name, with \p Detail describing the
+/// item being processed, such as a file or function name.
+void timeTraceProfilerBegin(StringRef Name, StringRef Detail);
+
+/// \brief Open a time section named \p Name. \p Detail is only called if the
+/// profiler is active, so expensive descriptions are only computed when
+/// needed.
+void timeTraceProfilerBegin(StringRef Name,
+                            llvm::function_ref<std::string()> Detail);
+
+/// \brief Close the innermost open time section.
+void timeTraceProfilerEnd();
+
+/// \brief RAII object that records a time section for its lifetime if the
+/// calling thread has an active time trace profiler.
+class TimeTraceScope {
+  bool Active;
+
+public:
+  TimeTraceScope(StringRef Name, StringRef Detail)
+      : Active(timeTraceProfilerEnabled()) {
+    if (Active)
+      timeTraceProfilerBegin(Name, Detail);
+  }
+  TimeTraceScope(StringRef Name, llvm::function_ref<std::string()> Detail)
+      : Active(timeTraceProfilerEnabled()) {
+    if (Active)
+      timeTraceProfilerBegin(Name, Detail);
+  }
+  ~TimeTraceScope() {
+    if (Active && timeTraceProfilerEnabled())
+      timeTraceProfilerEnd();
+  }
+
+  TimeTraceScope(const TimeTraceScope &) = delete;
+  TimeTraceScope &operator=(const TimeTraceScope &) = delete;
+};
+
+} // end namespace clang
+
+#endif // LLVM_CLANG_BASIC_TIMETRACE_H
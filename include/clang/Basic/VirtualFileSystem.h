@@ -15,6 +15,7 @@
 
 #include "clang/Basic/LLVM.h"
 #include "llvm/ADT/IntrusiveRefCntPtr.h"
+#include "llvm/ADT/STLExtras.h"
 #include "llvm/ADT/Optional.h"
 #include "llvm/ADT/SmallVector.h"
 #include "llvm/ADT/StringRef.h"
@@ -26,6 +27,7 @@
 #include "llvm/Support/raw_ostream.h"
 #include <algorithm>
 #include <cassert>
+#include <chrono>
 #include <cstdint>
 #include <ctime>
 #include <memory>
@@ -265,6 +267,17 @@ public:
 /// the operating system.
 IntrusiveRefCntPtr<FileSystem> getRealFileSystem();
 
+/// \brief Create an \p vfs::FileSystem for the 'real' file system, as seen by
+/// the operating system, that has its own working directory.
+///
+/// Unlike the file system returned by \c getRealFileSystem(), changing the
+/// working directory of the returned file system does not call chdir() and
+/// therefore does not affect the rest of the process. This makes it suitable
+/// for use from several threads at once, e.g. one instance per worker.
+/// Relative paths are resolved against the instance's working directory,
+/// which is initialized to the process's current directory.
+std::unique_ptr<FileSystem> createPhysicalFileSystem();
+
 /// \brief A file system that allows overlaying one \p AbstractFileSystem on top
 /// of another.
 ///
@@ -357,6 +370,83 @@ public:
   std::error_code setCurrentWorkingDirectory(const Twine &Path) override;
 };
 
+/// \brief A thread-safe cache of file status and file contents that can be
+/// shared by many \p FileSystem instances, threads and translation units.
+///
+/// Status results are keyed by absolute path. They are trusted for the
+/// configured status lifetime (forever by default) or until \c invalidate()
+/// is called, so that repeated lookups of the same headers across translation
+/// units do not hit the operating system.
+///
+/// File contents are keyed by file identity (\c UniqueID). Every time a file
+/// is opened, its modification time and size are compared with the cached
+/// buffer, and the buffer is re-read if the file changed. The total size of
+/// the cached buffers is bounded; least recently used buffers are evicted
+/// first. Buffers handed out by the cache keep their storage alive, so
+/// eviction never invalidates a buffer that is still in use.
+class SharedFileCache : public llvm::ThreadSafeRefCountedBase<SharedFileCache> {
+public:
+  struct Statistics {
+    uint64_t StatusHits = 0;
+    uint64_t StatusMisses = 0;
+    uint64_t BufferHits = 0;
+    uint64_t BufferMisses = 0;
+    uint64_t BufferInvalidations = 0;
+    uint64_t BufferEvictions = 0;
+  };
+
+  /// \brief The default bound on the total size of cached buffers.
+  static const uint64_t DefaultMaxBufferBytes = 1ULL << 30;
+
+  explicit SharedFileCache(uint64_t MaxBufferBytes = DefaultMaxBufferBytes);
+  ~SharedFileCache();
+
+  /// \brief Returns the process-wide cache.
+  static IntrusiveRefCntPtr<SharedFileCache> getGlobal();
+
+  /// \brief Limit how long a cached status result is trusted. A zero
+  /// lifetime disables status caching; None (the default) trusts cached
+  /// results until \c invalidate() is called.
+  void setStatusLifetime(Optional<std::chrono::milliseconds> Lifetime);
+
+  /// \brief Forget all cached status results. Cached buffers are kept, since
+  /// they are validated against the file on every open anyway.
+  void invalidate();
+
+  /// \brief Drop all cached status results and buffers.
+  void clear();
+
+  Statistics getStatistics() const;
+
+  /// \brief Returns the cached status for the absolute path \p Path, or
+  /// computes and caches it using \p Compute.
+  llvm::ErrorOr<Status>
+  getStatus(StringRef Path, llvm::function_ref<llvm::ErrorOr<Status>()> Compute);
+
+  /// \brief Returns the cached contents of the file described by \p S, or
+  /// reads and caches them using \p Read. The returned buffer is always null
+  /// terminated.
+  llvm::ErrorOr<std::shared_ptr<llvm::MemoryBuffer>> getBuffer(
+      const Status &S,
+      llvm::function_ref<
+          llvm::ErrorOr<std::unique_ptr<llvm::MemoryBuffer>>()> Read);
+
+private:
+  struct Implementation;
+  std::unique_ptr<Implementation> Impl;
+};
+
+/// \brief Create a file system that memoizes the status results and file
+/// contents of \p BaseFS in \p Cache.
+///
+/// Files are still opened through \p BaseFS so that changes on disk are
+/// detected, but their contents are read (or mapped) only once per process.
+/// Volatile files are never cached.
+IntrusiveRefCntPtr<FileSystem>
+createCachingFileSystem(IntrusiveRefCntPtr<FileSystem> BaseFS,
+                        IntrusiveRefCntPtr<SharedFileCache> Cache =
+                            SharedFileCache::getGlobal());
+
 /// \brief Get a globally unique ID for a virtual file or directory.
 llvm::sys::fs::UniqueID getNextVirtualUniqueID();
 
@@ -12,13 +12,17 @@
 
 #include "clang/Basic/LLVM.h"
 #include "llvm/IR/ModuleSummaryIndex.h"
+#include "llvm/IR/ValueHandle.h"
 #include <memory>
+#include <vector>
 
 namespace llvm {
   class BitcodeModule;
   template <typename T> class Expected;
+  class Function;
   class Module;
   class MemoryBufferRef;
+  template <typename T> class SmallPtrSetImpl;
 }
 
 namespace clang {
@@ -37,12 +41,51 @@ namespace clang {
     Backend_EmitObj        ///< Emit native object files
   };
 
+  /// Runs the per-function optimization passes of the backend on functions
+  /// as they are generated, on a thread of its own, so that they are optimized
+  /// while the rest of the translation unit is parsed.
+  ///
+  /// The module must not be used by anything else between a call to
+  /// optimize() and the following call to wait().
+  class FunctionPassPipeline {
+  public:
+    FunctionPassPipeline(DiagnosticsEngine &Diags,
+                         const HeaderSearchOptions &HeaderOpts,
+                         const CodeGenOptions &CGOpts,
+                         const TargetOptions &TOpts, const LangOptions &LOpts,
+                         llvm::Module *M);
+    ~FunctionPassPipeline();
+
+    /// Determine whether the per-function passes can run on functions as
+    /// they are generated with the given options.
+    static bool isSupported(const CodeGenOptions &CGOpts,
+                            const LangOptions &LOpts);
+
+    /// Start optimizing the given functions, skipping those deleted since.
+    void optimize(std::vector<llvm::WeakVH> Functions);
+
+    /// Wait until the functions given to optimize() are optimized.
+    void wait();
+
+    /// Add the functions optimized so far, which haven't been deleted since,
+    /// to \p Functions.
+    void getOptimizedFunctions(
+        llvm::SmallPtrSetImpl<const llvm::Function *> &Functions) const;
+
+  private:
+    struct Implementation;
+    std::unique_ptr<Implementation> Impl;
+  };
+
+  /// \param Pipeline The pipeline which already ran the per-function passes
+  /// on some of the functions of \p M, if any.
   void EmitBackendOutput(DiagnosticsEngine &Diags, const HeaderSearchOptions &,
                          const CodeGenOptions &CGOpts,
                          const TargetOptions &TOpts, const LangOptions &LOpts,
                          const llvm::DataLayout &TDesc, llvm::Module *M,
                          BackendAction Action,
-                         std::unique_ptr<raw_pwrite_stream> OS);
+                         std::unique_ptr<raw_pwrite_stream> OS,
+                         const FunctionPassPipeline *Pipeline = nullptr);
 
   void EmbedBitcode(llvm::Module *M, const CodeGenOptions &CGOpts,
                     llvm::MemoryBufferRef Buf);
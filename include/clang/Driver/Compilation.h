@@ -270,6 +270,16 @@ public:
       const JobList &Jobs,
       SmallVectorImpl<std::pair<int, const Command *>> &FailingCommands) const;
 
+  /// ExecuteJobsInParallel - Execute the jobs on up to \p NumThreads threads.
+  ///
+  /// A job starts as soon as the jobs producing its inputs have succeeded.
+  /// The output of every job is captured and printed in job order. No new
+  /// jobs are started after the first failure.
+  void ExecuteJobsInParallel(
+      const JobList &Jobs,
+      SmallVectorImpl<std::pair<int, const Command *>> &FailingCommands,
+      unsigned NumThreads) const;
+
   /// initCompilationForDiagnostics - Remove stale state and suppress output
   /// so compilation can be reexecuted to generate additional diagnostic
   /// information (e.g., preprocessed source(s)).
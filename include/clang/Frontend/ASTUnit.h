@@ -30,6 +30,7 @@
 #include "llvm/ADT/SmallVector.h"
 #include "llvm/ADT/StringMap.h"
 #include "llvm/Support/MD5.h"
+#include <atomic>
 #include <cassert>
 #include <memory>
 #include <string>
@@ -201,8 +202,15 @@ private:
   llvm::StringMap<SourceLocation> PreambleSrcLocCache;
 
 private:
-  /// The contents of the preamble.
-  llvm::Optional<PrecompiledPreamble> Preamble;
+  /// The contents of the preamble, possibly shared with other ASTUnits
+  /// through PreambleStore::getShared().
+  std::shared_ptr<PrecompiledPreamble> Preamble;
+
+  struct PreambleData;
+
+  /// \brief If the preamble was built on top of a base preamble, what we
+  /// computed while building the base.
+  std::shared_ptr<const PreambleData> PreambleBaseData;
 
   /// \brief When non-NULL, this is the buffer used to store the contents of
   /// the main file when it has been padded for use with the precompiled
@@ -335,6 +343,10 @@ private:
   /// inconsistent state, and is not safe to free.
   unsigned UnsafeToFree : 1;
 
+  /// \brief The flag set by the client to cancel the current parse or code
+  /// completion, if any.
+  const std::atomic<bool> *CancellationFlag = nullptr;
+
   /// \brief Cache any "global" code-completion results, so that we can avoid
   /// recomputing them with each completion.
   void CacheCodeCompletionResults();
@@ -404,6 +416,20 @@ public:
   bool isUnsafeToFree() const { return UnsafeToFree; }
   void setUnsafeToFree(bool Value) { UnsafeToFree = Value; }
 
+  /// \brief Set the flag that the client sets, possibly from another thread,
+  /// to cancel the reparse or code completion in progress.
+  ///
+  /// A cancelled reparse skips building the preamble and stops parsing at the
+  /// next top-level declaration, leaving a partial AST until the next reparse.
+  void setCancellationFlag(const std::atomic<bool> *Flag);
+
+  /// \brief Returns true if the client asked to cancel the reparse or code
+  /// completion in progress.
+  bool isCancellationRequested() const {
+    return CancellationFlag &&
+           CancellationFlag->load(std::memory_order_relaxed);
+  }
+
   const DiagnosticsEngine &getDiagnostics() const { return *Diagnostics; }
   DiagnosticsEngine &getDiagnostics()             { return *Diagnostics; }
   
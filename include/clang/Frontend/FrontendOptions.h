@@ -177,6 +177,8 @@ public:
                                            /// metrics and statistics.
   unsigned ShowTimers : 1;                 ///< Show timers for individual
                                            /// actions.
+  unsigned TimeTrace : 1;                  ///< Write a Chrome trace of the
+                                           /// time spent in the frontend.
   unsigned ShowVersion : 1;                ///< Show the -version text.
   unsigned FixWhatYouCan : 1;              ///< Apply fixes even if there are
                                            /// unfixable errors.
@@ -327,10 +329,30 @@ public:
   /// Filename to write statistics to.
   std::string StatsFile;
 
+  /// Minimum time, in microseconds, of the sections written to the time
+  /// trace.
+  unsigned TimeTraceGranularity = 500;
+
+  /// If non-empty, write a report of the cost of every file of the
+  /// translation unit to this file.
+  std::string HeaderCostReport;
+
+  /// If non-empty, write a report of the cost of every template
+  /// instantiation to this file.
+  std::string TemplateInstantiationReport;
+
+  /// Whether the template instantiation report is written as JSON rather
+  /// than as text.
+  bool TemplateInstantiationReportJSON = false;
+
+  /// The maximum number of threads used to compress the source files embedded
+  /// in precompiled headers and modules. The output does not depend on it.
+  unsigned SerializationThreads = 0;
+
 public:
   FrontendOptions() :
     DisableFree(false), RelocatablePCH(false), ShowHelp(false),
-    ShowStats(false), ShowTimers(false), ShowVersion(false),
+    ShowStats(false), ShowTimers(false), TimeTrace(false), ShowVersion(false),
     FixWhatYouCan(false), FixOnlyWarnings(false), FixAndRecompile(false),
     FixToTemporaries(false), ARCMTMigrateEmitARCErrors(false),
     SkipFunctionBodies(false), UseGlobalModuleIndex(true),
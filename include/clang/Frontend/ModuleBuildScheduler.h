@@ -0,0 +1,154 @@
+//===--- ModuleBuildScheduler.h - Parallel module builds --------*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+//  This file defines the ModuleBuildScheduler class, which runs implicit
+//  module builds in parallel and lets the threads of a process wait for each
+//  other's module builds without polling lock files.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_CLANG_FRONTEND_MODULEBUILDSCHEDULER_H
+#define LLVM_CLANG_FRONTEND_MODULEBUILDSCHEDULER_H
+
+#include "clang/Basic/LLVM.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/StringMap.h"
+#include <condition_variable>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace clang {
+
+/// \brief Coordinates the implicit module builds of a process.
+///
+/// Different processes building the same module file coordinate through
+/// llvm::LockFileManager, which makes the waiting process poll the lock file.
+/// Threads of the same process additionally register the module files they
+/// build here, so that other threads needing the same module file are woken
+/// up as soon as it has been written.
+///
+/// The scheduler also runs a graph of module builds on a thread pool, starting
+/// each build once the builds it depends on have succeeded.
+///
+/// Modules that import each other without declaring it in their module maps
+/// could make two threads wait for each other's builds. The scheduler keeps
+/// track of which thread waits for which, and refuses a wait that would
+/// deadlock, so that the module can be built on the waiting thread, where the
+/// module build stack diagnoses the cycle like in a serial build.
+class ModuleBuildScheduler {
+public:
+  /// \brief A module build in a graph of builds.
+  struct Job {
+    /// \brief The indices of the jobs that have to succeed before this one is
+    /// started.
+    SmallVector<unsigned, 4> Deps;
+
+    /// \brief Builds the module. Returns false if the build failed.
+    std::function<bool()> Build;
+  };
+
+  /// \brief The outcome of waitForBuild().
+  enum WaitResult {
+    /// No thread of this process is building the module file.
+    NotBuilding,
+    /// Another thread of this process was building the module file, and is
+    /// done with it (whether it succeeded or not).
+    BuildFinished,
+    /// The thread building the module file is itself waiting, directly or
+    /// through other threads, for the current thread. The modules import
+    /// each other, and waiting would deadlock.
+    WouldDeadlock
+  };
+
+  /// \brief Registers a module file as being built by the current thread for
+  /// as long as it lives.
+  class BuildClaim {
+    ModuleBuildScheduler &Scheduler;
+    std::string ModuleFileName;
+    bool Owned;
+
+  public:
+    BuildClaim(ModuleBuildScheduler &Scheduler, StringRef ModuleFileName)
+        : Scheduler(Scheduler), ModuleFileName(ModuleFileName),
+          Owned(Scheduler.beginBuild(ModuleFileName)) {}
+    BuildClaim(const BuildClaim &) = delete;
+    BuildClaim &operator=(const BuildClaim &) = delete;
+    ~BuildClaim() {
+      if (Owned)
+        Scheduler.endBuild(ModuleFileName);
+    }
+  };
+
+  /// \brief Makes the current thread act as another, blocked thread for as
+  /// long as it lives.
+  ///
+  /// Module builds run on helper threads with a large stack while the thread
+  /// starting them waits, so for the purpose of finding waits that deadlock,
+  /// the helper thread continues the starting thread.
+  class ThreadContinuation {
+    uint64_t SavedThread;
+
+  public:
+    explicit ThreadContinuation(uint64_t Thread);
+    ThreadContinuation(const ThreadContinuation &) = delete;
+    ThreadContinuation &operator=(const ThreadContinuation &) = delete;
+    ~ThreadContinuation();
+  };
+
+  /// \brief Returns the scheduler shared by all compiler instances of the
+  /// process.
+  static ModuleBuildScheduler &get();
+
+  /// \brief Returns an identifier for the current thread, which is that of
+  /// the thread it continues, if any.
+  static uint64_t getCurrentThread();
+
+  /// \brief Note that the current thread is about to build \p ModuleFileName.
+  ///
+  /// \returns false if another thread already claimed it.
+  bool beginBuild(StringRef ModuleFileName);
+
+  /// \brief Note that the current thread is done building \p ModuleFileName,
+  /// and wake up the threads waiting for it.
+  void endBuild(StringRef ModuleFileName);
+
+  /// \brief If another thread of this process is building \p ModuleFileName,
+  /// block until it is done, unless that would deadlock.
+  WaitResult waitForBuild(StringRef ModuleFileName);
+
+  /// \brief Run \p Jobs on up to \p NumThreads threads.
+  ///
+  /// A job is started once all of its dependencies succeeded, so the jobs
+  /// depending on a failed job, or on a cycle of jobs, are never started.
+  ///
+  /// \returns for each job whether it was run and succeeded.
+  std::vector<bool> runJobs(ArrayRef<Job> Jobs, unsigned NumThreads);
+
+private:
+  /// \brief Whether \p Waiter is blocked, directly or through other threads,
+  /// until \p Target makes progress. Requires Mutex to be held.
+  bool isWaitingFor(uint64_t Waiter, uint64_t Target) const;
+
+  std::mutex Mutex;
+  std::condition_variable BuildDone;
+  /// The thread building each module file being built.
+  llvm::StringMap<uint64_t> BuildsInProgress;
+  /// The module file that each thread blocked in waitForBuild() waits for.
+  std::map<uint64_t, std::string> WaitingThreads;
+  /// The thread that called runJobs() for each thread running one of its
+  /// jobs; the caller is blocked until the job is done.
+  std::map<uint64_t, uint64_t> JobCallers;
+};
+
+} // end namespace clang
+
+#endif // LLVM_CLANG_FRONTEND_MODULEBUILDSCHEDULER_H
@@ -0,0 +1,159 @@
+//===--- PreambleStore.h - Preambles shared between ASTUnits ----*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+//  This file defines the PreambleStore class, which lets the translation units
+//  of a process share their precompiled preambles within a memory budget.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_CLANG_FRONTEND_PREAMBLESTORE_H
+#define LLVM_CLANG_FRONTEND_PREAMBLESTORE_H
+
+#include "clang/Basic/LLVM.h"
+#include "clang/Lex/Lexer.h"
+#include "llvm/ADT/Optional.h"
+#include "llvm/ADT/StringMap.h"
+#include <cstddef>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+
+namespace llvm {
+class MemoryBuffer;
+}
+
+namespace clang {
+
+class CompilerInvocation;
+class PrecompiledPreamble;
+
+/// \brief Shares precompiled preambles between translation units.
+///
+/// Hosts that keep many translation units open, such as IDEs using libclang,
+/// tend to parse many files starting with the same includes, or the same file
+/// from several indices. Each translation unit would normally build and keep
+/// its own copy of the preamble. The store lets them find the preamble
+/// another one built for the same preamble text, directory and invocation;
+/// the preamble is then validated with PrecompiledPreamble::CanReuse() as
+/// usual.
+///
+/// A preamble is built in memory if it is expected to fit in what remains of
+/// the memory budget. When the preambles of the store don't fit, the least
+/// recently used ones are moved to temporary files, including those in use by
+/// a translation unit, and when the store holds too many preambles, the least
+/// recently used ones are dropped.
+class PreambleStore {
+public:
+  /// \brief Data computed by the client that built a preamble, which the
+  /// other clients need to use the preamble. All the clients of a store have
+  /// to agree on its concrete type.
+  class ClientData {
+  public:
+    virtual ~ClientData();
+  };
+
+  /// \brief A preamble of the store and the data of its client.
+  struct Entry {
+    std::shared_ptr<PrecompiledPreamble> Preamble;
+    std::shared_ptr<const ClientData> Data;
+  };
+
+  struct Statistics {
+    /// \brief The number of preambles in the store.
+    unsigned NumPreambles = 0;
+
+    /// \brief The number of bytes used by the in-memory preambles.
+    std::size_t MemoryUsage = 0;
+
+    /// \brief The number of lookups that found a preamble.
+    unsigned NumHits = 0;
+
+    /// \brief The number of lookups that found nothing.
+    unsigned NumMisses = 0;
+
+    /// \brief The number of preambles moved to disk.
+    unsigned NumSpills = 0;
+
+    /// \brief The number of preambles dropped to make room for others.
+    unsigned NumEvictions = 0;
+  };
+
+  /// \brief Returns the store shared by all translation units of the process.
+  /// It is disabled until setLimits() is called.
+  static PreambleStore &getShared();
+
+  /// \brief Set how many bytes of preambles the store keeps in memory and how
+  /// many preambles it keeps at all. A \p MaxPreambles of zero disables the
+  /// store and drops all its preambles.
+  void setLimits(std::size_t MemoryBudget, unsigned MaxPreambles);
+
+  /// \brief Returns true if preambles should be looked up and registered.
+  bool isEnabled() const;
+
+  /// \brief Returns true if a new preamble of about \p ExpectedSize bytes, or
+  /// of unknown size if zero, should be built in memory rather than in a
+  /// temporary file.
+  bool shouldBuildInMemory(std::size_t ExpectedSize) const;
+
+  /// \brief Compute the key of the preamble of \p MainFileBuffer, the main
+  /// file of \p Invocation, given its \p Bounds.
+  ///
+  /// The key covers the text of the preamble, and the options that affect the
+  /// contents of a preamble without being checked by
+  /// PrecompiledPreamble::CanReuse(). It doesn't depend on the name of the
+  /// main file, only on its directory.
+  static std::string getKey(const CompilerInvocation &Invocation,
+                            const llvm::MemoryBuffer *MainFileBuffer,
+                            PreambleBounds Bounds);
+
+  /// \brief Find the preamble registered under \p Key, making it the most
+  /// recently used one.
+  Optional<Entry> lookup(StringRef Key);
+
+  /// \brief Register a preamble under \p Key, replacing the one registered
+  /// before, if any.
+  void insert(StringRef Key, Entry E);
+
+  /// \brief Drop the preamble registered under \p Key if it is \p Preamble,
+  /// e.g. because it turned out to be out of date.
+  void remove(StringRef Key, const PrecompiledPreamble *Preamble);
+
+  /// \brief Drop all preambles and reset the statistics.
+  void clear();
+
+  Statistics getStatistics();
+
+private:
+  struct StoredPreamble {
+    std::string Key;
+    Entry E;
+  };
+
+  /// \brief Move preambles to disk until the in-memory ones fit in the budget,
+  /// then drop preambles until there are few enough of them.
+  void enforceLimits();
+
+  /// \brief Returns the number of bytes used by the in-memory preambles.
+  std::size_t getMemoryUsage() const;
+
+  mutable std::mutex Mutex;
+  std::size_t MemoryBudget = 0;
+  unsigned MaxPreambles = 0;
+
+  /// \brief The preambles, most recently used first.
+  std::list<StoredPreamble> Preambles;
+  llvm::StringMap<std::list<StoredPreamble>::iterator> PreamblesByKey;
+
+  Statistics Stats;
+};
+
+} // end namespace clang
+
+#endif // LLVM_CLANG_FRONTEND_PREAMBLESTORE_H
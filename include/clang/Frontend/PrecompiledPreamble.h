@@ -18,9 +18,12 @@
 #include "clang/Lex/Preprocessor.h"
 #include "llvm/ADT/IntrusiveRefCntPtr.h"
 #include "llvm/Support/AlignOf.h"
+#include "llvm/Support/FileSystem.h"
 #include "llvm/Support/MD5.h"
 #include <cstddef>
+#include <map>
 #include <memory>
+#include <mutex>
 #include <system_error>
 #include <type_traits>
 
@@ -77,12 +80,19 @@ public:
   ///
   /// \param Callbacks A set of callbacks to be executed when building
   /// the preamble.
+  ///
+  /// \param Base If non-null, an up-to-date preamble of a prefix of the
+  /// preamble, see getReusablePrefix(). Only the rest of the preamble is
+  /// parsed, and its PCH is chained to the PCH of \p Base, which has to be
+  /// stored in a temporary file and must not end inside a conditional. The
+  /// new preamble keeps \p Base alive.
   static llvm::ErrorOr<PrecompiledPreamble>
   Build(const CompilerInvocation &Invocation,
         const llvm::MemoryBuffer *MainFileBuffer, PreambleBounds Bounds,
         DiagnosticsEngine &Diagnostics, IntrusiveRefCntPtr<vfs::FileSystem> VFS,
         std::shared_ptr<PCHContainerOperations> PCHContainerOps,
-        bool StoreInMemory, PreambleCallbacks &Callbacks);
+        bool StoreInMemory, PreambleCallbacks &Callbacks,
+        std::shared_ptr<const PrecompiledPreamble> Base = nullptr);
 
   PrecompiledPreamble(PrecompiledPreamble &&) = default;
   PrecompiledPreamble &operator=(PrecompiledPreamble &&) = default;
@@ -95,12 +105,44 @@ public:
   /// be used for logging and debugging purposes only.
   std::size_t getSize() const;
 
+  /// Returns true if the PCH is stored in memory rather than in a temporary
+  /// file.
+  bool isInMemory() const;
+
+  /// Moves an in-memory PCH to a temporary file. May be called while the
+  /// preamble is in use: the compiler runs and ASTs that already use the
+  /// in-memory PCH keep its memory alive until they are done with it, later
+  /// ones use the file.
+  std::error_code moveToDisk();
+
   /// Check whether PrecompiledPreamble can be reused for the new contents(\p
   /// MainFileBuffer) of the main file.
   bool CanReuse(const CompilerInvocation &Invocation,
                 const llvm::MemoryBuffer *MainFileBuffer, PreambleBounds Bounds,
                 vfs::FileSystem *VFS) const;
 
+  /// Returns the bounds of the longest prefix of the preamble that ends with
+  /// a line of an \#include directive of the main file, and that is still up
+  /// to date for the new contents (\p MainFileBuffer) of the main file. Its
+  /// size is zero if there is no such prefix.
+  ///
+  /// When CanReuse() fails because a header used by the preamble changed, a
+  /// preamble built for this prefix can serve as the base of the new one, so
+  /// that only the headers included after the changed one are parsed again.
+  PreambleBounds getReusablePrefix(const CompilerInvocation &Invocation,
+                                   const llvm::MemoryBuffer *MainFileBuffer,
+                                   vfs::FileSystem *VFS) const;
+
+  /// Returns true if the preamble ends inside a conditional directive of the
+  /// main file, e.g. inside its include guard. Such a preamble can't be the
+  /// base of another one.
+  bool endsInConditional() const { return EndsInConditional; }
+
+  /// Returns the preamble this one was built on top of, if any.
+  const std::shared_ptr<const PrecompiledPreamble> &getBase() const {
+    return Base;
+  }
+
   /// Changes options inside \p CI to use PCH from this preamble. Also remaps
   /// main file to \p MainFileBuffer and updates \p VFS to ensure the preamble
   /// is accessible.
@@ -115,7 +157,11 @@ public:
 private:
   PrecompiledPreamble(PCHStorage Storage, std::vector<char> PreambleBytes,
                       bool PreambleEndsAtStartOfLine,
-                      llvm::StringMap<PreambleFileHash> FilesInPreamble);
+                      llvm::StringMap<PreambleFileHash> FilesInPreamble,
+                      std::vector<unsigned> IncludeEnds,
+                      llvm::StringMap<unsigned> FileIncludeCounts,
+                      bool EndsInConditional,
+                      std::shared_ptr<const PrecompiledPreamble> Base);
 
   /// A temp file that would be deleted on destructor call. If destructor is not
   /// called for any reason, the file will be deleted at static objects'
@@ -157,7 +203,8 @@ private:
 
   class InMemoryPreamble {
   public:
-    std::string Data;
+    /// Shared with the buffers given to the compiler runs using the PCH.
+    std::shared_ptr<std::string> Data = std::make_shared<std::string>();
   };
 
   class PCHStorage {
@@ -229,8 +276,23 @@ private:
                                    PreprocessorOptions &PreprocessorOpts,
                                    IntrusiveRefCntPtr<vfs::FileSystem> &VFS);
 
+  /// Collects the hashes of the files remapped by \p Invocation, by unique ID.
+  /// Returns false if one of them can't be found.
+  static bool
+  getOverriddenFiles(const CompilerInvocation &Invocation,
+                     vfs::FileSystem *VFS,
+                     std::map<llvm::sys::fs::UniqueID, PreambleFileHash> &Out);
+
+  /// Returns true if the file \p Filename still matches \p Hash.
+  static bool isFileUpToDate(
+      StringRef Filename, const PreambleFileHash &Hash, vfs::FileSystem *VFS,
+      const std::map<llvm::sys::fs::UniqueID, PreambleFileHash> &Overridden);
+
   /// Manages the memory buffer or temporary file that stores the PCH.
   PCHStorage Storage;
+  /// Guards Storage, which moveToDisk() changes while other threads may be
+  /// using the preamble.
+  std::unique_ptr<std::mutex> StorageMutex;
   /// Keeps track of the files that were used when computing the
   /// preamble, with both their buffer size and their modification time.
   ///
@@ -243,6 +305,16 @@ private:
   std::vector<char> PreambleBytes;
   /// See PreambleBounds::PreambleEndsAtStartOfLine
   bool PreambleEndsAtStartOfLine;
+  /// The offsets right after the lines of the \#include directives of the
+  /// main file, including those of the base preamble.
+  std::vector<unsigned> IncludeEnds;
+  /// For the files in FilesInPreamble, the number of \#include directives of
+  /// the main file that had been processed when they were first entered.
+  llvm::StringMap<unsigned> FileIncludeCounts;
+  /// See endsInConditional().
+  bool EndsInConditional;
+  /// The preamble of a prefix this one was built on top of, if any.
+  std::shared_ptr<const PrecompiledPreamble> Base;
 };
 
 /// A set of callbacks to gather useful information while building a preamble.
@@ -53,6 +53,7 @@ class PreprocessorOutputOptions;
 class SourceManager;
 class Stmt;
 class TargetInfo;
+class TemplateInstantiationCallback;
 class FrontendOptions;
 
 /// Apply the header search options to get given HeaderSearch object.
@@ -170,6 +171,27 @@ void AttachHeaderIncludeGen(Preprocessor &PP,
                             StringRef OutputPath = "",
                             bool ShowDepth = true, bool MSStyle = false);
 
+/// AttachHeaderCostReport - Charge every file of the translation unit with
+/// the time spent while lexing it, its tokens and bytes, and the number of
+/// declarations it produced and the time spent parsing and analyzing them,
+/// both for the file itself and including everything it includes. The report
+/// is written to \p OutputFile as JSON at the end of the translation unit.
+///
+/// \returns an AST consumer that wraps \p Consumer and must be used in its
+/// place.
+std::unique_ptr<ASTConsumer>
+AttachHeaderCostReport(CompilerInstance &CI, StringRef OutputFile,
+                       std::unique_ptr<ASTConsumer> Consumer);
+
+/// Create a template instantiation callback that measures the time, the
+/// number of nested instantiations and the AST memory of every template
+/// instantiation, and writes a report ranking the templates by cost to
+/// \p OutputFile when parsing finishes.
+///
+/// \param JSON - Whether to write the report as JSON instead of text.
+std::unique_ptr<TemplateInstantiationCallback>
+createTemplateInstantiationProfiler(StringRef OutputFile, bool JSON);
+
 /// Cache tokens for use with PCH. Note that this requires a seekable stream.
 void CacheTokens(Preprocessor &PP, raw_pwrite_stream *OS);
 
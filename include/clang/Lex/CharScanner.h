@@ -0,0 +1,99 @@
+//===--- CharScanner.h - Vectorized character run scanning ------*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+//  This file defines the scanners the lexer uses to skip runs of uninteresting
+//  characters (identifier bodies, whitespace, comment and string literal
+//  bodies) many bytes at a time.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_CLANG_LEX_CHARSCANNER_H
+#define LLVM_CLANG_LEX_CHARSCANNER_H
+
+#include "clang/Basic/CharInfo.h"
+
+namespace clang {
+namespace charscan {
+
+/// The kinds of character runs that can be skipped.
+enum class RunKind {
+  /// [_A-Za-z0-9]
+  IdentifierBody,
+  /// ' ', '\\t', '\\f' and '\\v'.
+  HorizontalWhitespace,
+  /// Anything but '\\n', '\\r' and '\\0'.
+  LineCommentBody,
+  /// Anything but '"', '\\\\', '?', '\\n', '\\r' and '\\0', i.e. the characters
+  /// of a string literal that need no decoding.
+  StringLiteralBody
+};
+
+/// The implementations of the scanners.
+enum class ScanImpl {
+  /// One character at a time; always available.
+  Portable,
+  /// 16 characters at a time.
+  SSE2,
+  /// 32 characters at a time, if the host supports it.
+  AVX2
+};
+
+/// Returns true if \p Impl can be used on the host.
+bool isScanImplSupported(ScanImpl Impl);
+
+/// Returns the fastest implementation supported by the host.
+ScanImpl getBestScanImpl();
+
+/// Returns a pointer to the first character at or after \p Ptr that is not
+/// part of a run of \p Kind, using \p Impl, which must be supported.
+///
+/// Blocks of characters are only read if they end at or before \p End; past
+/// that the characters are checked one at a time, so the run must be
+/// terminated by a character that does not belong to it (e.g. the nul
+/// terminator of a memory buffer).
+const char *skipRun(RunKind Kind, const char *Ptr, const char *End,
+                    ScanImpl Impl);
+
+/// Like the above, using the fastest implementation supported by the host.
+const char *skipRun(RunKind Kind, const char *Ptr, const char *End);
+
+/// Skip over the characters of an identifier, starting at \p Ptr.
+inline const char *skipIdentifierBody(const char *Ptr, const char *End) {
+  // Most identifiers are short; finish those without calling the scanner.
+  for (unsigned I = 0; I != 8; ++I, ++Ptr)
+    if (!isIdentifierBody(*Ptr))
+      return Ptr;
+  return skipRun(RunKind::IdentifierBody, Ptr, End);
+}
+
+/// Skip over horizontal whitespace, starting at \p Ptr.
+inline const char *skipHorizontalWhitespace(const char *Ptr,
+                                            const char *End) {
+  // Runs of whitespace are mostly a single space or a short indentation.
+  for (unsigned I = 0; I != 4; ++I, ++Ptr)
+    if (!isHorizontalWhitespace(*Ptr))
+      return Ptr;
+  return skipRun(RunKind::HorizontalWhitespace, Ptr, End);
+}
+
+/// Skip to the first newline or nul character at or after \p Ptr.
+inline const char *skipLineCommentBody(const char *Ptr, const char *End) {
+  return skipRun(RunKind::LineCommentBody, Ptr, End);
+}
+
+/// Skip to the first character at or after \p Ptr that may end a string
+/// literal or needs decoding (an escape, trigraph, newline or nul).
+inline const char *skipStringLiteralBody(const char *Ptr, const char *End) {
+  return skipRun(RunKind::StringLiteralBody, Ptr, End);
+}
+
+} // end namespace charscan
+} // end namespace clang
+
+#endif // LLVM_CLANG_LEX_CHARSCANNER_H
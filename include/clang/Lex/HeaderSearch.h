@@ -41,6 +41,7 @@ class FileManager;
 class HeaderMap;
 class HeaderSearchOptions;
 class IdentifierInfo;
+class IncludeGuardCache;
 class LangOptions;
 class Module;
 class Preprocessor;
@@ -86,6 +87,10 @@ struct HeaderFileInfo {
 
   /// \brief Whether this file has been looked up as a header.
   unsigned IsValid : 1;
+
+  /// \brief Whether the controlling macro was taken from the include guard
+  /// cache, and has not been confirmed by lexing the file yet.
+  unsigned ControllingMacroFromCache : 1;
   
   /// \brief The number of times the file has been included already.
   unsigned short NumIncludes = 0;
@@ -114,7 +119,8 @@ struct HeaderFileInfo {
   HeaderFileInfo()
       : isImport(false), isPragmaOnce(false), DirInfo(SrcMgr::C_User), 
         External(false), isModuleHeader(false), isCompilingModuleHeader(false),
-        Resolved(false), IndexHeaderMapHeader(false), IsValid(false)  {}
+        Resolved(false), IndexHeaderMapHeader(false), IsValid(false),
+        ControllingMacroFromCache(false) {}
 
   /// \brief Retrieve the controlling macro for this header file, if
   /// any.
@@ -255,6 +261,7 @@ class HeaderSearch {
   // Various statistics we track for performance analysis.
   unsigned NumIncluded = 0;
   unsigned NumMultiIncludeFileOptzn = 0;
+  unsigned NumIncludeGuardCacheOptzn = 0;
   unsigned NumFrameworkLookups = 0;
   unsigned NumSubFrameworkLookups = 0;
 
@@ -465,6 +472,14 @@ public:
     getFileInfo(File).ControllingMacro = ControllingMacro;
   }
 
+  /// \brief Note that \p File, with the given contents, was lexed to its end
+  /// and found to be guarded by \p ControllingMacro (null if it is not
+  /// guarded), updating \p Cache and dropping a controlling macro taken from
+  /// it that the file did not honor.
+  void UpdateIncludeGuardCache(IncludeGuardCache &Cache, const FileEntry *File,
+                               const IdentifierInfo *ControllingMacro,
+                               StringRef Contents);
+
   /// \brief Return true if this is the first time encountering this header.
   bool FirstTimeLexingFile(const FileEntry *File) {
     return getFileInfo(File).NumIncludes == 1;
@@ -160,6 +160,11 @@ public:
   /// regenerated often.
   unsigned ModuleCachePruneAfter = 31 * 24 * 60 * 60;
 
+  /// \brief The number of threads used to build the modules a module depends
+  /// on before building the module itself, or 0 to build each module when it
+  /// is first imported.
+  unsigned ModuleBuildThreads = 0;
+
   /// \brief The time in seconds when the build session started.
   ///
   /// This time is used by other optimizations in header search and module
@@ -203,6 +208,10 @@ public:
 
   unsigned ModulesHashContent : 1;
 
+  /// \brief Whether the module files built in the module cache are stored as
+  /// chunks shared between all of them (see ModuleChunkStore).
+  unsigned ModulesDedupCache : 1;
+
   HeaderSearchOptions(StringRef _Sysroot = "/")
       : Sysroot(_Sysroot), ModuleFormat("raw"), DisableModuleHash(false),
         ImplicitModuleMaps(false), ModuleMapFileHomeIsCwd(false),
@@ -210,7 +219,8 @@ public:
         UseStandardCXXIncludes(true), UseLibcxx(false), Verbose(false),
         ModulesValidateOncePerBuildSession(false),
         ModulesValidateSystemHeaders(false), UseDebugInfo(false),
-        ModulesValidateDiagnosticOptions(true), ModulesHashContent(false) {}
+        ModulesValidateDiagnosticOptions(true), ModulesHashContent(false),
+        ModulesDedupCache(false) {}
 
   /// AddPath - Add the \p Path path to the specified \p Group list.
   void AddPath(StringRef Path, frontend::IncludeDirGroup Group,
@@ -0,0 +1,86 @@
+//===--- IncludeGuardCache.h - Include guards shared across TUs -*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+//  This file defines the IncludeGuardCache class, which remembers the include
+//  guards of header files across the translation units of a process.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_CLANG_LEX_INCLUDEGUARDCACHE_H
+#define LLVM_CLANG_LEX_INCLUDEGUARDCACHE_H
+
+#include "clang/Basic/LLVM.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/FileSystem.h"
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+namespace clang {
+
+class FileEntry;
+
+/// \brief Remembers the controlling macros of the header files lexed by the
+/// preprocessors of a process.
+///
+/// A preprocessor only learns the controlling macro of a header (its
+/// \#ifndef guard) by lexing it once. Preprocessors sharing this cache through
+/// PreprocessorOptions::IncludeGuards can skip the first \#include of a header
+/// whose guard is already defined without lexing it.
+///
+/// Entries are keyed by the file's unique ID, size and modification time, and
+/// remember a hash of the contents the guard was found in. Whenever a header
+/// is lexed to its end, its entry is checked against what the lexer found and
+/// replaced or dropped if they disagree.
+///
+/// The cache is thread-safe. The -fshare-include-guards flag makes a
+/// translation unit use the process-wide cache returned by getGlobal().
+class IncludeGuardCache {
+  struct Entry {
+    off_t Size;
+    time_t ModTime;
+    uint64_t ContentHash;
+    std::string ControllingMacro;
+  };
+
+  mutable std::mutex Mutex;
+  std::map<llvm::sys::fs::UniqueID, Entry> Entries;
+  unsigned NumInvalidations = 0;
+
+public:
+  /// \brief Returns the process-wide cache.
+  static std::shared_ptr<IncludeGuardCache> getGlobal();
+
+  /// \brief Returns the controlling macro recorded for \p File, or an empty
+  /// string if none is known for its current size and modification time.
+  std::string lookup(const FileEntry *File) const;
+
+  /// \brief Note that \p File, with the given contents, was lexed to its end
+  /// and found to be guarded by \p ControllingMacro (empty if it is not
+  /// guarded).
+  ///
+  /// \returns false if this contradicts the recorded entry for the file.
+  bool fileLexed(const FileEntry *File, StringRef ControllingMacro,
+                 StringRef Contents);
+
+  /// \brief Forget all entries.
+  void clear();
+
+  /// \brief The number of files with a known controlling macro.
+  unsigned size() const;
+
+  /// \brief The number of entries replaced or dropped because the file did not
+  /// match them.
+  unsigned getNumInvalidations() const;
+};
+
+} // end namespace clang
+
+#endif // LLVM_CLANG_LEX_INCLUDEGUARDCACHE_H
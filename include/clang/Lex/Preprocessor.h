@@ -47,9 +47,11 @@
 #include "llvm/Support/Allocator.h"
 #include "llvm/Support/Casting.h"
 #include "llvm/Support/Registry.h"
+#include <atomic>
 #include <cassert>
 #include <cstddef>
 #include <cstdint>
+#include <functional>
 #include <memory>
 #include <map>
 #include <string>
@@ -259,6 +261,10 @@ class Preprocessor {
   /// avoid tearing the Lexer and etc. down).
   bool IncrementalProcessing = false;
 
+  /// \brief The flag set by the client to cancel the processing of the
+  /// translation unit, if any.
+  const std::atomic<bool> *CancellationFlag = nullptr;
+
   /// The kind of translation unit we are processing.
   TranslationUnitKind TUKind;
 
@@ -462,6 +468,9 @@ private:
   /// encountered (e.g. a file is \#included, etc).
   std::unique_ptr<PPCallbacks> Callbacks;
 
+  /// \brief Invoked on every token returned by Lex(), if set.
+  std::function<void(const Token &)> OnToken;
+
   struct MacroExpandsInfo {
     Token Tok;
     MacroDefinition MD;
@@ -917,6 +926,14 @@ public:
   }
   /// \}
 
+  /// \brief Register a function that is called on every token returned by
+  /// Lex(), e.g. to count the tokens of each file.
+  ///
+  /// Only one watcher can be registered at a time.
+  void setTokenWatcher(std::function<void(const Token &)> F) {
+    OnToken = std::move(F);
+  }
+
   bool isMacroDefined(StringRef Id) {
     return isMacroDefined(&Identifiers.get(Id));
   }
@@ -1415,6 +1432,23 @@ public:
   void enableIncrementalProcessing(bool value = true) {
     IncrementalProcessing = value;
   }
+
+  /// \brief Set the flag that the client sets, possibly from another thread,
+  /// to cancel the processing of the translation unit.
+  ///
+  /// Cancellation is cooperative: the parser stops at the next top-level
+  /// declaration and Sema stops performing pending instantiations, as if the
+  /// end of the translation unit had been reached.
+  void setCancellationFlag(const std::atomic<bool> *Flag) {
+    CancellationFlag = Flag;
+  }
+
+  /// \brief Returns true if the client asked to cancel the processing of the
+  /// translation unit.
+  bool isCancellationRequested() const {
+    return CancellationFlag &&
+           CancellationFlag->load(std::memory_order_relaxed);
+  }
   
   /// \brief Specify the point at which code-completion will be performed.
   ///
@@ -27,6 +27,8 @@ class MemoryBuffer;
 
 namespace clang {
 
+class IncludeGuardCache;
+
 /// \brief Enumerate the kinds of standard library that 
 enum ObjCXXARCStandardLibraryKind {
   ARCXX_nolib,
@@ -155,6 +157,17 @@ public:
   /// build it again.
   std::shared_ptr<FailedModulesSet> FailedModules;
 
+  /// \brief The include guards of header files, shared with the preprocessors
+  /// of other translation units in this process, or null.
+  ///
+  /// Long-lived hosts that preprocess many translation units (e.g. libclang
+  /// clients, refactoring tools or the -cc1 compile server) can set this to
+  /// let a preprocessor skip the first \#include of a header whose guard is
+  /// already defined. -fshare-include-guards sets it to the process-wide
+  /// cache. Such a header is reported through PPCallbacks::FileSkipped rather
+  /// than PPCallbacks::FileChanged.
+  std::shared_ptr<IncludeGuardCache> IncludeGuards;
+
 public:
   PreprocessorOptions() : PrecompiledPreambleBytes(0, false) {}
 
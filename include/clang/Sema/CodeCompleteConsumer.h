@@ -25,6 +25,7 @@
 #include "llvm/Support/Allocator.h"
 #include <string>
 #include <utility>
+#include <vector>
 
 namespace clang {
 
@@ -825,6 +826,42 @@ inline bool operator>=(const CodeCompletionResult &X,
 raw_ostream &operator<<(raw_ostream &OS,
                               const CodeCompletionString &CCS);
 
+/// \brief Keeps the code-completion results with the best priority among the
+/// results it is given one at a time, up to a fixed number of them.
+///
+/// Consumers build a completion string for each result they are handed, so
+/// bounding the results before they get to the consumer avoids building the
+/// strings of results that wouldn't be shown anyway.
+class BoundedCodeCompletionResults {
+public:
+  /// \param MaxResults The number of results to keep, or 0 to keep them all.
+  explicit BoundedCodeCompletionResults(unsigned MaxResults)
+      : MaxResults(MaxResults) {}
+
+  /// \brief Add a result, dropping the worst result kept so far if there are
+  /// too many of them.
+  void add(const CodeCompletionResult &R);
+
+  /// \brief Returns the number of results added, kept or not.
+  unsigned getNumAdded() const { return NumAdded; }
+
+  /// \brief Retrieve the kept results, in the order they were added.
+  std::vector<CodeCompletionResult> takeResults();
+
+private:
+  struct KeptResult {
+    CodeCompletionResult Result;
+    unsigned Index;
+  };
+
+  unsigned MaxResults;
+  unsigned NumAdded = 0;
+
+  /// \brief The kept results. Once there are \c MaxResults of them, they form
+  /// a heap with the worst result on top.
+  std::vector<KeptResult> Kept;
+};
+
 /// \brief Abstract interface for a consumer of code-completion
 /// information.
 class CodeCompleteConsumer {
@@ -934,6 +971,10 @@ public:
     return CodeCompleteOpts.IncludeBriefComments;
   }
 
+  /// \brief The maximum number of results to hand to the consumer, or 0 for
+  /// no limit.
+  unsigned getMaxResults() const { return CodeCompleteOpts.MaxResults; }
+
   /// \brief Determine whether the output of this consumer is binary.
   bool isOutputBinary() const { return OutputIsBinary; }
 
@@ -942,6 +983,9 @@ public:
 
   /// \name Code-completion filtering
   /// \brief Check if the result should be filtered out.
+  ///
+  /// \p Filter is the identifier being completed, if any. Sema doesn't
+  /// report the results filtered out.
   virtual bool isResultFilteredOut(StringRef Filter,
                                    CodeCompletionResult Results) {
     return false;
@@ -35,9 +35,14 @@ public:
   /// Show brief documentation comments in code completion results.
   unsigned IncludeBriefComments : 1;
 
+  /// The maximum number of results to report, or 0 to report them all. When
+  /// there are more results, the ones with the best priority are reported.
+  unsigned MaxResults;
+
   CodeCompleteOptions()
       : IncludeMacros(0), IncludeCodePatterns(0), IncludeGlobals(1),
-        IncludeNamespaceLevelDecls(1), IncludeBriefComments(0) {}
+        IncludeNamespaceLevelDecls(1), IncludeBriefComments(0),
+        MaxResults(0) {}
 };
 
 } // namespace clang
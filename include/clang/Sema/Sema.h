@@ -172,6 +172,7 @@ namespace clang {
   class TemplateArgumentList;
   class TemplateArgumentLoc;
   class TemplateDecl;
+  class TemplateInstantiationCallback;
   class TemplateParameterList;
   class TemplatePartialOrderingContext;
   class TemplateTemplateParmDecl;
@@ -1058,6 +1059,53 @@ public:
   /// for C++ records.
   llvm::FoldingSet<SpecialMemberOverloadResultEntry> SpecialMemberCache;
 
+  /// \brief A successful template argument deduction from the arguments of a
+  /// call, cached when -fcache-template-deduction is enabled.
+  class CachedCallDeduction : public llvm::FoldingSetNode {
+  public:
+    struct Argument {
+      CanQualType Type;
+      ExprValueKind ValueKind;
+      ExprObjectKind ObjectKind;
+    };
+
+    /// \brief The canonical declaration of the template.
+    FunctionTemplateDecl *Template;
+
+    /// \brief The call arguments deduction was performed from.
+    ArrayRef<Argument> Args;
+
+    /// \brief The specialization produced by template argument deduction.
+    FunctionDecl *Specialization;
+
+    /// \brief The parameter types the arguments are checked against once
+    /// deduction succeeds, per DR1391.
+    ArrayRef<QualType> ParamTypesForArgChecking;
+
+    /// \brief The value of getCallDeductionGeneration() once deduction was
+    /// done. The deduction is redone when it changes.
+    unsigned Generation;
+
+    void Profile(llvm::FoldingSetNodeID &ID) { Profile(ID, Template, Args); }
+    static void Profile(llvm::FoldingSetNodeID &ID,
+                        FunctionTemplateDecl *Template,
+                        ArrayRef<Argument> Args);
+  };
+
+  /// \brief A cache of template argument deductions from call arguments,
+  /// keyed by the template and the types and classifications of the
+  /// arguments.
+  llvm::FoldingSet<CachedCallDeduction> CallDeductionCache;
+
+  /// \brief The number of template argument deductions that were found in
+  /// CallDeductionCache.
+  unsigned NumCachedCallDeductionsReused;
+
+  /// \brief Returns a number that changes whenever the deductions in
+  /// CallDeductionCache may be out of date, i.e. when a declaration becomes
+  /// visible in a namespace or an external source provides new ones.
+  unsigned getCallDeductionGeneration() const;
+
   /// \brief A cache of the flags available in enumerations with the flag_bits
   /// attribute.
   mutable llvm::DenseMap<const EnumDecl*, llvm::APInt> FlagBitsCache;
@@ -7166,6 +7214,11 @@ public:
   /// synthesis of another, additional contexts are pushed onto the stack.
   SmallVector<CodeSynthesisContext, 16> CodeSynthesisContexts;
 
+  /// \brief The callbacks notified whenever a code synthesis context is
+  /// entered or left, e.g. to profile template instantiations.
+  std::vector<std::unique_ptr<TemplateInstantiationCallback>>
+      TemplateInstCallbacks;
+
   /// Specializations whose definitions are currently being instantiated.
   llvm::DenseSet<std::pair<Decl *, unsigned>> InstantiatingSpecializations;
 
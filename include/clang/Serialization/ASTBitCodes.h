@@ -627,6 +627,10 @@ namespace serialization {
 
       /// \brief The stack of open #ifs/#ifdefs recorded in a preamble.
       PP_CONDITIONAL_STACK = 62,
+
+      /// \brief Record code for the names of the selectors that have methods
+      /// in the method pool of a module, for the global module index.
+      METHOD_POOL_NAMES = 63,
     };
 
     /// \brief Record types used within a source manager block.
@@ -8,9 +8,10 @@
 //===----------------------------------------------------------------------===//
 //
 // This file defines the GlobalModuleIndex class, which manages a global index
-// containing all of the identifiers known to the various modules within a given
-// subdirectory of the module cache. It is used to improve the performance of
-// queries such as "do any modules know about this identifier?"
+// containing all of the identifiers and Objective-C selectors known to the
+// various modules within a given subdirectory of the module cache. It is used
+// to improve the performance of queries such as "do any modules know about
+// this identifier?"
 //
 //===----------------------------------------------------------------------===//
 #ifndef LLVM_CLANG_SERIALIZATION_GLOBALMODULEINDEX_H
@@ -70,6 +71,13 @@ class GlobalModuleIndex {
   /// GlobalModuleIndex.
   void *IdentifierIndex;
 
+  /// \brief The selector hash table, mapping the names of selectors to the
+  /// modules with methods for them.
+  ///
+  /// This pointer also points to an IdentifierIndexTable object. It is null
+  /// if some of the module files did not record their selectors.
+  void *SelectorIndex;
+
   /// \brief Information about a given module file.
   struct ModuleInfo {
     ModuleInfo() : File(), Size(), ModTime() { }
@@ -115,7 +123,14 @@ class GlobalModuleIndex {
   /// \brief The number of identifier lookup hits, where we recognize the
   /// identifier.
   unsigned NumIdentifierLookupHits;
-  
+
+  /// \brief The number of selector lookups we performed.
+  unsigned NumSelectorLookups;
+
+  /// \brief The number of selector lookup hits, where some module has methods
+  /// for the selector.
+  unsigned NumSelectorLookupHits;
+
   /// \brief Internal constructor. Use \c readIndex() to read an index.
   explicit GlobalModuleIndex(std::unique_ptr<llvm::MemoryBuffer> Buffer,
                              llvm::BitstreamCursor Cursor);
@@ -179,6 +194,19 @@ public:
   /// \returns true if the identifier is known to the index, false otherwise.
   bool lookupIdentifier(StringRef Name, HitSet &Hits);
 
+  /// \brief Look for all of the module files with Objective-C methods for the
+  /// given selector.
+  ///
+  /// \param Name The name of the selector, as given by
+  /// \c Selector::getAsString().
+  ///
+  /// \param Hits Will be populated with the set of module files that have
+  /// methods for this selector.
+  ///
+  /// \returns true if the index knows about the selectors of its module files,
+  /// false otherwise.
+  bool lookupSelector(StringRef Name, HitSet &Hits);
+
   /// \brief Note that the given module file has been loaded.
   ///
   /// \returns false if the global module index has information about this
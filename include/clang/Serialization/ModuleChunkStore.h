@@ -0,0 +1,91 @@
+//===--- ModuleChunkStore.h - Deduplicated module cache storage -*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+//  This file defines the ModuleChunkStore class, which stores the module files
+//  of a module cache as lists of chunks shared between all of them.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_CLANG_SERIALIZATION_MODULECHUNKSTORE_H
+#define LLVM_CLANG_SERIALIZATION_MODULECHUNKSTORE_H
+
+#include "clang/Basic/LLVM.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/ErrorOr.h"
+#include <ctime>
+#include <memory>
+
+namespace llvm {
+class MemoryBuffer;
+}
+
+namespace clang {
+
+/// \brief Stores module files as content-defined chunks shared by all the
+/// module files of a module cache.
+///
+/// The module files built for different configurations of the same module
+/// (different macros, flags, and therefore module hashes) are mostly
+/// identical. A module file is split into chunks at positions determined by
+/// its contents, so that identical runs of bytes produce identical chunks no
+/// matter where they are in the file. Each chunk is stored once, under the
+/// hash of its contents, in the "chunks" directory of the module cache; it is
+/// compressed unless it is the whole module file. The module file itself is
+/// replaced by a small manifest listing its chunks.
+///
+/// Readers of module files call materialize() on what they read, which
+/// reassembles the module file if it is a manifest. Module files whose chunks
+/// went missing fail to load and are rebuilt like any missing module.
+class ModuleChunkStore {
+public:
+  /// \brief What storing a module file did.
+  struct StoreStatistics {
+    /// The number of chunks of the module file.
+    unsigned NumChunks = 0;
+    /// The number of those chunks that were already in the store.
+    unsigned NumSharedChunks = 0;
+  };
+
+  /// \brief Returns true if \p Contents is the manifest of a chunked module
+  /// file.
+  static bool isManifest(StringRef Contents);
+
+  /// \brief Store the contents of the module file \p ModuleFileName, which
+  /// lives in the module cache \p ModuleCachePath, as chunks and replace it
+  /// with a manifest.
+  ///
+  /// The module file is left alone if this fails. On success, \p Stats, if
+  /// given, describes how much of the module file was already stored.
+  static std::error_code storeModuleFile(StringRef ModuleFileName,
+                                         StringRef ModuleCachePath,
+                                         StoreStatistics *Stats = nullptr);
+
+  /// \brief If \p Buffer is the manifest of a chunked module file, returns a
+  /// buffer with the contents of the module file; otherwise returns
+  /// \p Buffer itself.
+  ///
+  /// A module file made of a single chunk is backed by the mapping of that
+  /// chunk. Chunk boundaries fall anywhere in the module file, so the chunks
+  /// of a larger one cannot be mapped next to each other; they are copied into
+  /// one buffer instead.
+  static llvm::ErrorOr<std::unique_ptr<llvm::MemoryBuffer>>
+  materialize(std::unique_ptr<llvm::MemoryBuffer> Buffer);
+
+  /// \brief Remove the chunks of the module cache \p ModuleCachePath that are
+  /// not used by any of its module files.
+  ///
+  /// Chunks modified less than \p GracePeriod seconds before \p CurrentTime
+  /// are kept, because they may belong to a module file being written.
+  static void pruneUnusedChunks(StringRef ModuleCachePath, time_t CurrentTime,
+                                time_t GracePeriod = 60 * 60);
+};
+
+} // end namespace clang
+
+#endif // LLVM_CLANG_SERIALIZATION_MODULECHUNKSTORE_H
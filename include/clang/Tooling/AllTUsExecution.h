@@ -0,0 +1,124 @@
+//===--- AllTUsExecution.h - Execute actions on all TUs. -*- C++ --------*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+//  This file defines a tool executor that runs given actions on all TUs in the
+//  compilation database. Translation units are processed in parallel on a
+//  pool of worker threads.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_CLANG_TOOLING_ALLTUSEXECUTION_H
+#define LLVM_CLANG_TOOLING_ALLTUSEXECUTION_H
+
+#include "clang/Tooling/ArgumentsAdjusters.h"
+#include "clang/Tooling/Execution.h"
+#include "llvm/ADT/StringMap.h"
+#include <mutex>
+
+namespace clang {
+namespace tooling {
+
+/// \brief Thread-safe result container used by \c AllTUsToolExecutor.
+///
+/// Results are recorded per translation unit and merged in the order of the
+/// translation units, so the merged results do not depend on the order in
+/// which the worker threads finish.
+class AllTUsToolResults : public ToolResults {
+public:
+  /// \brief Prepares storage for \p NumTUs translation units. Clears any
+  /// previously recorded results.
+  void reset(size_t NumTUs);
+
+  /// \brief Records a result for the translation unit being processed by the
+  /// calling thread. Results reported from threads that are not processing a
+  /// translation unit are appended after all per-TU results.
+  void addResult(StringRef Key, StringRef Value) override;
+  std::vector<std::pair<std::string, std::string>> AllKVResults() override;
+  void forEachResult(llvm::function_ref<void(StringRef Key, StringRef Value)>
+                         Callback) override;
+
+private:
+  std::mutex Mutex;
+  /// Results of translation unit #i, in the order they were reported.
+  std::vector<std::vector<std::pair<std::string, std::string>>> PerTUResults;
+  /// Results reported outside of any translation unit.
+  std::vector<std::pair<std::string, std::string>> OtherResults;
+};
+
+/// \brief Executes given frontend actions on all files/TUs in the compilation
+/// database, spreading the translation units over a pool of worker threads.
+///
+/// Every translation unit is processed by its own \c ClangTool with its own
+/// \c FileManager, on top of a physical file system whose working directory is
+/// private to the worker thread, so compile commands with different
+/// directories can run concurrently.
+///
+/// This executor uses the same default arguments adjusters as the
+/// \c StandaloneToolExecutor.
+class AllTUsToolExecutor : public ToolExecutor {
+public:
+  static const char *ExecutorName;
+
+  /// \brief Init with \p CompilationDatabase.
+  /// This uses \p ThreadCount threads to execute the actions on all files in
+  /// parallel. If \p ThreadCount is 0, this uses the number of hardware
+  /// threads.
+  AllTUsToolExecutor(const CompilationDatabase &Compilations,
+                     unsigned ThreadCount,
+                     std::shared_ptr<PCHContainerOperations> PCHContainerOps =
+                         std::make_shared<PCHContainerOperations>());
+
+  /// \brief Init with \p CommonOptionsParser. This is expected to be used by
+  /// `createExecutorFromCommandLineArgs` based on commandline options.
+  ///
+  /// The executor takes ownership of \p Options.
+  AllTUsToolExecutor(CommonOptionsParser Options, unsigned ThreadCount,
+                     std::shared_ptr<PCHContainerOperations> PCHContainerOps =
+                         std::make_shared<PCHContainerOperations>());
+
+  StringRef getExecutorName() const override { return ExecutorName; }
+
+  using ToolExecutor::execute;
+
+  llvm::Error
+  execute(llvm::ArrayRef<
+          std::pair<std::unique_ptr<FrontendActionFactory>, ArgumentsAdjuster>>
+              Actions) override;
+
+  ExecutionContext *getExecutionContext() override { return &Context; };
+
+  ToolResults *getToolResults() override { return &Results; }
+
+  void mapVirtualFile(StringRef FilePath, StringRef Content) override {
+    OverlayFiles[FilePath] = Content;
+  }
+
+private:
+  /// \brief Execution context that knows which translation unit the calling
+  /// worker thread is processing.
+  class AllTUsExecutionContext : public ExecutionContext {
+  public:
+    using ExecutionContext::ExecutionContext;
+    std::string getCurrentCompilationUnit() override;
+  };
+
+  // Used to store the parser when the executor is initialized with parser.
+  llvm::Optional<CommonOptionsParser> OptionsParser;
+  const CompilationDatabase &Compilations;
+  std::shared_ptr<PCHContainerOperations> PCHContainerOps;
+  AllTUsToolResults Results;
+  AllTUsExecutionContext Context;
+  llvm::StringMap<std::string> OverlayFiles;
+  unsigned ThreadCount;
+};
+
+} // end namespace tooling
+} // end namespace clang
+
+#endif // LLVM_CLANG_TOOLING_ALLTUSEXECUTION_H
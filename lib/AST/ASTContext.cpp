@@ -13,6 +13,8 @@
 
 #include "clang/AST/ASTContext.h"
 #include "CXXABI.h"
+#include "ConstexprCallCache.h"
+#include "ConstexprInterpreter.h"
 #include "clang/AST/APValue.h"
 #include "clang/AST/ASTMutationListener.h"
 #include "clang/AST/ASTTypeTraits.h"
@@ -914,6 +916,9 @@ void ASTContext::PrintStats() const {
                << NumImplicitDestructors
                << " implicit destructors created\n";
 
+  if (ConstexprCalls)
+    ConstexprCalls->PrintStats();
+
   if (ExternalSource) {
     llvm::errs() << "\n";
     ExternalSource->PrintStats();
@@ -9522,6 +9527,19 @@ bool ASTContext::isNearlyEmpty(const CXXRecordDecl *RD) const {
   return ABI->isNearlyEmpty(RD);
 }
 
+ConstexprInterpreter &ASTContext::getConstexprInterpreter() {
+  if (!ConstexprInterp)
+    ConstexprInterp.reset(new ConstexprInterpreter(*this));
+  return *ConstexprInterp;
+}
+
+ConstexprCallCache &ASTContext::getConstexprCallCache() {
+  if (!ConstexprCalls)
+    ConstexprCalls.reset(
+        new ConstexprCallCache(getLangOpts().ConstexprCacheSize * 1024));
+  return *ConstexprCalls;
+}
+
 VTableContextBase *ASTContext::getVTableContext() {
   if (!VTContext.get()) {
     if (Target->getCXXABI().isMicrosoft())
@@ -0,0 +1,225 @@
+//===--- ConstexprCallCache.cpp - Cache of constexpr call results ---------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file implements the cache of constexpr call results used by
+// -fconstexpr-cache-size.
+//
+//===----------------------------------------------------------------------===//
+
+#include "ConstexprCallCache.h"
+#include "llvm/Support/raw_ostream.h"
+#include <memory>
+
+using namespace clang;
+
+/// Add a cacheable value to a profile. The type of the value isn't needed:
+/// it is determined by the function and the position of the value.
+static void profileValue(llvm::FoldingSetNodeID &ID, const APValue &V) {
+  ID.AddInteger(V.getKind());
+  switch (V.getKind()) {
+  case APValue::Uninitialized:
+    return;
+  case APValue::Int:
+    V.getInt().Profile(ID);
+    return;
+  case APValue::Float:
+    V.getFloat().bitcastToAPInt().Profile(ID);
+    return;
+  case APValue::ComplexInt:
+    V.getComplexIntReal().Profile(ID);
+    V.getComplexIntImag().Profile(ID);
+    return;
+  case APValue::ComplexFloat:
+    V.getComplexFloatReal().bitcastToAPInt().Profile(ID);
+    V.getComplexFloatImag().bitcastToAPInt().Profile(ID);
+    return;
+  case APValue::Vector:
+    ID.AddInteger(V.getVectorLength());
+    for (unsigned I = 0, N = V.getVectorLength(); I != N; ++I)
+      profileValue(ID, V.getVectorElt(I));
+    return;
+  case APValue::Array:
+    ID.AddInteger(V.getArrayInitializedElts());
+    for (unsigned I = 0, N = V.getArrayInitializedElts(); I != N; ++I)
+      profileValue(ID, V.getArrayInitializedElt(I));
+    if (V.hasArrayFiller())
+      profileValue(ID, V.getArrayFiller());
+    return;
+  case APValue::Struct:
+    for (unsigned I = 0, N = V.getStructNumBases(); I != N; ++I)
+      profileValue(ID, V.getStructBase(I));
+    for (unsigned I = 0, N = V.getStructNumFields(); I != N; ++I)
+      profileValue(ID, V.getStructField(I));
+    return;
+  case APValue::Union:
+    ID.AddPointer(V.getUnionField());
+    if (V.getUnionField())
+      profileValue(ID, V.getUnionValue());
+    return;
+  case APValue::LValue:
+  case APValue::MemberPointer:
+  case APValue::AddrLabelDiff:
+    break;
+  }
+  llvm_unreachable("profiling a value that can't be cached");
+}
+
+/// Estimate the memory used by a value, beyond sizeof(APValue).
+static std::size_t getValueSize(const APValue &V) {
+  auto IntSize = [](const llvm::APInt &I) -> std::size_t {
+    return I.getNumWords() > 1 ? I.getNumWords() * sizeof(uint64_t) : 0;
+  };
+
+  std::size_t Size = 0;
+  switch (V.getKind()) {
+  case APValue::Int:
+    return IntSize(V.getInt());
+  case APValue::ComplexInt:
+    return IntSize(V.getComplexIntReal()) + IntSize(V.getComplexIntImag());
+  case APValue::Vector:
+    for (unsigned I = 0, N = V.getVectorLength(); I != N; ++I)
+      Size += sizeof(APValue) + getValueSize(V.getVectorElt(I));
+    return Size;
+  case APValue::Array:
+    for (unsigned I = 0, N = V.getArrayInitializedElts(); I != N; ++I)
+      Size += sizeof(APValue) + getValueSize(V.getArrayInitializedElt(I));
+    if (V.hasArrayFiller())
+      Size += sizeof(APValue) + getValueSize(V.getArrayFiller());
+    return Size;
+  case APValue::Struct:
+    for (unsigned I = 0, N = V.getStructNumBases(); I != N; ++I)
+      Size += sizeof(APValue) + getValueSize(V.getStructBase(I));
+    for (unsigned I = 0, N = V.getStructNumFields(); I != N; ++I)
+      Size += sizeof(APValue) + getValueSize(V.getStructField(I));
+    return Size;
+  case APValue::Union:
+    if (V.getUnionField())
+      Size = sizeof(APValue) + getValueSize(V.getUnionValue());
+    return Size;
+  default:
+    return Size;
+  }
+}
+
+void ConstexprCallCache::Entry::Profile(llvm::FoldingSetNodeID &ID,
+                                        const FunctionDecl *Callee,
+                                        ArrayRef<APValue> Args) {
+  ID.AddPointer(Callee);
+  ID.AddInteger(Args.size());
+  for (const APValue &Arg : Args)
+    profileValue(ID, Arg);
+}
+
+ConstexprCallCache::~ConstexprCallCache() {
+  Entries.clearAndDispose(std::default_delete<Entry>());
+}
+
+bool ConstexprCallCache::isCacheable(const APValue &V) {
+  switch (V.getKind()) {
+  case APValue::Uninitialized:
+  case APValue::Int:
+  case APValue::Float:
+  case APValue::ComplexInt:
+  case APValue::ComplexFloat:
+    return true;
+  case APValue::Vector:
+    for (unsigned I = 0, N = V.getVectorLength(); I != N; ++I)
+      if (!isCacheable(V.getVectorElt(I)))
+        return false;
+    return true;
+  case APValue::Array:
+    for (unsigned I = 0, N = V.getArrayInitializedElts(); I != N; ++I)
+      if (!isCacheable(V.getArrayInitializedElt(I)))
+        return false;
+    return !V.hasArrayFiller() || isCacheable(V.getArrayFiller());
+  case APValue::Struct:
+    for (unsigned I = 0, N = V.getStructNumBases(); I != N; ++I)
+      if (!isCacheable(V.getStructBase(I)))
+        return false;
+    for (unsigned I = 0, N = V.getStructNumFields(); I != N; ++I)
+      if (!isCacheable(V.getStructField(I)))
+        return false;
+    return true;
+  case APValue::Union:
+    return !V.getUnionField() || isCacheable(V.getUnionValue());
+  case APValue::LValue:
+  case APValue::MemberPointer:
+  case APValue::AddrLabelDiff:
+    return false;
+  }
+  llvm_unreachable("unknown APValue kind");
+}
+
+const ConstexprCallCache::Entry *
+ConstexprCallCache::lookup(const FunctionDecl *Callee, ArrayRef<APValue> Args,
+                           unsigned MaxSteps, unsigned MaxDepth) {
+  llvm::FoldingSetNodeID ID;
+  Entry::Profile(ID, Callee, Args);
+  void *InsertPos;
+  Entry *E = EntriesByCall.FindNodeOrInsertPos(ID, InsertPos);
+  if (!E || E->Steps > MaxSteps || E->Depth > MaxDepth) {
+    ++NumMisses;
+    return nullptr;
+  }
+
+  ++NumHits;
+  Entries.splice(Entries.begin(), Entries, E->getIterator());
+  return E;
+}
+
+void ConstexprCallCache::insert(const FunctionDecl *Callee,
+                                ArrayRef<APValue> Args, const APValue &Result,
+                                unsigned Steps, unsigned Depth) {
+  std::unique_ptr<Entry> New(new Entry);
+  New->Callee = Callee;
+  New->Args.append(Args.begin(), Args.end());
+  New->Result = Result;
+  New->Steps = Steps;
+  New->Depth = Depth;
+  New->Size = sizeof(Entry) + Args.size() * sizeof(APValue) +
+              getValueSize(Result);
+  for (const APValue &Arg : Args)
+    New->Size += getValueSize(Arg);
+  if (New->Size > MemoryBudget)
+    return;
+
+  // The call may already be cached, if it was found to take too many steps
+  // or calls to be reused; keep the cheapest evaluation.
+  llvm::FoldingSetNodeID ID;
+  Entry::Profile(ID, Callee, Args);
+  void *InsertPos;
+  if (Entry *Old = EntriesByCall.FindNodeOrInsertPos(ID, InsertPos)) {
+    if (Old->Steps <= Steps && Old->Depth <= Depth)
+      return;
+    remove(*Old);
+  }
+
+  while (MemoryUsage + New->Size > MemoryBudget) {
+    remove(Entries.back());
+    ++NumEvictions;
+  }
+
+  MemoryUsage += New->Size;
+  EntriesByCall.InsertNode(New.get());
+  Entries.push_front(*New.release());
+}
+
+void ConstexprCallCache::remove(Entry &E) {
+  EntriesByCall.RemoveNode(&E);
+  MemoryUsage -= E.Size;
+  Entries.removeAndDispose(E, std::default_delete<Entry>());
+}
+
+void ConstexprCallCache::PrintStats() const {
+  llvm::errs() << "\n*** Constexpr Call Cache Stats:\n";
+  llvm::errs() << "  " << Entries.size() << " call results cached, using "
+               << MemoryUsage << " bytes.\n";
+  llvm::errs() << "  " << NumHits << " hits, " << NumMisses << " misses, "
+               << NumEvictions << " evictions.\n";
+}
@@ -0,0 +1,105 @@
+//===--- ConstexprCallCache.h - Cache of constexpr call results -*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file defines the ConstexprCallCache class, which remembers the results
+// of constexpr function calls so that they aren't evaluated again.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_CLANG_LIB_AST_CONSTEXPRCALLCACHE_H
+#define LLVM_CLANG_LIB_AST_CONSTEXPRCALLCACHE_H
+
+#include "clang/AST/APValue.h"
+#include "clang/Basic/LLVM.h"
+#include "llvm/ADT/FoldingSet.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/simple_ilist.h"
+#include <cstddef>
+
+namespace clang {
+
+class FunctionDecl;
+
+/// \brief A cache of the results of calls to constexpr functions, keyed by
+/// the function and the values of the arguments.
+///
+/// Only calls whose arguments and result don't refer to any object can be
+/// cached: such a call can neither depend on nor change anything but its own
+/// frame and the object whose initializer is being evaluated, so unless it
+/// reads that object, evaluating it again would produce the same result. The
+/// cache holds at most a given amount of memory; the least recently used
+/// results are evicted first.
+class ConstexprCallCache {
+public:
+  /// \brief The result of a call.
+  struct Entry : llvm::FoldingSetNode, llvm::ilist_node<Entry> {
+    const FunctionDecl *Callee;
+    SmallVector<APValue, 4> Args;
+    APValue Result;
+
+    /// \brief The number of steps the evaluation of the call took.
+    unsigned Steps;
+
+    /// \brief The depth of the deepest call nested in the call, counting the
+    /// call itself as 1.
+    unsigned Depth;
+
+    /// \brief An estimate of the memory used by the entry.
+    std::size_t Size;
+
+    void Profile(llvm::FoldingSetNodeID &ID) const {
+      Profile(ID, Callee, Args);
+    }
+    static void Profile(llvm::FoldingSetNodeID &ID, const FunctionDecl *Callee,
+                        ArrayRef<APValue> Args);
+  };
+
+  /// \param MemoryBudget The maximum amount of memory, in bytes, the cached
+  /// results may use.
+  explicit ConstexprCallCache(std::size_t MemoryBudget)
+      : MemoryBudget(MemoryBudget) {}
+  ~ConstexprCallCache();
+
+  ConstexprCallCache(const ConstexprCallCache &) = delete;
+  ConstexprCallCache &operator=(const ConstexprCallCache &) = delete;
+
+  /// \brief Determine whether \p V can be part of a cached call, i.e. whether
+  /// it doesn't refer to any object.
+  static bool isCacheable(const APValue &V);
+
+  /// \brief Returns the result of an earlier call to \p Callee with \p Args,
+  /// or null if there was no such call, or if it took more than \p MaxSteps
+  /// steps or nested calls more than \p MaxDepth deep.
+  const Entry *lookup(const FunctionDecl *Callee, ArrayRef<APValue> Args,
+                      unsigned MaxSteps, unsigned MaxDepth);
+
+  /// \brief Record the result of a call, which must be cacheable.
+  void insert(const FunctionDecl *Callee, ArrayRef<APValue> Args,
+              const APValue &Result, unsigned Steps, unsigned Depth);
+
+  void PrintStats() const;
+
+private:
+  std::size_t MemoryBudget;
+  std::size_t MemoryUsage = 0;
+
+  /// \brief The cached results, most recently used first.
+  llvm::simple_ilist<Entry> Entries;
+  llvm::FoldingSet<Entry> EntriesByCall;
+
+  unsigned NumHits = 0;
+  unsigned NumMisses = 0;
+  unsigned NumEvictions = 0;
+
+  void remove(Entry &E);
+};
+
+} // end namespace clang
+
+#endif // LLVM_CLANG_LIB_AST_CONSTEXPRCALLCACHE_H
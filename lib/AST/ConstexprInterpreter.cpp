@@ -0,0 +1,1124 @@
+//===--- ConstexprInterpreter.cpp - Bytecode constexpr evaluation ---------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file implements the bytecode compiler and the stack machine used by
+// -fconstexpr-bytecode.
+//
+// Values are held in 64-bit slots: signed values are sign-extended and
+// unsigned values zero-extended from the width of their type. Each function
+// frame is a run of slots for its parameters and locals, followed by the
+// operands of the instructions being evaluated.
+//
+// The compiler only accepts what it can evaluate exactly like the AST
+// evaluator in ExprConstant.cpp does, and the machine gives up whenever the
+// AST evaluator would produce a diagnostic. Statements are counted against
+// the step limit in the same way, so -fconstexpr-steps and
+// -fconstexpr-depth apply unchanged.
+//
+//===----------------------------------------------------------------------===//
+
+#include "ConstexprInterpreter.h"
+#include "clang/AST/APValue.h"
+#include "clang/AST/ASTContext.h"
+#include "clang/AST/Decl.h"
+#include "clang/AST/DeclCXX.h"
+#include "clang/AST/Expr.h"
+#include "clang/AST/ExprCXX.h"
+#include "clang/AST/Stmt.h"
+#include "llvm/ADT/Optional.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/Support/MathExtras.h"
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+using namespace clang;
+
+namespace {
+enum class Op : uint8_t {
+  /// Push Constants[Arg].
+  Const,
+  /// Push the local Arg.
+  Load,
+  /// Push the value of Globals[Arg], read when the instruction runs.
+  LoadGlobal,
+  /// Pop a value into the local Arg.
+  Store,
+  /// Pop a value.
+  Pop,
+  /// Swap the two values on top of the stack.
+  Swap,
+  /// Jump to the instruction Arg.
+  Jump,
+  /// Pop a value and jump to the instruction Arg if it is zero.
+  JumpIfFalse,
+  /// Pop a value and jump to the instruction Arg if it isn't zero.
+  JumpIfTrue,
+  /// Count a statement against the step limit.
+  Step,
+  /// Call Callees[Arg], with its arguments on top of the stack.
+  Call,
+  /// Pop the return value and return it to the caller.
+  Return,
+  /// Give up, e.g. after flowing off the end of the function.
+  Fail,
+
+  // Unary operations, on the type of the instruction.
+  Neg,
+  Not,
+  LNot,
+  Convert,
+  ToBool,
+
+  // Binary operations. Arithmetic is performed in the type of the
+  // instruction, comparisons compare values of that type, and shifts shift
+  // values of that type by any amount.
+  Add,
+  Sub,
+  Mul,
+  Div,
+  Rem,
+  Shl,
+  Shr,
+  And,
+  Or,
+  Xor,
+  LT,
+  GT,
+  LE,
+  GE,
+  EQ,
+  NE
+};
+
+/// \brief The width and signedness of an integral type.
+struct IntType {
+  uint8_t Width;
+  bool Signed;
+};
+
+struct Instruction {
+  Op Opcode;
+  IntType Type;
+  /// A constant, local, global, callee or instruction index.
+  uint32_t Arg;
+};
+} // end anonymous namespace
+
+struct ConstexprInterpreter::CompiledFunction {
+  unsigned NumParams = 0;
+  unsigned NumLocals = 0;
+  IntType ReturnType;
+  std::vector<IntType> ParamTypes;
+  std::vector<Instruction> Code;
+  std::vector<int64_t> Constants;
+  std::vector<const VarDecl *> Globals;
+
+  struct Callee {
+    const FunctionDecl *FD;
+    /// The callee's bytecode, once the callee was first called.
+    CompiledFunction *Code;
+  };
+  std::vector<Callee> Callees;
+
+  /// Set once the function turns out to call a function that can't be
+  /// compiled.
+  bool CallsUncompilable = false;
+};
+
+/// \brief Truncate \p V to the width of \p T, then extend it back according
+/// to the signedness of \p T.
+static int64_t normalize(uint64_t V, IntType T) {
+  if (T.Width >= 64)
+    return static_cast<int64_t>(V);
+  uint64_t Mask = (uint64_t(1) << T.Width) - 1;
+  V &= Mask;
+  if (T.Signed && (V >> (T.Width - 1)) & 1)
+    V |= ~Mask;
+  return static_cast<int64_t>(V);
+}
+
+/// \brief Returns true if \p V is representable in the signed type \p T.
+static bool fitsSigned(int64_t V, IntType T) {
+  return T.Width >= 64 || normalize(V, T) == V;
+}
+
+static bool isMinSigned(int64_t V, IntType T) {
+  return V == normalize(uint64_t(1) << (T.Width - 1), T);
+}
+
+/// \brief Multiply two 64-bit signed values, returning false on overflow.
+static bool multiplySigned(int64_t A, int64_t B, int64_t &Result) {
+  uint64_t UA = A < 0 ? 0 - static_cast<uint64_t>(A) : A;
+  uint64_t UB = B < 0 ? 0 - static_cast<uint64_t>(B) : B;
+  uint64_t Product = UA * UB;
+  if (UA && Product / UA != UB)
+    return false;
+  if ((A < 0) != (B < 0)) {
+    if (Product > (uint64_t(1) << 63))
+      return false;
+    Result = static_cast<int64_t>(0 - Product);
+    return true;
+  }
+  if (Product > uint64_t(INT64_MAX))
+    return false;
+  Result = static_cast<int64_t>(Product);
+  return true;
+}
+
+/// \brief Read the value of the constant variable \p VD.
+static bool readGlobal(const VarDecl *VD, IntType T, int64_t &Result) {
+  const VarDecl *Definition = nullptr;
+  const Expr *Init = VD->getAnyInitializer(Definition);
+  if (!Init || Init->isValueDependent() || Definition->isInvalidDecl())
+    return false;
+  // Leave a variable whose initializer is being evaluated alone: checking
+  // it now would record that it isn't a constant.
+  const EvaluatedStmt *Eval = Definition->ensureEvaluatedStmt();
+  if (Eval->IsEvaluating || Eval->CheckingICE)
+    return false;
+  // The AST evaluator only notes a const variable whose initializer isn't an
+  // integral constant expression, but that's still a diagnostic.
+  if (!Definition->isConstexpr() && !Definition->checkInitIsICE())
+    return false;
+  const APValue *Value = Definition->evaluateValue();
+  if (!Value || !Value->isInt())
+    return false;
+  Result = normalize(Value->getInt().getZExtValue(), T);
+  return true;
+}
+
+/// \brief Perform a binary operation, returning false if the AST evaluator
+/// would diagnose it.
+static bool evaluateBinary(Op Opcode, IntType T, int64_t L, int64_t R,
+                           int64_t &Result) {
+  uint64_t UL = static_cast<uint64_t>(L), UR = static_cast<uint64_t>(R);
+  switch (Opcode) {
+  case Op::Add:
+    if (T.Signed) {
+      Result = static_cast<int64_t>(UL + UR);
+      return ((L ^ Result) & (R ^ Result)) >= 0 && fitsSigned(Result, T);
+    }
+    Result = normalize(UL + UR, T);
+    return true;
+  case Op::Sub:
+    if (T.Signed) {
+      Result = static_cast<int64_t>(UL - UR);
+      return ((L ^ R) & (L ^ Result)) >= 0 && fitsSigned(Result, T);
+    }
+    Result = normalize(UL - UR, T);
+    return true;
+  case Op::Mul:
+    if (T.Signed)
+      return multiplySigned(L, R, Result) && fitsSigned(Result, T);
+    Result = normalize(UL * UR, T);
+    return true;
+  case Op::Div:
+  case Op::Rem:
+    if (R == 0)
+      return false;
+    if (T.Signed) {
+      if (R == -1 && isMinSigned(L, T))
+        return false;
+      Result = Opcode == Op::Div ? L / R : L % R;
+      return true;
+    }
+    Result = normalize(Opcode == Op::Div ? UL / UR : UL % UR, T);
+    return true;
+  case Op::Shl:
+    if (R < 0 || R >= T.Width)
+      return false;
+    if (T.Signed) {
+      // C++11 [expr.shift]p2: A signed left shift must have a non-negative
+      // operand, and must not overflow the corresponding unsigned type.
+      if (L < 0)
+        return false;
+      unsigned LeadingZeros =
+          T.Width - (64 - llvm::countLeadingZeros(UL, llvm::ZB_Max));
+      if (L != 0 && LeadingZeros < R)
+        return false;
+    }
+    Result = normalize(UL << R, T);
+    return true;
+  case Op::Shr:
+    if (R < 0 || R >= T.Width)
+      return false;
+    if (T.Signed)
+      Result = L < 0 ? ~(~L >> R) : L >> R;
+    else
+      Result = static_cast<int64_t>(UL >> R);
+    return true;
+  case Op::And:
+    Result = L & R;
+    return true;
+  case Op::Or:
+    Result = L | R;
+    return true;
+  case Op::Xor:
+    Result = L ^ R;
+    return true;
+  case Op::LT:
+    Result = T.Signed ? L < R : UL < UR;
+    return true;
+  case Op::GT:
+    Result = T.Signed ? L > R : UL > UR;
+    return true;
+  case Op::LE:
+    Result = T.Signed ? L <= R : UL <= UR;
+    return true;
+  case Op::GE:
+    Result = T.Signed ? L >= R : UL >= UR;
+    return true;
+  case Op::EQ:
+    Result = L == R;
+    return true;
+  case Op::NE:
+    Result = L != R;
+    return true;
+  default:
+    llvm_unreachable("not a binary operation");
+  }
+}
+
+//===----------------------------------------------------------------------===//
+// Compilation
+//===----------------------------------------------------------------------===//
+
+namespace {
+/// \brief Compiles the body of a function. Every compile* function returns
+/// false if the construct can't be compiled.
+class FunctionCompiler {
+  ASTContext &Ctx;
+  ConstexprInterpreter::CompiledFunction &F;
+
+  /// The slots of the parameters and of the locals declared so far.
+  llvm::DenseMap<const VarDecl *, unsigned> Locals;
+  llvm::DenseMap<const FunctionDecl *, unsigned> CalleeIndices;
+
+  /// The jumps to patch at the end of the innermost loop.
+  struct LoopJumps {
+    SmallVector<unsigned, 4> Breaks;
+    SmallVector<unsigned, 4> Continues;
+  };
+  LoopJumps *CurrentLoop = nullptr;
+
+public:
+  FunctionCompiler(ASTContext &Ctx,
+                   ConstexprInterpreter::CompiledFunction &F)
+      : Ctx(Ctx), F(F) {}
+
+  bool compileFunction(const FunctionDecl *FD, const Stmt *Body);
+
+private:
+  Optional<IntType> getIntType(QualType T) const;
+
+  unsigned emit(Op Opcode, IntType T = IntType(), uint32_t Arg = 0) {
+    F.Code.push_back({Opcode, T, Arg});
+    return F.Code.size() - 1;
+  }
+  void emitConstant(int64_t V) {
+    F.Constants.push_back(V);
+    emit(Op::Const, IntType(), F.Constants.size() - 1);
+  }
+  /// Point the jump at \p Jump to the next instruction.
+  void patchJump(unsigned Jump) { F.Code[Jump].Arg = F.Code.size(); }
+
+  bool compileStmt(const Stmt *S);
+  bool compileVarDecl(const VarDecl *VD);
+  bool compileLoopBody(const Stmt *Body, LoopJumps &Jumps);
+
+  bool compileRValue(const Expr *E);
+  bool compileLValue(const Expr *E, unsigned &Slot);
+  bool compileDiscarded(const Expr *E);
+  bool compileCast(const CastExpr *E, IntType T);
+  bool compileUnaryOperator(const UnaryOperator *E, IntType T);
+  bool compileBinaryOperator(const BinaryOperator *E, IntType T);
+  bool compileCall(const CallExpr *E);
+  bool compileConstantRead(const VarDecl *VD);
+};
+} // end anonymous namespace
+
+Optional<IntType> FunctionCompiler::getIntType(QualType T) const {
+  if (T.isVolatileQualified() || !T->isIntegralOrEnumerationType())
+    return None;
+  if (const EnumType *ET = T->getAs<EnumType>())
+    if (!ET->getDecl()->isComplete())
+      return None;
+  unsigned Width = Ctx.getIntWidth(T);
+  if (Width == 0 || Width > 64)
+    return None;
+  return IntType{static_cast<uint8_t>(Width),
+                 T->isSignedIntegerOrEnumerationType()};
+}
+
+bool FunctionCompiler::compileFunction(const FunctionDecl *FD,
+                                       const Stmt *Body) {
+  Optional<IntType> ReturnType = getIntType(FD->getReturnType());
+  if (!ReturnType || FD->isVariadic())
+    return false;
+  F.ReturnType = *ReturnType;
+
+  for (const ParmVarDecl *PVD : FD->parameters()) {
+    Optional<IntType> T = getIntType(PVD->getType());
+    if (!T)
+      return false;
+    Locals[PVD] = F.NumLocals++;
+    F.ParamTypes.push_back(*T);
+  }
+  F.NumParams = F.NumLocals;
+
+  if (!compileStmt(Body))
+    return false;
+  // Flowing off the end of the function is diagnosed by the AST evaluator.
+  emit(Op::Fail);
+  return true;
+}
+
+bool FunctionCompiler::compileStmt(const Stmt *S) {
+  // Mirror the Info.nextStep() call at the start of EvaluateStmt.
+  emit(Op::Step);
+
+  switch (S->getStmtClass()) {
+  default:
+    if (const Expr *E = dyn_cast<Expr>(S))
+      return compileDiscarded(E);
+    return false;
+
+  case Stmt::NullStmtClass:
+    return true;
+
+  case Stmt::CompoundStmtClass:
+    for (const Stmt *Child : cast<CompoundStmt>(S)->body())
+      if (!compileStmt(Child))
+        return false;
+    return true;
+
+  case Stmt::DeclStmtClass:
+    for (const Decl *D : cast<DeclStmt>(S)->decls()) {
+      if (const VarDecl *VD = dyn_cast<VarDecl>(D)) {
+        if (!compileVarDecl(VD))
+          return false;
+      } else if (!isa<TypeDecl>(D) && !isa<StaticAssertDecl>(D) &&
+                 !isa<UsingDecl>(D) && !isa<UsingDirectiveDecl>(D)) {
+        return false;
+      }
+    }
+    return true;
+
+  case Stmt::ReturnStmtClass: {
+    const Expr *RetExpr = cast<ReturnStmt>(S)->getRetValue();
+    if (!RetExpr || !compileRValue(RetExpr))
+      return false;
+    emit(Op::Return);
+    return true;
+  }
+
+  case Stmt::IfStmtClass: {
+    const IfStmt *IS = cast<IfStmt>(S);
+    if (IS->getInit() && !compileStmt(IS->getInit()))
+      return false;
+    if (IS->getConditionVariable() &&
+        !compileVarDecl(IS->getConditionVariable()))
+      return false;
+    if (!compileRValue(IS->getCond()))
+      return false;
+    unsigned ToElse = emit(Op::JumpIfFalse);
+    if (IS->getThen() && !compileStmt(IS->getThen()))
+      return false;
+    if (!IS->getElse()) {
+      patchJump(ToElse);
+      return true;
+    }
+    unsigned ToEnd = emit(Op::Jump);
+    patchJump(ToElse);
+    if (!compileStmt(IS->getElse()))
+      return false;
+    patchJump(ToEnd);
+    return true;
+  }
+
+  case Stmt::WhileStmtClass: {
+    const WhileStmt *WS = cast<WhileStmt>(S);
+    unsigned Cond = F.Code.size();
+    if (WS->getConditionVariable() &&
+        !compileVarDecl(WS->getConditionVariable()))
+      return false;
+    if (!compileRValue(WS->getCond()))
+      return false;
+    unsigned ToEnd = emit(Op::JumpIfFalse);
+    LoopJumps Jumps;
+    if (!compileLoopBody(WS->getBody(), Jumps))
+      return false;
+    emit(Op::Jump, IntType(), Cond);
+    for (unsigned Jump : Jumps.Continues)
+      F.Code[Jump].Arg = Cond;
+    patchJump(ToEnd);
+    for (unsigned Jump : Jumps.Breaks)
+      patchJump(Jump);
+    return true;
+  }
+
+  case Stmt::DoStmtClass: {
+    const DoStmt *DS = cast<DoStmt>(S);
+    unsigned Body = F.Code.size();
+    LoopJumps Jumps;
+    if (!compileLoopBody(DS->getBody(), Jumps))
+      return false;
+    for (unsigned Jump : Jumps.Continues)
+      patchJump(Jump);
+    if (!compileRValue(DS->getCond()))
+      return false;
+    emit(Op::JumpIfTrue, IntType(), Body);
+    for (unsigned Jump : Jumps.Breaks)
+      patchJump(Jump);
+    return true;
+  }
+
+  case Stmt::ForStmtClass: {
+    const ForStmt *FS = cast<ForStmt>(S);
+    if (FS->getInit() && !compileStmt(FS->getInit()))
+      return false;
+    unsigned Cond = F.Code.size();
+    Optional<unsigned> ToEnd;
+    if (FS->getCond()) {
+      if (FS->getConditionVariable() &&
+          !compileVarDecl(FS->getConditionVariable()))
+        return false;
+      if (!compileRValue(FS->getCond()))
+        return false;
+      ToEnd = emit(Op::JumpIfFalse);
+    }
+    LoopJumps Jumps;
+    if (!compileLoopBody(FS->getBody(), Jumps))
+      return false;
+    for (unsigned Jump : Jumps.Continues)
+      patchJump(Jump);
+    if (FS->getInc() && !compileDiscarded(FS->getInc()))
+      return false;
+    emit(Op::Jump, IntType(), Cond);
+    if (ToEnd)
+      patchJump(*ToEnd);
+    for (unsigned Jump : Jumps.Breaks)
+      patchJump(Jump);
+    return true;
+  }
+
+  case Stmt::BreakStmtClass:
+    if (!CurrentLoop)
+      return false;
+    CurrentLoop->Breaks.push_back(emit(Op::Jump));
+    return true;
+
+  case Stmt::ContinueStmtClass:
+    if (!CurrentLoop)
+      return false;
+    CurrentLoop->Continues.push_back(emit(Op::Jump));
+    return true;
+  }
+}
+
+bool FunctionCompiler::compileLoopBody(const Stmt *Body, LoopJumps &Jumps) {
+  LoopJumps *OuterLoop = CurrentLoop;
+  CurrentLoop = &Jumps;
+  bool Compiled = compileStmt(Body);
+  CurrentLoop = OuterLoop;
+  return Compiled;
+}
+
+bool FunctionCompiler::compileVarDecl(const VarDecl *VD) {
+  if (!VD->hasLocalStorage() || isa<DecompositionDecl>(VD))
+    return false;
+  Optional<IntType> T = getIntType(VD->getType());
+  // Reading an uninitialized variable is diagnosed by the AST evaluator.
+  if (!T || !VD->getInit())
+    return false;
+
+  // The variable isn't added to the locals until it is initialized, so that
+  // uses of it in its own initializer are rejected.
+  if (!compileRValue(VD->getInit()))
+    return false;
+  unsigned Slot = F.NumLocals++;
+  Locals[VD] = Slot;
+  emit(Op::Store, *T, Slot);
+  return true;
+}
+
+bool FunctionCompiler::compileDiscarded(const Expr *E) {
+  if (E->isGLValue()) {
+    unsigned Slot;
+    return compileLValue(E, Slot);
+  }
+  if (E->getType()->isVoidType()) {
+    const CastExpr *CE = dyn_cast<CastExpr>(E->IgnoreParens());
+    return CE && CE->getCastKind() == CK_ToVoid &&
+           compileDiscarded(CE->getSubExpr());
+  }
+  if (!compileRValue(E))
+    return false;
+  emit(Op::Pop);
+  return true;
+}
+
+bool FunctionCompiler::compileLValue(const Expr *E, unsigned &Slot) {
+  if (!E->isGLValue())
+    return false;
+  Optional<IntType> T = getIntType(E->getType());
+  if (!T)
+    return false;
+  bool CanModify = Ctx.getLangOpts().CPlusPlus14;
+
+  switch (E->getStmtClass()) {
+  default:
+    return false;
+
+  case Stmt::ParenExprClass:
+    return compileLValue(cast<ParenExpr>(E)->getSubExpr(), Slot);
+
+  case Stmt::DeclRefExprClass: {
+    const VarDecl *VD = dyn_cast<VarDecl>(cast<DeclRefExpr>(E)->getDecl());
+    auto Known = VD ? Locals.find(VD) : Locals.end();
+    if (Known == Locals.end())
+      return false;
+    Slot = Known->second;
+    return true;
+  }
+
+  case Stmt::UnaryOperatorClass: {
+    const UnaryOperator *UO = cast<UnaryOperator>(E);
+    if (!CanModify || !UO->isPrefix() || !UO->isIncrementDecrementOp() ||
+        E->getType()->isBooleanType())
+      return false;
+    if (!compileLValue(UO->getSubExpr(), Slot))
+      return false;
+    emit(Op::Load, *T, Slot);
+    emitConstant(1);
+    emit(UO->isIncrementOp() ? Op::Add : Op::Sub, *T);
+    emit(Op::Store, *T, Slot);
+    return true;
+  }
+
+  case Stmt::BinaryOperatorClass:
+  case Stmt::CompoundAssignOperatorClass: {
+    const BinaryOperator *BO = cast<BinaryOperator>(E);
+    if (BO->getOpcode() == BO_Comma)
+      return compileDiscarded(BO->getLHS()) &&
+             compileLValue(BO->getRHS(), Slot);
+    if (!CanModify || !BO->isAssignmentOp())
+      return false;
+
+    // Like the AST evaluator, evaluate the left-hand side first.
+    if (!compileLValue(BO->getLHS(), Slot) || !compileRValue(BO->getRHS()))
+      return false;
+    if (BO->getOpcode() == BO_Assign) {
+      emit(Op::Store, *T, Slot);
+      return true;
+    }
+
+    const CompoundAssignOperator *CAO = cast<CompoundAssignOperator>(BO);
+    Optional<IntType> LHSType = getIntType(CAO->getComputationLHSType());
+    Optional<IntType> ResultType =
+        getIntType(CAO->getComputationResultType());
+    if (!LHSType || !ResultType)
+      return false;
+    emit(Op::Load, *T, Slot);
+    emit(Op::Convert, *LHSType);
+    emit(Op::Swap);
+    Op Opcode;
+    switch (CAO->getOpForCompoundAssignment(CAO->getOpcode())) {
+    case BO_Mul: Opcode = Op::Mul; break;
+    case BO_Div: Opcode = Op::Div; break;
+    case BO_Rem: Opcode = Op::Rem; break;
+    case BO_Add: Opcode = Op::Add; break;
+    case BO_Sub: Opcode = Op::Sub; break;
+    case BO_Shl: Opcode = Op::Shl; break;
+    case BO_Shr: Opcode = Op::Shr; break;
+    case BO_And: Opcode = Op::And; break;
+    case BO_Xor: Opcode = Op::Xor; break;
+    case BO_Or: Opcode = Op::Or; break;
+    default:
+      return false;
+    }
+    emit(Opcode, *LHSType);
+    emit(E->getType()->isBooleanType() ? Op::ToBool : Op::Convert, *T);
+    emit(Op::Store, *T, Slot);
+    return true;
+  }
+  }
+}
+
+bool FunctionCompiler::compileRValue(const Expr *E) {
+  if (E->isGLValue())
+    return false;
+  Optional<IntType> T = getIntType(E->getType());
+  if (!T)
+    return false;
+
+  switch (E->getStmtClass()) {
+  default:
+    return false;
+
+  case Stmt::IntegerLiteralClass:
+    emitConstant(normalize(cast<IntegerLiteral>(E)->getValue().getZExtValue(),
+                           *T));
+    return true;
+
+  case Stmt::CharacterLiteralClass:
+    emitConstant(normalize(cast<CharacterLiteral>(E)->getValue(), *T));
+    return true;
+
+  case Stmt::CXXBoolLiteralExprClass:
+    emitConstant(cast<CXXBoolLiteralExpr>(E)->getValue());
+    return true;
+
+  case Stmt::UnaryExprOrTypeTraitExprClass: {
+    llvm::APSInt Value;
+    if (!E->EvaluateAsInt(Value, Ctx))
+      return false;
+    emitConstant(normalize(Value.getZExtValue(), *T));
+    return true;
+  }
+
+  case Stmt::ParenExprClass:
+    return compileRValue(cast<ParenExpr>(E)->getSubExpr());
+
+  case Stmt::SubstNonTypeTemplateParmExprClass:
+    return compileRValue(
+        cast<SubstNonTypeTemplateParmExpr>(E)->getReplacement());
+
+  case Stmt::CXXDefaultArgExprClass:
+    return compileRValue(cast<CXXDefaultArgExpr>(E)->getExpr());
+
+  case Stmt::InitListExprClass: {
+    const InitListExpr *ILE = cast<InitListExpr>(E);
+    return ILE->getNumInits() == 1 && compileRValue(ILE->getInit(0));
+  }
+
+  case Stmt::DeclRefExprClass: {
+    const EnumConstantDecl *ECD =
+        dyn_cast<EnumConstantDecl>(cast<DeclRefExpr>(E)->getDecl());
+    if (!ECD)
+      return false;
+    emitConstant(normalize(ECD->getInitVal().getZExtValue(), *T));
+    return true;
+  }
+
+  case Stmt::ImplicitCastExprClass:
+  case Stmt::CStyleCastExprClass:
+  case Stmt::CXXStaticCastExprClass:
+  case Stmt::CXXFunctionalCastExprClass:
+    return compileCast(cast<CastExpr>(E), *T);
+
+  case Stmt::UnaryOperatorClass:
+    return compileUnaryOperator(cast<UnaryOperator>(E), *T);
+
+  case Stmt::BinaryOperatorClass:
+    return compileBinaryOperator(cast<BinaryOperator>(E), *T);
+
+  case Stmt::ConditionalOperatorClass: {
+    const ConditionalOperator *CO = cast<ConditionalOperator>(E);
+    if (!compileRValue(CO->getCond()))
+      return false;
+    unsigned ToFalse = emit(Op::JumpIfFalse);
+    if (!compileRValue(CO->getTrueExpr()))
+      return false;
+    unsigned ToEnd = emit(Op::Jump);
+    patchJump(ToFalse);
+    if (!compileRValue(CO->getFalseExpr()))
+      return false;
+    patchJump(ToEnd);
+    return true;
+  }
+
+  case Stmt::CallExprClass:
+  case Stmt::CXXOperatorCallExprClass:
+    return compileCall(cast<CallExpr>(E));
+  }
+}
+
+bool FunctionCompiler::compileCast(const CastExpr *E, IntType T) {
+  const Expr *SubExpr = E->getSubExpr();
+  switch (E->getCastKind()) {
+  default:
+    return false;
+
+  case CK_LValueToRValue: {
+    if (const DeclRefExpr *DRE = dyn_cast<DeclRefExpr>(SubExpr->IgnoreParens()))
+      if (const VarDecl *VD = dyn_cast<VarDecl>(DRE->getDecl()))
+        if (!Locals.count(VD))
+          return compileConstantRead(VD);
+    unsigned Slot;
+    if (!compileLValue(SubExpr, Slot))
+      return false;
+    emit(Op::Load, T, Slot);
+    return true;
+  }
+
+  case CK_NoOp:
+    return compileRValue(SubExpr);
+
+  case CK_IntegralCast:
+    if (!compileRValue(SubExpr))
+      return false;
+    // Conversions to bool compare with zero rather than truncate.
+    emit(E->getType()->isBooleanType() ? Op::ToBool : Op::Convert, T);
+    return true;
+
+  case CK_IntegralToBoolean:
+    if (!compileRValue(SubExpr))
+      return false;
+    emit(Op::ToBool, T);
+    return true;
+  }
+}
+
+bool FunctionCompiler::compileConstantRead(const VarDecl *VD) {
+  if (VD->hasLocalStorage() || !VD->isUsableInConstantExpressions(Ctx))
+    return false;
+  Optional<IntType> T = getIntType(VD->getType());
+  if (!T)
+    return false;
+  // The initializer is only looked at when the read runs: the variable may
+  // be defined later, or be the one whose initializer calls this function.
+  F.Globals.push_back(VD);
+  emit(Op::LoadGlobal, *T, F.Globals.size() - 1);
+  return true;
+}
+
+bool FunctionCompiler::compileUnaryOperator(const UnaryOperator *E,
+                                            IntType T) {
+  const Expr *SubExpr = E->getSubExpr();
+  switch (E->getOpcode()) {
+  default:
+    return false;
+
+  case UO_Plus:
+    return compileRValue(SubExpr);
+
+  case UO_Minus:
+  case UO_Not:
+  case UO_LNot:
+    if (!compileRValue(SubExpr))
+      return false;
+    emit(E->getOpcode() == UO_Minus ? Op::Neg
+         : E->getOpcode() == UO_Not ? Op::Not : Op::LNot, T);
+    return true;
+
+  case UO_PostInc:
+  case UO_PostDec: {
+    if (!Ctx.getLangOpts().CPlusPlus14 || E->getType()->isBooleanType())
+      return false;
+    unsigned Slot;
+    if (!compileLValue(SubExpr, Slot))
+      return false;
+    // Leave the old value on the stack.
+    emit(Op::Load, T, Slot);
+    emit(Op::Load, T, Slot);
+    emitConstant(1);
+    emit(E->isIncrementOp() ? Op::Add : Op::Sub, T);
+    emit(Op::Store, T, Slot);
+    return true;
+  }
+  }
+}
+
+bool FunctionCompiler::compileBinaryOperator(const BinaryOperator *E,
+                                             IntType T) {
+  switch (E->getOpcode()) {
+  case BO_Comma:
+    return compileDiscarded(E->getLHS()) && compileRValue(E->getRHS());
+
+  case BO_LAnd:
+  case BO_LOr: {
+    // The right-hand side is only evaluated if the left-hand side doesn't
+    // determine the result.
+    bool IsAnd = E->getOpcode() == BO_LAnd;
+    if (!compileRValue(E->getLHS()))
+      return false;
+    unsigned ToShortCircuit = emit(IsAnd ? Op::JumpIfFalse : Op::JumpIfTrue);
+    if (!compileRValue(E->getRHS()))
+      return false;
+    emit(Op::ToBool, T);
+    unsigned ToEnd = emit(Op::Jump);
+    patchJump(ToShortCircuit);
+    emitConstant(IsAnd ? 0 : 1);
+    patchJump(ToEnd);
+    return true;
+  }
+
+  default:
+    break;
+  }
+
+  Op Opcode;
+  switch (E->getOpcode()) {
+  case BO_Mul: Opcode = Op::Mul; break;
+  case BO_Div: Opcode = Op::Div; break;
+  case BO_Rem: Opcode = Op::Rem; break;
+  case BO_Add: Opcode = Op::Add; break;
+  case BO_Sub: Opcode = Op::Sub; break;
+  case BO_Shl: Opcode = Op::Shl; break;
+  case BO_Shr: Opcode = Op::Shr; break;
+  case BO_And: Opcode = Op::And; break;
+  case BO_Xor: Opcode = Op::Xor; break;
+  case BO_Or: Opcode = Op::Or; break;
+  case BO_LT: Opcode = Op::LT; break;
+  case BO_GT: Opcode = Op::GT; break;
+  case BO_LE: Opcode = Op::LE; break;
+  case BO_GE: Opcode = Op::GE; break;
+  case BO_EQ: Opcode = Op::EQ; break;
+  case BO_NE: Opcode = Op::NE; break;
+  default:
+    return false;
+  }
+
+  // Comparisons are performed in the type of their operands.
+  if (E->isComparisonOp()) {
+    Optional<IntType> OperandType = getIntType(E->getLHS()->getType());
+    if (!OperandType)
+      return false;
+    T = *OperandType;
+  }
+
+  if (!compileRValue(E->getLHS()) || !compileRValue(E->getRHS()))
+    return false;
+  emit(Opcode, T);
+  return true;
+}
+
+bool FunctionCompiler::compileCall(const CallExpr *E) {
+  const FunctionDecl *Callee = E->getDirectCallee();
+  if (!Callee || Callee->getBuiltinID() || Callee->isVariadic() ||
+      E->getNumArgs() != Callee->getNumParams())
+    return false;
+  if (const CXXMethodDecl *MD = dyn_cast<CXXMethodDecl>(Callee))
+    if (!MD->isStatic())
+      return false;
+
+  for (const Expr *Arg : E->arguments())
+    if (!compileRValue(Arg))
+      return false;
+
+  auto Known = CalleeIndices.find(Callee);
+  unsigned Index;
+  if (Known != CalleeIndices.end()) {
+    Index = Known->second;
+  } else {
+    Index = F.Callees.size();
+    F.Callees.push_back({Callee, nullptr});
+    CalleeIndices[Callee] = Index;
+  }
+  emit(Op::Call, IntType(), Index);
+  return true;
+}
+
+//===----------------------------------------------------------------------===//
+// Evaluation
+//===----------------------------------------------------------------------===//
+
+ConstexprInterpreter::ConstexprInterpreter(ASTContext &Ctx) : Ctx(Ctx) {}
+
+ConstexprInterpreter::~ConstexprInterpreter() {}
+
+ConstexprInterpreter::CompiledFunction *
+ConstexprInterpreter::getFunction(const FunctionDecl *FD) {
+  const FunctionDecl *Definition = nullptr;
+  const Stmt *Body = FD->getBody(Definition);
+  // A function defined later may be compiled then.
+  if (!Body)
+    return nullptr;
+
+  auto Known = Functions.find(Definition);
+  if (Known != Functions.end())
+    return Known->second.get();
+
+  std::unique_ptr<CompiledFunction> Code(new CompiledFunction);
+  if (!Ctx.getLangOpts().CPlusPlus || Ctx.getLangOpts().OpenCL ||
+      !Definition->isConstexpr() || Definition->isInvalidDecl() ||
+      !FunctionCompiler(Ctx, *Code).compileFunction(Definition, Body))
+    Code.reset();
+
+  // Compiling only evaluates sizeof and alignof expressions, which call no
+  // function, so nothing else compiled this function in the meantime. If that
+  // changes, keep the first version: callers may already point to it.
+  return Functions.insert(std::make_pair(Definition, std::move(Code)))
+      .first->second.get();
+}
+
+bool ConstexprInterpreter::evaluateCall(const FunctionDecl *Callee,
+                                        ArrayRef<APValue> Args,
+                                        unsigned &StepsLeft,
+                                        unsigned CallDepth,
+                                        unsigned &DeepestCallDepth,
+                                        APValue &Result) {
+  DeepestCallDepth = CallDepth;
+  CompiledFunction *F = getFunction(Callee);
+  if (!F || F->CallsUncompilable || Args.size() != F->NumParams)
+    return false;
+
+  SmallVector<int64_t, 64> Stack;
+  for (unsigned I = 0; I != F->NumParams; ++I) {
+    if (!Args[I].isInt() ||
+        Args[I].getInt().getBitWidth() != F->ParamTypes[I].Width)
+      return false;
+    Stack.push_back(normalize(Args[I].getInt().getZExtValue(),
+                              F->ParamTypes[I]));
+  }
+  Stack.resize(F->NumLocals);
+
+  struct Frame {
+    CompiledFunction *F;
+    unsigned PC;
+    unsigned Base;
+  };
+  SmallVector<Frame, 16> Frames;
+  unsigned PC = 0;
+  unsigned Base = 0;
+  const unsigned MaxCallDepth = Ctx.getLangOpts().ConstexprCallDepth;
+
+  auto Pop = [&]() {
+    int64_t V = Stack.back();
+    Stack.pop_back();
+    return V;
+  };
+
+  while (true) {
+    const Instruction &I = F->Code[PC++];
+    switch (I.Opcode) {
+    case Op::Const:
+      Stack.push_back(F->Constants[I.Arg]);
+      break;
+
+    case Op::Load: {
+      int64_t V = Stack[Base + I.Arg];
+      Stack.push_back(V);
+      break;
+    }
+
+    case Op::LoadGlobal: {
+      int64_t V;
+      if (!readGlobal(F->Globals[I.Arg], I.Type, V))
+        return false;
+      Stack.push_back(V);
+      break;
+    }
+
+    case Op::Store:
+      Stack[Base + I.Arg] = Pop();
+      break;
+
+    case Op::Pop:
+      Stack.pop_back();
+      break;
+
+    case Op::Swap:
+      std::swap(Stack[Stack.size() - 1], Stack[Stack.size() - 2]);
+      break;
+
+    case Op::Jump:
+      PC = I.Arg;
+      break;
+
+    case Op::JumpIfFalse:
+      if (!Pop())
+        PC = I.Arg;
+      break;
+
+    case Op::JumpIfTrue:
+      if (Pop())
+        PC = I.Arg;
+      break;
+
+    case Op::Step:
+      if (!StepsLeft)
+        return false;
+      --StepsLeft;
+      break;
+
+    case Op::Call: {
+      CompiledFunction::Callee &C = F->Callees[I.Arg];
+      if (!C.Code)
+        C.Code = getFunction(C.FD);
+      if (!C.Code || C.Code->CallsUncompilable) {
+        // Remember the callee can't be compiled, so that we don't start
+        // evaluating its callers again, unless it may still be defined.
+        const FunctionDecl *Definition;
+        if (C.FD->getBody(Definition))
+          F->CallsUncompilable = true;
+        return false;
+      }
+      if (CallDepth > MaxCallDepth)
+        return false;
+      ++CallDepth;
+      DeepestCallDepth = std::max(DeepestCallDepth, CallDepth);
+      Frames.push_back({F, PC, Base});
+      F = C.Code;
+      PC = 0;
+      Base = Stack.size() - F->NumParams;
+      Stack.resize(Base + F->NumLocals);
+      break;
+    }
+
+    case Op::Return: {
+      int64_t V = normalize(Pop(), F->ReturnType);
+      Stack.resize(Base);
+      if (Frames.empty()) {
+        IntType T = F->ReturnType;
+        Result = APValue(llvm::APSInt(
+            llvm::APInt(T.Width, static_cast<uint64_t>(V), T.Signed),
+            !T.Signed));
+        return true;
+      }
+      Stack.push_back(V);
+      F = Frames.back().F;
+      PC = Frames.back().PC;
+      Base = Frames.back().Base;
+      Frames.pop_back();
+      --CallDepth;
+      break;
+    }
+
+    case Op::Fail:
+      return false;
+
+    case Op::Neg: {
+      int64_t V = Pop();
+      if (I.Type.Signed && isMinSigned(V, I.Type))
+        return false;
+      Stack.push_back(normalize(0 - static_cast<uint64_t>(V), I.Type));
+      break;
+    }
+
+    case Op::Not:
+      Stack.push_back(normalize(~static_cast<uint64_t>(Pop()), I.Type));
+      break;
+
+    case Op::LNot:
+      Stack.push_back(!Pop());
+      break;
+
+    case Op::Convert:
+      Stack.push_back(normalize(static_cast<uint64_t>(Pop()), I.Type));
+      break;
+
+    case Op::ToBool:
+      Stack.push_back(Pop() != 0);
+      break;
+
+    default: {
+      int64_t R = Pop();
+      int64_t L = Pop();
+      int64_t V;
+      if (!evaluateBinary(I.Opcode, I.Type, L, R, V))
+        return false;
+      Stack.push_back(V);
+      break;
+    }
+    }
+  }
+}
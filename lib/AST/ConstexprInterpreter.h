@@ -0,0 +1,77 @@
+//===--- ConstexprInterpreter.h - Bytecode constexpr evaluation -*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file defines the ConstexprInterpreter class, which compiles constexpr
+// functions into bytecode and evaluates calls to them on a stack machine.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_CLANG_LIB_AST_CONSTEXPRINTERPRETER_H
+#define LLVM_CLANG_LIB_AST_CONSTEXPRINTERPRETER_H
+
+#include "clang/Basic/LLVM.h"
+#include "llvm/ADT/DenseMap.h"
+#include <memory>
+
+namespace clang {
+
+class APValue;
+class ASTContext;
+class FunctionDecl;
+
+/// \brief Evaluates calls to constexpr functions from bytecode.
+///
+/// The bodies of constexpr functions are compiled into bytecode the first
+/// time they are called, and the bytecode is kept for the later calls. Only
+/// functions whose parameters, locals and return value have integral or
+/// enumeration type, and which only call functions of the same kind, can be
+/// compiled.
+///
+/// The interpreter doesn't produce diagnostics: whenever a call can't be
+/// compiled or the evaluation would fail, it gives up, and the call is
+/// evaluated from the AST instead so that the problem is diagnosed.
+class ConstexprInterpreter {
+public:
+  struct CompiledFunction;
+
+  explicit ConstexprInterpreter(ASTContext &Ctx);
+  ~ConstexprInterpreter();
+
+  /// \brief Evaluate a call to \p Callee with the given arguments.
+  ///
+  /// \param StepsLeft The number of statements that may still be evaluated,
+  /// decremented for each statement as the AST evaluator does.
+  ///
+  /// \param CallDepth The depth of the call in the constexpr call stack.
+  ///
+  /// \param DeepestCallDepth Set to the depth of the deepest call nested in
+  /// the call, or of the call itself if it makes none.
+  ///
+  /// \returns true and sets \p Result if the call was evaluated; false if it
+  /// has to be evaluated from the AST.
+  bool evaluateCall(const FunctionDecl *Callee, ArrayRef<APValue> Args,
+                    unsigned &StepsLeft, unsigned CallDepth,
+                    unsigned &DeepestCallDepth, APValue &Result);
+
+  /// \brief Returns the bytecode of \p FD, compiling it if needed, or null if
+  /// it can't be compiled.
+  CompiledFunction *getFunction(const FunctionDecl *FD);
+
+private:
+  ASTContext &Ctx;
+
+  /// \brief The compiled functions, by definition. Functions that can't be
+  /// compiled are mapped to null.
+  llvm::DenseMap<const FunctionDecl *, std::unique_ptr<CompiledFunction>>
+      Functions;
+};
+
+} // end namespace clang
+
+#endif // LLVM_CLANG_LIB_AST_CONSTEXPRINTERPRETER_H
@@ -1728,6 +1728,9 @@ void DeclContext::makeDeclVisibleInContextWithFlags(NamedDecl *D, bool Internal,
   if (shouldBeHidden(D))
     return;
 
+  if (isFileContext())
+    getParentASTContext().declarationMadeVisible();
+
   // If we already have a lookup data structure, perform the insertion into
   // it. If we might have externally-stored decls with this name, look them
   // up and perform the insertion. If this decl was declared outside its
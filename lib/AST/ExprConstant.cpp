@@ -33,6 +33,8 @@
 //
 //===----------------------------------------------------------------------===//
 
+#include "ConstexprCallCache.h"
+#include "ConstexprInterpreter.h"
 #include "clang/AST/APValue.h"
 #include "clang/AST/ASTContext.h"
 #include "clang/AST/ASTDiagnostic.h"
@@ -580,6 +582,14 @@ namespace {
     /// CallStackDepth - The number of calls in the call stack right now.
     unsigned CallStackDepth;
 
+    /// DeepestCallStackDepth - The largest number of calls there has been in
+    /// the call stack since this was last reset.
+    unsigned DeepestCallStackDepth;
+
+    /// UsedEvaluatingDecl - Whether the object whose initializer is being
+    /// evaluated has been read or modified since this was last reset.
+    bool UsedEvaluatingDecl;
+
     /// NextCallIndex - The next call index to assign.
     unsigned NextCallIndex;
 
@@ -711,7 +721,8 @@ namespace {
 
     EvalInfo(const ASTContext &C, Expr::EvalStatus &S, EvaluationMode Mode)
       : Ctx(const_cast<ASTContext &>(C)), EvalStatus(S), CurrentCall(nullptr),
-        CallStackDepth(0), NextCallIndex(1),
+        CallStackDepth(0), DeepestCallStackDepth(0), UsedEvaluatingDecl(false),
+        NextCallIndex(1),
         StepsLeft(getLangOpts().ConstexprStepLimit),
         BottomFrame(*this, SourceLocation(), nullptr, nullptr, nullptr),
         EvaluatingDecl((const ValueDecl *)nullptr),
@@ -1160,6 +1171,8 @@ CallStackFrame::CallStackFrame(EvalInfo &Info, SourceLocation CallLoc,
       Arguments(Arguments), CallLoc(CallLoc), Index(Info.NextCallIndex++) {
   Info.CurrentCall = this;
   ++Info.CallStackDepth;
+  Info.DeepestCallStackDepth =
+      std::max(Info.DeepestCallStackDepth, Info.CallStackDepth);
 }
 
 CallStackFrame::~CallStackFrame() {
@@ -2456,6 +2469,7 @@ static bool evaluateVarDeclInit(EvalInfo &Info, const Expr *E,
   // If we're currently evaluating the initializer of this declaration, use that
   // in-flight value.
   if (Info.EvaluatingDecl.dyn_cast<const ValueDecl*>() == VD) {
+    Info.UsedEvaluatingDecl = true;
     Result = Info.EvaluatingDeclValue;
     return true;
   }
@@ -3065,6 +3079,7 @@ static CompleteObject findCompleteObject(EvalInfo &Info, const Expr *E,
         // OK, we can read and modify an object if we're in the process of
         // evaluating its initializer, because its lifetime began in this
         // evaluation.
+        Info.UsedEvaluatingDecl = true;
       } else if (AK != AK_Read) {
         // All the remaining cases only permit reading.
         Info.FFDiag(E, diag::note_constexpr_modify_global);
@@ -3147,6 +3162,8 @@ static CompleteObject findCompleteObject(EvalInfo &Info, const Expr *E,
           Info.Note(MTE->getExprLoc(), diag::note_constexpr_temporary_here);
           return CompleteObject();
         }
+        if (VD && VD->getCanonicalDecl() == ED->getCanonicalDecl())
+          Info.UsedEvaluatingDecl = true;
 
         BaseVal = Info.Ctx.getMaterializedTemporaryValue(MTE, false);
         assert(BaseVal && "got reference to unevaluated temporary");
@@ -4259,20 +4276,15 @@ static bool EvaluateArgs(ArrayRef<const Expr*> Args, ArgVector &ArgValues,
   return Success;
 }
 
-/// Evaluate a function call.
-static bool HandleFunctionCall(SourceLocation CallLoc,
-                               const FunctionDecl *Callee, const LValue *This,
-                               ArrayRef<const Expr*> Args, const Stmt *Body,
-                               EvalInfo &Info, APValue &Result,
-                               const LValue *ResultSlot) {
-  ArgVector ArgValues(Args.size());
-  if (!EvaluateArgs(Args, ArgValues, Info))
-    return false;
-
-  if (!Info.CheckCallLimit(CallLoc))
-    return false;
-
-  CallStackFrame Frame(Info, CallLoc, Callee, This, ArgValues.data());
+/// Evaluate the body of a function call, once its arguments are evaluated.
+static bool EvaluateFunctionBody(SourceLocation CallLoc,
+                                 const FunctionDecl *Callee,
+                                 const LValue *This,
+                                 ArrayRef<const Expr*> Args,
+                                 APValue *ArgValues, const Stmt *Body,
+                                 EvalInfo &Info, APValue &Result,
+                                 const LValue *ResultSlot) {
+  CallStackFrame Frame(Info, CallLoc, Callee, This, ArgValues);
 
   // For a trivial copy or move assignment, perform an APValue copy. This is
   // essential for unions, where the operations performed by the assignment
@@ -4313,6 +4325,124 @@ static bool HandleFunctionCall(SourceLocation CallLoc,
   return ESR == ESR_Returned;
 }
 
+/// Evaluate a function call, once its arguments are evaluated.
+static bool EvaluateFunctionCall(SourceLocation CallLoc,
+                                 const FunctionDecl *Callee,
+                                 const LValue *This,
+                                 ArrayRef<const Expr*> Args,
+                                 ArgVector &ArgValues, const Stmt *Body,
+                                 EvalInfo &Info, APValue &Result,
+                                 const LValue *ResultSlot) {
+  // With -fconstexpr-bytecode, try to evaluate the call from bytecode. If the
+  // interpreter can't, e.g. because the evaluation fails, evaluate it from
+  // the AST so that the failure is diagnosed.
+  APValue BytecodeResult;
+  bool EvaluatedFromBytecode = false;
+  if (Info.getLangOpts().ConstexprBytecode && !This &&
+      !Info.checkingPotentialConstantExpression()) {
+    unsigned StepsLeft = Info.StepsLeft;
+    unsigned DeepestCallDepth;
+    EvaluatedFromBytecode = Info.Ctx.getConstexprInterpreter().evaluateCall(
+        Callee, ArgValues, Info.StepsLeft, Info.CallStackDepth + 1,
+        DeepestCallDepth, BytecodeResult);
+    if (EvaluatedFromBytecode && !Info.getLangOpts().ConstexprBytecodeVerify) {
+      Info.DeepestCallStackDepth =
+          std::max(Info.DeepestCallStackDepth, DeepestCallDepth);
+      Result = std::move(BytecodeResult);
+      return true;
+    }
+    Info.StepsLeft = StepsLeft;
+  }
+
+  bool Success = EvaluateFunctionBody(CallLoc, Callee, This, Args,
+                                      ArgValues.data(), Body, Info, Result,
+                                      ResultSlot);
+
+  // With -fconstexpr-bytecode-verify, both evaluations must agree.
+  if (EvaluatedFromBytecode &&
+      (!Success || !Result.isInt() ||
+       !APSInt::isSameValue(Result.getInt(), BytecodeResult.getInt())))
+    Info.Ctx.getDiagnostics().Report(CallLoc,
+                                     diag::err_constexpr_bytecode_mismatch)
+        << Callee << BytecodeResult.getInt().toString(10) << Success
+        << (Success ? Result.getAsString(Info.Ctx, Callee->getReturnType())
+                    : std::string());
+  return Success;
+}
+
+/// Evaluate a function call.
+static bool HandleFunctionCall(SourceLocation CallLoc,
+                               const FunctionDecl *Callee, const LValue *This,
+                               ArrayRef<const Expr*> Args, const Stmt *Body,
+                               EvalInfo &Info, APValue &Result,
+                               const LValue *ResultSlot) {
+  ArgVector ArgValues(Args.size());
+  if (!EvaluateArgs(Args, ArgValues, Info))
+    return false;
+
+  if (!Info.CheckCallLimit(CallLoc))
+    return false;
+
+  // With -fconstexpr-cache-size, reuse the result of an earlier call with the
+  // same arguments. A call whose arguments refer to objects may read or
+  // modify them, so it isn't cached.
+  if (!Info.getLangOpts().ConstexprCacheSize || This ||
+      Info.checkingPotentialConstantExpression() ||
+      !llvm::all_of(ArgValues, ConstexprCallCache::isCacheable))
+    return EvaluateFunctionCall(CallLoc, Callee, This, Args, ArgValues, Body,
+                                Info, Result, ResultSlot);
+
+  // The earlier call must have stayed within the limits of this one.
+  ConstexprCallCache &Cache = Info.Ctx.getConstexprCallCache();
+  unsigned DepthLeft =
+      Info.getLangOpts().ConstexprCallDepth + 1 - Info.CallStackDepth;
+  if (const ConstexprCallCache::Entry *Cached =
+          Cache.lookup(Callee, ArgValues, Info.StepsLeft, DepthLeft)) {
+    Info.StepsLeft -= Cached->Steps;
+    Info.DeepestCallStackDepth =
+        std::max(Info.DeepestCallStackDepth,
+                 Info.CallStackDepth + Cached->Depth);
+    Result = Cached->Result;
+    return true;
+  }
+
+  // Only cache results which are known to be constant expressions, i.e. for
+  // which nothing was noted. Evaluations which keep going after a failure,
+  // or which accept values that aren't constants, can't tell.
+  auto IsConstantSoFar = [&Info] {
+    return (Info.EvalMode == EvalInfo::EM_ConstantExpression ||
+            Info.EvalMode == EvalInfo::EM_ConstantExpressionUnevaluated ||
+            Info.EvalMode == EvalInfo::EM_ConstantFold ||
+            Info.EvalMode == EvalInfo::EM_IgnoreSideEffects) &&
+           Info.EvalStatus.Diag && Info.EvalStatus.Diag->empty() &&
+           !Info.EvalStatus.HasSideEffects &&
+           !Info.EvalStatus.HasUndefinedBehavior;
+  };
+  if (!IsConstantSoFar())
+    return EvaluateFunctionCall(CallLoc, Callee, This, Args, ArgValues, Body,
+                                Info, Result, ResultSlot);
+
+  // The call may modify its parameters; keep the arguments for the key.
+  ArgVector Key(ArgValues);
+  unsigned StepsLeft = Info.StepsLeft;
+  unsigned OuterDeepestCallStackDepth = Info.DeepestCallStackDepth;
+  Info.DeepestCallStackDepth = Info.CallStackDepth;
+  bool OuterUsedEvaluatingDecl = Info.UsedEvaluatingDecl;
+  Info.UsedEvaluatingDecl = false;
+  bool Success = EvaluateFunctionCall(CallLoc, Callee, This, Args, ArgValues,
+                                      Body, Info, Result, ResultSlot);
+  // A call which reads the object being initialized, which can change between
+  // calls, isn't cached, and neither are the calls around it.
+  if (Success && IsConstantSoFar() && !Info.UsedEvaluatingDecl &&
+      ConstexprCallCache::isCacheable(Result))
+    Cache.insert(Callee, Key, Result, StepsLeft - Info.StepsLeft,
+                 Info.DeepestCallStackDepth - Info.CallStackDepth);
+  Info.DeepestCallStackDepth =
+      std::max(OuterDeepestCallStackDepth, Info.DeepestCallStackDepth);
+  Info.UsedEvaluatingDecl |= OuterUsedEvaluatingDecl;
+  return Success;
+}
+
 /// Evaluate a constructor call.
 static bool HandleConstructorCall(const Expr *E, const LValue &This,
                                   APValue *ArgValues,
@@ -29,6 +29,7 @@
 #include "llvm/Support/Compiler.h"
 #include "llvm/Support/ErrorHandling.h"
 #include "llvm/Support/FileSystem.h"
+#include "llvm/Support/LEB128.h"
 #include "llvm/Support/MathExtras.h"
 #include "llvm/Support/MemoryBuffer.h"
 #include "llvm/Support/Path.h"
@@ -1116,11 +1117,10 @@ unsigned SourceManager::getColumnNumber(FileID FID, unsigned FilePos,
   // See if we just calculated the line number for this FilePos and can use
   // that to lookup the start of the line instead of searching for it.
   if (LastLineNoFileIDQuery == FID &&
-      LastLineNoContentCache->SourceLineCache != nullptr &&
-      LastLineNoResult < LastLineNoContentCache->NumLines) {
-    unsigned *SourceLineCache = LastLineNoContentCache->SourceLineCache;
-    unsigned LineStart = SourceLineCache[LastLineNoResult - 1];
-    unsigned LineEnd = SourceLineCache[LastLineNoResult];
+      !LastLineNoContentCache->LineOffsets.empty() &&
+      LastLineNoNextLineStart != 0) {
+    unsigned LineStart = LastLineNoLineStart;
+    unsigned LineEnd = LastLineNoNextLineStart;
     if (FilePos >= LineStart && FilePos < LineEnd) {
       // LineEnd is the LineStart of the next line.
       // A line ends with separator LF or CR+LF on Windows.
@@ -1175,93 +1175,133 @@ unsigned SourceManager::getPresumedColumnNumber(SourceLocation Loc,
 #include <emmintrin.h>
 #endif
 
-static LLVM_ATTRIBUTE_NOINLINE void
-ComputeLineNumbers(DiagnosticsEngine &Diag, ContentCache *FI,
-                   llvm::BumpPtrAllocator &Alloc,
-                   const SourceManager &SM, bool &Invalid);
-static void ComputeLineNumbers(DiagnosticsEngine &Diag, ContentCache *FI,
-                               llvm::BumpPtrAllocator &Alloc,
-                               const SourceManager &SM, bool &Invalid) {
-  // Note that calling 'getBuffer()' may lazily page in the file.
-  MemoryBuffer *Buffer = FI->getBuffer(Diag, SM, SourceLocation(), &Invalid);
-  if (Invalid)
-    return;
+void LineOffsetIndex::clear() {
+  Chunks.clear();
+  Deltas.clear();
+  NumLines = 0;
+  LastLineStart = 0;
+  ScanPos = 0;
+  Complete = false;
+}
 
-  // Find the file offsets of all of the *physical* source lines.  This does
-  // not look at trigraphs, escaped newlines, or anything else tricky.
-  SmallVector<unsigned, 256> LineOffsets;
+void LineOffsetIndex::addLine(unsigned Offset) {
+  if (NumLines % LinesPerChunk == 0) {
+    Chunks.push_back({Offset, static_cast<unsigned>(Deltas.size())});
+  } else {
+    uint8_t Encoded[8];
+    unsigned Length = llvm::encodeULEB128(Offset - LastLineStart, Encoded);
+    Deltas.insert(Deltas.end(), Encoded, Encoded + Length);
+  }
+  LastLineStart = Offset;
+  ++NumLines;
+}
 
+/// Find the file offsets of the *physical* source lines, starting at ScanPos,
+/// until ScanPos reaches \p OffsetLimit or \p LineLimit lines are known.  This
+/// does not look at trigraphs, escaped newlines, or anything else tricky.
+void LineOffsetIndex::scan(const char *Buf, unsigned Size,
+                           unsigned OffsetLimit, unsigned LineLimit) {
   // Line #1 starts at char 0.
-  LineOffsets.push_back(0);
-
-  const unsigned char *Buf = (const unsigned char *)Buffer->getBufferStart();
-  const unsigned char *End = (const unsigned char *)Buffer->getBufferEnd();
-  unsigned Offs = 0;
-  while (true) {
-    // Skip over the contents of the line.
-    const unsigned char *NextBuf = (const unsigned char *)Buf;
+  if (NumLines == 0)
+    addLine(0);
+
+  // Record the line following the newline at \p Pos, and return its offset.
+  auto AddLineAfter = [&](unsigned Pos) {
+    // If this is \n\r or \r\n, skip both characters.
+    unsigned Next = Pos + 1;
+    if (Next < Size && (Buf[Next] == '\n' || Buf[Next] == '\r') &&
+        Buf[Next] != Buf[Pos])
+      ++Next;
+    addLine(Next);
+    return Next;
+  };
 
+  unsigned Pos = ScanPos;
+  while (Pos < Size && Pos < OffsetLimit && NumLines < LineLimit) {
 #ifdef __SSE2__
-    // Try to skip to the next newline using SSE instructions. This is very
+    // Handle all the newlines of a 16 byte block at once. This is very
     // performance sensitive for programs with lots of diagnostics and in -E
     // mode.
-    __m128i CRs = _mm_set1_epi8('\r');
-    __m128i LFs = _mm_set1_epi8('\n');
-
-    // First fix up the alignment to 16 bytes.
-    while (((uintptr_t)NextBuf & 0xF) != 0) {
-      if (*NextBuf == '\n' || *NextBuf == '\r' || *NextBuf == '\0')
-        goto FoundSpecialChar;
-      ++NextBuf;
-    }
-
-    // Scan 16 byte chunks for '\r' and '\n'. Ignore '\0'.
-    while (NextBuf+16 <= End) {
-      const __m128i Chunk = *(const __m128i*)NextBuf;
-      __m128i Cmp = _mm_or_si128(_mm_cmpeq_epi8(Chunk, CRs),
-                                 _mm_cmpeq_epi8(Chunk, LFs));
-      unsigned Mask = _mm_movemask_epi8(Cmp);
-
-      // If we found a newline, adjust the pointer and jump to the handling code.
-      if (Mask != 0) {
-        NextBuf += llvm::countTrailingZeros(Mask);
-        goto FoundSpecialChar;
+    if (Size - Pos >= 16) {
+      const __m128i Chunk = _mm_loadu_si128((const __m128i *)(Buf + Pos));
+      unsigned Mask =
+          _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(Chunk,
+                                                        _mm_set1_epi8('\r')),
+                                         _mm_cmpeq_epi8(Chunk,
+                                                        _mm_set1_epi8('\n'))));
+      unsigned BlockEnd = Pos + 16;
+      while (Mask) {
+        unsigned NewlinePos = Pos + llvm::countTrailingZeros(Mask);
+        unsigned Next = AddLineAfter(NewlinePos);
+        // Drop the newline itself and, for \r\n or \n\r, its partner.
+        Mask &= ~0U << (std::min(Next, BlockEnd) - Pos);
+        BlockEnd = std::max(BlockEnd, Next);
       }
-      NextBuf += 16;
+      Pos = BlockEnd;
+      continue;
     }
 #endif
 
-    while (*NextBuf != '\n' && *NextBuf != '\r' && *NextBuf != '\0')
-      ++NextBuf;
+    if (Buf[Pos] == '\n' || Buf[Pos] == '\r')
+      Pos = AddLineAfter(Pos);
+    else
+      ++Pos;
+  }
 
-#ifdef __SSE2__
-FoundSpecialChar:
-#endif
-    Offs += NextBuf-Buf;
-    Buf = NextBuf;
-
-    if (Buf[0] == '\n' || Buf[0] == '\r') {
-      // If this is \n\r or \r\n, skip both characters.
-      if ((Buf[1] == '\n' || Buf[1] == '\r') && Buf[0] != Buf[1]) {
-        ++Offs;
-        ++Buf;
-      }
-      ++Offs;
-      ++Buf;
-      LineOffsets.push_back(Offs);
-    } else {
-      // Otherwise, this is a null.  If end of file, exit.
-      if (Buf == End) break;
-      // Otherwise, skip the null.
-      ++Offs;
-      ++Buf;
+  ScanPos = Pos;
+  if (Pos >= Size)
+    Complete = true;
+}
+
+unsigned LineOffsetIndex::getLineStart(unsigned Line) const {
+  assert(Line < NumLines && "Line not indexed yet");
+  const Chunk &C = Chunks[Line / LinesPerChunk];
+  unsigned Offset = C.FirstLineStart;
+  const uint8_t *Delta = Deltas.data() + C.FirstDelta;
+  for (unsigned I = 0, E = Line % LinesPerChunk; I != E; ++I) {
+    unsigned Length;
+    Offset += llvm::decodeULEB128(Delta, &Length);
+    Delta += Length;
+  }
+  return Offset;
+}
+
+unsigned LineOffsetIndex::getLineNumber(unsigned Offset, unsigned *LineStart,
+                                        unsigned *NextLineStart) const {
+  assert(covers(Offset) && "Offset not indexed yet");
+
+  // Find the last chunk starting at or before Offset; the first one starts at
+  // offset 0.
+  auto C = std::upper_bound(Chunks.begin(), Chunks.end(), Offset,
+                            [](unsigned Offset, const Chunk &C) {
+                              return Offset < C.FirstLineStart;
+                            });
+  --C;
+
+  // Walk the lines of the chunk up to the one containing Offset.
+  unsigned Line = (C - Chunks.begin()) * LinesPerChunk;
+  unsigned ChunkEnd = std::min<unsigned>(NumLines, Line + LinesPerChunk);
+  unsigned Start = C->FirstLineStart;
+  unsigned Next = 0;
+  const uint8_t *Delta = Deltas.data() + C->FirstDelta;
+  for (; Line + 1 < ChunkEnd; ++Line) {
+    unsigned Length;
+    unsigned NextStart = Start + llvm::decodeULEB128(Delta, &Length);
+    Delta += Length;
+    if (NextStart > Offset) {
+      Next = NextStart;
+      break;
     }
+    Start = NextStart;
   }
+  if (!Next && Line + 1 < NumLines)
+    Next = (C + 1)->FirstLineStart;
 
-  // Copy the offsets into the FileInfo structure.
-  FI->NumLines = LineOffsets.size();
-  FI->SourceLineCache = Alloc.Allocate<unsigned>(LineOffsets.size());
-  std::copy(LineOffsets.begin(), LineOffsets.end(), FI->SourceLineCache);
+  if (LineStart)
+    *LineStart = Start;
+  if (NextLineStart)
+    *NextLineStart = Next;
+  return Line + 1;
 }
 
 /// getLineNumber - Given a SourceLocation, return the spelling line number
@@ -1291,73 +1331,35 @@ unsigned SourceManager::getLineNumber(FileID FID, unsigned FilePos,
     Content = const_cast<ContentCache*>(Entry.getFile().getContentCache());
   }
   
-  // If this is the first use of line information for this buffer, compute the
-  /// SourceLineCache for it on demand.
-  if (!Content->SourceLineCache) {
+  // If the previous query was to the same line, we are done.
+  LineOffsetIndex &Lines = Content->LineOffsets;
+  if (LastLineNoFileIDQuery == FID && !Lines.empty() &&
+      FilePos >= LastLineNoLineStart && FilePos < LastLineNoNextLineStart) {
+    if (Invalid)
+      *Invalid = false;
+    return LastLineNoResult;
+  }
+
+  // Extend the line index of the buffer as far as needed.  Note that calling
+  // 'getBuffer()' may lazily page in the file.
+  if (!Lines.covers(FilePos)) {
     bool MyInvalid = false;
-    ComputeLineNumbers(Diag, Content, ContentCacheAlloc, *this, MyInvalid);
+    llvm::MemoryBuffer *Buffer =
+        Content->getBuffer(Diag, *this, SourceLocation(), &MyInvalid);
     if (Invalid)
       *Invalid = MyInvalid;
     if (MyInvalid)
       return 1;
+    Lines.extendToOffset(Buffer->getBufferStart(), Buffer->getBufferSize(),
+                         FilePos);
   } else if (Invalid)
     *Invalid = false;
 
-  // Okay, we know we have a line number table.  Do a binary search to find the
-  // line number that this character position lands on.
-  unsigned *SourceLineCache = Content->SourceLineCache;
-  unsigned *SourceLineCacheStart = SourceLineCache;
-  unsigned *SourceLineCacheEnd = SourceLineCache + Content->NumLines;
-
-  unsigned QueriedFilePos = FilePos+1;
-
-  // FIXME: I would like to be convinced that this code is worth being as
-  // complicated as it is, binary search isn't that slow.
-  //
-  // If it is worth being optimized, then in my opinion it could be more
-  // performant, simpler, and more obviously correct by just "galloping" outward
-  // from the queried file position. In fact, this could be incorporated into a
-  // generic algorithm such as lower_bound_with_hint.
-  //
-  // If someone gives me a test case where this matters, and I will do it! - DWD
-
-  // If the previous query was to the same file, we know both the file pos from
-  // that query and the line number returned.  This allows us to narrow the
-  // search space from the entire file to something near the match.
-  if (LastLineNoFileIDQuery == FID) {
-    if (QueriedFilePos >= LastLineNoFilePos) {
-      // FIXME: Potential overflow?
-      SourceLineCache = SourceLineCache+LastLineNoResult-1;
-
-      // The query is likely to be nearby the previous one.  Here we check to
-      // see if it is within 5, 10 or 20 lines.  It can be far away in cases
-      // where big comment blocks and vertical whitespace eat up lines but
-      // contribute no tokens.
-      if (SourceLineCache+5 < SourceLineCacheEnd) {
-        if (SourceLineCache[5] > QueriedFilePos)
-          SourceLineCacheEnd = SourceLineCache+5;
-        else if (SourceLineCache+10 < SourceLineCacheEnd) {
-          if (SourceLineCache[10] > QueriedFilePos)
-            SourceLineCacheEnd = SourceLineCache+10;
-          else if (SourceLineCache+20 < SourceLineCacheEnd) {
-            if (SourceLineCache[20] > QueriedFilePos)
-              SourceLineCacheEnd = SourceLineCache+20;
-          }
-        }
-      }
-    } else {
-      if (LastLineNoResult < Content->NumLines)
-        SourceLineCacheEnd = SourceLineCache+LastLineNoResult+1;
-    }
-  }
-
-  unsigned *Pos
-    = std::lower_bound(SourceLineCache, SourceLineCacheEnd, QueriedFilePos);
-  unsigned LineNo = Pos-SourceLineCacheStart;
+  unsigned LineNo = Lines.getLineNumber(FilePos, &LastLineNoLineStart,
+                                        &LastLineNoNextLineStart);
 
   LastLineNoFileIDQuery = FID;
   LastLineNoContentCache = Content;
-  LastLineNoFilePos = QueriedFilePos;
   LastLineNoResult = LineNo;
   return LineNo;
 }
@@ -1728,24 +1730,23 @@ SourceLocation SourceManager::translateLineCol(FileID FID,
   if (!Content)
     return SourceLocation();
 
-  // If this is the first use of line information for this buffer, compute the
-  // SourceLineCache for it on demand.
-  if (!Content->SourceLineCache) {
-    bool MyInvalid = false;
-    ComputeLineNumbers(Diag, Content, ContentCacheAlloc, *this, MyInvalid);
-    if (MyInvalid)
-      return SourceLocation();
-  }
+  // Extend the line index of the buffer up to the requested line.
+  bool MyInvalid = false;
+  llvm::MemoryBuffer *Buffer =
+      Content->getBuffer(Diag, *this, SourceLocation(), &MyInvalid);
+  if (MyInvalid)
+    return SourceLocation();
+  LineOffsetIndex &Lines = Content->LineOffsets;
+  Lines.extendToLine(Buffer->getBufferStart(), Buffer->getBufferSize(), Line);
 
-  if (Line > Content->NumLines) {
-    unsigned Size = Content->getBuffer(Diag, *this)->getBufferSize();
+  if (Line > Lines.getNumKnownLines()) {
+    unsigned Size = Buffer->getBufferSize();
     if (Size > 0)
       --Size;
     return FileLoc.getLocWithOffset(Size);
   }
 
-  llvm::MemoryBuffer *Buffer = Content->getBuffer(Diag, *this);
-  unsigned FilePos = Content->SourceLineCache[Line - 1];
+  unsigned FilePos = Lines.getLineStart(Line - 1);
   const char *Buf = Buffer->getBufferStart() + FilePos;
   unsigned BufLength = Buffer->getBufferSize() - FilePos;
   if (BufLength == 0)
@@ -2134,7 +2135,7 @@ void SourceManager::PrintStats() const {
   unsigned NumLineNumsComputed = 0;
   unsigned NumFileBytesMapped = 0;
   for (fileinfo_iterator I = fileinfo_begin(), E = fileinfo_end(); I != E; ++I){
-    NumLineNumsComputed += I->second->SourceLineCache != nullptr;
+    NumLineNumsComputed += !I->second->LineOffsets.empty();
     NumFileBytesMapped  += I->second->getSizeBytesMapped();
   }
   unsigned NumMacroArgsComputed = MacroArgsCacheMap.size();
@@ -2235,5 +2236,11 @@ size_t SourceManager::getDataStructureSizes() const {
   if (OverriddenFilesInfo)
     size += llvm::capacity_in_bytes(OverriddenFilesInfo->OverriddenFiles);
 
+  // The line tables are built lazily and grow with the lines queried.
+  for (const SrcMgr::ContentCache *Content : MemBufferInfos)
+    size += Content->LineOffsets.getMemorySize();
+  for (const auto &FileInfo : FileInfos)
+    size += FileInfo.second->LineOffsets.getMemorySize();
+
   return size;
 }
@@ -0,0 +1,190 @@
+//===- TimeTrace.cpp - Hierarchical compile time profiler -----------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+//  This file implements the time trace profiler.
+//
+//===----------------------------------------------------------------------===//
+
+#include "clang/Basic/TimeTrace.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/raw_ostream.h"
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <vector>
+
+using namespace clang;
+
+namespace clang {
+
+LLVM_THREAD_LOCAL TimeTraceProfiler *TimeTraceProfilerInstance = nullptr;
+
+namespace {
+using Clock = std::chrono::steady_clock;
+using MicroSeconds = std::chrono::duration<int64_t, std::micro>;
+} // end anonymous namespace
+
+struct TimeTraceProfiler {
+  /// A time section, open or closed.
+  struct Entry {
+    Clock::time_point Start;
+    Clock::duration Duration;
+    std::string Name;
+    std::string Detail;
+  };
+
+  explicit TimeTraceProfiler(unsigned Granularity)
+      : StartTime(Clock::now()), Granularity(Granularity) {}
+
+  void begin(StringRef Name, StringRef Detail) {
+    Stack.push_back(
+        {Clock::now(), Clock::duration(), Name.str(), Detail.str()});
+  }
+
+  void end() {
+    assert(!Stack.empty() && "Must call begin() first");
+    Entry &E = Stack.back();
+    E.Duration = Clock::now() - E.Start;
+
+    // Only sections that are long enough are written to the trace, which
+    // keeps traces of large translation units at a manageable size.
+    if (std::chrono::duration_cast<MicroSeconds>(E.Duration).count() >=
+        Granularity)
+      Entries.push_back(E);
+
+    // Only the outermost section of each name counts towards its total;
+    // e.g. a template instantiation triggered by another instantiation is
+    // already part of the outer one.
+    if (std::none_of(Stack.begin(), Stack.end() - 1,
+                     [&](const Entry &Open) { return Open.Name == E.Name; })) {
+      auto &CountAndTotal = CountAndTotalPerName[E.Name];
+      ++CountAndTotal.first;
+      CountAndTotal.second += E.Duration;
+    }
+
+    Stack.pop_back();
+  }
+
+  void write(raw_ostream &OS);
+
+  SmallVector<Entry, 16> Stack;
+  std::vector<Entry> Entries;
+  llvm::StringMap<std::pair<unsigned, Clock::duration>> CountAndTotalPerName;
+  Clock::time_point StartTime;
+  unsigned Granularity;
+};
+
+} // end namespace clang
+
+/// Write \p Str as a JSON string literal.
+static void writeJSONString(raw_ostream &OS, StringRef Str) {
+  OS << '"';
+  for (unsigned char C : Str) {
+    switch (C) {
+    case '"':
+      OS << "\\\"";
+      break;
+    case '\\':
+      OS << "\\\\";
+      break;
+    case '\n':
+      OS << "\\n";
+      break;
+    case '\t':
+      OS << "\\t";
+      break;
+    default:
+      if (C < 0x20)
+        OS << llvm::format("\\u%04x", C);
+      else
+        OS << C;
+      break;
+    }
+  }
+  OS << '"';
+}
+
+void TimeTraceProfiler::write(raw_ostream &OS) {
+  auto Micros = [](Clock::duration D) {
+    return std::chrono::duration_cast<MicroSeconds>(D).count();
+  };
+
+  OS << "{ \"traceEvents\": [\n";
+
+  // Complete events, one per recorded section.
+  for (const Entry &E : Entries) {
+    OS << "{ \"pid\": 1, \"tid\": 0, \"ph\": \"X\", \"ts\": "
+       << Micros(E.Start - StartTime) << ", \"dur\": " << Micros(E.Duration)
+       << ", \"name\": ";
+    writeJSONString(OS, E.Name);
+    OS << ", \"args\": { \"detail\": ";
+    writeJSONString(OS, E.Detail);
+    OS << " } },\n";
+  }
+
+  // Totals per section name, longest first, each on its own row.
+  using NameAndTotal =
+      std::pair<StringRef, std::pair<unsigned, Clock::duration>>;
+  std::vector<NameAndTotal> Totals;
+  for (const auto &Total : CountAndTotalPerName)
+    Totals.emplace_back(Total.getKey(), Total.getValue());
+  std::sort(Totals.begin(), Totals.end(),
+            [](const NameAndTotal &A, const NameAndTotal &B) {
+              if (A.second.second != B.second.second)
+                return A.second.second > B.second.second;
+              return A.first < B.first;
+            });
+  unsigned Tid = 1;
+  for (const auto &Total : Totals) {
+    int64_t Duration = Micros(Total.second.second);
+    unsigned Count = Total.second.first;
+    OS << "{ \"pid\": 1, \"tid\": " << Tid++ << ", \"ph\": \"X\", \"ts\": 0"
+       << ", \"dur\": " << Duration << ", \"name\": ";
+    writeJSONString(OS, "Total " + Total.first.str());
+    OS << ", \"args\": { \"count\": " << Count << ", \"avg ms\": "
+       << llvm::format("%.3f", Duration / 1000.0 / Count) << " } },\n";
+  }
+
+  OS << "{ \"pid\": 1, \"tid\": 0, \"ph\": \"M\", \"ts\": 0, "
+        "\"name\": \"process_name\", \"args\": { \"name\": \"clang\" } }\n";
+  OS << "] }\n";
+}
+
+void clang::timeTraceProfilerInitialize(unsigned GranularityInMicroseconds) {
+  assert(!TimeTraceProfilerInstance && "Profiler should not be initialized");
+  TimeTraceProfilerInstance = new TimeTraceProfiler(GranularityInMicroseconds);
+}
+
+void clang::timeTraceProfilerCleanup() {
+  delete TimeTraceProfilerInstance;
+  TimeTraceProfilerInstance = nullptr;
+}
+
+void clang::timeTraceProfilerWrite(raw_ostream &OS) {
+  assert(TimeTraceProfilerInstance && "Profiler object can't be null");
+  TimeTraceProfilerInstance->write(OS);
+}
+
+void clang::timeTraceProfilerBegin(StringRef Name, StringRef Detail) {
+  if (TimeTraceProfilerInstance)
+    TimeTraceProfilerInstance->begin(Name, Detail);
+}
+
+void clang::timeTraceProfilerBegin(StringRef Name,
+                                   llvm::function_ref<std::string()> Detail) {
+  if (TimeTraceProfilerInstance)
+    TimeTraceProfilerInstance->begin(Name, Detail());
+}
+
+void clang::timeTraceProfilerEnd() {
+  if (TimeTraceProfilerInstance)
+    TimeTraceProfilerInstance->end();
+}
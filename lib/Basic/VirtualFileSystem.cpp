@@ -24,7 +24,10 @@
 #include "llvm/Support/Process.h"
 #include "llvm/Support/YAMLParser.h"
 #include <atomic>
+#include <limits>
+#include <map>
 #include <memory>
+#include <mutex>
 #include <utility>
 
 using namespace clang;
@@ -187,20 +190,49 @@ std::error_code RealFile::close() {
 
 namespace {
 /// \brief The file system according to your operating system.
+///
+/// By default the working directory is the process's working directory, and
+/// changing it calls chdir(). If \c LinkCWDToProcess is false, the file system
+/// keeps a working directory of its own and resolves relative paths against
+/// it before calling into the operating system.
 class RealFileSystem : public FileSystem {
 public:
+  explicit RealFileSystem(bool LinkCWDToProcess = true) {
+    if (!LinkCWDToProcess) {
+      SmallString<128> PWD;
+      if (!llvm::sys::fs::current_path(PWD))
+        WD = PWD.str().str();
+    }
+  }
+
   ErrorOr<Status> status(const Twine &Path) override;
   ErrorOr<std::unique_ptr<File>> openFileForRead(const Twine &Path) override;
   directory_iterator dir_begin(const Twine &Dir, std::error_code &EC) override;
 
   llvm::ErrorOr<std::string> getCurrentWorkingDirectory() const override;
   std::error_code setCurrentWorkingDirectory(const Twine &Path) override;
+
+private:
+  /// \brief Resolves \p Path against the private working directory, if any.
+  Twine adjustPath(const Twine &Path, SmallVectorImpl<char> &Storage) const {
+    if (!WD)
+      return Path;
+    Path.toVector(Storage);
+    sys::fs::make_absolute(*WD, Storage);
+    return Storage;
+  }
+
+  /// \brief The private working directory, or None if the process's working
+  /// directory is used.
+  Optional<std::string> WD;
 };
 } // end anonymous namespace
 
 ErrorOr<Status> RealFileSystem::status(const Twine &Path) {
+  SmallString<256> Storage;
   sys::fs::file_status RealStatus;
-  if (std::error_code EC = sys::fs::status(Path, RealStatus))
+  if (std::error_code EC =
+          sys::fs::status(adjustPath(Path, Storage), RealStatus))
     return EC;
   return Status::copyWithNewName(RealStatus, Path.str());
 }
@@ -208,13 +240,17 @@ ErrorOr<Status> RealFileSystem::status(const Twine &Path) {
 ErrorOr<std::unique_ptr<File>>
 RealFileSystem::openFileForRead(const Twine &Name) {
   int FD;
-  SmallString<256> RealName;
-  if (std::error_code EC = sys::fs::openFileForRead(Name, FD, &RealName))
+  SmallString<256> RealName, Storage;
+  if (std::error_code EC = sys::fs::openFileForRead(adjustPath(Name, Storage),
+                                                    FD, &RealName))
     return EC;
   return std::unique_ptr<File>(new RealFile(FD, Name.str(), RealName.str()));
 }
 
 llvm::ErrorOr<std::string> RealFileSystem::getCurrentWorkingDirectory() const {
+  if (WD)
+    return *WD;
+
   SmallString<256> Dir;
   if (std::error_code EC = llvm::sys::fs::current_path(Dir))
     return EC;
@@ -222,6 +258,19 @@ llvm::ErrorOr<std::string> RealFileSystem::getCurrentWorkingDirectory() const {
 }
 
 std::error_code RealFileSystem::setCurrentWorkingDirectory(const Twine &Path) {
+  if (WD) {
+    SmallString<128> Absolute;
+    adjustPath(Path, Absolute);
+    bool IsDir;
+    if (std::error_code EC = llvm::sys::fs::is_directory(Absolute, IsDir))
+      return EC;
+    if (!IsDir)
+      return make_error_code(llvm::errc::not_a_directory);
+    llvm::sys::path::remove_dots(Absolute, /*remove_dot_dot=*/true);
+    WD = Absolute.str().str();
+    return std::error_code();
+  }
+
   // FIXME: chdir is thread hostile; on the other hand, creating the same
   // behavior as chdir is complex: chdir resolves the path once, thus
   // guaranteeing that all subsequent relative path operations work
@@ -229,6 +278,8 @@ std::error_code RealFileSystem::setCurrentWorkingDirectory(const Twine &Path) {
   // difference for example on network filesystems, where symlinks might be
   // switched during runtime of the tool. Fixing this depends on having a
   // file system abstraction that allows openat() style interactions.
+  // createPhysicalFileSystem() avoids the chdir at the cost of resolving
+  // relative paths lexically.
   return llvm::sys::fs::set_current_path(Path);
 }
 
@@ -237,6 +288,10 @@ IntrusiveRefCntPtr<FileSystem> vfs::getRealFileSystem() {
   return FS;
 }
 
+std::unique_ptr<FileSystem> vfs::createPhysicalFileSystem() {
+  return llvm::make_unique<RealFileSystem>(/*LinkCWDToProcess=*/false);
+}
+
 namespace {
 class RealFSDirIter : public clang::vfs::detail::DirIterImpl {
   llvm::sys::fs::directory_iterator Iter;
@@ -268,7 +323,9 @@ public:
 
 directory_iterator RealFileSystem::dir_begin(const Twine &Dir,
                                              std::error_code &EC) {
-  return directory_iterator(std::make_shared<RealFSDirIter>(Dir, EC));
+  SmallString<128> Storage;
+  return directory_iterator(
+      std::make_shared<RealFSDirIter>(adjustPath(Dir, Storage), EC));
 }
 
 //===-----------------------------------------------------------------------===/
@@ -702,6 +759,351 @@ std::error_code InMemoryFileSystem::setCurrentWorkingDirectory(const Twine &P) {
 }
 }
 
+//===-----------------------------------------------------------------------===/
+// SharedFileCache and CachingFileSystem implementation
+//===-----------------------------------------------------------------------===/
+
+namespace {
+/// \brief A buffer that shares the storage of a cached buffer and keeps it
+/// alive for as long as the buffer is in use.
+class SharedMemoryBuffer : public llvm::MemoryBuffer {
+  std::shared_ptr<llvm::MemoryBuffer> Storage;
+  std::string Name;
+
+public:
+  SharedMemoryBuffer(std::shared_ptr<llvm::MemoryBuffer> Storage,
+                     StringRef Name, bool RequiresNullTerminator)
+      : Storage(std::move(Storage)), Name(Name) {
+    init(this->Storage->getBufferStart(), this->Storage->getBufferEnd(),
+         RequiresNullTerminator);
+  }
+
+  StringRef getBufferIdentifier() const override { return Name; }
+
+  BufferKind getBufferKind() const override {
+    return Storage->getBufferKind();
+  }
+};
+} // end anonymous namespace
+
+/// The status and buffer tables are split into shards with separate locks so
+/// that threads looking up unrelated files rarely contend.
+static const unsigned NumSharedFileCacheShards = 16;
+
+struct SharedFileCache::Implementation {
+  typedef std::chrono::steady_clock Clock;
+
+  struct StatusEntry {
+    llvm::ErrorOr<Status> Result;
+    Clock::time_point Time;
+  };
+
+  struct BufferEntry {
+    sys::TimePoint<> MTime;
+    uint64_t Size;
+    std::shared_ptr<llvm::MemoryBuffer> Buffer;
+    uint64_t LastUse;
+  };
+
+  struct StatusShard {
+    std::mutex Mutex;
+    llvm::StringMap<StatusEntry> Entries;
+  };
+
+  struct BufferShard {
+    std::mutex Mutex;
+    std::map<std::pair<uint64_t, uint64_t>, BufferEntry> Entries;
+  };
+
+  StatusShard StatusShards[NumSharedFileCacheShards];
+  BufferShard BufferShards[NumSharedFileCacheShards];
+
+  std::mutex ConfigMutex;
+  Optional<std::chrono::milliseconds> StatusLifetime;
+
+  const uint64_t MaxBufferBytes;
+  std::atomic<uint64_t> BufferBytes;
+  std::atomic<uint64_t> UseCounter;
+
+  std::atomic<uint64_t> StatusHits, StatusMisses, BufferHits, BufferMisses,
+      BufferInvalidations, BufferEvictions;
+
+  explicit Implementation(uint64_t MaxBufferBytes)
+      : MaxBufferBytes(MaxBufferBytes), BufferBytes(0), UseCounter(0),
+        StatusHits(0), StatusMisses(0), BufferHits(0), BufferMisses(0),
+        BufferInvalidations(0), BufferEvictions(0) {}
+
+  StatusShard &getStatusShard(StringRef Path) {
+    return StatusShards[llvm::HashString(Path) % NumSharedFileCacheShards];
+  }
+
+  BufferShard &getBufferShard(const UniqueID &ID) {
+    return BufferShards[(ID.getFile() ^ ID.getDevice()) %
+                        NumSharedFileCacheShards];
+  }
+
+  /// \brief Evict least recently used buffers until the cached buffers use at
+  /// most three quarters of the budget. Must be called without holding any
+  /// shard lock.
+  void evictBuffers();
+};
+
+void SharedFileCache::Implementation::evictBuffers() {
+  const uint64_t Target = MaxBufferBytes / 4 * 3;
+  while (BufferBytes > Target) {
+    // Find the least recently used entry. Eviction is rare, so a linear scan
+    // is cheaper than maintaining a global LRU list on every hit.
+    unsigned VictimShard = NumSharedFileCacheShards;
+    std::pair<uint64_t, uint64_t> VictimKey;
+    uint64_t VictimUse = std::numeric_limits<uint64_t>::max();
+    for (unsigned I = 0; I != NumSharedFileCacheShards; ++I) {
+      std::lock_guard<std::mutex> Lock(BufferShards[I].Mutex);
+      for (const auto &Entry : BufferShards[I].Entries)
+        if (Entry.second.LastUse < VictimUse) {
+          VictimShard = I;
+          VictimKey = Entry.first;
+          VictimUse = Entry.second.LastUse;
+        }
+    }
+    if (VictimShard == NumSharedFileCacheShards)
+      return;
+
+    std::lock_guard<std::mutex> Lock(BufferShards[VictimShard].Mutex);
+    auto &Entries = BufferShards[VictimShard].Entries;
+    auto It = Entries.find(VictimKey);
+    // Another thread may have evicted or refreshed the entry in the meantime.
+    if (It == Entries.end() || It->second.LastUse != VictimUse)
+      continue;
+    BufferBytes -= It->second.Buffer->getBufferSize();
+    Entries.erase(It);
+    ++BufferEvictions;
+  }
+}
+
+SharedFileCache::SharedFileCache(uint64_t MaxBufferBytes)
+    : Impl(new Implementation(MaxBufferBytes)) {}
+
+SharedFileCache::~SharedFileCache() {}
+
+IntrusiveRefCntPtr<SharedFileCache> SharedFileCache::getGlobal() {
+  static IntrusiveRefCntPtr<SharedFileCache> Cache = new SharedFileCache();
+  return Cache;
+}
+
+void SharedFileCache::setStatusLifetime(
+    Optional<std::chrono::milliseconds> Lifetime) {
+  std::lock_guard<std::mutex> Lock(Impl->ConfigMutex);
+  Impl->StatusLifetime = Lifetime;
+}
+
+void SharedFileCache::invalidate() {
+  for (auto &Shard : Impl->StatusShards) {
+    std::lock_guard<std::mutex> Lock(Shard.Mutex);
+    Shard.Entries.clear();
+  }
+}
+
+void SharedFileCache::clear() {
+  invalidate();
+  for (auto &Shard : Impl->BufferShards) {
+    std::lock_guard<std::mutex> Lock(Shard.Mutex);
+    for (const auto &Entry : Shard.Entries)
+      Impl->BufferBytes -= Entry.second.Buffer->getBufferSize();
+    Shard.Entries.clear();
+  }
+}
+
+SharedFileCache::Statistics SharedFileCache::getStatistics() const {
+  Statistics Stats;
+  Stats.StatusHits = Impl->StatusHits;
+  Stats.StatusMisses = Impl->StatusMisses;
+  Stats.BufferHits = Impl->BufferHits;
+  Stats.BufferMisses = Impl->BufferMisses;
+  Stats.BufferInvalidations = Impl->BufferInvalidations;
+  Stats.BufferEvictions = Impl->BufferEvictions;
+  return Stats;
+}
+
+ErrorOr<Status>
+SharedFileCache::getStatus(StringRef Path,
+                           llvm::function_ref<ErrorOr<Status>()> Compute) {
+  Optional<std::chrono::milliseconds> Lifetime;
+  {
+    std::lock_guard<std::mutex> Lock(Impl->ConfigMutex);
+    Lifetime = Impl->StatusLifetime;
+  }
+  if (Lifetime && Lifetime->count() == 0)
+    return Compute();
+
+  auto &Shard = Impl->getStatusShard(Path);
+  auto Now = Implementation::Clock::now();
+  {
+    std::lock_guard<std::mutex> Lock(Shard.Mutex);
+    auto It = Shard.Entries.find(Path);
+    if (It != Shard.Entries.end() &&
+        (!Lifetime || Now - It->second.Time < *Lifetime)) {
+      ++Impl->StatusHits;
+      return It->second.Result;
+    }
+  }
+
+  // Compute outside of the lock; a racing thread computing the same result
+  // is harmless.
+  ++Impl->StatusMisses;
+  ErrorOr<Status> Result = Compute();
+  // Only remember successful lookups and plain "not found" results. Other
+  // errors may be transient.
+  if (Result || Result.getError() == llvm::errc::no_such_file_or_directory) {
+    std::lock_guard<std::mutex> Lock(Shard.Mutex);
+    Implementation::StatusEntry Entry{Result, Now};
+    auto Inserted = Shard.Entries.insert(std::make_pair(Path, Entry));
+    if (!Inserted.second)
+      Inserted.first->second = Entry;
+  }
+  return Result;
+}
+
+ErrorOr<std::shared_ptr<MemoryBuffer>> SharedFileCache::getBuffer(
+    const Status &S,
+    llvm::function_ref<ErrorOr<std::unique_ptr<MemoryBuffer>>()> Read) {
+  auto Key = std::make_pair(S.getUniqueID().getDevice(),
+                            S.getUniqueID().getFile());
+  auto &Shard = Impl->getBufferShard(S.getUniqueID());
+  {
+    std::lock_guard<std::mutex> Lock(Shard.Mutex);
+    auto It = Shard.Entries.find(Key);
+    if (It != Shard.Entries.end()) {
+      Implementation::BufferEntry &Entry = It->second;
+      if (Entry.MTime == S.getLastModificationTime() &&
+          Entry.Size == S.getSize()) {
+        ++Impl->BufferHits;
+        Entry.LastUse = ++Impl->UseCounter;
+        return Entry.Buffer;
+      }
+      // The file changed on disk since it was cached.
+      ++Impl->BufferInvalidations;
+      Impl->BufferBytes -= Entry.Buffer->getBufferSize();
+      Shard.Entries.erase(It);
+    }
+  }
+
+  ++Impl->BufferMisses;
+  ErrorOr<std::unique_ptr<MemoryBuffer>> Buffer = Read();
+  if (!Buffer)
+    return Buffer.getError();
+  std::shared_ptr<MemoryBuffer> Shared(std::move(*Buffer));
+
+  // Don't let a single huge file flush the whole cache.
+  if (Shared->getBufferSize() > Impl->MaxBufferBytes / 4)
+    return Shared;
+
+  {
+    std::lock_guard<std::mutex> Lock(Shard.Mutex);
+    auto Inserted = Shard.Entries.insert(
+        std::make_pair(Key, Implementation::BufferEntry{
+                                S.getLastModificationTime(), S.getSize(),
+                                Shared, ++Impl->UseCounter}));
+    // Another thread read the same file concurrently; share its buffer.
+    if (!Inserted.second)
+      return Inserted.first->second.Buffer;
+    Impl->BufferBytes += Shared->getBufferSize();
+  }
+  if (Impl->BufferBytes > Impl->MaxBufferBytes)
+    Impl->evictBuffers();
+  return Shared;
+}
+
+namespace {
+/// \brief A file opened through a \c CachingFileSystem. The underlying file is
+/// open, so status() reflects the file on disk; only the contents come from
+/// the cache.
+class CachingFile : public File {
+  std::unique_ptr<File> Base;
+  IntrusiveRefCntPtr<SharedFileCache> Cache;
+
+public:
+  CachingFile(std::unique_ptr<File> Base,
+              IntrusiveRefCntPtr<SharedFileCache> Cache)
+      : Base(std::move(Base)), Cache(std::move(Cache)) {}
+
+  ErrorOr<Status> status() override { return Base->status(); }
+  ErrorOr<std::string> getName() override { return Base->getName(); }
+  std::error_code close() override { return Base->close(); }
+
+  ErrorOr<std::unique_ptr<MemoryBuffer>>
+  getBuffer(const Twine &Name, int64_t FileSize, bool RequiresNullTerminator,
+            bool IsVolatile) override {
+    ErrorOr<Status> S = Base->status();
+    if (IsVolatile || !S || !S->isRegularFile())
+      return Base->getBuffer(Name, FileSize, RequiresNullTerminator,
+                             IsVolatile);
+
+    auto Shared = Cache->getBuffer(*S, [&] {
+      // Always read with a null terminator so that the cached buffer can be
+      // handed to every client.
+      return Base->getBuffer(Name, /*FileSize=*/-1,
+                             /*RequiresNullTerminator=*/true,
+                             /*IsVolatile=*/false);
+    });
+    if (!Shared)
+      return Shared.getError();
+    return std::unique_ptr<MemoryBuffer>(new SharedMemoryBuffer(
+        std::move(*Shared), Name.str(), RequiresNullTerminator));
+  }
+};
+
+/// \brief A file system that memoizes status results and file contents of
+/// another file system in a \c SharedFileCache.
+class CachingFileSystem : public FileSystem {
+  IntrusiveRefCntPtr<FileSystem> BaseFS;
+  IntrusiveRefCntPtr<SharedFileCache> Cache;
+
+public:
+  CachingFileSystem(IntrusiveRefCntPtr<FileSystem> BaseFS,
+                    IntrusiveRefCntPtr<SharedFileCache> Cache)
+      : BaseFS(std::move(BaseFS)), Cache(std::move(Cache)) {}
+
+  ErrorOr<Status> status(const Twine &Path) override {
+    SmallString<256> AbsPath;
+    Path.toVector(AbsPath);
+    if (BaseFS->makeAbsolute(AbsPath))
+      return BaseFS->status(Path);
+    ErrorOr<Status> Result =
+        Cache->getStatus(AbsPath, [&] { return BaseFS->status(AbsPath); });
+    if (!Result)
+      return Result;
+    return Status::copyWithNewName(*Result, Path.str());
+  }
+
+  ErrorOr<std::unique_ptr<File>>
+  openFileForRead(const Twine &Path) override {
+    auto F = BaseFS->openFileForRead(Path);
+    if (!F)
+      return F;
+    return std::unique_ptr<File>(new CachingFile(std::move(*F), Cache));
+  }
+
+  directory_iterator dir_begin(const Twine &Dir,
+                               std::error_code &EC) override {
+    return BaseFS->dir_begin(Dir, EC);
+  }
+
+  llvm::ErrorOr<std::string> getCurrentWorkingDirectory() const override {
+    return BaseFS->getCurrentWorkingDirectory();
+  }
+
+  std::error_code setCurrentWorkingDirectory(const Twine &Path) override {
+    return BaseFS->setCurrentWorkingDirectory(Path);
+  }
+};
+} // end anonymous namespace
+
+IntrusiveRefCntPtr<FileSystem>
+vfs::createCachingFileSystem(IntrusiveRefCntPtr<FileSystem> BaseFS,
+                             IntrusiveRefCntPtr<SharedFileCache> Cache) {
+  return new CachingFileSystem(std::move(BaseFS), std::move(Cache));
+}
+
 //===-----------------------------------------------------------------------===/
 // RedirectingFileSystem implementation
 //===-----------------------------------------------------------------------===/
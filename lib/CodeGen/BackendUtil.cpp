@@ -11,10 +11,14 @@
 #include "clang/Basic/Diagnostic.h"
 #include "clang/Basic/LangOptions.h"
 #include "clang/Basic/TargetOptions.h"
+#include "clang/Basic/TimeTrace.h"
 #include "clang/Frontend/CodeGenOptions.h"
 #include "clang/Frontend/FrontendDiagnostic.h"
 #include "clang/Frontend/Utils.h"
 #include "clang/Lex/HeaderSearchOptions.h"
+#include "llvm/ADT/DenseSet.h"
+#include "llvm/ADT/EquivalenceClasses.h"
+#include "llvm/ADT/SetVector.h"
 #include "llvm/ADT/SmallSet.h"
 #include "llvm/ADT/StringExtras.h"
 #include "llvm/ADT/StringSwitch.h"
@@ -27,12 +31,14 @@
 #include "llvm/CodeGen/RegAllocRegistry.h"
 #include "llvm/CodeGen/SchedulerRegistry.h"
 #include "llvm/IR/DataLayout.h"
+#include "llvm/IR/DiagnosticInfo.h"
 #include "llvm/IR/IRPrintingPasses.h"
 #include "llvm/IR/LegacyPassManager.h"
 #include "llvm/IR/Module.h"
 #include "llvm/IR/ModuleSummaryIndex.h"
 #include "llvm/IR/Verifier.h"
 #include "llvm/LTO/LTOBackend.h"
+#include "llvm/Linker/Linker.h"
 #include "llvm/MC/MCAsmInfo.h"
 #include "llvm/MC/SubtargetFeature.h"
 #include "llvm/Passes/PassBuilder.h"
@@ -40,6 +46,7 @@
 #include "llvm/Support/MemoryBuffer.h"
 #include "llvm/Support/PrettyStackTrace.h"
 #include "llvm/Support/TargetRegistry.h"
+#include "llvm/Support/ThreadPool.h"
 #include "llvm/Support/Timer.h"
 #include "llvm/Support/raw_ostream.h"
 #include "llvm/Target/TargetMachine.h"
@@ -55,9 +62,14 @@
 #include "llvm/Transforms/ObjCARC.h"
 #include "llvm/Transforms/Scalar.h"
 #include "llvm/Transforms/Scalar/GVN.h"
+#include "llvm/Transforms/Utils/Cloning.h"
 #include "llvm/Transforms/Utils/NameAnonGlobals.h"
 #include "llvm/Transforms/Utils/SymbolRewriter.h"
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
 #include <memory>
+#include <mutex>
 using namespace clang;
 using namespace llvm;
 
@@ -120,8 +132,24 @@ public:
 
   std::unique_ptr<TargetMachine> TM;
 
+  /// The pipeline which already ran the per-function passes on some of the
+  /// functions, if any.
+  const FunctionPassPipeline *Pipeline = nullptr;
+
+  /// Create the per-function passes of the optimization pipeline, for
+  /// FunctionPassPipeline.
+  void CreatePerFunctionPasses(legacy::FunctionPassManager &PerFunctionPasses);
+
+  /// Run the optimization passes on the module, unless \p Optimize is false,
+  /// and emit it as requested by \p Action.
   void EmitAssembly(BackendAction Action,
-                    std::unique_ptr<raw_pwrite_stream> OS);
+                    std::unique_ptr<raw_pwrite_stream> OS,
+                    bool Optimize = true);
+
+  /// Run the optimization passes on the module, and nothing else. Unlike
+  /// EmitAssembly, this leaves the global LLVM options alone, so that several
+  /// modules can be optimized at once.
+  void OptimizeModule();
 
   void EmitAssemblyWithNewPassManager(BackendAction Action,
                                       std::unique_ptr<raw_pwrite_stream> OS);
@@ -723,7 +751,8 @@ bool EmitAssemblyHelper::AddEmitPasses(legacy::PassManager &CodeGenPasses,
 }
 
 void EmitAssemblyHelper::EmitAssembly(BackendAction Action,
-                                      std::unique_ptr<raw_pwrite_stream> OS) {
+                                      std::unique_ptr<raw_pwrite_stream> OS,
+                                      bool Optimize) {
   TimeRegion Region(llvm::TimePassesIsEnabled ? &CodeGenerationTime : nullptr);
 
   setCommandLineOpts(CodeGenOpts);
@@ -746,7 +775,8 @@ void EmitAssemblyHelper::EmitAssembly(BackendAction Action,
   PerFunctionPasses.add(
       createTargetTransformInfoWrapperPass(getTargetIRAnalysis()));
 
-  CreatePasses(PerModulePasses, PerFunctionPasses);
+  if (Optimize)
+    CreatePasses(PerModulePasses, PerFunctionPasses);
 
   legacy::PassManager CodeGenPasses;
   CodeGenPasses.add(
@@ -797,25 +827,160 @@ void EmitAssemblyHelper::EmitAssembly(BackendAction Action,
 
   {
     PrettyStackTraceString CrashInfo("Per-function optimization");
+    TimeTraceScope TimeScope("PerFunctionPasses", StringRef());
+
+    SmallPtrSet<const Function *, 32> Optimized;
+    if (Pipeline) {
+      Pipeline->getOptimizedFunctions(Optimized);
+      Diags.Report(diag::remark_fe_pipelined_codegen)
+          << unsigned(Optimized.size());
+    }
 
     PerFunctionPasses.doInitialization();
     for (Function &F : *TheModule)
-      if (!F.isDeclaration())
+      if (!F.isDeclaration() && !Optimized.count(&F)) {
+        TimeTraceScope FunctionScope("RunFunctionPasses", F.getName());
         PerFunctionPasses.run(F);
+      }
     PerFunctionPasses.doFinalization();
   }
 
   {
     PrettyStackTraceString CrashInfo("Per-module optimization passes");
+    TimeTraceScope TimeScope("PerModulePasses", StringRef());
     PerModulePasses.run(*TheModule);
   }
 
   {
     PrettyStackTraceString CrashInfo("Code generation");
+    TimeTraceScope TimeScope("CodeGenPasses", StringRef());
     CodeGenPasses.run(*TheModule);
   }
 }
 
+void EmitAssemblyHelper::OptimizeModule() {
+  CreateTargetMachine(/*MustCreateTM=*/false);
+  if (TM)
+    TheModule->setDataLayout(TM->createDataLayout());
+
+  legacy::PassManager PerModulePasses;
+  PerModulePasses.add(
+      createTargetTransformInfoWrapperPass(getTargetIRAnalysis()));
+
+  legacy::FunctionPassManager PerFunctionPasses(TheModule);
+  PerFunctionPasses.add(
+      createTargetTransformInfoWrapperPass(getTargetIRAnalysis()));
+
+  CreatePasses(PerModulePasses, PerFunctionPasses);
+
+  PerFunctionPasses.doInitialization();
+  for (Function &F : *TheModule)
+    if (!F.isDeclaration())
+      PerFunctionPasses.run(F);
+  PerFunctionPasses.doFinalization();
+
+  PerModulePasses.run(*TheModule);
+}
+
+void EmitAssemblyHelper::CreatePerFunctionPasses(
+    legacy::FunctionPassManager &PerFunctionPasses) {
+  CreateTargetMachine(/*MustCreateTM=*/false);
+  PerFunctionPasses.add(
+      createTargetTransformInfoWrapperPass(getTargetIRAnalysis()));
+
+  // The module passes are created along with them, and dropped.
+  legacy::PassManager PerModulePasses;
+  CreatePasses(PerModulePasses, PerFunctionPasses);
+}
+
+struct FunctionPassPipeline::Implementation {
+  EmitAssemblyHelper Helper;
+  legacy::FunctionPassManager PerFunctionPasses;
+
+  /// The functions to optimize next.
+  std::vector<WeakVH> Pending;
+
+  /// The functions optimized so far. Those deleted since are null.
+  std::vector<WeakVH> Optimized;
+
+  ThreadPool Pool;
+
+  Implementation(DiagnosticsEngine &Diags, const HeaderSearchOptions &HeaderOpts,
+                 const CodeGenOptions &CGOpts,
+                 const clang::TargetOptions &TOpts, const LangOptions &LOpts,
+                 Module *M)
+      : Helper(Diags, HeaderOpts, CGOpts, TOpts, LOpts, M),
+        PerFunctionPasses(M), Pool(1) {
+    Helper.CreatePerFunctionPasses(PerFunctionPasses);
+  }
+
+  void optimizePending() {
+    PrettyStackTraceString CrashInfo("Per-function optimization");
+
+    // Some passes look at the module when they are initialized, e.g. for the
+    // runtime functions it declares, so initialize them for each batch.
+    PerFunctionPasses.doInitialization();
+    for (Value *V : Pending)
+      if (auto *F = cast_or_null<Function>(V))
+        if (!F->isDeclaration())
+          PerFunctionPasses.run(*F);
+    PerFunctionPasses.doFinalization();
+
+    Optimized.insert(Optimized.end(), Pending.begin(), Pending.end());
+    Pending.clear();
+  }
+};
+
+FunctionPassPipeline::FunctionPassPipeline(
+    DiagnosticsEngine &Diags, const HeaderSearchOptions &HeaderOpts,
+    const CodeGenOptions &CGOpts, const clang::TargetOptions &TOpts,
+    const LangOptions &LOpts, Module *M)
+    : Impl(new Implementation(Diags, HeaderOpts, CGOpts, TOpts, LOpts, M)) {}
+
+FunctionPassPipeline::~FunctionPassPipeline() {}
+
+bool FunctionPassPipeline::isSupported(const CodeGenOptions &CGOpts,
+                                       const LangOptions &LOpts) {
+  // The functions are optimized while the module is still being generated:
+  // the verifier and full debug info would see the module unfinished, the
+  // embedded bitcode would no longer be the unoptimized module, and the
+  // options given with -backend-option, pass timers, optimization records and
+  // OpenMP and CUDA post-processing expect the optimizer to run once IR
+  // generation is done. Remarks would be reported from another thread while
+  // parsing goes on. With -fbackend-threads, the partitions run the
+  // per-function passes again.
+  return CGOpts.OptimizationLevel > 0 && !CGOpts.DisableLLVMPasses &&
+         CGOpts.BackendThreads <= 1 &&
+         !CGOpts.ExperimentalNewPassManager && !CGOpts.VerifyModule &&
+         CGOpts.getDebugInfo() <= codegenoptions::DebugLineTablesOnly &&
+         !CGOpts.MacroDebugInfo && !CGOpts.TimePasses &&
+         CGOpts.getEmbedBitcode() == CodeGenOptions::Embed_Off &&
+         CGOpts.BackendOptions.empty() && CGOpts.DebugPass.empty() &&
+         CGOpts.LimitFloatPrecision.empty() && CGOpts.OptRecordFile.empty() &&
+         !CGOpts.OptimizationRemarkPattern &&
+         !CGOpts.OptimizationRemarkMissedPattern &&
+         !CGOpts.OptimizationRemarkAnalysisPattern && !LOpts.OpenMP &&
+         !LOpts.CUDA;
+}
+
+void FunctionPassPipeline::optimize(std::vector<WeakVH> Functions) {
+  if (Functions.empty())
+    return;
+  wait();
+  Impl->Pending = std::move(Functions);
+  Implementation *I = Impl.get();
+  Impl->Pool.async([I] { I->optimizePending(); });
+}
+
+void FunctionPassPipeline::wait() { Impl->Pool.wait(); }
+
+void FunctionPassPipeline::getOptimizedFunctions(
+    SmallPtrSetImpl<const Function *> &Functions) const {
+  for (const WeakVH &V : Impl->Optimized)
+    if (Value *F = V)
+      Functions.insert(cast<Function>(F));
+}
+
 static PassBuilder::OptimizationLevel mapToLevel(const CodeGenOptions &Opts) {
   switch (Opts.OptimizationLevel) {
   default:
@@ -1009,12 +1174,14 @@ void EmitAssemblyHelper::EmitAssemblyWithNewPassManager(
   // Now that we have all of the passes ready, run them.
   {
     PrettyStackTraceString CrashInfo("Optimizer");
+    TimeTraceScope TimeScope("Optimizer", StringRef());
     MPM.run(*TheModule, MAM);
   }
 
   // Now if needed, run the legacy PM for codegen.
   if (NeedCodeGen) {
     PrettyStackTraceString CrashInfo("Code generation");
+    TimeTraceScope TimeScope("CodeGenPasses", StringRef());
     CodeGenPasses.run(*TheModule);
   }
 }
@@ -1140,6 +1307,426 @@ static void runThinLTOBackend(ModuleSummaryIndex *CombinedIndex, Module *M,
   }
 }
 
+/// Determine whether the optimization pipeline can run on partitions of the
+/// module in parallel. Instrumentation passes add state to each module they
+/// run on, and debug info, remarks and pass timers can't be split between
+/// modules or threads. The options given with -backend-option are only set
+/// once the partitions are linked back, so there mustn't be any; those given
+/// with -mllvm are set before the compilation starts and apply to all the
+/// partitions.
+static bool canOptimizeInParallel(const CodeGenOptions &CGOpts,
+                                  const LangOptions &LOpts,
+                                  BackendAction Action) {
+  return CGOpts.BackendThreads > 1 && Action != Backend_EmitNothing &&
+         CGOpts.OptimizationLevel > 0 && !CGOpts.DisableLLVMPasses &&
+         !CGOpts.ExperimentalNewPassManager && !CGOpts.PrepareForLTO &&
+         !CGOpts.EmitSummaryIndex &&
+         CGOpts.getDebugInfo() == codegenoptions::NoDebugInfo &&
+         !CGOpts.DebugInfoForProfiling && !CGOpts.TimePasses &&
+         CGOpts.BackendOptions.empty() && CGOpts.DebugPass.empty() &&
+         CGOpts.LimitFloatPrecision.empty() &&
+         CGOpts.OptRecordFile.empty() && !CGOpts.OptimizationRemarkPattern &&
+         !CGOpts.OptimizationRemarkMissedPattern &&
+         !CGOpts.OptimizationRemarkAnalysisPattern &&
+         !CGOpts.hasProfileClangInstr() && !CGOpts.hasProfileIRInstr() &&
+         !CGOpts.hasProfileIRUse() && CGOpts.SampleProfileFile.empty() &&
+         !CGOpts.EmitGcovArcs && !CGOpts.EmitGcovNotes &&
+         !CGOpts.SanitizeCoverageType &&
+         !CGOpts.SanitizeCoverageIndirectCalls &&
+         !CGOpts.SanitizeCoverageTraceCmp &&
+         !LOpts.Sanitize.hasOneOf(
+             SanitizerKind::Address | SanitizerKind::KernelAddress |
+             SanitizerKind::HWAddress | SanitizerKind::Memory |
+             SanitizerKind::Thread | SanitizerKind::DataFlow |
+             SanitizerKind::Efficiency);
+}
+
+/// Whether a definition may be copied into every partition that refers to
+/// it. The linker keeps one of the copies.
+static bool isCopyable(const GlobalValue &GV) {
+  return GV.hasLinkOnceLinkage() || GV.hasAvailableExternallyLinkage();
+}
+
+namespace {
+/// A set of definitions that have to be optimized together.
+struct PartitionGroup {
+  /// The definitions, in module order.
+  SmallVector<const GlobalValue *, 4> Members;
+
+  /// The groups whose definitions the members refer to.
+  SmallSetVector<unsigned, 4> Refs;
+
+  /// The number of instructions in the members.
+  unsigned Size = 0;
+
+  /// Whether every member may be copied into every partition.
+  bool Copyable = true;
+};
+
+/// The assignment of the definitions of a module to partitions.
+struct ModulePartitioning {
+  std::vector<PartitionGroup> Groups;
+  DenseMap<const GlobalValue *, unsigned> GroupOf;
+
+  /// The groups each partition has to contain, either because they are
+  /// assigned to it or because they are copyable and referred to from it.
+  std::vector<DenseSet<unsigned>> PartitionGroups;
+};
+} // end anonymous namespace
+
+/// Call \p Callback with each global value that uses \p V, looking through
+/// constants.
+static void forEachGlobalUser(const Value *V,
+                              function_ref<void(const GlobalValue *)> Callback) {
+  SmallVector<const User *, 8> Worklist(V->user_begin(), V->user_end());
+  SmallPtrSet<const User *, 8> Visited;
+  while (!Worklist.empty()) {
+    const User *U = Worklist.pop_back_val();
+    if (!Visited.insert(U).second)
+      continue;
+    if (auto *I = dyn_cast<Instruction>(U))
+      Callback(I->getFunction());
+    else if (auto *GV = dyn_cast<GlobalValue>(U))
+      Callback(GV);
+    else
+      Worklist.append(U->user_begin(), U->user_end());
+  }
+}
+
+/// Split the definitions of \p M into groups that can be optimized apart,
+/// and assign the groups to \p NumPartitions partitions of similar size.
+///
+/// A definition has to be in the same partition as the definitions that
+/// refer to its local symbol or its basic blocks, and as the other members
+/// of its comdat. Always-inline functions are kept with their callers, so
+/// that they are still inlined.
+static ModulePartitioning partitionModule(const Module &M,
+                                          unsigned NumPartitions) {
+  EquivalenceClasses<const GlobalValue *> Classes;
+  DenseMap<const Comdat *, const GlobalValue *> ComdatLeaders;
+  for (const GlobalValue &GV : M.global_values()) {
+    if (GV.isDeclaration())
+      continue;
+    Classes.insert(&GV);
+
+    if (const Comdat *C = GV.getComdat()) {
+      auto Known = ComdatLeaders.insert(std::make_pair(C, &GV));
+      if (!Known.second)
+        Classes.unionSets(Known.first->second, &GV);
+    }
+
+    if (auto *GIS = dyn_cast<GlobalIndirectSymbol>(&GV))
+      if (const GlobalObject *Base = GIS->getBaseObject())
+        Classes.unionSets(Base, &GV);
+
+    auto Join = [&](const GlobalValue *User) {
+      if (!User->isDeclaration())
+        Classes.unionSets(User, &GV);
+    };
+    if (GV.hasLocalLinkage())
+      forEachGlobalUser(&GV, Join);
+
+    if (auto *F = dyn_cast<Function>(&GV)) {
+      if (F->hasFnAttribute(Attribute::AlwaysInline) && !isCopyable(*F))
+        forEachGlobalUser(F, Join);
+      for (const User *U : F->users())
+        if (isa<BlockAddress>(U))
+          forEachGlobalUser(U, Join);
+    }
+  }
+
+  // Gather the groups in module order, so that the partitioning only depends
+  // on the module.
+  ModulePartitioning Result;
+  DenseMap<const GlobalValue *, unsigned> GroupOfLeader;
+  for (const GlobalValue &GV : M.global_values()) {
+    if (GV.isDeclaration())
+      continue;
+    auto Known = GroupOfLeader.insert(
+        std::make_pair(Classes.getLeaderValue(&GV), Result.Groups.size()));
+    if (Known.second)
+      Result.Groups.emplace_back();
+    PartitionGroup &Group = Result.Groups[Known.first->second];
+    Group.Members.push_back(&GV);
+    Group.Copyable &= isCopyable(GV);
+    Result.GroupOf[&GV] = Known.first->second;
+    if (auto *F = dyn_cast<Function>(&GV)) {
+      for (const BasicBlock &BB : *F)
+        Group.Size += BB.size();
+    } else {
+      ++Group.Size;
+    }
+  }
+
+  for (unsigned I = 0, N = Result.Groups.size(); I != N; ++I)
+    for (const GlobalValue *GV : Result.Groups[I].Members)
+      forEachGlobalUser(GV, [&](const GlobalValue *User) {
+        auto Known = Result.GroupOf.find(User);
+        if (Known != Result.GroupOf.end() && Known->second != I)
+          Result.Groups[Known->second].Refs.insert(I);
+      });
+
+  // Assign the largest groups first, each to the smallest partition so far.
+  std::vector<unsigned> Order;
+  for (unsigned I = 0, N = Result.Groups.size(); I != N; ++I)
+    if (!Result.Groups[I].Copyable)
+      Order.push_back(I);
+  std::stable_sort(Order.begin(), Order.end(), [&](unsigned L, unsigned R) {
+    return Result.Groups[L].Size > Result.Groups[R].Size;
+  });
+  std::vector<uint64_t> PartitionSizes(NumPartitions);
+  Result.PartitionGroups.resize(NumPartitions);
+  for (unsigned I : Order) {
+    unsigned Partition =
+        std::min_element(PartitionSizes.begin(), PartitionSizes.end()) -
+        PartitionSizes.begin();
+    PartitionSizes[Partition] += Result.Groups[I].Size;
+    Result.PartitionGroups[Partition].insert(I);
+  }
+
+  // Add the copyable groups each partition refers to.
+  for (DenseSet<unsigned> &Groups : Result.PartitionGroups) {
+    SmallVector<unsigned, 16> Worklist(Groups.begin(), Groups.end());
+    while (!Worklist.empty())
+      for (unsigned Ref : Result.Groups[Worklist.pop_back_val()].Refs)
+        if (Result.Groups[Ref].Copyable && Groups.insert(Ref).second)
+          Worklist.push_back(Ref);
+  }
+  return Result;
+}
+
+namespace {
+/// Forwards the diagnostics reported while optimizing the partitions to the
+/// handler of the original module's context, one partition after the other.
+class PartitionDiagnostics {
+  LLVMContext &Target;
+  std::mutex Mutex;
+  std::condition_variable Finished;
+  std::vector<bool> Done;
+
+public:
+  PartitionDiagnostics(LLVMContext &Target, unsigned NumPartitions)
+      : Target(Target), Done(NumPartitions) {}
+
+  LLVMContext &getTarget() { return Target; }
+
+  /// Report \p DI from the partition \p Partition. This waits for the
+  /// partitions before it to finish, so that the diagnostics come in the
+  /// same order whatever the scheduling of the threads.
+  void report(unsigned Partition, const DiagnosticInfo &DI) {
+    std::unique_lock<std::mutex> Lock(Mutex);
+    Finished.wait(Lock, [&] {
+      return std::find(Done.begin(), Done.begin() + Partition, false) ==
+             Done.begin() + Partition;
+    });
+    Target.diagnose(DI);
+  }
+
+  /// Note that the partition \p Partition won't report anything more.
+  void finish(unsigned Partition) {
+    {
+      std::lock_guard<std::mutex> Lock(Mutex);
+      Done[Partition] = true;
+    }
+    Finished.notify_all();
+  }
+};
+
+/// The diagnostic handler of the context a partition is optimized in.
+struct PartitionDiagnosticHandler : public DiagnosticHandler {
+  PartitionDiagnostics &Diagnostics;
+  unsigned Partition;
+
+  PartitionDiagnosticHandler(PartitionDiagnostics &Diagnostics,
+                             unsigned Partition)
+      : Diagnostics(Diagnostics), Partition(Partition) {}
+
+  const DiagnosticHandler *getTargetHandler() const {
+    return Diagnostics.getTarget().getDiagHandlerPtr();
+  }
+
+  bool isAnalysisRemarkEnabled(StringRef PassName) const override {
+    return getTargetHandler()->isAnalysisRemarkEnabled(PassName);
+  }
+  bool isMissedOptRemarkEnabled(StringRef PassName) const override {
+    return getTargetHandler()->isMissedOptRemarkEnabled(PassName);
+  }
+  bool isPassedOptRemarkEnabled(StringRef PassName) const override {
+    return getTargetHandler()->isPassedOptRemarkEnabled(PassName);
+  }
+  bool isAnyRemarkEnabled() const override {
+    return getTargetHandler()->isAnyRemarkEnabled();
+  }
+
+  bool handleDiagnostics(const DiagnosticInfo &DI) override {
+    Diagnostics.report(Partition, DI);
+    return true;
+  }
+};
+} // end anonymous namespace
+
+/// Optimize \p M as \p NumPartitions partitions in parallel, and link the
+/// optimized partitions back together into a new module, in the context of
+/// \p M. Returns null if the definitions all have to be optimized together,
+/// or if the partitions can't be linked back.
+///
+/// Each partition is moved to its own LLVMContext through bitcode. The
+/// partitioning and the linking order only depend on the module, and the
+/// definitions of the result are put back in the order of \p M, so the
+/// output doesn't depend on the scheduling of the threads.
+static std::unique_ptr<Module>
+optimizeInParallel(DiagnosticsEngine &Diags,
+                   const HeaderSearchOptions &HeaderOpts,
+                   const CodeGenOptions &CGOpts,
+                   const clang::TargetOptions &TOpts,
+                   const LangOptions &LOpts, Module &M,
+                   unsigned NumPartitions) {
+  TimeTraceScope TimeScope("ParallelOptimization", StringRef());
+  ModulePartitioning Partitioning = partitionModule(M, NumPartitions);
+
+  // When the definitions can't be split, e.g. because they all call the same
+  // internal function, there is nothing to run in parallel; leave the module
+  // to the serial pipeline.
+  if (llvm::count_if(Partitioning.PartitionGroups,
+                     [](const DenseSet<unsigned> &Groups) {
+                       return !Groups.empty();
+                     }) < 2)
+    return nullptr;
+
+  // A linkonce definition that had to be assigned to a single partition, as
+  // it refers to a local symbol, must not be dropped from it once it is no
+  // longer used there: the other partitions may still refer to it. Make it
+  // weak while it is optimized.
+  StringMap<GlobalValue::LinkageTypes> WeakenedLinkages;
+  for (const PartitionGroup &Group : Partitioning.Groups)
+    if (!Group.Copyable)
+      for (const GlobalValue *GV : Group.Members)
+        if (GV->hasLinkOnceLinkage())
+          WeakenedLinkages[GV->getName()] = GV->getLinkage();
+
+  std::vector<SmallString<0>> Bitcode(NumPartitions);
+  for (unsigned I = 0; I != NumPartitions; ++I) {
+    const DenseSet<unsigned> &Groups = Partitioning.PartitionGroups[I];
+    auto IsInPartition = [&](const GlobalValue *GV) {
+      return GV->isDeclaration() ||
+             Groups.count(Partitioning.GroupOf.lookup(GV));
+    };
+    ValueToValueMapTy VMap;
+    std::unique_ptr<Module> Part = CloneModule(&M, VMap, IsInPartition);
+
+    // Drop the declarations left for the definitions of other partitions
+    // which aren't referred to from this one. Those of local symbols would
+    // clash with the definitions when linking back.
+    for (const GlobalValue &GV : M.global_values()) {
+      if (IsInPartition(&GV))
+        continue;
+      auto *Clone = cast<GlobalValue>(VMap[&GV]);
+      Clone->removeDeadConstantUsers();
+      if (Clone->use_empty())
+        Clone->eraseFromParent();
+    }
+    for (GlobalValue &GV : Part->global_values())
+      if (!GV.isDeclaration() && GV.hasLinkOnceLinkage() &&
+          WeakenedLinkages.count(GV.getName()))
+        GV.setLinkage(GV.hasLinkOnceODRLinkage() ? GlobalValue::WeakODRLinkage
+                                                 : GlobalValue::WeakAnyLinkage);
+
+    // Module level inline asm only goes in the first partition.
+    if (I != 0)
+      Part->setModuleInlineAsm("");
+
+    raw_svector_ostream OS(Bitcode[I]);
+    WriteBitcodeToFile(Part.get(), OS);
+  }
+
+  PartitionDiagnostics Diagnostics(M.getContext(), NumPartitions);
+  std::atomic<bool> Failed(false);
+  {
+    ThreadPool Pool(NumPartitions);
+    for (unsigned I = 0; I != NumPartitions; ++I) {
+      Pool.async([&, I] {
+        LLVMContext Ctx;
+        Ctx.setDiagnosticHandler(
+            llvm::make_unique<PartitionDiagnosticHandler>(Diagnostics, I));
+        Expected<std::unique_ptr<Module>> Part = parseBitcodeFile(
+            MemoryBufferRef(StringRef(Bitcode[I].data(), Bitcode[I].size()),
+                            "<partition>"),
+            Ctx);
+        if (!Part) {
+          consumeError(Part.takeError());
+          Failed = true;
+          Diagnostics.finish(I);
+          return;
+        }
+        EmitAssemblyHelper(Diags, HeaderOpts, CGOpts, TOpts, LOpts,
+                           Part->get())
+            .OptimizeModule();
+        Bitcode[I].clear();
+        raw_svector_ostream OS(Bitcode[I]);
+        WriteBitcodeToFile(Part->get(), OS);
+        Diagnostics.finish(I);
+      });
+    }
+    Pool.wait();
+  }
+
+  if (Failed)
+    return nullptr;
+
+  // Link the partitions back in order. Of the copies of a definition, the
+  // linker keeps the one from the first partition.
+  std::unique_ptr<Module> Result;
+  for (unsigned I = 0; I != NumPartitions; ++I) {
+    Expected<std::unique_ptr<Module>> Part = parseBitcodeFile(
+        MemoryBufferRef(StringRef(Bitcode[I].data(), Bitcode[I].size()),
+                        "<partition>"),
+        M.getContext());
+    if (!Part) {
+      consumeError(Part.takeError());
+      return nullptr;
+    }
+    if (!Result)
+      Result = std::move(*Part);
+    else if (Linker::linkModules(*Result, std::move(*Part)))
+      return nullptr;
+  }
+
+  for (const auto &Weakened : WeakenedLinkages)
+    if (GlobalValue *GV = Result->getNamedValue(Weakened.getKey()))
+      if (!GV->isDeclaration())
+        GV->setLinkage(Weakened.getValue());
+
+  // Every partition brings its own copy of metadata such as llvm.ident.
+  for (NamedMDNode &NMD : Result->named_metadata()) {
+    if (&NMD == Result->getModuleFlagsMetadata())
+      continue;
+    SmallVector<MDNode *, 4> Operands;
+    SmallPtrSet<MDNode *, 4> Seen;
+    for (MDNode *Op : NMD.operands())
+      if (Seen.insert(Op).second)
+        Operands.push_back(Op);
+    if (Operands.size() == NMD.getNumOperands())
+      continue;
+    NMD.clearOperands();
+    for (MDNode *Op : Operands)
+      NMD.addOperand(Op);
+  }
+
+  // Put the definitions back in their original order. Those created by the
+  // optimizer go last.
+  StringMap<unsigned> Positions;
+  for (const GlobalValue &GV : M.global_values())
+    Positions.insert(std::make_pair(GV.getName(), Positions.size() + 1));
+  auto ComesBefore = [&](const GlobalValue &L, const GlobalValue &R) {
+    return Positions.lookup(L.getName()) - 1 <
+           Positions.lookup(R.getName()) - 1;
+  };
+  Result->getFunctionList().sort(ComesBefore);
+  Result->getGlobalList().sort(ComesBefore);
+  Result->getAliasList().sort(ComesBefore);
+  return Result;
+}
+
 void clang::EmitBackendOutput(DiagnosticsEngine &Diags,
                               const HeaderSearchOptions &HeaderOpts,
                               const CodeGenOptions &CGOpts,
@@ -1147,7 +1734,10 @@ void clang::EmitBackendOutput(DiagnosticsEngine &Diags,
                               const LangOptions &LOpts,
                               const llvm::DataLayout &TDesc, Module *M,
                               BackendAction Action,
-                              std::unique_ptr<raw_pwrite_stream> OS) {
+                              std::unique_ptr<raw_pwrite_stream> OS,
+                              const FunctionPassPipeline *Pipeline) {
+  TimeTraceScope TimeScope("Backend", StringRef());
+
   if (!CGOpts.ThinLTOIndexFile.empty()) {
     // If we are performing a ThinLTO importing compile, load the function index
     // into memory and pass it into runThinLTOBackend, which will run the
@@ -1173,9 +1763,26 @@ void clang::EmitBackendOutput(DiagnosticsEngine &Diags,
     }
   }
 
+  // Optimize partitions of the module in parallel, and emit the result of
+  // linking them back without running the optimizer again. The code is then
+  // generated from the linked module on this thread: splitCodeGen would
+  // produce an object file for each partition, not a single one.
+  std::unique_ptr<Module> Linked;
+  if (canOptimizeInParallel(CGOpts, LOpts, Action))
+    Linked = optimizeInParallel(Diags, HeaderOpts, CGOpts, TOpts, LOpts, *M,
+                                CGOpts.BackendThreads);
+  if (Linked) {
+    Diags.Report(diag::remark_fe_backend_threads) << CGOpts.BackendThreads;
+    M = Linked.get();
+  }
+
   EmitAssemblyHelper AsmHelper(Diags, HeaderOpts, CGOpts, TOpts, LOpts, M);
+  if (!Linked)
+    AsmHelper.Pipeline = Pipeline;
 
-  if (CGOpts.ExperimentalNewPassManager)
+  if (Linked)
+    AsmHelper.EmitAssembly(Action, std::move(OS), /*Optimize=*/false);
+  else if (CGOpts.ExperimentalNewPassManager)
     AsmHelper.EmitAssemblyWithNewPassManager(Action, std::move(OS));
   else
     AsmHelper.EmitAssembly(Action, std::move(OS));
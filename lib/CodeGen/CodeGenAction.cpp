@@ -101,12 +101,56 @@ namespace clang {
 
     std::unique_ptr<CodeGenerator> Gen;
 
+    /// With -fpipelined-codegen, optimizes the functions generated by each
+    /// callback while the parser goes on to the next one.
+    std::unique_ptr<FunctionPassPipeline> Pipeline;
+
+    /// The depth of nested callbacks generating IR.
+    unsigned IRGenerationDepth = 0;
+
     SmallVector<LinkModule, 4> LinkModules;
 
     // This is here so that the diagnostic printer knows the module a diagnostic
     // refers to.
     llvm::Module *CurLinkModule = nullptr;
 
+    /// The LLVMContext whose handlers installDiagnosticHandlers replaced, and
+    /// those handlers.
+    LLVMContext *HandlersContext = nullptr;
+    LLVMContext::InlineAsmDiagHandlerTy OldInlineAsmHandler = nullptr;
+    void *OldInlineAsmContext = nullptr;
+    std::unique_ptr<DiagnosticHandler> OldDiagnosticHandler;
+
+    /// Install handlers so that the diagnostics of LLVM get printed through
+    /// our diagnostics hooks.
+    void installDiagnosticHandlers() {
+      if (HandlersContext)
+        return;
+      LLVMContext &Ctx = getModule()->getContext();
+      HandlersContext = &Ctx;
+
+      OldInlineAsmHandler = Ctx.getInlineAsmDiagnosticHandler();
+      OldInlineAsmContext = Ctx.getInlineAsmDiagnosticContext();
+      Ctx.setInlineAsmDiagnosticHandler(InlineAsmDiagHandler, this);
+
+      OldDiagnosticHandler = Ctx.getDiagnosticHandler();
+      Ctx.setDiagnosticHandler(llvm::make_unique<ClangDiagnosticHandler>(
+        CodeGenOpts, this));
+      Ctx.setDiagnosticsHotnessRequested(CodeGenOpts.DiagnosticsWithHotness);
+      if (CodeGenOpts.DiagnosticsHotnessThreshold != 0)
+        Ctx.setDiagnosticsHotnessThreshold(
+            CodeGenOpts.DiagnosticsHotnessThreshold);
+    }
+
+    void restoreDiagnosticHandlers() {
+      if (!HandlersContext)
+        return;
+      HandlersContext->setInlineAsmDiagnosticHandler(OldInlineAsmHandler,
+                                                     OldInlineAsmContext);
+      HandlersContext->setDiagnosticHandler(std::move(OldDiagnosticHandler));
+      HandlersContext = nullptr;
+    }
+
   public:
     BackendConsumer(BackendAction Action, DiagnosticsEngine &Diags,
                     const HeaderSearchOptions &HeaderSearchOpts,
@@ -135,8 +179,24 @@ namespace clang {
 
     CodeGenerator *getCodeGenerator() { return Gen.get(); }
 
+    /// Wait for the pipeline to be done with the module before generating
+    /// more IR.
+    void startIRGeneration() {
+      if (Pipeline && IRGenerationDepth++ == 0)
+        Pipeline->wait();
+    }
+
+    /// Hand the functions generated by the outermost callback over to the
+    /// pipeline.
+    void finishIRGeneration() {
+      if (Pipeline && --IRGenerationDepth == 0)
+        Pipeline->optimize(Gen->CGM().takeFunctionDefinitions());
+    }
+
     void HandleCXXStaticMemberVarInstantiation(VarDecl *VD) override {
+      startIRGeneration();
       Gen->HandleCXXStaticMemberVarInstantiation(VD);
+      finishIRGeneration();
     }
 
     void Initialize(ASTContext &Ctx) override {
@@ -151,6 +211,17 @@ namespace clang {
 
       if (llvm::TimePassesIsEnabled)
         LLVMIRGeneration.stopTimer();
+
+      if (CodeGenOpts.PipelinedCodeGen &&
+          FunctionPassPipeline::isSupported(CodeGenOpts, LangOpts)) {
+        // The pipeline may report diagnostics before the translation unit is
+        // done.
+        installDiagnosticHandlers();
+        Pipeline = llvm::make_unique<FunctionPassPipeline>(
+            Diags, HeaderSearchOpts, CodeGenOpts, TargetOpts, LangOpts,
+            getModule());
+        Gen->CGM().recordFunctionDefinitions();
+      }
     }
 
     bool HandleTopLevelDecl(DeclGroupRef D) override {
@@ -165,7 +236,9 @@ namespace clang {
           LLVMIRGeneration.startTimer();
       }
 
+      startIRGeneration();
       Gen->HandleTopLevelDecl(D);
+      finishIRGeneration();
 
       if (llvm::TimePassesIsEnabled) {
         LLVMIRGenerationRefCount -= 1;
@@ -183,7 +256,9 @@ namespace clang {
       if (llvm::TimePassesIsEnabled)
         LLVMIRGeneration.startTimer();
 
+      startIRGeneration();
       Gen->HandleInlineFunctionDefinition(D);
+      finishIRGeneration();
 
       if (llvm::TimePassesIsEnabled)
         LLVMIRGeneration.stopTimer();
@@ -233,6 +308,9 @@ namespace clang {
             LLVMIRGeneration.startTimer();
         }
 
+        // The functions generated from here on are left to the backend.
+        if (Pipeline)
+          Pipeline->wait();
         Gen->HandleTranslationUnit(C);
 
         if (llvm::TimePassesIsEnabled) {
@@ -245,25 +323,13 @@ namespace clang {
       }
 
       // Silently ignore if we weren't initialized for some reason.
-      if (!getModule())
+      if (!getModule()) {
+        restoreDiagnosticHandlers();
         return;
+      }
 
-      // Install an inline asm handler so that diagnostics get printed through
-      // our diagnostics hooks.
       LLVMContext &Ctx = getModule()->getContext();
-      LLVMContext::InlineAsmDiagHandlerTy OldHandler =
-        Ctx.getInlineAsmDiagnosticHandler();
-      void *OldContext = Ctx.getInlineAsmDiagnosticContext();
-      Ctx.setInlineAsmDiagnosticHandler(InlineAsmDiagHandler, this);
-
-      std::unique_ptr<DiagnosticHandler> OldDiagnosticHandler =
-          Ctx.getDiagnosticHandler();
-      Ctx.setDiagnosticHandler(llvm::make_unique<ClangDiagnosticHandler>(
-        CodeGenOpts, this));
-      Ctx.setDiagnosticsHotnessRequested(CodeGenOpts.DiagnosticsWithHotness);
-      if (CodeGenOpts.DiagnosticsHotnessThreshold != 0)
-        Ctx.setDiagnosticsHotnessThreshold(
-            CodeGenOpts.DiagnosticsHotnessThreshold);
+      installDiagnosticHandlers();
 
       std::unique_ptr<llvm::ToolOutputFile> OptRecordFile;
       if (!CodeGenOpts.OptRecordFile.empty()) {
@@ -291,11 +357,11 @@ namespace clang {
 
       EmitBackendOutput(Diags, HeaderSearchOpts, CodeGenOpts, TargetOpts,
                         LangOpts, C.getTargetInfo().getDataLayout(),
-                        getModule(), Action, std::move(AsmOutStream));
-
-      Ctx.setInlineAsmDiagnosticHandler(OldHandler, OldContext);
+                        getModule(), Action, std::move(AsmOutStream),
+                        Pipeline.get());
+      Pipeline.reset();
 
-      Ctx.setDiagnosticHandler(std::move(OldDiagnosticHandler));
+      restoreDiagnosticHandlers();
 
       if (OptRecordFile)
         OptRecordFile->keep();
@@ -305,23 +371,33 @@ namespace clang {
       PrettyStackTraceDecl CrashInfo(D, SourceLocation(),
                                      Context->getSourceManager(),
                                      "LLVM IR generation of declaration");
+      startIRGeneration();
       Gen->HandleTagDeclDefinition(D);
+      finishIRGeneration();
     }
 
     void HandleTagDeclRequiredDefinition(const TagDecl *D) override {
+      startIRGeneration();
       Gen->HandleTagDeclRequiredDefinition(D);
+      finishIRGeneration();
     }
 
     void CompleteTentativeDefinition(VarDecl *D) override {
+      startIRGeneration();
       Gen->CompleteTentativeDefinition(D);
+      finishIRGeneration();
     }
 
     void AssignInheritanceModel(CXXRecordDecl *RD) override {
+      startIRGeneration();
       Gen->AssignInheritanceModel(RD);
+      finishIRGeneration();
     }
 
     void HandleVTable(CXXRecordDecl *RD) override {
+      startIRGeneration();
       Gen->HandleVTable(RD);
+      finishIRGeneration();
     }
 
     static void InlineAsmDiagHandler(const llvm::SMDiagnostic &SM,void *Context,
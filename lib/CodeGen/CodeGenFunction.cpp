@@ -444,6 +444,8 @@ void CodeGenFunction::FinishFunction(SourceLocation EndLoc) {
     llvm::PromoteMemToReg(NormalCleanupDest, DT);
     NormalCleanupDest = nullptr;
   }
+
+  CGM.addFunctionDefinition(CurFn);
 }
 
 /// ShouldInstrumentFunction - Return true if the current function should be
@@ -40,6 +40,7 @@
 #include "clang/Basic/Module.h"
 #include "clang/Basic/SourceManager.h"
 #include "clang/Basic/TargetInfo.h"
+#include "clang/Basic/TimeTrace.h"
 #include "clang/Basic/Version.h"
 #include "clang/CodeGen/ConstantInitBuilder.h"
 #include "clang/Frontend/CodeGenOptions.h"
@@ -1730,8 +1731,20 @@ ConstantAddress CodeGenModule::GetWeakRefReference(const ValueDecl *VD) {
   return ConstantAddress(Aliasee, Alignment);
 }
 
+/// Describe \p D in time trace sections.
+static std::string getTimeTraceDetail(const ValueDecl *D,
+                                      const PrintingPolicy &Policy) {
+  std::string Name;
+  llvm::raw_string_ostream OS(Name);
+  D->getNameForDiagnostic(OS, Policy, /*Qualified=*/true);
+  return OS.str();
+}
+
 void CodeGenModule::EmitGlobal(GlobalDecl GD) {
   const auto *Global = cast<ValueDecl>(GD.getDecl());
+  TimeTraceScope TimeScope("EmitGlobal", [&]() {
+    return getTimeTraceDetail(Global, Context.getPrintingPolicy());
+  });
 
   // Weak references don't produce any output by themselves.
   if (Global->hasAttr<WeakRefAttr>())
@@ -2023,6 +2036,10 @@ bool CodeGenModule::shouldOpportunisticallyEmitVTables() {
 
 void CodeGenModule::EmitGlobalDefinition(GlobalDecl GD, llvm::GlobalValue *GV) {
   const auto *D = cast<ValueDecl>(GD.getDecl());
+  // Deferred definitions are emitted here rather than from EmitGlobal.
+  TimeTraceScope TimeScope("EmitGlobalDefinition", [&]() {
+    return getTimeTraceDetail(D, Context.getPrintingPolicy());
+  });
 
   PrettyStackTraceDecl CrashInfo(const_cast<ValueDecl *>(D), D->getLocation(),
                                  Context.getSourceManager(),
@@ -350,6 +350,11 @@ private:
   std::vector<llvm::WeakTrackingVH> LLVMUsed;
   std::vector<llvm::WeakTrackingVH> LLVMCompilerUsed;
 
+  /// The functions whose body was emitted since they were last taken, if
+  /// they are recorded for -fpipelined-codegen.
+  std::vector<llvm::WeakVH> EmittedFunctionDefinitions;
+  bool RecordFunctionDefinitions = false;
+
   /// Store the list of global constructors and their respective priorities to
   /// be emitted when the translation unit is complete.
   CtorList GlobalCtors;
@@ -939,6 +944,23 @@ public:
   /// Add a global to a list to be added to the llvm.compiler.used metadata.
   void addCompilerUsedGlobal(llvm::GlobalValue *GV);
 
+  /// Start recording the functions whose body is emitted.
+  void recordFunctionDefinitions() { RecordFunctionDefinitions = true; }
+
+  /// Note that the body of \p F was emitted.
+  void addFunctionDefinition(llvm::Function *F) {
+    if (RecordFunctionDefinitions)
+      EmittedFunctionDefinitions.emplace_back(F);
+  }
+
+  /// Take the functions whose body was emitted since the last call, if they
+  /// are recorded.
+  std::vector<llvm::WeakVH> takeFunctionDefinitions() {
+    std::vector<llvm::WeakVH> Functions;
+    Functions.swap(EmittedFunctionDefinitions);
+    return Functions;
+  }
+
   /// Add a destructor and object to add to the C++ global destructor function.
   void AddCXXDtorEntry(llvm::Constant *DtorFn, llvm::Constant *Object) {
     CXXGlobalDtors.emplace_back(DtorFn, Object);
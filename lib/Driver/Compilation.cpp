@@ -14,9 +14,17 @@
 #include "clang/Driver/Options.h"
 #include "clang/Driver/ToolChain.h"
 #include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/Config/llvm-config.h"
 #include "llvm/Option/ArgList.h"
 #include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Process.h"
+#include "llvm/Support/Threading.h"
 #include "llvm/Support/raw_ostream.h"
+#include <condition_variable>
+#include <mutex>
+#include <thread>
 
 using namespace clang::driver;
 using namespace clang;
@@ -137,43 +145,49 @@ bool Compilation::CleanupFileMap(const ArgStringMap &Files,
   return Success;
 }
 
-int Compilation::ExecuteCommand(const Command &C,
-                                const Command *&FailingCommand) const {
-  if ((getDriver().CCPrintOptions ||
-       getArgs().hasArg(options::OPT_v)) && !getDriver().CCGenDiagnostics) {
+/// Print the command line of \p C if -v or CC_PRINT_OPTIONS ask for it.
+/// Returns false if the requested log file cannot be opened.
+static bool printCommandIfRequested(const Compilation &Comp,
+                                    const Command &C) {
+  const Driver &D = Comp.getDriver();
+  if ((D.CCPrintOptions || Comp.getArgs().hasArg(options::OPT_v)) &&
+      !D.CCGenDiagnostics) {
     raw_ostream *OS = &llvm::errs();
 
     // Follow gcc implementation of CC_PRINT_OPTIONS; we could also cache the
     // output stream.
-    if (getDriver().CCPrintOptions && getDriver().CCPrintOptionsFilename) {
+    if (D.CCPrintOptions && D.CCPrintOptionsFilename) {
       std::error_code EC;
-      OS = new llvm::raw_fd_ostream(getDriver().CCPrintOptionsFilename, EC,
+      OS = new llvm::raw_fd_ostream(D.CCPrintOptionsFilename, EC,
                                     llvm::sys::fs::F_Append |
                                         llvm::sys::fs::F_Text);
       if (EC) {
-        getDriver().Diag(clang::diag::err_drv_cc_print_options_failure)
+        D.Diag(clang::diag::err_drv_cc_print_options_failure)
             << EC.message();
-        FailingCommand = &C;
         delete OS;
-        return 1;
+        return false;
       }
     }
 
-    if (getDriver().CCPrintOptions)
+    if (D.CCPrintOptions)
       *OS << "[Logging clang options]";
 
-    C.Print(*OS, "\n", /*Quote=*/getDriver().CCPrintOptions);
+    C.Print(*OS, "\n", /*Quote=*/D.CCPrintOptions);
 
     if (OS != &llvm::errs())
       delete OS;
   }
+  return true;
+}
 
-  std::string Error;
-  bool ExecutionFailed;
-  int Res = C.Execute(Redirects, &Error, &ExecutionFailed);
+/// Diagnose the outcome of running \p C and compute the driver's result code.
+static int reportCommandResult(const Compilation &Comp, const Command &C,
+                               int Res, const std::string &Error,
+                               bool ExecutionFailed,
+                               const Command *&FailingCommand) {
   if (!Error.empty()) {
     assert(Res && "Error string set with 0 result code!");
-    getDriver().Diag(clang::diag::err_drv_command_failure) << Error;
+    Comp.getDriver().Diag(clang::diag::err_drv_command_failure) << Error;
   }
 
   if (Res)
@@ -182,6 +196,20 @@ int Compilation::ExecuteCommand(const Command &C,
   return ExecutionFailed ? 1 : Res;
 }
 
+int Compilation::ExecuteCommand(const Command &C,
+                                const Command *&FailingCommand) const {
+  if (!printCommandIfRequested(*this, C)) {
+    FailingCommand = &C;
+    return 1;
+  }
+
+  std::string Error;
+  bool ExecutionFailed;
+  int Res = C.Execute(Redirects, &Error, &ExecutionFailed);
+  return reportCommandResult(*this, C, Res, Error, ExecutionFailed,
+                             FailingCommand);
+}
+
 using FailingCommandList = SmallVectorImpl<std::pair<int, const Command *>>;
 
 static bool ActionFailed(const Action *A,
@@ -212,8 +240,212 @@ static bool InputsOk(const Command &C,
   return !ActionFailed(&C.getSource(), FailingCommands);
 }
 
+/// Computes, for every job, the indices of the jobs that produce its inputs.
+///
+/// A job depends on another job if the action of the other job is reachable
+/// through the inputs of its own action; actions that were combined into the
+/// job itself (e.g. an integrated assembler step) are looked through.
+static std::vector<SmallVector<unsigned, 2>>
+computeJobDependencies(const JobList &Jobs) {
+  llvm::DenseMap<const Action *, unsigned> JobForAction;
+  unsigned Index = 0;
+  for (const auto &Job : Jobs)
+    JobForAction[&Job.getSource()] = Index++;
+
+  std::vector<SmallVector<unsigned, 2>> Deps(Jobs.size());
+  Index = 0;
+  for (const auto &Job : Jobs) {
+    SmallVector<const Action *, 8> Worklist(Job.getSource().input_begin(),
+                                            Job.getSource().input_end());
+    llvm::SmallPtrSet<const Action *, 8> Visited;
+    while (!Worklist.empty()) {
+      const Action *A = Worklist.pop_back_val();
+      if (!Visited.insert(A).second)
+        continue;
+      auto It = JobForAction.find(A);
+      if (It != JobForAction.end() && It->second != Index) {
+        Deps[Index].push_back(It->second);
+        continue;
+      }
+      Worklist.append(A->input_begin(), A->input_end());
+    }
+    ++Index;
+  }
+  return Deps;
+}
+
+namespace {
+/// The state of one job during parallel execution.
+struct ParallelJob {
+  enum StateKind { Pending, Running, Finished, Skipped } State = Pending;
+  /// Temporary files receiving the job's stdout and stderr.
+  SmallString<128> OutPath, ErrPath;
+  int Res = 0;
+  std::string Error;
+  bool ExecutionFailed = false;
+  /// Whether the job's captured output has been replayed.
+  bool Replayed = false;
+};
+} // end anonymous namespace
+
+/// Copies the contents of the temporary file \p Path to \p OS and deletes it.
+static void replayCapturedOutput(StringRef Path, raw_ostream &OS) {
+  if (Path.empty())
+    return;
+  if (auto Buffer = llvm::MemoryBuffer::getFile(Path)) {
+    OS << (*Buffer)->getBuffer();
+    OS.flush();
+  }
+  llvm::sys::fs::remove(Path);
+}
+
+void Compilation::ExecuteJobsInParallel(const JobList &Jobs,
+                                        FailingCommandList &FailingCommands,
+                                        unsigned NumThreads) const {
+  std::vector<SmallVector<unsigned, 2>> Deps = computeJobDependencies(Jobs);
+  std::vector<const Command *> Commands;
+  for (const auto &Job : Jobs)
+    Commands.push_back(&Job);
+  std::vector<ParallelJob> State(Commands.size());
+
+  std::mutex Mutex;
+  std::condition_variable Finished;
+  std::vector<std::thread> Threads;
+  unsigned NumRunning = 0;
+  bool StopLaunching = false;
+  // Captured output is replayed in job order; NextToReplay is the first job
+  // whose output has not been replayed yet.
+  unsigned NextToReplay = 0;
+
+  auto ReplayInOrder = [&] {
+    while (NextToReplay != State.size()) {
+      ParallelJob &J = State[NextToReplay];
+      if (J.State == ParallelJob::Running ||
+          (J.State == ParallelJob::Pending && !StopLaunching))
+        break;
+      if (J.State == ParallelJob::Finished && !J.Replayed) {
+        replayCapturedOutput(J.OutPath, llvm::outs());
+        replayCapturedOutput(J.ErrPath, llvm::errs());
+        J.Replayed = true;
+        const Command *FailingCommand = nullptr;
+        if (int Res = reportCommandResult(*this, *Commands[NextToReplay],
+                                          J.Res, J.Error, J.ExecutionFailed,
+                                          FailingCommand))
+          FailingCommands.push_back(std::make_pair(Res, FailingCommand));
+      }
+      ++NextToReplay;
+    }
+  };
+
+  std::unique_lock<std::mutex> Lock(Mutex);
+  for (;;) {
+    // Launch every ready job, in job order, while there are free threads.
+    for (unsigned I = 0, E = Commands.size();
+         I != E && NumRunning < NumThreads && !StopLaunching; ++I) {
+      ParallelJob &J = State[I];
+      if (J.State != ParallelJob::Pending)
+        continue;
+      bool Ready = true, Skip = false;
+      for (unsigned D : Deps[I]) {
+        if (State[D].State == ParallelJob::Skipped ||
+            (State[D].State == ParallelJob::Finished &&
+             (State[D].Res || State[D].ExecutionFailed)))
+          Skip = true;
+        else if (State[D].State != ParallelJob::Finished)
+          Ready = false;
+      }
+      if (Skip) {
+        J.State = ParallelJob::Skipped;
+        continue;
+      }
+      if (!Ready)
+        continue;
+
+      if (!printCommandIfRequested(*this, *Commands[I])) {
+        J.State = ParallelJob::Finished;
+        J.Res = 1;
+        StopLaunching = true;
+        continue;
+      }
+
+      // Capture the job's output so that it can be printed without
+      // interleaving with the output of other jobs. Explicit redirections
+      // (e.g. when generating crash diagnostics) are honored as-is.
+      std::vector<Optional<StringRef>> JobRedirects = Redirects;
+      if (JobRedirects.empty()) {
+        int FD;
+        JobRedirects = {None, None, None};
+        if (!llvm::sys::fs::createTemporaryFile("clang-job", "out", FD,
+                                                J.OutPath)) {
+          llvm::sys::Process::SafelyCloseFileDescriptor(FD);
+          JobRedirects[1] = StringRef(J.OutPath);
+        }
+        if (!llvm::sys::fs::createTemporaryFile("clang-job", "err", FD,
+                                                J.ErrPath)) {
+          llvm::sys::Process::SafelyCloseFileDescriptor(FD);
+          JobRedirects[2] = StringRef(J.ErrPath);
+        }
+      }
+
+      J.State = ParallelJob::Running;
+      ++NumRunning;
+      Threads.emplace_back([&, I, JobRedirects] {
+        std::string Error;
+        bool ExecutionFailed = false;
+        int Res = Commands[I]->Execute(JobRedirects, &Error, &ExecutionFailed);
+        std::lock_guard<std::mutex> Guard(Mutex);
+        ParallelJob &Done = State[I];
+        Done.Res = Res;
+        Done.Error = std::move(Error);
+        Done.ExecutionFailed = ExecutionFailed;
+        Done.State = ParallelJob::Finished;
+        --NumRunning;
+        Finished.notify_one();
+      });
+    }
+
+    ReplayInOrder();
+    if (NumRunning == 0)
+      break;
+
+    // Wait for a job to finish. Stop starting new jobs after the first
+    // failure; the jobs that are already running are allowed to finish.
+    Finished.wait(Lock);
+    for (const ParallelJob &J : State)
+      if (J.State == ParallelJob::Finished && (J.Res || J.ExecutionFailed))
+        StopLaunching = true;
+  }
+  // Jobs that were never started are reported as not run.
+  StopLaunching = true;
+  ReplayInOrder();
+  Lock.unlock();
+
+  for (std::thread &T : Threads)
+    T.join();
+}
+
+static unsigned getParallelJobs(const ArgList &Args) {
+  unsigned NumJobs = 1;
+  if (Arg *A = Args.getLastArg(options::OPT_parallel_jobs_EQ))
+    if (StringRef(A->getValue()).getAsInteger(10, NumJobs))
+      return 1; // Diagnosed by the driver.
+  if (NumJobs == 0)
+    NumJobs = llvm::hardware_concurrency();
+  return std::max(NumJobs, 1u);
+}
+
 void Compilation::ExecuteJobs(const JobList &Jobs,
                               FailingCommandList &FailingCommands) const {
+#if LLVM_ENABLE_THREADS
+  // Run independent jobs concurrently if asked to. The cl driver mode stops at
+  // the first failure anyway, so it always runs the jobs in sequence.
+  unsigned NumThreads = getParallelJobs(getArgs());
+  if (NumThreads > 1 && Jobs.size() > 1 && !TheDriver.IsCLMode()) {
+    ExecuteJobsInParallel(Jobs, FailingCommands, NumThreads);
+    return;
+  }
+#endif
+
   // According to UNIX standard, driver need to continue compiling all the
   // inputs on the command line even one of them failed.
   // In all but CLMode, execute all the jobs unless the necessary inputs for the
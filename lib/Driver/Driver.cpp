@@ -884,6 +884,14 @@ Compilation *Driver::BuildCompilation(ArrayRef<const char *> ArgList) {
   // Ignore -pipe.
   Args.ClaimAllArgs(options::OPT_pipe);
 
+  // -parallel-jobs is used when the jobs are executed.
+  if (Arg *A = Args.getLastArg(options::OPT_parallel_jobs_EQ)) {
+    unsigned NumJobs;
+    if (StringRef(A->getValue()).getAsInteger(10, NumJobs))
+      Diag(diag::err_drv_invalid_int_value)
+          << A->getAsString(Args) << A->getValue();
+  }
+
   // Extract -ccc args.
   //
   // FIXME: We need to figure out where this behavior should live. Most of it
@@ -27,6 +27,7 @@
 #include "clang/Frontend/FrontendDiagnostic.h"
 #include "clang/Frontend/FrontendOptions.h"
 #include "clang/Frontend/MultiplexConsumer.h"
+#include "clang/Frontend/PreambleStore.h"
 #include "clang/Frontend/Utils.h"
 #include "clang/Lex/HeaderSearch.h"
 #include "clang/Lex/Preprocessor.h"
@@ -35,6 +36,7 @@
 #include "clang/Serialization/ASTReader.h"
 #include "clang/Serialization/ASTWriter.h"
 #include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/Hashing.h"
 #include "llvm/ADT/StringExtras.h"
 #include "llvm/ADT/StringSet.h"
 #include "llvm/Support/CrashRecoveryContext.h"
@@ -229,6 +231,14 @@ void ASTUnit::setPreprocessor(std::shared_ptr<Preprocessor> PP) {
   this->PP = std::move(PP);
 }
 
+void ASTUnit::setCancellationFlag(const std::atomic<bool> *Flag) {
+  CancellationFlag = Flag;
+  // The preprocessor of the last parse outlives it; don't leave it pointing to
+  // a flag that may be gone.
+  if (PP)
+    PP->setCancellationFlag(Flag);
+}
+
 /// \brief Determine the set of code-completion contexts in which this 
 /// declaration should be shown.
 static unsigned getDeclShowContexts(const NamedDecl *ND,
@@ -815,6 +825,27 @@ public:
   }
 };
 
+/// \brief Notes whether the name of the main file is expanded, through
+/// __BASE_FILE__ or through __FILE__ in the main file itself.
+class MainFileNameTrackerPPCallbacks : public PPCallbacks {
+  const SourceManager &SM;
+  bool &UsesMainFileName;
+
+public:
+  MainFileNameTrackerPPCallbacks(const SourceManager &SM,
+                                 bool &UsesMainFileName)
+      : SM(SM), UsesMainFileName(UsesMainFileName) {}
+
+  void MacroExpands(const Token &MacroNameTok, const MacroDefinition &MD,
+                    SourceRange Range, const MacroArgs *Args) override {
+    StringRef Name = MacroNameTok.getIdentifierInfo()->getName();
+    if (Name == "__BASE_FILE__" ||
+        (Name == "__FILE__" &&
+         SM.isInMainFile(SM.getExpansionLoc(Range.getBegin()))))
+      UsesMainFileName = true;
+  }
+};
+
 /// \brief Add the given declaration to the hash of all top-level entities.
 void AddTopLevelDeclarationToHash(Decl *D, unsigned &Hash) {
   if (!D)
@@ -941,6 +972,13 @@ class ASTUnitPreambleCallbacks : public PreambleCallbacks {
 public:
   unsigned getHash() const { return Hash; }
 
+  /// \brief Whether the preamble depends on the name of its main file.
+  bool usesMainFileName() const { return UsesMainFileName; }
+
+  void BeforeExecute(CompilerInstance &CI) override {
+    SM = &CI.getSourceManager();
+  }
+
   std::vector<Decl *> takeTopLevelDecls() { return std::move(TopLevelDecls); }
 
   std::vector<serialization::DeclID> takeTopLevelDeclIDs() {
@@ -971,11 +1009,16 @@ public:
   }
 
   std::unique_ptr<PPCallbacks> createPPCallbacks() override {
-    return llvm::make_unique<MacroDefinitionTrackerPPCallbacks>(Hash);
+    return llvm::make_unique<PPChainedCallbacks>(
+        llvm::make_unique<MacroDefinitionTrackerPPCallbacks>(Hash),
+        llvm::make_unique<MainFileNameTrackerPPCallbacks>(*SM,
+                                                          UsesMainFileName));
   }
 
 private:
   unsigned Hash = 0;
+  const SourceManager *SM = nullptr;
+  bool UsesMainFileName = false;
   std::vector<Decl *> TopLevelDecls;
   std::vector<serialization::DeclID> TopLevelDeclIDs;
   llvm::SmallVector<ASTUnit::StandaloneDiagnostic, 4> PreambleDiags;
@@ -983,6 +1026,42 @@ private:
 
 } // anonymous namespace
 
+/// \brief What an ASTUnit computed while building a preamble, which it needs
+/// besides the PCH to use the preamble, e.g. when the preamble was built by
+/// another ASTUnit, or to build another preamble on top of it.
+struct ASTUnit::PreambleData : public PreambleStore::ClientData {
+  std::vector<serialization::DeclID> TopLevelDeclIDs;
+  unsigned TopLevelHashValue = 0;
+  unsigned NumWarnings = 0;
+
+  /// \brief Whether diagnostics were captured while building the preamble.
+  bool CapturedDiagnostics = false;
+  SmallVector<ASTUnit::StandaloneDiagnostic, 4> Diagnostics;
+
+  /// \brief The main file the preamble was built for, which its diagnostics
+  /// refer to.
+  std::string MainFilePath;
+
+  /// \brief Whether the preamble, or its base, depends on the name of its
+  /// main file, in which case it can't be shared with other main files.
+  bool UsesMainFileName = false;
+
+  /// \brief The data of the base preamble, if the preamble has one.
+  std::shared_ptr<const PreambleData> Base;
+};
+
+/// \brief Make the diagnostics of a preamble built for the main file
+/// \p OldMainFile refer to \p NewMainFile, which shares the preamble.
+static void
+renameMainFile(SmallVectorImpl<ASTUnit::StandaloneDiagnostic> &Diagnostics,
+               StringRef OldMainFile, StringRef NewMainFile) {
+  if (OldMainFile == NewMainFile)
+    return;
+  for (ASTUnit::StandaloneDiagnostic &SD : Diagnostics)
+    if (SD.Filename == OldMainFile)
+      SD.Filename = NewMainFile;
+}
+
 static bool isNonDriverDiag(const StoredDiagnostic &StoredDiag) {
   return StoredDiag.getLocation().isValid();
 }
@@ -1125,6 +1204,8 @@ bool ASTUnit::Parse(std::shared_ptr<PCHContainerOperations> PCHContainerOps,
   if (!Act->BeginSourceFile(*Clang.get(), Clang->getFrontendOpts().Inputs[0]))
     goto error;
 
+  Clang->getPreprocessor().setCancellationFlag(CancellationFlag);
+
   if (SavedMainFileBuffer)
     TranslateStoredDiagnostics(getFileManager(), getSourceManager(),
                                PreambleDiagnostics, StoredDiagnostics);
@@ -1241,6 +1322,11 @@ ASTUnit::getMainBufferWithPrecompiledPreamble(
   if (!Bounds.Size)
     return nullptr;
 
+  // The preamble that can't be reused anymore, to rebuild only its part after
+  // the first change.
+  std::shared_ptr<const PrecompiledPreamble> OldPreamble;
+  std::shared_ptr<const PreambleData> OldPreambleBaseData;
+
   if (Preamble) {
     if (Preamble->CanReuse(PreambleInvocationIn, MainFileBuffer.get(), Bounds,
                            VFS.get())) {
@@ -1256,7 +1342,8 @@ ASTUnit::getMainBufferWithPrecompiledPreamble(
       PreambleRebuildCounter = 1;
       return MainFileBuffer;
     } else {
-      Preamble.reset();
+      OldPreamble = std::move(Preamble);
+      OldPreambleBaseData = std::move(PreambleBaseData);
       PreambleDiagnostics.clear();
       TopLevelDeclsInPreamble.clear();
       PreambleSrcLocCache.clear();
@@ -1264,6 +1351,50 @@ ASTUnit::getMainBufferWithPrecompiledPreamble(
     }
   }
 
+  // Another ASTUnit may have built this preamble already.
+  PreambleStore &Store = PreambleStore::getShared();
+  bool UseStore = Store.isEnabled();
+  std::string StoreKey;
+  if (UseStore) {
+    StoreKey = PreambleStore::getKey(PreambleInvocationIn,
+                                     MainFileBuffer.get(), Bounds);
+    if (Optional<PreambleStore::Entry> Shared = Store.lookup(StoreKey)) {
+      const auto &Data =
+          static_cast<const PreambleData &>(*Shared->Data);
+      // Don't lose the diagnostics of the preamble if we capture them.
+      if (Data.CapturedDiagnostics || !CaptureDiagnostics) {
+        if (Shared->Preamble->CanReuse(PreambleInvocationIn,
+                                       MainFileBuffer.get(), Bounds,
+                                       VFS.get())) {
+          Preamble = std::move(Shared->Preamble);
+          PreambleBaseData = Data.Base;
+          TopLevelDecls.clear();
+          TopLevelDeclsInPreamble = Data.TopLevelDeclIDs;
+          NumWarningsInPreamble = Data.NumWarnings;
+          checkAndRemoveNonDriverDiags(StoredDiagnostics);
+          PreambleDiagnostics = Data.Diagnostics;
+          renameMainFile(PreambleDiagnostics, Data.MainFilePath, MainFilePath);
+
+          getDiagnostics().Reset();
+          ProcessWarningOptions(getDiagnostics(),
+                                PreambleInvocationIn.getDiagnosticOpts());
+          getDiagnostics().setNumWarnings(NumWarningsInPreamble);
+
+          PreambleTopLevelHashValue = Data.TopLevelHashValue;
+          if (CurrentTopLevelHashValue != PreambleTopLevelHashValue) {
+            CompletionCacheTopLevelHashValue = 0;
+            PreambleTopLevelHashValue = CurrentTopLevelHashValue;
+          }
+
+          PreambleRebuildCounter = 1;
+          return MainFileBuffer;
+        }
+        // Out of date; drop it so that the rebuilt preamble replaces it.
+        Store.remove(StoreKey, Shared->Preamble.get());
+      }
+    }
+  }
+
   // If the preamble rebuild counter > 1, it's because we previously
   // failed to build a preamble and we're not yet ready to try
   // again. Decrement the counter and return a failure.
@@ -1278,9 +1409,16 @@ ASTUnit::getMainBufferWithPrecompiledPreamble(
   if (!AllowRebuild)
     return nullptr;
 
+  // Don't start building a preamble that nobody will use; the next parse will
+  // build it.
+  if (isCancellationRequested())
+    return nullptr;
+
   SmallVector<StandaloneDiagnostic, 4> NewPreambleDiagsStandalone;
   SmallVector<StoredDiagnostic, 4> NewPreambleDiags;
   ASTUnitPreambleCallbacks Callbacks;
+  // The new preamble is probably about the size of the one it replaces.
+  std::size_t ExpectedPreambleSize = OldPreamble ? OldPreamble->getSize() : 0;
   {
     llvm::Optional<CaptureDroppedDiagnostics> Capture;
     if (CaptureDiagnostics)
@@ -1291,13 +1429,66 @@ ASTUnit::getMainBufferWithPrecompiledPreamble(
     SimpleTimer PreambleTimer(WantTiming);
     PreambleTimer.setOutput("Precompiling preamble");
 
+    // If only a header included late in the preamble changed, build the new
+    // preamble on top of one for the include directives before it, so that
+    // the next time that header changes only the rest is parsed again.
+    std::shared_ptr<const PrecompiledPreamble> BasePreamble;
+    if (OldPreamble) {
+      PreambleBounds Prefix = OldPreamble->getReusablePrefix(
+          PreambleInvocationIn, MainFileBuffer.get(), VFS.get());
+      const auto &OldBase = OldPreamble->getBase();
+      if (OldBase && OldPreambleBaseData && !OldBase->endsInConditional() &&
+          OldBase->getBounds().Size <= Prefix.Size &&
+          OldBase->getBounds().Size < Bounds.Size) {
+        BasePreamble = OldBase;
+        PreambleBaseData = std::move(OldPreambleBaseData);
+      } else if (Prefix.Size && Prefix.Size < Bounds.Size) {
+        ASTUnitPreambleCallbacks BaseCallbacks;
+        llvm::ErrorOr<PrecompiledPreamble> NewBase = PrecompiledPreamble::Build(
+            PreambleInvocationIn, MainFileBuffer.get(), Prefix, *Diagnostics,
+            VFS, PCHContainerOps, /*StoreInMemory=*/false, BaseCallbacks);
+        // A prefix ending inside a conditional can't be chained to; build
+        // the whole preamble instead.
+        if (NewBase && !NewBase->endsInConditional()) {
+          BasePreamble =
+              std::make_shared<PrecompiledPreamble>(std::move(*NewBase));
+          auto BaseData = std::make_shared<PreambleData>();
+          BaseData->TopLevelDeclIDs = BaseCallbacks.takeTopLevelDeclIDs();
+          BaseData->TopLevelHashValue = BaseCallbacks.getHash();
+          BaseData->NumWarnings = getDiagnostics().getNumWarnings();
+          BaseData->CapturedDiagnostics = CaptureDiagnostics;
+          BaseData->Diagnostics = NewPreambleDiagsStandalone;
+          BaseData->MainFilePath = MainFilePath;
+          BaseData->UsesMainFileName = BaseCallbacks.usesMainFileName();
+          PreambleBaseData = std::move(BaseData);
+        } else {
+          // The full build reports the same diagnostics.
+          NewPreambleDiagsStandalone.clear();
+          NewPreambleDiags.clear();
+        }
+      }
+      OldPreamble.reset();
+
+      if (BasePreamble) {
+        // The diagnostics of the base preamble are not emitted again.
+        NewPreambleDiagsStandalone = PreambleBaseData->Diagnostics;
+        renameMainFile(NewPreambleDiagsStandalone,
+                       PreambleBaseData->MainFilePath, MainFilePath);
+        NewPreambleDiags.clear();
+      }
+    }
+
     llvm::ErrorOr<PrecompiledPreamble> NewPreamble = PrecompiledPreamble::Build(
         PreambleInvocationIn, MainFileBuffer.get(), Bounds, *Diagnostics, VFS,
-        PCHContainerOps, /*StoreInMemory=*/false, Callbacks);
+        PCHContainerOps,
+        /*StoreInMemory=*/UseStore &&
+            Store.shouldBuildInMemory(ExpectedPreambleSize),
+        Callbacks, BasePreamble);
     if (NewPreamble) {
-      Preamble = std::move(*NewPreamble);
+      Preamble = std::make_shared<PrecompiledPreamble>(std::move(*NewPreamble));
       PreambleRebuildCounter = 1;
     } else {
+      PreambleBaseData.reset();
       switch (static_cast<BuildPreambleError>(NewPreamble.getError().value())) {
       case BuildPreambleError::CouldntCreateTempFile:
       case BuildPreambleError::PreambleIsEmpty:
@@ -1324,10 +1515,38 @@ ASTUnit::getMainBufferWithPrecompiledPreamble(
 
   NumWarningsInPreamble = getDiagnostics().getNumWarnings();
 
+  // Account for the declarations and warnings of the base preamble. The
+  // declaration IDs of the base PCH stay the same in the PCHs chained to it.
+  if (PreambleBaseData) {
+    TopLevelDeclsInPreamble.insert(TopLevelDeclsInPreamble.begin(),
+                                   PreambleBaseData->TopLevelDeclIDs.begin(),
+                                   PreambleBaseData->TopLevelDeclIDs.end());
+    PreambleTopLevelHashValue = unsigned(llvm::hash_combine(
+        PreambleBaseData->TopLevelHashValue, PreambleTopLevelHashValue));
+    NumWarningsInPreamble += PreambleBaseData->NumWarnings;
+  }
+
   checkAndRemoveNonDriverDiags(NewPreambleDiags);
   StoredDiagnostics = std::move(NewPreambleDiags);
   PreambleDiagnostics = std::move(NewPreambleDiagsStandalone);
 
+  // The name of the main file is part of a preamble using __FILE__ or
+  // __BASE_FILE__, so other main files can't use it.
+  bool UsesMainFileName =
+      Callbacks.usesMainFileName() ||
+      (PreambleBaseData && PreambleBaseData->UsesMainFileName);
+  if (UseStore && !UsesMainFileName) {
+    auto Data = std::make_shared<PreambleData>();
+    Data->TopLevelDeclIDs = TopLevelDeclsInPreamble;
+    Data->TopLevelHashValue = PreambleTopLevelHashValue;
+    Data->NumWarnings = NumWarningsInPreamble;
+    Data->CapturedDiagnostics = CaptureDiagnostics;
+    Data->Diagnostics = PreambleDiagnostics;
+    Data->Base = PreambleBaseData;
+    Data->MainFilePath = MainFilePath;
+    Store.insert(StoreKey, PreambleStore::Entry{Preamble, std::move(Data)});
+  }
+
   // If the hash of top-level entities differs from the hash of the top-level
   // entities the last time we rebuilt the preamble, clear out the completion
   // cache.
@@ -1865,6 +2084,11 @@ namespace {
     CodeCompletionTUInfo &getCodeCompletionTUInfo() override {
       return Next.getCodeCompletionTUInfo();
     }
+
+    bool isResultFilteredOut(StringRef Filter,
+                             CodeCompletionResult Result) override {
+      return Next.isResultFilteredOut(Filter, Result);
+    }
   };
 } // anonymous namespace
 
@@ -1963,6 +2187,9 @@ void AugmentedCodeCompleteConsumer::ProcessCodeCompleteResults(Sema &S,
         ? NormalContexts : (1LL << Context.getKind());
   // Contains the set of names that are hidden by "local" completion results.
   llvm::StringSet<llvm::BumpPtrAllocator> HiddenNames;
+  // Sema only reports the local results that the next consumer doesn't filter
+  // out; do the same for the cached ones.
+  StringRef Filter = S.getPreprocessor().getCodeCompletionFilter();
   typedef CodeCompletionResult Result;
   SmallVector<Result, 8> AllResults;
   for (ASTUnit::cached_completion_iterator 
@@ -2027,19 +2254,32 @@ void AugmentedCodeCompleteConsumer::ProcessCodeCompleteResults(Sema &S,
       Completion = Builder.TakeString();
     }
     
-    AllResults.push_back(Result(Completion, Priority, C->Kind,
-                                C->Availability));
+    Result R(Completion, Priority, C->Kind, C->Availability);
+    if (!Filter.empty() && Next.isResultFilteredOut(Filter, R))
+      continue;
+    AllResults.push_back(R);
   }
   
   // If we did not add any cached completion results, just forward the
   // results we were given to the next consumer.
-  if (!AddedResult) {
-    Next.ProcessCodeCompleteResults(S, Context, Results, NumResults);
-    return;
-  }
-  
-  Next.ProcessCodeCompleteResults(S, Context, AllResults.data(),
-                                  AllResults.size());
+  MutableArrayRef<Result> ToForward(Results, NumResults);
+  if (AddedResult)
+    ToForward = AllResults;
+
+  // Sema bounded its results without knowing about the cached ones. The best
+  // of all results are still among those it kept and the cached ones.
+  std::vector<Result> BestResults;
+  unsigned MaxResults = getMaxResults();
+  if (MaxResults && ToForward.size() > MaxResults) {
+    BoundedCodeCompletionResults Best(MaxResults);
+    for (const Result &R : ToForward)
+      Best.add(R);
+    BestResults = Best.takeResults();
+    ToForward = BestResults;
+  }
+
+  Next.ProcessCodeCompleteResults(S, Context, ToForward.data(),
+                                  ToForward.size());
 }
 
 void ASTUnit::CodeComplete(
@@ -2192,6 +2432,7 @@ void ASTUnit::CodeComplete(
   std::unique_ptr<SyntaxOnlyAction> Act;
   Act.reset(new SyntaxOnlyAction);
   if (Act->BeginSourceFile(*Clang.get(), Clang->getFrontendOpts().Inputs[0])) {
+    Clang->getPreprocessor().setCancellationFlag(CancellationFlag);
     Act->Execute();
     Act->EndSourceFile();
   }
@@ -24,6 +24,7 @@
 #include "clang/Frontend/FrontendActions.h"
 #include "clang/Frontend/FrontendDiagnostic.h"
 #include "clang/Frontend/LogDiagnosticPrinter.h"
+#include "clang/Frontend/ModuleBuildScheduler.h"
 #include "clang/Frontend/SerializedDiagnosticPrinter.h"
 #include "clang/Frontend/TextDiagnosticPrinter.h"
 #include "clang/Frontend/Utils.h"
@@ -34,8 +35,12 @@
 #include "clang/Lex/PreprocessorOptions.h"
 #include "clang/Sema/CodeCompleteConsumer.h"
 #include "clang/Sema/Sema.h"
+#include "clang/Sema/TemplateInstCallback.h"
 #include "clang/Serialization/ASTReader.h"
 #include "clang/Serialization/GlobalModuleIndex.h"
+#include "clang/Serialization/ModuleChunkStore.h"
+#include "llvm/ADT/MapVector.h"
+#include "llvm/ADT/SmallPtrSet.h"
 #include "llvm/ADT/Statistic.h"
 #include "llvm/Support/CrashRecoveryContext.h"
 #include "llvm/Support/Errc.h"
@@ -637,6 +642,15 @@ void CompilerInstance::createSema(TranslationUnitKind TUKind,
                                   CodeCompleteConsumer *CompletionConsumer) {
   TheSema.reset(new Sema(getPreprocessor(), getASTContext(), getASTConsumer(),
                          TUKind, CompletionConsumer));
+  // Profile template instantiations if requested. Implicitly built modules
+  // inherit the option but must not overwrite the report of the main file.
+  const FrontendOptions &FEOpts = getFrontendOpts();
+  if (!FEOpts.TemplateInstantiationReport.empty() &&
+      !FEOpts.BuildingImplicitModule)
+    TheSema->TemplateInstCallbacks.push_back(
+        createTemplateInstantiationProfiler(
+            FEOpts.TemplateInstantiationReport,
+            FEOpts.TemplateInstantiationReportJSON));
   // Attach the external sema source if there is any.
   if (ExternalSemaSrc) {
     TheSema->addExternalSource(ExternalSemaSrc.get());
@@ -1056,17 +1070,13 @@ static InputKind::Language getLanguageFromOptions(const LangOptions &LangOpts) {
   return LangOpts.CPlusPlus ? InputKind::CXX : InputKind::C;
 }
 
-/// \brief Compile a module file for the given module, using the options 
-/// provided by the importing compiler instance. Returns true if the module
-/// was built without errors.
-static bool
-compileModuleImpl(CompilerInstance &ImportingInstance, SourceLocation ImportLoc,
-                  StringRef ModuleName, FrontendInputFile Input,
-                  StringRef OriginalModuleMapFile, StringRef ModuleFileName,
-                  llvm::function_ref<void(CompilerInstance &)> PreBuildStep =
-                      [](CompilerInstance &) {},
-                  llvm::function_ref<void(CompilerInstance &)> PostBuildStep =
-                      [](CompilerInstance &) {}) {
+/// \brief Create the invocation that builds a module file for the given
+/// module, using the options provided by the importing compiler instance.
+static std::shared_ptr<CompilerInvocation>
+createModuleInvocation(CompilerInstance &ImportingInstance,
+                       StringRef ModuleName, FrontendInputFile Input,
+                       StringRef OriginalModuleMapFile,
+                       StringRef ModuleFileName) {
   // Construct a compiler invocation for creating this module.
   auto Invocation =
       std::make_shared<CompilerInvocation>(ImportingInstance.getInvocation());
@@ -1122,7 +1132,24 @@ compileModuleImpl(CompilerInstance &ImportingInstance, SourceLocation ImportLoc,
   Invocation->getDiagnosticOpts().VerifyDiagnostics = 0;
   assert(ImportingInstance.getInvocation().getModuleHash() ==
          Invocation->getModuleHash() && "Module hash mismatch!");
-  
+  return Invocation;
+}
+
+/// \brief Compile a module file for the given module, using the options 
+/// provided by the importing compiler instance. Returns true if the module
+/// was built without errors.
+static bool
+compileModuleImpl(CompilerInstance &ImportingInstance, SourceLocation ImportLoc,
+                  StringRef ModuleName, FrontendInputFile Input,
+                  StringRef OriginalModuleMapFile, StringRef ModuleFileName,
+                  llvm::function_ref<void(CompilerInstance &)> PreBuildStep =
+                      [](CompilerInstance &) {},
+                  llvm::function_ref<void(CompilerInstance &)> PostBuildStep =
+                      [](CompilerInstance &) {}) {
+  std::shared_ptr<CompilerInvocation> Invocation =
+      createModuleInvocation(ImportingInstance, ModuleName, Input,
+                             OriginalModuleMapFile, ModuleFileName);
+
   // Construct a compiler instance that will be used to actually create the
   // module.  Since we're sharing a PCMCache,
   // CompilerInstance::CompilerInstance is responsible for finalizing the
@@ -1163,9 +1190,11 @@ compileModuleImpl(CompilerInstance &ImportingInstance, SourceLocation ImportLoc,
   // Execute the action to actually build the module in-place. Use a separate
   // thread so that we get a stack large enough.
   const unsigned ThreadStackSize = 8 << 20;
+  uint64_t BuildingThread = ModuleBuildScheduler::getCurrentThread();
   llvm::CrashRecoveryContext CRC;
   CRC.RunSafelyOnThread(
       [&]() {
+        ModuleBuildScheduler::ThreadContinuation Continuation(BuildingThread);
         GenerateModuleFromModuleMapAction Action;
         Instance.ExecuteAction(Action);
       },
@@ -1186,55 +1215,66 @@ compileModuleImpl(CompilerInstance &ImportingInstance, SourceLocation ImportLoc,
   return !Instance.getDiagnostics().hasErrorOccurred();
 }
 
-/// \brief Compile a module file for the given module, using the options 
-/// provided by the importing compiler instance. Returns true if the module
-/// was built without errors.
+/// \brief Determine the module map to build the given module from. If the
+/// module was inferred, this is a fake file whose contents are returned in
+/// \p InferredModuleMap.
+static FrontendInputFile getModuleMapInput(CompilerInstance &ImportingInstance,
+                                           Module *Module,
+                                           std::string &InferredModuleMap) {
+  InputKind IK(getLanguageFromOptions(ImportingInstance.getLangOpts()),
+               InputKind::ModuleMap);
+
+  // Use the module map where this module resides.
+  ModuleMap &ModMap
+    = ImportingInstance.getPreprocessor().getHeaderSearchInfo().getModuleMap();
+  if (const FileEntry *ModuleMapFile =
+          ModMap.getContainingModuleMapFile(Module))
+    return FrontendInputFile(ModuleMapFile->getName(), IK, +Module->IsSystem);
+
+  // FIXME: We only need to fake up an input file here as a way of
+  // transporting the module's directory to the module map parser. We should
+  // be able to do that more directly, and parse from a memory buffer without
+  // inventing this file.
+  SmallString<128> FakeModuleMapFile(Module->Directory->getName());
+  llvm::sys::path::append(FakeModuleMapFile, "__inferred_module.map");
+
+  llvm::raw_string_ostream OS(InferredModuleMap);
+  Module->print(OS);
+  OS.flush();
+
+  return FrontendInputFile(FakeModuleMapFile, IK, +Module->IsSystem);
+}
+
+/// \brief Make the inferred module map of a module build available to the
+/// compiler instance building it.
+static void addInferredModuleMap(CompilerInstance &Instance,
+                                 StringRef FakeModuleMapFile,
+                                 StringRef InferredModuleMap) {
+  std::unique_ptr<llvm::MemoryBuffer> ModuleMapBuffer =
+      llvm::MemoryBuffer::getMemBuffer(InferredModuleMap);
+  const FileEntry *ModuleMapFile = Instance.getFileManager().getVirtualFile(
+      FakeModuleMapFile, InferredModuleMap.size(), 0);
+  Instance.getSourceManager().overrideFileContents(ModuleMapFile,
+                                                   std::move(ModuleMapBuffer));
+}
+
 static bool compileModuleImpl(CompilerInstance &ImportingInstance,
                               SourceLocation ImportLoc,
                               Module *Module,
                               StringRef ModuleFileName) {
-  InputKind IK(getLanguageFromOptions(ImportingInstance.getLangOpts()),
-               InputKind::ModuleMap);
-
   // Get or create the module map that we'll use to build this module.
   ModuleMap &ModMap 
     = ImportingInstance.getPreprocessor().getHeaderSearchInfo().getModuleMap();
-  bool Result;
-  if (const FileEntry *ModuleMapFile =
-          ModMap.getContainingModuleMapFile(Module)) {
-    // Use the module map where this module resides.
-    Result = compileModuleImpl(
-        ImportingInstance, ImportLoc, Module->getTopLevelModuleName(),
-        FrontendInputFile(ModuleMapFile->getName(), IK, +Module->IsSystem),
-        ModMap.getModuleMapFileForUniquing(Module)->getName(),
-        ModuleFileName);
-  } else {
-    // FIXME: We only need to fake up an input file here as a way of
-    // transporting the module's directory to the module map parser. We should
-    // be able to do that more directly, and parse from a memory buffer without
-    // inventing this file.
-    SmallString<128> FakeModuleMapFile(Module->Directory->getName());
-    llvm::sys::path::append(FakeModuleMapFile, "__inferred_module.map");
-
-    std::string InferredModuleMapContent;
-    llvm::raw_string_ostream OS(InferredModuleMapContent);
-    Module->print(OS);
-    OS.flush();
-
-    Result = compileModuleImpl(
-        ImportingInstance, ImportLoc, Module->getTopLevelModuleName(),
-        FrontendInputFile(FakeModuleMapFile, IK, +Module->IsSystem),
-        ModMap.getModuleMapFileForUniquing(Module)->getName(),
-        ModuleFileName,
-        [&](CompilerInstance &Instance) {
-      std::unique_ptr<llvm::MemoryBuffer> ModuleMapBuffer =
-          llvm::MemoryBuffer::getMemBuffer(InferredModuleMapContent);
-      ModuleMapFile = Instance.getFileManager().getVirtualFile(
-          FakeModuleMapFile, InferredModuleMapContent.size(), 0);
-      Instance.getSourceManager().overrideFileContents(
-          ModuleMapFile, std::move(ModuleMapBuffer));
-    });
-  }
+  std::string InferredModuleMap;
+  FrontendInputFile Input =
+      getModuleMapInput(ImportingInstance, Module, InferredModuleMap);
+  bool Result = compileModuleImpl(
+      ImportingInstance, ImportLoc, Module->getTopLevelModuleName(), Input,
+      ModMap.getModuleMapFileForUniquing(Module)->getName(), ModuleFileName,
+      [&](CompilerInstance &Instance) {
+    if (!InferredModuleMap.empty())
+      addInferredModuleMap(Instance, Input.getFile(), InferredModuleMap);
+  });
 
   // We've rebuilt a module. If we're allowed to generate or update the global
   // module index, record that fact in the importing compiler instance.
@@ -1245,6 +1285,280 @@ static bool compileModuleImpl(CompilerInstance &ImportingInstance,
   return Result;
 }
 
+/// \brief Collect the other top-level modules that the given module depends on
+/// according to the module maps, i.e. the modules it uses or re-exports by
+/// name.
+static void collectModuleMapDependencies(HeaderSearch &HS, Module *M,
+                                         SmallVectorImpl<Module *> &Deps) {
+  ModuleMap &ModMap = HS.getModuleMap();
+  llvm::SmallPtrSet<Module *, 8> Seen;
+  SmallVector<Module *, 8> Worklist(1, M);
+  while (!Worklist.empty()) {
+    Module *Sub = Worklist.pop_back_val();
+
+    // Load the module maps of the modules named in the declarations, so that
+    // they can be resolved.
+    for (const ModuleId &Use : Sub->UnresolvedDirectUses)
+      HS.lookupModule(Use.front().first);
+    for (const Module::UnresolvedExportDecl &Export : Sub->UnresolvedExports)
+      if (!Export.Id.empty())
+        HS.lookupModule(Export.Id.front().first);
+    ModMap.resolveUses(Sub, /*Complain=*/false);
+    ModMap.resolveExports(Sub, /*Complain=*/false);
+
+    auto AddDep = [&](Module *Dep) {
+      Dep = Dep->getTopLevelModule();
+      if (Dep != M && Seen.insert(Dep).second)
+        Deps.push_back(Dep);
+    };
+    for (Module *Use : Sub->DirectUses)
+      AddDep(Use);
+    for (const Module::ExportDecl &Export : Sub->Exports)
+      if (Module *Exported = Export.getPointer())
+        AddDep(Exported);
+
+    Worklist.append(Sub->submodule_begin(), Sub->submodule_end());
+  }
+}
+
+namespace {
+/// \brief Collects the diagnostics of a module built on another thread, to
+/// be reported once the build is done.
+class StoringDiagnosticConsumer : public DiagnosticConsumer {
+  std::vector<StoredDiagnostic> &Diagnostics;
+
+public:
+  StoringDiagnosticConsumer(std::vector<StoredDiagnostic> &Diagnostics)
+      : Diagnostics(Diagnostics) {}
+
+  void HandleDiagnostic(DiagnosticsEngine::Level DiagLevel,
+                        const Diagnostic &Info) override {
+    DiagnosticConsumer::HandleDiagnostic(DiagLevel, Info);
+    Diagnostics.push_back(StoredDiagnostic(DiagLevel, Info));
+  }
+};
+
+/// \brief A module file built ahead of its first import.
+struct PrebuiltModule {
+  Module *Mod;
+  std::string ModuleFileName;
+  std::shared_ptr<CompilerInvocation> Invocation;
+  std::string InferredModuleMap;
+
+  /// Whether the module file was built by this build, rather than by another
+  /// thread or process.
+  bool BuiltHere = false;
+
+  /// The diagnostics of the build, and the source manager they refer to.
+  std::vector<StoredDiagnostic> Diagnostics;
+  IntrusiveRefCntPtr<FileManager> FileMgr;
+  IntrusiveRefCntPtr<DiagnosticsEngine> Diags;
+  IntrusiveRefCntPtr<SourceManager> SourceMgr;
+};
+} // end anonymous namespace
+
+/// \brief Move the contents of a module file that was just built into the
+/// chunk store of the module cache, if the module cache is deduplicated.
+///
+/// This is done while holding the lock on the module file. If it fails, the
+/// module file is simply left as it is.
+static void storeBuiltModuleFile(DiagnosticsEngine &Diags, SourceLocation Loc,
+                                 const HeaderSearchOptions &HSOpts,
+                                 StringRef ModuleName,
+                                 StringRef ModuleFileName) {
+  if (!HSOpts.ModulesDedupCache || HSOpts.ModuleCachePath.empty())
+    return;
+  ModuleChunkStore::StoreStatistics Stats;
+  if (!ModuleChunkStore::storeModuleFile(ModuleFileName,
+                                         HSOpts.ModuleCachePath, &Stats))
+    Diags.Report(Loc, diag::remark_module_dedup_store)
+        << ModuleName << Stats.NumChunks << Stats.NumSharedChunks;
+}
+
+/// \brief Build a module file on the current thread, with a compiler instance
+/// that shares nothing but the virtual file system with the importer.
+static bool compilePrebuiltModule(
+    PrebuiltModule &Prebuilt,
+    std::shared_ptr<PCHContainerOperations> PCHContainerOps,
+    IntrusiveRefCntPtr<vfs::FileSystem> VFS) {
+  // Other processes coordinate with us through the lock file. If another
+  // thread or process is already building the module, let it finish, and
+  // leave the module to the importers if that fails. If the thread building
+  // it is waiting for this one, the modules import each other; leave it to
+  // the importers to diagnose the cycle.
+  llvm::LockFileManager Locked(Prebuilt.ModuleFileName);
+  if (Locked != llvm::LockFileManager::LFS_Owned) {
+    if (Locked == llvm::LockFileManager::LFS_Shared) {
+      switch (ModuleBuildScheduler::get().waitForBuild(
+          Prebuilt.ModuleFileName)) {
+      case ModuleBuildScheduler::NotBuilding:
+        Locked.waitForUnlock();
+        break;
+      case ModuleBuildScheduler::BuildFinished:
+        break;
+      case ModuleBuildScheduler::WouldDeadlock:
+        return false;
+      }
+    }
+    return true;
+  }
+  ModuleBuildScheduler::BuildClaim Claim(ModuleBuildScheduler::get(),
+                                         Prebuilt.ModuleFileName);
+
+  // A separate PCM cache, which also makes the instance a module build.
+  IntrusiveRefCntPtr<MemoryBufferCache> PCMCache(new MemoryBufferCache);
+  CompilerInstance Instance(std::move(PCHContainerOps), PCMCache.get());
+  CompilerInvocation &Inv = *Prebuilt.Invocation;
+  Instance.setInvocation(Prebuilt.Invocation);
+  Instance.createDiagnostics(
+      new StoringDiagnosticConsumer(Prebuilt.Diagnostics),
+      /*ShouldOwnClient=*/true);
+  Instance.setVirtualFileSystem(VFS);
+  Instance.createFileManager();
+  Instance.createSourceManager(Instance.getFileManager());
+  Instance.getSourceManager().pushModuleBuildStack(
+      Inv.getLangOpts()->CurrentModule, FullSourceLoc());
+  if (!Prebuilt.InferredModuleMap.empty())
+    addInferredModuleMap(Instance, Inv.getFrontendOpts().Inputs[0].getFile(),
+                         Prebuilt.InferredModuleMap);
+
+  // Keep the source manager, and what it refers to, alive for the stored
+  // diagnostics.
+  Prebuilt.FileMgr = &Instance.getFileManager();
+  Prebuilt.Diags = &Instance.getDiagnostics();
+  Prebuilt.SourceMgr = &Instance.getSourceManager();
+
+  const unsigned ThreadStackSize = 8 << 20;
+  uint64_t BuildingThread = ModuleBuildScheduler::getCurrentThread();
+  llvm::CrashRecoveryContext CRC;
+  CRC.RunSafelyOnThread(
+      [&]() {
+        ModuleBuildScheduler::ThreadContinuation Continuation(BuildingThread);
+        GenerateModuleFromModuleMapAction Action;
+        Instance.ExecuteAction(Action);
+      },
+      ThreadStackSize);
+
+  Instance.clearOutputFiles(/*EraseFiles=*/true);
+  if (Instance.getDiagnostics().hasErrorOccurred())
+    return false;
+  storeBuiltModuleFile(Instance.getDiagnostics(), SourceLocation(),
+                       Inv.getHeaderSearchOpts(), Prebuilt.Mod->Name,
+                       Prebuilt.ModuleFileName);
+  Prebuilt.BuiltHere = true;
+  return true;
+}
+
+/// \brief Build the missing module files of the modules that the given module
+/// depends on according to the module maps, in parallel, before building the
+/// module itself.
+///
+/// This is only an optimization: the modules that fail to build here are
+/// built, and their errors reported, when they are imported.
+static void prebuildModuleDependencies(CompilerInstance &ImportingInstance,
+                                       SourceLocation ImportLoc,
+                                       Module *Module) {
+  HeaderSearch &HS = ImportingInstance.getPreprocessor().getHeaderSearchInfo();
+  ModuleMap &ModMap = HS.getModuleMap();
+  const PreprocessorOptions &PPOpts = ImportingInstance.getPreprocessorOpts();
+
+  // Discover the module graph below the module.
+  llvm::MapVector<clang::Module *, SmallVector<clang::Module *, 4>> Graph;
+  SmallVector<clang::Module *, 16> Worklist(1, Module);
+  Graph[Module];
+  while (!Worklist.empty()) {
+    clang::Module *M = Worklist.pop_back_val();
+    SmallVector<clang::Module *, 4> Deps;
+    collectModuleMapDependencies(HS, M, Deps);
+    for (clang::Module *Dep : Deps)
+      if (!Graph.count(Dep)) {
+        Graph[Dep];
+        Worklist.push_back(Dep);
+      }
+    Graph[M] = std::move(Deps);
+  }
+
+  // Set up a build for each of the modules whose module file is missing.
+  std::vector<PrebuiltModule> Prebuilt;
+  llvm::DenseMap<clang::Module *, unsigned> PrebuiltIndex;
+  for (auto &Node : Graph) {
+    clang::Module *M = Node.first;
+    if (M == Module || !M->isAvailable() || M->getASTFile() ||
+        !ModMap.getModuleMapFileForUniquing(M) ||
+        (PPOpts.FailedModules &&
+         PPOpts.FailedModules->hasAlreadyFailed(M->Name)))
+      continue;
+    std::string ModuleFileName = HS.getCachedModuleFileName(M);
+    if (ModuleFileName.empty() || llvm::sys::fs::exists(ModuleFileName))
+      continue;
+
+    PrebuiltModule P;
+    P.Mod = M;
+    P.ModuleFileName = ModuleFileName;
+    FrontendInputFile Input =
+        getModuleMapInput(ImportingInstance, M, P.InferredModuleMap);
+    P.Invocation = createModuleInvocation(
+        ImportingInstance, M->Name, Input,
+        ModMap.getModuleMapFileForUniquing(M)->getName(), ModuleFileName);
+
+    // Nothing reachable from the invocation may be shared with other threads.
+    P.Invocation->getPreprocessorOpts().FailedModules =
+        std::make_shared<PreprocessorOptions::FailedModulesSet>();
+    P.Invocation->getHeaderSearchOpts().ModuleBuildThreads = 0;
+    P.Invocation->getDiagnosticOpts().DiagnosticLogFile.clear();
+    P.Invocation->getDiagnosticOpts().DiagnosticSerializationFile.clear();
+
+    PrebuiltIndex[M] = Prebuilt.size();
+    Prebuilt.push_back(std::move(P));
+  }
+  if (Prebuilt.empty())
+    return;
+
+  std::vector<ModuleBuildScheduler::Job> Jobs(Prebuilt.size());
+  for (unsigned I = 0, E = Prebuilt.size(); I != E; ++I) {
+    for (clang::Module *Dep : Graph[Prebuilt[I].Mod]) {
+      auto Known = PrebuiltIndex.find(Dep);
+      if (Known != PrebuiltIndex.end())
+        Jobs[I].Deps.push_back(Known->second);
+    }
+    Jobs[I].Build = [&, I] {
+      return compilePrebuiltModule(
+          Prebuilt[I], ImportingInstance.getPCHContainerOperations(),
+          &ImportingInstance.getVirtualFileSystem());
+    };
+  }
+
+  std::vector<bool> Built = ModuleBuildScheduler::get().runJobs(
+      Jobs, ImportingInstance.getHeaderSearchOpts().ModuleBuildThreads);
+
+  // Report the modules built here and their warnings, in a deterministic
+  // order. Modules that another thread or process built are reported there.
+  DiagnosticsEngine &Diags = ImportingInstance.getDiagnostics();
+  for (unsigned I = 0, E = Prebuilt.size(); I != E; ++I) {
+    PrebuiltModule &P = Prebuilt[I];
+    if (!Built[I] || !P.BuiltHere)
+      continue;
+    Diags.Report(ImportLoc, diag::remark_module_build)
+        << P.Mod->Name << P.ModuleFileName;
+    if (!P.Diagnostics.empty()) {
+      // The stored locations refer to the source manager of the build, which
+      // the importer's engine cannot be pointed at, so the diagnostics are
+      // emitted through an engine of their own and counted in the importer's.
+      DiagnosticsEngine Replay(Diags.getDiagnosticIDs(),
+                               &Diags.getDiagnosticOptions(),
+                               Diags.getClient(), /*ShouldOwnClient=*/false);
+      Replay.setSourceManager(P.SourceMgr.get());
+      for (const StoredDiagnostic &D : P.Diagnostics)
+        Replay.Report(D);
+      Diags.setNumWarnings(Diags.getNumWarnings() + Replay.getNumWarnings());
+    }
+    Diags.Report(ImportLoc, diag::remark_module_build_done) << P.Mod->Name;
+
+    if (ImportingInstance.getFrontendOpts().GenerateGlobalModuleIndex)
+      ImportingInstance.setBuildGlobalModuleIndex(true);
+  }
+}
+
 static bool compileAndLoadModule(CompilerInstance &ImportingInstance,
                                  SourceLocation ImportLoc,
                                  SourceLocation ModuleNameLoc, Module *Module,
@@ -1261,6 +1575,11 @@ static bool compileAndLoadModule(CompilerInstance &ImportingInstance,
   StringRef Dir = llvm::sys::path::parent_path(ModuleFileName);
   llvm::sys::fs::create_directories(Dir);
 
+  // Build the modules this one depends on in parallel first, if allowed.
+  if (ImportingInstance.getHeaderSearchOpts().ModuleBuildThreads &&
+      !ImportingInstance.getModuleDepCollector())
+    prebuildModuleDependencies(ImportingInstance, ImportLoc, Module);
+
   while (1) {
     unsigned ModuleLoadCapabilities = ASTReader::ARR_Missing;
     llvm::LockFileManager Locked(ModuleFileName);
@@ -1274,18 +1593,43 @@ static bool compileAndLoadModule(CompilerInstance &ImportingInstance,
       // Clear out any potential leftover.
       Locked.unsafeRemoveLockFile();
       // FALLTHROUGH
-    case llvm::LockFileManager::LFS_Owned:
-      // We're responsible for building the module ourselves.
+    case llvm::LockFileManager::LFS_Owned: {
+      // We're responsible for building the module ourselves. Let the other
+      // threads of this process know, so that they don't poll the lock file.
+      ModuleBuildScheduler::BuildClaim Claim(ModuleBuildScheduler::get(),
+                                             ModuleFileName);
       if (!compileModuleImpl(ImportingInstance, ModuleNameLoc, Module,
                              ModuleFileName)) {
         diagnoseBuildFailure();
         return false;
       }
+      storeBuiltModuleFile(Diags, ModuleNameLoc,
+                           ImportingInstance.getHeaderSearchOpts(),
+                           Module->Name, ModuleFileName);
       break;
+    }
 
-    case llvm::LockFileManager::LFS_Shared:
+    case llvm::LockFileManager::LFS_Shared: {
       // Someone else is responsible for building the module. Wait for them to
-      // finish.
+      // finish; if it is another thread of this process, it will tell us.
+      ModuleBuildScheduler::WaitResult Wait =
+          ModuleBuildScheduler::get().waitForBuild(ModuleFileName);
+      if (Wait == ModuleBuildScheduler::BuildFinished) {
+        ModuleLoadCapabilities |= ASTReader::ARR_OutOfDate;
+        break;
+      }
+      if (Wait == ModuleBuildScheduler::WouldDeadlock) {
+        // The thread building the module is waiting for this one, so the
+        // modules import each other without saying so in their module maps.
+        // Build it here instead, like a serial build would, so that the
+        // module build stack diagnoses the cycle.
+        if (!compileModuleImpl(ImportingInstance, ModuleNameLoc, Module,
+                               ModuleFileName)) {
+          diagnoseBuildFailure();
+          return false;
+        }
+        break;
+      }
       switch (Locked.waitForUnlock()) {
       case llvm::LockFileManager::Res_Success:
         ModuleLoadCapabilities |= ASTReader::ARR_OutOfDate;
@@ -1433,6 +1777,10 @@ static void pruneModuleCache(const HeaderSearchOptions &HSOpts) {
     if (!llvm::sys::fs::is_directory(Dir->path()))
       continue;
 
+    // The chunks of deduplicated module files are pruned below.
+    if (llvm::sys::path::filename(Dir->path()) == "chunks")
+      continue;
+
     // Walk all of the files within this directory.
     for (llvm::sys::fs::directory_iterator File(Dir->path(), EC), FileEnd;
          File != FileEnd && !EC; File.increment(EC)) {
@@ -1468,6 +1816,9 @@ static void pruneModuleCache(const HeaderSearchOptions &HSOpts) {
             llvm::sys::fs::directory_iterator() && !EC)
       llvm::sys::fs::remove(Dir->path());
   }
+
+  // Remove the chunks no longer used by any of the remaining module files.
+  ModuleChunkStore::pruneUnusedChunks(ModuleCachePathNative, CurrentTime);
 }
 
 void CompilerInstance::createModuleManager() {
@@ -149,6 +149,15 @@ FrontendAction::CreateWrappedASTConsumer(CompilerInstance &CI,
   if (!Consumer)
     return nullptr;
 
+  // Charge the cost of the translation unit to its headers if requested.
+  // Implicitly built modules inherit the option but must not overwrite the
+  // report of the main file.
+  const FrontendOptions &FEOpts = CI.getFrontendOpts();
+  if (!FEOpts.HeaderCostReport.empty() && !FEOpts.BuildingImplicitModule &&
+      CI.hasPreprocessor())
+    Consumer = AttachHeaderCostReport(CI, FEOpts.HeaderCostReport,
+                                      std::move(Consumer));
+
   // If there are no registered plugins we don't need to wrap the consumer
   if (FrontendPluginRegistry::begin() == FrontendPluginRegistry::end())
     return Consumer;
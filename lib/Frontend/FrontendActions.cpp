@@ -99,7 +99,8 @@ GeneratePCHAction::CreateASTConsumer(CompilerInstance &CI, StringRef InFile) {
                         Buffer, CI.getFrontendOpts().ModuleFileExtensions,
       /*AllowASTWithErrors*/CI.getPreprocessorOpts().AllowPCHWithCompilerErrors,
                         /*IncludeTimestamps*/
-                          +CI.getFrontendOpts().IncludeTimestamps));
+                          +CI.getFrontendOpts().IncludeTimestamps,
+                        CI.getFrontendOpts().SerializationThreads));
   Consumers.push_back(CI.getPCHContainerWriter().CreatePCHContainerGenerator(
       CI, InFile, OutputFile, std::move(OS), Buffer));
 
@@ -163,7 +164,8 @@ GenerateModuleAction::CreateASTConsumer(CompilerInstance &CI,
                         Buffer, CI.getFrontendOpts().ModuleFileExtensions,
                         /*AllowASTWithErrors=*/false,
                         /*IncludeTimestamps=*/
-                          +CI.getFrontendOpts().BuildingImplicitModule));
+                          +CI.getFrontendOpts().BuildingImplicitModule,
+                        CI.getFrontendOpts().SerializationThreads));
   Consumers.push_back(CI.getPCHContainerWriter().CreatePCHContainerGenerator(
       CI, InFile, OutputFile, std::move(OS), Buffer));
   return llvm::make_unique<MultiplexConsumer>(std::move(Consumers));
@@ -0,0 +1,336 @@
+//===--- HeaderCostReport.cpp - Per-header compile cost report ------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file implements a report that charges every file of a translation unit
+// with the compile time, tokens, bytes and declarations it is responsible for.
+// utils/header-cost-report.py merges the reports of a whole build.
+//
+//===----------------------------------------------------------------------===//
+
+#include "clang/Frontend/Utils.h"
+#include "clang/AST/ASTConsumer.h"
+#include "clang/AST/DeclBase.h"
+#include "clang/AST/DeclGroup.h"
+#include "clang/Basic/SourceManager.h"
+#include "clang/Frontend/CompilerInstance.h"
+#include "clang/Frontend/FrontendDiagnostic.h"
+#include "clang/Frontend/MultiplexConsumer.h"
+#include "clang/Lex/PPCallbacks.h"
+#include "clang/Lex/Preprocessor.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/raw_ostream.h"
+#include <algorithm>
+#include <chrono>
+
+using namespace clang;
+
+namespace {
+using Clock = std::chrono::steady_clock;
+
+/// The costs charged to a file.
+struct Costs {
+  /// Wall time while the file was the one being lexed. Lexing and parsing are
+  /// interleaved, so this includes parsing the file's tokens.
+  Clock::duration Time = Clock::duration::zero();
+  /// Time spent parsing and analyzing the file's top-level declarations.
+  Clock::duration DeclTime = Clock::duration::zero();
+  uint64_t Tokens = 0;
+  uint64_t Bytes = 0;
+  uint64_t Decls = 0;
+};
+
+struct FileCosts {
+  std::string Name;
+  unsigned Inclusions = 0;
+  /// Costs of the file itself.
+  Costs Self;
+  /// Costs of the file and everything it includes.
+  Costs Total;
+};
+
+class HeaderCostCollector {
+  SourceManager &SM;
+  DiagnosticsEngine &Diags;
+  std::string OutputFile;
+
+  std::vector<FileCosts> Files;
+  llvm::StringMap<unsigned> FileIndex;
+
+  /// The files being processed, innermost last.
+  struct ActiveFile {
+    unsigned File;
+    /// Whether this is the outermost entry of the file on the stack; a file
+    /// that includes itself is only charged inclusive costs once.
+    bool Outermost;
+  };
+  SmallVector<ActiveFile, 32> Stack;
+
+  Clock::time_point LastFileSwitch;
+  Clock::time_point LastDeclEnd;
+  bool Finished = false;
+
+public:
+  HeaderCostCollector(SourceManager &SM, DiagnosticsEngine &Diags,
+                      StringRef OutputFile)
+      : SM(SM), Diags(Diags), OutputFile(OutputFile) {}
+
+  void enterFile(FileID FID);
+  void exitFile();
+  void endOfMainFile();
+  void tokenLexed();
+  void handleDecls(DeclGroupRef D);
+  void declsHandled() { LastDeclEnd = Clock::now(); }
+  void writeReport();
+
+private:
+  unsigned getFileIndex(FileID FID);
+
+  /// Charge \p Update to the file at \p Depth of the stack and, inclusively,
+  /// to the files including it.
+  template <typename Fn> void charge(unsigned Depth, Fn Update) {
+    Update(Files[Stack[Depth].File].Self);
+    for (unsigned I = 0; I <= Depth; ++I)
+      if (Stack[I].Outermost)
+        Update(Files[Stack[I].File].Total);
+  }
+
+  /// Charge the time since the last file switch to the current file.
+  void chargeTime() {
+    Clock::time_point Now = Clock::now();
+    if (!Stack.empty() && !Finished) {
+      Clock::duration Elapsed = Now - LastFileSwitch;
+      charge(Stack.size() - 1, [&](Costs &C) { C.Time += Elapsed; });
+    }
+    LastFileSwitch = Now;
+  }
+};
+
+class HeaderCostPPCallbacks : public PPCallbacks {
+  std::shared_ptr<HeaderCostCollector> Collector;
+  SourceManager &SM;
+
+public:
+  HeaderCostPPCallbacks(std::shared_ptr<HeaderCostCollector> Collector,
+                        SourceManager &SM)
+      : Collector(std::move(Collector)), SM(SM) {}
+
+  void FileChanged(SourceLocation Loc, FileChangeReason Reason,
+                   SrcMgr::CharacteristicKind FileType,
+                   FileID PrevFID) override {
+    if (Reason == EnterFile)
+      Collector->enterFile(SM.getFileID(SM.getExpansionLoc(Loc)));
+    else if (Reason == ExitFile)
+      Collector->exitFile();
+  }
+
+  void EndOfMainFile() override { Collector->endOfMainFile(); }
+};
+
+/// Runs before the main AST consumer and charges each top-level declaration
+/// to its file.
+class HeaderCostDeclCounter : public ASTConsumer {
+  std::shared_ptr<HeaderCostCollector> Collector;
+
+public:
+  explicit HeaderCostDeclCounter(std::shared_ptr<HeaderCostCollector> C)
+      : Collector(std::move(C)) {}
+
+  bool HandleTopLevelDecl(DeclGroupRef D) override {
+    Collector->handleDecls(D);
+    return true;
+  }
+};
+
+/// Runs after the main AST consumer, so that the time the main consumer
+/// spends on a declaration (e.g. generating code) is not charged to the next
+/// one, and writes the report at the end of the translation unit.
+class HeaderCostReportWriter : public ASTConsumer {
+  std::shared_ptr<HeaderCostCollector> Collector;
+
+public:
+  explicit HeaderCostReportWriter(std::shared_ptr<HeaderCostCollector> C)
+      : Collector(std::move(C)) {}
+
+  bool HandleTopLevelDecl(DeclGroupRef D) override {
+    Collector->declsHandled();
+    return true;
+  }
+
+  void HandleTranslationUnit(ASTContext &Ctx) override {
+    Collector->writeReport();
+  }
+};
+} // end anonymous namespace
+
+unsigned HeaderCostCollector::getFileIndex(FileID FID) {
+  const FileEntry *FE = SM.getFileEntryForID(FID);
+  StringRef Name =
+      FE ? FE->getName() : SM.getBufferName(SM.getLocForStartOfFile(FID));
+  auto Inserted = FileIndex.insert({Name, Files.size()});
+  if (Inserted.second) {
+    Files.emplace_back();
+    Files.back().Name = Name;
+  }
+  return Inserted.first->second;
+}
+
+void HeaderCostCollector::enterFile(FileID FID) {
+  chargeTime();
+  if (Stack.empty())
+    LastDeclEnd = LastFileSwitch;
+
+  const FileEntry *FE = SM.getFileEntryForID(FID);
+  uint64_t Size = FE ? FE->getSize() : SM.getFileIDSize(FID);
+  unsigned Index = getFileIndex(FID);
+  bool Outermost = std::none_of(
+      Stack.begin(), Stack.end(),
+      [&](const ActiveFile &Active) { return Active.File == Index; });
+  Stack.push_back({Index, Outermost});
+  ++Files[Index].Inclusions;
+  charge(Stack.size() - 1, [&](Costs &C) { C.Bytes += Size; });
+}
+
+void HeaderCostCollector::exitFile() {
+  chargeTime();
+  // The main file is never exited.
+  if (Stack.size() > 1)
+    Stack.pop_back();
+}
+
+void HeaderCostCollector::endOfMainFile() {
+  chargeTime();
+  Finished = true;
+}
+
+void HeaderCostCollector::tokenLexed() {
+  if (!Stack.empty() && !Finished)
+    charge(Stack.size() - 1, [](Costs &C) { ++C.Tokens; });
+}
+
+/// Count \p D and the declarations nested in it.
+static uint64_t countDecls(const Decl *D) {
+  uint64_t Count = 1;
+  if (const auto *DC = dyn_cast<DeclContext>(D))
+    for (const Decl *Child : DC->noload_decls())
+      Count += countDecls(Child);
+  return Count;
+}
+
+void HeaderCostCollector::handleDecls(DeclGroupRef D) {
+  if (D.begin() == D.end() || Stack.empty())
+    return;
+
+  // The time since the previous declaration was handled was spent on this
+  // group; charge it to the file of its first declaration.
+  Clock::time_point Now = Clock::now();
+  Clock::duration Elapsed = Now - LastDeclEnd;
+  LastDeclEnd = Now;
+
+  bool First = true;
+  for (const Decl *TopLevel : D) {
+    uint64_t Count = countDecls(TopLevel);
+    auto Update = [&](Costs &C) {
+      C.Decls += Count;
+      if (First)
+        C.DeclTime += Elapsed;
+    };
+
+    // The parser looks ahead, so the file of the declaration may already have
+    // been left; charge the files including it by following the include
+    // locations rather than the stack of active files.
+    FileID FID = SM.getFileID(SM.getExpansionLoc(TopLevel->getLocation()));
+    Update(Files[getFileIndex(FID)].Self);
+    SmallVector<unsigned, 16> Charged;
+    for (; FID.isValid(); FID = SM.getFileID(SM.getIncludeLoc(FID))) {
+      unsigned Index = getFileIndex(FID);
+      if (llvm::is_contained(Charged, Index))
+        continue;
+      Charged.push_back(Index);
+      Update(Files[Index].Total);
+    }
+    First = false;
+  }
+}
+
+static void printJSONString(raw_ostream &OS, StringRef Str) {
+  OS << '"';
+  for (unsigned char C : Str) {
+    if (C == '"' || C == '\\')
+      OS << '\\' << C;
+    else if (C < 0x20)
+      OS << llvm::format("\\u%04x", C);
+    else
+      OS << C;
+  }
+  OS << '"';
+}
+
+static void printCosts(raw_ostream &OS, const Costs &C) {
+  auto Millis = [](Clock::duration D) {
+    return std::chrono::duration<double, std::milli>(D).count();
+  };
+  OS << "{ \"time_ms\": " << llvm::format("%.3f", Millis(C.Time))
+     << ", \"decl_time_ms\": " << llvm::format("%.3f", Millis(C.DeclTime))
+     << ", \"tokens\": " << C.Tokens << ", \"bytes\": " << C.Bytes
+     << ", \"decls\": " << C.Decls << " }";
+}
+
+void HeaderCostCollector::writeReport() {
+  std::vector<const FileCosts *> Sorted;
+  for (const FileCosts &F : Files)
+    Sorted.push_back(&F);
+  std::stable_sort(Sorted.begin(), Sorted.end(),
+                   [](const FileCosts *A, const FileCosts *B) {
+                     return A->Total.Time > B->Total.Time;
+                   });
+
+  std::error_code EC;
+  llvm::raw_fd_ostream OS(OutputFile, EC, llvm::sys::fs::F_Text);
+  if (EC) {
+    Diags.Report(diag::err_fe_unable_to_open_output)
+        << OutputFile << EC.message();
+    return;
+  }
+
+  OS << "{\n  \"main_file\": ";
+  const FileEntry *Main = SM.getFileEntryForID(SM.getMainFileID());
+  printJSONString(OS, Main ? Main->getName() : StringRef("<stdin>"));
+  OS << ",\n  \"files\": [";
+  bool First = true;
+  for (const FileCosts *F : Sorted) {
+    OS << (First ? "\n" : ",\n") << "    { \"file\": ";
+    printJSONString(OS, F->Name);
+    OS << ", \"inclusions\": " << F->Inclusions << ",\n      \"self\": ";
+    printCosts(OS, F->Self);
+    OS << ",\n      \"total\": ";
+    printCosts(OS, F->Total);
+    OS << " }";
+    First = false;
+  }
+  OS << "\n  ]\n}\n";
+}
+
+std::unique_ptr<ASTConsumer>
+clang::AttachHeaderCostReport(CompilerInstance &CI, StringRef OutputFile,
+                              std::unique_ptr<ASTConsumer> Consumer) {
+  Preprocessor &PP = CI.getPreprocessor();
+  auto Collector = std::make_shared<HeaderCostCollector>(
+      PP.getSourceManager(), PP.getDiagnostics(), OutputFile);
+  PP.addPPCallbacks(llvm::make_unique<HeaderCostPPCallbacks>(
+      Collector, PP.getSourceManager()));
+  PP.setTokenWatcher([Collector](const Token &) { Collector->tokenLexed(); });
+
+  std::vector<std::unique_ptr<ASTConsumer>> Consumers;
+  Consumers.push_back(llvm::make_unique<HeaderCostDeclCounter>(Collector));
+  Consumers.push_back(std::move(Consumer));
+  Consumers.push_back(llvm::make_unique<HeaderCostReportWriter>(Collector));
+  return llvm::make_unique<MultiplexConsumer>(std::move(Consumers));
+}
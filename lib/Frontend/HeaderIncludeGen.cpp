@@ -11,7 +11,9 @@
 #include "clang/Frontend/Utils.h"
 #include "clang/Basic/SourceManager.h"
 #include "clang/Frontend/FrontendDiagnostic.h"
+#include "clang/Lex/HeaderSearch.h"
 #include "clang/Lex/Preprocessor.h"
+#include "llvm/ADT/SmallPtrSet.h"
 #include "llvm/ADT/SmallString.h"
 #include "llvm/Support/raw_ostream.h"
 using namespace clang;
@@ -19,6 +21,7 @@ using namespace clang;
 namespace {
 class HeaderIncludesCallback : public PPCallbacks {
   SourceManager &SM;
+  HeaderSearch &HS;
   raw_ostream *OutputFile;
   const DependencyOutputOptions &DepOpts;
   unsigned CurrentIncludeDepth;
@@ -27,13 +30,15 @@ class HeaderIncludesCallback : public PPCallbacks {
   bool ShowAllHeaders;
   bool ShowDepth;
   bool MSStyle;
+  llvm::SmallPtrSet<const FileEntry *, 8> CacheSkippedFiles;
 
 public:
   HeaderIncludesCallback(const Preprocessor *PP, bool ShowAllHeaders_,
                          raw_ostream *OutputFile_,
                          const DependencyOutputOptions &DepOpts,
                          bool OwnsOutputFile_, bool ShowDepth_, bool MSStyle_)
-      : SM(PP->getSourceManager()), OutputFile(OutputFile_), DepOpts(DepOpts),
+      : SM(PP->getSourceManager()), HS(PP->getHeaderSearchInfo()),
+        OutputFile(OutputFile_), DepOpts(DepOpts),
         CurrentIncludeDepth(0), HasProcessedPredefines(false),
         OwnsOutputFile(OwnsOutputFile_), ShowAllHeaders(ShowAllHeaders_),
         ShowDepth(ShowDepth_), MSStyle(MSStyle_) {}
@@ -46,6 +51,8 @@ public:
   void FileChanged(SourceLocation Loc, FileChangeReason Reason,
                    SrcMgr::CharacteristicKind FileType,
                    FileID PrevFID) override;
+  void FileSkipped(const FileEntry &SkippedFile, const Token &FilenameTok,
+                   SrcMgr::CharacteristicKind FileType) override;
 };
 }
 
@@ -164,3 +171,25 @@ void HeaderIncludesCallback::FileChanged(SourceLocation Loc,
                     MSStyle);
   }
 }
+
+void HeaderIncludesCallback::FileSkipped(const FileEntry &SkippedFile,
+                                         const Token &FilenameTok,
+                                         SrcMgr::CharacteristicKind FileType) {
+  // A header skipped because its include guard was known from another
+  // translation unit was never entered in this one. Show it once, as if it
+  // had been entered and found to be empty.
+  if (!HS.getFileInfo(&SkippedFile).ControllingMacroFromCache ||
+      !CacheSkippedFiles.insert(&SkippedFile).second)
+    return;
+
+  unsigned IncludeDepth = CurrentIncludeDepth + 1;
+  if (!HasProcessedPredefines && !(ShowAllHeaders && IncludeDepth > 2))
+    return;
+  if (!HasProcessedPredefines)
+    --IncludeDepth; // Ignore indent from <built-in>.
+  else if (!DepOpts.ShowIncludesPretendHeader.empty())
+    ++IncludeDepth; // Pretend inclusion by ShowIncludesPretendHeader.
+
+  PrintHeaderInfo(OutputFile, SkippedFile.getName(), ShowDepth, IncludeDepth,
+                  MSStyle);
+}
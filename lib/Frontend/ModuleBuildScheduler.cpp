@@ -0,0 +1,153 @@
+//===--- ModuleBuildScheduler.cpp - Parallel implicit module builds -------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "clang/Frontend/ModuleBuildScheduler.h"
+#include "llvm/ADT/SmallSet.h"
+#include "llvm/Support/Compiler.h"
+#include "llvm/Support/ManagedStatic.h"
+#include "llvm/Support/ThreadPool.h"
+#include <atomic>
+
+using namespace clang;
+
+static llvm::ManagedStatic<ModuleBuildScheduler> ProcessScheduler;
+
+/// The identifier of the current thread, assigned on first use.
+static LLVM_THREAD_LOCAL uint64_t CurrentThread;
+static std::atomic<uint64_t> NextThread(0);
+
+ModuleBuildScheduler &ModuleBuildScheduler::get() { return *ProcessScheduler; }
+
+uint64_t ModuleBuildScheduler::getCurrentThread() {
+  if (!CurrentThread)
+    CurrentThread = ++NextThread;
+  return CurrentThread;
+}
+
+ModuleBuildScheduler::ThreadContinuation::ThreadContinuation(uint64_t Thread)
+    : SavedThread(CurrentThread) {
+  CurrentThread = Thread;
+}
+
+ModuleBuildScheduler::ThreadContinuation::~ThreadContinuation() {
+  CurrentThread = SavedThread;
+}
+
+bool ModuleBuildScheduler::beginBuild(StringRef ModuleFileName) {
+  std::lock_guard<std::mutex> Lock(Mutex);
+  return BuildsInProgress
+      .insert(std::make_pair(ModuleFileName, getCurrentThread()))
+      .second;
+}
+
+void ModuleBuildScheduler::endBuild(StringRef ModuleFileName) {
+  {
+    std::lock_guard<std::mutex> Lock(Mutex);
+    BuildsInProgress.erase(ModuleFileName);
+  }
+  BuildDone.notify_all();
+}
+
+bool ModuleBuildScheduler::isWaitingFor(uint64_t Waiter,
+                                        uint64_t Target) const {
+  SmallVector<uint64_t, 8> Worklist(1, Waiter);
+  llvm::SmallSet<uint64_t, 8> Visited;
+  while (!Worklist.empty()) {
+    uint64_t Thread = Worklist.pop_back_val();
+    if (Thread == Target)
+      return true;
+    if (!Visited.insert(Thread).second)
+      continue;
+
+    // A thread waiting for a module file waits for the thread building it.
+    auto Waiting = WaitingThreads.find(Thread);
+    if (Waiting != WaitingThreads.end()) {
+      auto Build = BuildsInProgress.find(Waiting->second);
+      if (Build != BuildsInProgress.end())
+        Worklist.push_back(Build->second);
+    }
+
+    // A thread running jobs waits for the threads running them.
+    for (const auto &Job : JobCallers)
+      if (Job.second == Thread)
+        Worklist.push_back(Job.first);
+  }
+  return false;
+}
+
+ModuleBuildScheduler::WaitResult
+ModuleBuildScheduler::waitForBuild(StringRef ModuleFileName) {
+  std::unique_lock<std::mutex> Lock(Mutex);
+  auto Build = BuildsInProgress.find(ModuleFileName);
+  if (Build == BuildsInProgress.end())
+    return NotBuilding;
+
+  // Whichever thread closes a cycle of waits sees it, since the waits are
+  // registered under the lock.
+  uint64_t Self = getCurrentThread();
+  if (isWaitingFor(Build->second, Self))
+    return WouldDeadlock;
+
+  WaitingThreads[Self] = ModuleFileName.str();
+  BuildDone.wait(Lock, [&] { return !BuildsInProgress.count(ModuleFileName); });
+  WaitingThreads.erase(Self);
+  return BuildFinished;
+}
+
+std::vector<bool> ModuleBuildScheduler::runJobs(ArrayRef<Job> Jobs,
+                                                unsigned NumThreads) {
+  std::vector<unsigned> PendingDeps(Jobs.size());
+  std::vector<SmallVector<unsigned, 4>> Dependents(Jobs.size());
+  SmallVector<unsigned, 16> Ready;
+  for (unsigned I = 0, E = Jobs.size(); I != E; ++I) {
+    PendingDeps[I] = Jobs[I].Deps.size();
+    for (unsigned Dep : Jobs[I].Deps)
+      Dependents[Dep].push_back(I);
+    if (Jobs[I].Deps.empty())
+      Ready.push_back(I);
+  }
+
+  // Written by the job itself, so it can't be a bit vector.
+  std::vector<char> Succeeded(Jobs.size());
+  std::mutex StateMutex;
+  uint64_t Caller = getCurrentThread();
+  llvm::ThreadPool Pool(NumThreads);
+
+  std::function<void(unsigned)> Start = [&](unsigned I) {
+    Pool.async([&, I] {
+      uint64_t Self = getCurrentThread();
+      {
+        std::lock_guard<std::mutex> Lock(Mutex);
+        JobCallers[Self] = Caller;
+      }
+      bool Success = Jobs[I].Build();
+      {
+        std::lock_guard<std::mutex> Lock(Mutex);
+        JobCallers.erase(Self);
+      }
+      if (!Success)
+        return;
+      Succeeded[I] = true;
+
+      std::lock_guard<std::mutex> Lock(StateMutex);
+      for (unsigned Dependent : Dependents[I])
+        if (--PendingDeps[Dependent] == 0)
+          Start(Dependent);
+    });
+  };
+
+  {
+    std::lock_guard<std::mutex> Lock(StateMutex);
+    for (unsigned I : Ready)
+      Start(I);
+  }
+  Pool.wait();
+
+  return std::vector<bool>(Succeeded.begin(), Succeeded.end());
+}
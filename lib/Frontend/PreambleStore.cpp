@@ -0,0 +1,201 @@
+//===--- PreambleStore.cpp - Preambles shared between ASTUnits ------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "clang/Frontend/PreambleStore.h"
+#include "clang/Frontend/CompilerInvocation.h"
+#include "clang/Frontend/PrecompiledPreamble.h"
+#include "clang/Lex/HeaderSearchOptions.h"
+#include "clang/Lex/PreprocessorOptions.h"
+#include "llvm/Support/MD5.h"
+#include "llvm/Support/ManagedStatic.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Path.h"
+
+using namespace clang;
+
+static llvm::ManagedStatic<PreambleStore> SharedStore;
+
+PreambleStore::ClientData::~ClientData() {}
+
+PreambleStore &PreambleStore::getShared() { return *SharedStore; }
+
+void PreambleStore::setLimits(std::size_t MemoryBudget,
+                              unsigned MaxPreambles) {
+  std::lock_guard<std::mutex> Lock(Mutex);
+  this->MemoryBudget = MemoryBudget;
+  this->MaxPreambles = MaxPreambles;
+  enforceLimits();
+}
+
+bool PreambleStore::isEnabled() const {
+  std::lock_guard<std::mutex> Lock(Mutex);
+  return MaxPreambles != 0;
+}
+
+bool PreambleStore::shouldBuildInMemory(std::size_t ExpectedSize) const {
+  std::lock_guard<std::mutex> Lock(Mutex);
+  std::size_t MemoryUsage = getMemoryUsage();
+  return MemoryUsage < MemoryBudget &&
+         ExpectedSize <= MemoryBudget - MemoryUsage;
+}
+
+std::string PreambleStore::getKey(const CompilerInvocation &Invocation,
+                                  const llvm::MemoryBuffer *MainFileBuffer,
+                                  PreambleBounds Bounds) {
+  llvm::MD5 Hash;
+  auto AddString = [&](StringRef S) {
+    // Include the terminator so that consecutive strings can't run together.
+    Hash.update(S);
+    Hash.update(StringRef("", 1));
+  };
+
+  // The module hash covers the language, target and macro options.
+  AddString(Invocation.getModuleHash());
+
+  // Header search paths and implicit includes aren't part of the module hash,
+  // and CanReuse() only notices when a file used by the preamble changes, not
+  // when a different file would be found.
+  for (const auto &Entry : Invocation.getHeaderSearchOpts().UserEntries) {
+    AddString(Entry.Path);
+    Hash.update(static_cast<uint8_t>(Entry.Group));
+    Hash.update(static_cast<uint8_t>(Entry.IsFramework));
+  }
+  for (const auto &Prefix :
+       Invocation.getHeaderSearchOpts().SystemHeaderPrefixes) {
+    AddString(Prefix.Prefix);
+    Hash.update(static_cast<uint8_t>(Prefix.IsSystemHeader));
+  }
+  const PreprocessorOptions &PPOpts = Invocation.getPreprocessorOpts();
+  for (const std::string &Include : PPOpts.Includes)
+    AddString(Include);
+  for (const std::string &Include : PPOpts.MacroIncludes)
+    AddString(Include);
+  AddString(PPOpts.ImplicitPCHInclude);
+
+  // The text of the preamble. Files with the same preamble share it, as long
+  // as quoted includes are looked up in the same directory: the PCH holds the
+  // text of the preamble, and only offsets into it tie the preamble to its
+  // main file.
+  AddString(llvm::sys::path::parent_path(
+      Invocation.getFrontendOpts().Inputs[0].getFile()));
+  AddString(MainFileBuffer->getBuffer().substr(0, Bounds.Size));
+
+  llvm::MD5::MD5Result Result;
+  Hash.final(Result);
+  return Result.digest().str();
+}
+
+Optional<PreambleStore::Entry> PreambleStore::lookup(StringRef Key) {
+  std::lock_guard<std::mutex> Lock(Mutex);
+  // Enforce the limits first, to account for the preambles released since the
+  // last time.
+  enforceLimits();
+
+  auto Known = PreamblesByKey.find(Key);
+  if (Known == PreamblesByKey.end()) {
+    ++Stats.NumMisses;
+    return None;
+  }
+
+  ++Stats.NumHits;
+  Preambles.splice(Preambles.begin(), Preambles, Known->second);
+  return Known->second->E;
+}
+
+void PreambleStore::insert(StringRef Key, Entry E) {
+  assert(E.Preamble && "registering a null preamble");
+  std::lock_guard<std::mutex> Lock(Mutex);
+  if (!MaxPreambles)
+    return;
+
+  auto Known = PreamblesByKey.find(Key);
+  if (Known != PreamblesByKey.end()) {
+    Preambles.erase(Known->second);
+    PreamblesByKey.erase(Known);
+  }
+
+  Preambles.push_front(StoredPreamble{Key, std::move(E)});
+  PreamblesByKey[Key] = Preambles.begin();
+  enforceLimits();
+}
+
+void PreambleStore::remove(StringRef Key,
+                           const PrecompiledPreamble *Preamble) {
+  std::lock_guard<std::mutex> Lock(Mutex);
+  auto Known = PreamblesByKey.find(Key);
+  if (Known == PreamblesByKey.end() ||
+      Known->second->E.Preamble.get() != Preamble)
+    return;
+
+  Preambles.erase(Known->second);
+  PreamblesByKey.erase(Known);
+}
+
+void PreambleStore::clear() {
+  std::lock_guard<std::mutex> Lock(Mutex);
+  Preambles.clear();
+  PreamblesByKey.clear();
+  Stats = Statistics();
+}
+
+PreambleStore::Statistics PreambleStore::getStatistics() {
+  std::lock_guard<std::mutex> Lock(Mutex);
+  Statistics Result = Stats;
+  Result.NumPreambles = Preambles.size();
+  Result.MemoryUsage = getMemoryUsage();
+  return Result;
+}
+
+std::size_t PreambleStore::getMemoryUsage() const {
+  std::size_t MemoryUsage = 0;
+  for (const StoredPreamble &SP : Preambles)
+    if (SP.E.Preamble->isInMemory())
+      MemoryUsage += SP.E.Preamble->getSize();
+  return MemoryUsage;
+}
+
+void PreambleStore::enforceLimits() {
+  std::size_t MemoryUsage = getMemoryUsage();
+
+  // Preambles in use are moved to disk too: the translation units using them
+  // keep the memory until they parse again, and then use the file.
+  for (auto I = Preambles.rbegin(), E = Preambles.rend();
+       I != E && MemoryUsage > MemoryBudget; ++I) {
+    PrecompiledPreamble &Preamble = *I->E.Preamble;
+    if (!Preamble.isInMemory())
+      continue;
+
+    std::size_t Size = Preamble.getSize();
+    // If the preamble can't be written out, it can still be dropped below.
+    if (Preamble.moveToDisk())
+      continue;
+    MemoryUsage -= Size;
+    ++Stats.NumSpills;
+  }
+
+  // A preamble is in use if anyone but the store holds it. Dropping one that
+  // is in use frees no memory, but makes room for another preamble. Clients
+  // only get hold of a preamble through the store while the mutex is held, so
+  // a preamble found unused here stays so until we're done with it.
+  for (auto I = Preambles.end(); I != Preambles.begin() &&
+                                 (Preambles.size() > MaxPreambles ||
+                                  MemoryUsage > MemoryBudget);) {
+    --I;
+    bool FreesMemory =
+        I->E.Preamble->isInMemory() && I->E.Preamble.use_count() == 1;
+    if (Preambles.size() <= MaxPreambles && !FreesMemory)
+      continue;
+
+    if (FreesMemory)
+      MemoryUsage -= I->E.Preamble->getSize();
+    PreamblesByKey.erase(I->Key);
+    I = Preambles.erase(I);
+    ++Stats.NumEvictions;
+  }
+}
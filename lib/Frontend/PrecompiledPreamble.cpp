@@ -30,6 +30,8 @@
 #include "llvm/Support/Mutex.h"
 #include "llvm/Support/MutexGuard.h"
 #include "llvm/Support/Process.h"
+#include "llvm/Support/raw_ostream.h"
+#include <algorithm>
 #include <limits>
 #include <utility>
 
@@ -63,6 +65,21 @@ createVFSOverlayForPreamblePCH(StringRef PCHFilename,
   return Overlay;
 }
 
+/// A buffer over an in-memory PCH, which keeps the PCH alive after the
+/// preamble moves it to disk.
+class InMemoryPCHBuffer : public llvm::MemoryBuffer {
+  std::shared_ptr<const std::string> Data;
+
+public:
+  explicit InMemoryPCHBuffer(std::shared_ptr<const std::string> Data)
+      : Data(std::move(Data)) {
+    init(this->Data->data(), this->Data->data() + this->Data->size(),
+         /*RequiresNullTerminator=*/true);
+  }
+
+  BufferKind getBufferKind() const override { return MemoryBuffer_Malloc; }
+};
+
 /// Keeps a track of files to be deleted in destructor.
 class TemporaryFiles {
 public:
@@ -115,6 +132,82 @@ void TemporaryFiles::removeFile(StringRef File) {
   llvm::sys::fs::remove(File);
 }
 
+/// Records where the \#include directives of the main file end, and which of
+/// them first pulled in each file, so that a prefix of the preamble can be
+/// reused when a header changes.
+///
+/// Only the directives outside of conditionals count: a prefix ending inside
+/// one, e.g. inside the include guard of the main file, would be a preamble
+/// with an unterminated conditional.
+class IncludeBoundaryTracker : public PPCallbacks {
+public:
+  IncludeBoundaryTracker(const SourceManager &SM, StringRef MainFileContents,
+                         std::vector<unsigned> &IncludeEnds,
+                         llvm::StringMap<unsigned> &FileIncludeCounts)
+      : SM(SM), MainFileContents(MainFileContents), IncludeEnds(IncludeEnds),
+        FileIncludeCounts(FileIncludeCounts) {}
+
+  void InclusionDirective(SourceLocation HashLoc, const Token &IncludeTok,
+                          StringRef FileName, bool IsAngled,
+                          CharSourceRange FilenameRange, const FileEntry *File,
+                          StringRef SearchPath, StringRef RelativePath,
+                          const Module *Imported) override {
+    if (!SM.isWrittenInMainFile(HashLoc) || ConditionalDepth)
+      return;
+    SourceLocation End = SM.getExpansionLoc(FilenameRange.getEnd());
+    if (!SM.isWrittenInMainFile(End))
+      End = HashLoc;
+    size_t EndOfLine = MainFileContents.find('\n', SM.getFileOffset(End));
+    if (EndOfLine == StringRef::npos)
+      return;
+    IncludeEnds.push_back(EndOfLine + 1);
+  }
+
+  void FileChanged(SourceLocation Loc, FileChangeReason Reason,
+                   SrcMgr::CharacteristicKind FileType,
+                   FileID PrevFID) override {
+    if (Reason != EnterFile)
+      return;
+    if (const FileEntry *File =
+            SM.getFileEntryForID(SM.getFileID(SM.getExpansionLoc(Loc))))
+      FileIncludeCounts.insert(
+          std::make_pair(File->getName(), unsigned(IncludeEnds.size())));
+  }
+
+  void If(SourceLocation Loc, SourceRange ConditionRange,
+          ConditionValueKind ConditionValue) override {
+    enterConditional(Loc);
+  }
+
+  void Ifdef(SourceLocation Loc, const Token &MacroNameTok,
+             const MacroDefinition &MD) override {
+    enterConditional(Loc);
+  }
+
+  void Ifndef(SourceLocation Loc, const Token &MacroNameTok,
+              const MacroDefinition &MD) override {
+    enterConditional(Loc);
+  }
+
+  void Endif(SourceLocation Loc, SourceLocation IfLoc) override {
+    if (SM.isWrittenInMainFile(Loc) && ConditionalDepth)
+      --ConditionalDepth;
+  }
+
+private:
+  void enterConditional(SourceLocation Loc) {
+    if (SM.isWrittenInMainFile(Loc))
+      ++ConditionalDepth;
+  }
+
+  const SourceManager &SM;
+  StringRef MainFileContents;
+  std::vector<unsigned> &IncludeEnds;
+  llvm::StringMap<unsigned> &FileIncludeCounts;
+  /// The number of conditionals of the main file we are in.
+  unsigned ConditionalDepth = 0;
+};
+
 class PrecompilePreambleAction : public ASTFrontendAction {
 public:
   PrecompilePreambleAction(std::string *InMemStorage,
@@ -224,8 +317,13 @@ llvm::ErrorOr<PrecompiledPreamble> PrecompiledPreamble::Build(
     const llvm::MemoryBuffer *MainFileBuffer, PreambleBounds Bounds,
     DiagnosticsEngine &Diagnostics, IntrusiveRefCntPtr<vfs::FileSystem> VFS,
     std::shared_ptr<PCHContainerOperations> PCHContainerOps, bool StoreInMemory,
-    PreambleCallbacks &Callbacks) {
+    PreambleCallbacks &Callbacks,
+    std::shared_ptr<const PrecompiledPreamble> Base) {
   assert(VFS && "VFS is null");
+  assert((!Base || (Base->Storage.getKind() == PCHStorage::Kind::TempFile &&
+                    Base->PreambleBytes.size() < Bounds.Size &&
+                    !Base->EndsInConditional)) &&
+         "base preamble has to be a prefix stored in a file");
 
   if (!Bounds.Size)
     return BuildPreambleError::PreambleIsEmpty;
@@ -239,8 +337,11 @@ llvm::ErrorOr<PrecompiledPreamble> PrecompiledPreamble::Build(
   if (!StoreInMemory) {
     // Create a temporary file for the precompiled preamble. In rare
     // circumstances, this can fail.
+    // The path CreateNewPreamblePCHFile() may return is already taken by the
+    // base preamble, if any.
     llvm::ErrorOr<PrecompiledPreamble::TempPCHFile> PreamblePCHFile =
-        PrecompiledPreamble::TempPCHFile::CreateNewPreamblePCHFile();
+        Base ? TempPCHFile::createInSystemTempDir("preamble", "pch")
+             : TempPCHFile::CreateNewPreamblePCHFile();
     if (!PreamblePCHFile)
       return BuildPreambleError::CouldntCreateTempFile;
     TempFile = std::move(*PreamblePCHFile);
@@ -260,8 +361,18 @@ llvm::ErrorOr<PrecompiledPreamble> PrecompiledPreamble::Build(
   FrontendOpts.ProgramAction = frontend::GeneratePCH;
   FrontendOpts.OutputFile = StoreInMemory ? getInMemoryPreamblePath()
                                           : Storage.asFile().getFilePath();
-  PreprocessorOpts.PrecompiledPreambleBytes.first = 0;
-  PreprocessorOpts.PrecompiledPreambleBytes.second = false;
+  if (Base) {
+    // Skip the part of the main file covered by the base preamble, as when
+    // parsing the main file with a preamble.
+    PreprocessorOpts.PrecompiledPreambleBytes.first =
+        Base->PreambleBytes.size();
+    PreprocessorOpts.PrecompiledPreambleBytes.second =
+        Base->PreambleEndsAtStartOfLine;
+    PreprocessorOpts.DisablePCHValidation = true;
+  } else {
+    PreprocessorOpts.PrecompiledPreambleBytes.first = 0;
+    PreprocessorOpts.PrecompiledPreambleBytes.second = false;
+  }
   // Inform preprocessor to record conditional stack when building the preamble.
   PreprocessorOpts.GeneratePreamble = true;
 
@@ -306,6 +417,11 @@ llvm::ErrorOr<PrecompiledPreamble> PrecompiledPreamble::Build(
   if (!VFS)
     return BuildPreambleError::CouldntCreateVFSOverlay;
 
+  // Load the PCH of the base preamble. Writing a PCH while one is loaded
+  // chains the new PCH to it.
+  if (Base)
+    setupPreambleStorage(Base->Storage, PreprocessorOpts, VFS);
+
   // Create a file manager object to provide access to and cache the filesystem.
   Clang->setFileManager(new FileManager(Clang->getFileSystemOpts(), VFS));
 
@@ -332,7 +448,7 @@ llvm::ErrorOr<PrecompiledPreamble> PrecompiledPreamble::Build(
 
   std::unique_ptr<PrecompilePreambleAction> Act;
   Act.reset(new PrecompilePreambleAction(
-      StoreInMemory ? &Storage.asMemory().Data : nullptr, Callbacks));
+      StoreInMemory ? Storage.asMemory().Data.get() : nullptr, Callbacks));
   Callbacks.BeforeExecute(*Clang);
   if (!Act->BeginSourceFile(*Clang.get(), Clang->getFrontendOpts().Inputs[0]))
     return BuildPreambleError::BeginSourceFileFailed;
@@ -342,8 +458,25 @@ llvm::ErrorOr<PrecompiledPreamble> PrecompiledPreamble::Build(
   if (DelegatedPPCallbacks)
     Clang->getPreprocessor().addPPCallbacks(std::move(DelegatedPPCallbacks));
 
+  // The include directives of the base preamble aren't seen again.
+  std::vector<unsigned> IncludeEnds;
+  llvm::StringMap<unsigned> FileIncludeCounts;
+  if (Base) {
+    IncludeEnds = Base->IncludeEnds;
+    FileIncludeCounts = Base->FileIncludeCounts;
+  }
+  Clang->getPreprocessor().addPPCallbacks(
+      llvm::make_unique<IncludeBoundaryTracker>(
+          Clang->getSourceManager(),
+          MainFileBuffer->getBuffer().slice(0, Bounds.Size), IncludeEnds,
+          FileIncludeCounts));
+
   Act->Execute();
 
+  // The PCH of a preamble that ends inside a conditional records the
+  // conditional stack, which a preamble chained to it would replay.
+  bool EndsInConditional = Clang->getPreprocessor().hasRecordedPreamble();
+
   // Run the callbacks.
   Callbacks.AfterExecute(*Clang);
 
@@ -358,6 +491,9 @@ llvm::ErrorOr<PrecompiledPreamble> PrecompiledPreamble::Build(
 
   SourceManager &SourceMgr = Clang->getSourceManager();
   for (auto &Filename : PreambleDepCollector->getDependencies()) {
+    // The PCH of the base preamble is reported as a dependency too.
+    if (Base && Filename == Base->Storage.asFile().getFilePath())
+      continue;
     const FileEntry *File = Clang->getFileManager().getFile(Filename);
     if (!File || File == SourceMgr.getFileEntryForID(SourceMgr.getMainFileID()))
       continue;
@@ -372,9 +508,17 @@ llvm::ErrorOr<PrecompiledPreamble> PrecompiledPreamble::Build(
     }
   }
 
+  // Whether the files of the base preamble were reported as dependencies
+  // depends on the AST reader; make sure they are checked.
+  if (Base)
+    for (const auto &F : Base->FilesInPreamble)
+      FilesInPreamble.insert(std::make_pair(F.first(), F.second));
+
   return PrecompiledPreamble(std::move(Storage), std::move(PreambleBytes),
                              PreambleEndsAtStartOfLine,
-                             std::move(FilesInPreamble));
+                             std::move(FilesInPreamble), std::move(IncludeEnds),
+                             std::move(FileIncludeCounts), EndsInConditional,
+                             std::move(Base));
 }
 
 PreambleBounds PrecompiledPreamble::getBounds() const {
@@ -382,13 +526,14 @@ PreambleBounds PrecompiledPreamble::getBounds() const {
 }
 
 std::size_t PrecompiledPreamble::getSize() const {
+  std::lock_guard<std::mutex> Lock(*StorageMutex);
   switch (Storage.getKind()) {
   case PCHStorage::Kind::Empty:
     assert(false && "Calling getSize() on invalid PrecompiledPreamble. "
                     "Was it std::moved?");
     return 0;
   case PCHStorage::Kind::InMemory:
-    return Storage.asMemory().Data.size();
+    return Storage.asMemory().Data->size();
   case PCHStorage::Kind::TempFile: {
     uint64_t Result;
     if (llvm::sys::fs::file_size(Storage.asFile().getFilePath(), Result))
@@ -402,6 +547,38 @@ std::size_t PrecompiledPreamble::getSize() const {
   llvm_unreachable("Unhandled storage kind");
 }
 
+bool PrecompiledPreamble::isInMemory() const {
+  std::lock_guard<std::mutex> Lock(*StorageMutex);
+  return Storage.getKind() == PCHStorage::Kind::InMemory;
+}
+
+std::error_code PrecompiledPreamble::moveToDisk() {
+  std::lock_guard<std::mutex> Lock(*StorageMutex);
+  if (Storage.getKind() != PCHStorage::Kind::InMemory)
+    return std::error_code();
+
+  // Not CreateNewPreamblePCHFile(): the path it may return is reserved for
+  // the preambles that are built on disk.
+  llvm::ErrorOr<TempPCHFile> File =
+      TempPCHFile::createInSystemTempDir("preamble", "pch");
+  if (!File)
+    return File.getError();
+
+  std::error_code EC;
+  llvm::raw_fd_ostream OS(File->getFilePath(), EC, llvm::sys::fs::F_None);
+  if (EC)
+    return EC;
+  OS << *Storage.asMemory().Data;
+  OS.close();
+  if (OS.has_error()) {
+    OS.clear_error();
+    return std::make_error_code(std::errc::io_error);
+  }
+
+  Storage = PCHStorage(std::move(*File));
+  return std::error_code();
+}
+
 bool PrecompiledPreamble::CanReuse(const CompilerInvocation &Invocation,
                                    const llvm::MemoryBuffer *MainFileBuffer,
                                    PreambleBounds Bounds,
@@ -411,10 +588,6 @@ bool PrecompiledPreamble::CanReuse(const CompilerInvocation &Invocation,
       Bounds.Size <= MainFileBuffer->getBufferSize() &&
       "Buffer is too large. Bounds were calculated from a different buffer?");
 
-  auto PreambleInvocation = std::make_shared<CompilerInvocation>(Invocation);
-  PreprocessorOptions &PreprocessorOpts =
-      PreambleInvocation->getPreprocessorOpts();
-
   if (!Bounds.Size)
     return false;
 
@@ -434,6 +607,55 @@ bool PrecompiledPreamble::CanReuse(const CompilerInvocation &Invocation,
   // First, make a record of those files that have been overridden via
   // remapping or unsaved_files.
   std::map<llvm::sys::fs::UniqueID, PreambleFileHash> OverriddenFiles;
+  if (!getOverriddenFiles(Invocation, VFS, OverriddenFiles))
+    return false;
+
+  // Check whether anything has changed.
+  for (const auto &F : FilesInPreamble)
+    if (!isFileUpToDate(F.first(), F.second, VFS, OverriddenFiles))
+      return false;
+  return true;
+}
+
+PreambleBounds PrecompiledPreamble::getReusablePrefix(
+    const CompilerInvocation &Invocation,
+    const llvm::MemoryBuffer *MainFileBuffer, vfs::FileSystem *VFS) const {
+  // Only the include directives before the first change to the text of the
+  // preamble can be kept.
+  StringRef OldText(PreambleBytes.data(), PreambleBytes.size());
+  StringRef NewText = MainFileBuffer->getBuffer();
+  size_t CommonSize = 0;
+  while (CommonSize < OldText.size() && CommonSize < NewText.size() &&
+         OldText[CommonSize] == NewText[CommonSize])
+    ++CommonSize;
+  unsigned NumIncludes =
+      std::upper_bound(IncludeEnds.begin(), IncludeEnds.end(), CommonSize) -
+      IncludeEnds.begin();
+
+  // Nor those that pulled in a file that changed since.
+  std::map<llvm::sys::fs::UniqueID, PreambleFileHash> OverriddenFiles;
+  if (!getOverriddenFiles(Invocation, VFS, OverriddenFiles))
+    return PreambleBounds(0, false);
+  for (const auto &F : FilesInPreamble) {
+    if (isFileUpToDate(F.first(), F.second, VFS, OverriddenFiles))
+      continue;
+    auto Count = FileIncludeCounts.find(F.first());
+    if (Count == FileIncludeCounts.end() || Count->second == 0)
+      return PreambleBounds(0, false);
+    NumIncludes = std::min(NumIncludes, Count->second - 1);
+  }
+
+  if (!NumIncludes)
+    return PreambleBounds(0, false);
+  return PreambleBounds(IncludeEnds[NumIncludes - 1],
+                        /*PreambleEndsAtStartOfLine=*/true);
+}
+
+bool PrecompiledPreamble::getOverriddenFiles(
+    const CompilerInvocation &Invocation, vfs::FileSystem *VFS,
+    std::map<llvm::sys::fs::UniqueID, PreambleFileHash> &Out) {
+  const PreprocessorOptions &PreprocessorOpts =
+      Invocation.getPreprocessorOpts();
   for (const auto &R : PreprocessorOpts.RemappedFiles) {
     vfs::Status Status;
     if (!moveOnNoError(VFS->status(R.second), Status)) {
@@ -442,7 +664,7 @@ bool PrecompiledPreamble::CanReuse(const CompilerInvocation &Invocation,
       return false;
     }
 
-    OverriddenFiles[Status.getUniqueID()] = PreambleFileHash::createForFile(
+    Out[Status.getUniqueID()] = PreambleFileHash::createForFile(
         Status.getSize(), llvm::sys::toTimeT(Status.getLastModificationTime()));
   }
 
@@ -451,35 +673,31 @@ bool PrecompiledPreamble::CanReuse(const CompilerInvocation &Invocation,
     if (!moveOnNoError(VFS->status(RB.first), Status))
       return false;
 
-    OverriddenFiles[Status.getUniqueID()] =
+    Out[Status.getUniqueID()] =
         PreambleFileHash::createForMemoryBuffer(RB.second);
   }
+  return true;
+}
 
-  // Check whether anything has changed.
-  for (const auto &F : FilesInPreamble) {
-    vfs::Status Status;
-    if (!moveOnNoError(VFS->status(F.first()), Status)) {
-      // If we can't stat the file, assume that something horrible happened.
-      return false;
-    }
-
-    std::map<llvm::sys::fs::UniqueID, PreambleFileHash>::iterator Overridden =
-        OverriddenFiles.find(Status.getUniqueID());
-    if (Overridden != OverriddenFiles.end()) {
-      // This file was remapped; check whether the newly-mapped file
-      // matches up with the previous mapping.
-      if (Overridden->second != F.second)
-        return false;
-      continue;
-    }
+bool PrecompiledPreamble::isFileUpToDate(
+    StringRef Filename, const PreambleFileHash &Hash, vfs::FileSystem *VFS,
+    const std::map<llvm::sys::fs::UniqueID, PreambleFileHash> &Overridden) {
+  vfs::Status Status;
+  if (!moveOnNoError(VFS->status(Filename), Status)) {
+    // If we can't stat the file, assume that something horrible happened.
+    return false;
+  }
 
-    // The file was not remapped; check whether it has changed on disk.
-    if (Status.getSize() != uint64_t(F.second.Size) ||
-        llvm::sys::toTimeT(Status.getLastModificationTime()) !=
-            F.second.ModTime)
-      return false;
+  auto OverriddenHash = Overridden.find(Status.getUniqueID());
+  if (OverriddenHash != Overridden.end()) {
+    // This file was remapped; check whether the newly-mapped file
+    // matches up with the previous mapping.
+    return OverriddenHash->second == Hash;
   }
-  return true;
+
+  // The file was not remapped; check whether it has changed on disk.
+  return Status.getSize() == uint64_t(Hash.Size) &&
+         llvm::sys::toTimeT(Status.getLastModificationTime()) == Hash.ModTime;
 }
 
 void PrecompiledPreamble::AddImplicitPreamble(
@@ -498,16 +716,30 @@ void PrecompiledPreamble::AddImplicitPreamble(
   PreprocessorOpts.PrecompiledPreambleBytes.second = PreambleEndsAtStartOfLine;
   PreprocessorOpts.DisablePCHValidation = true;
 
+  // The PCH of the base preamble is loaded as an import of ours, it only
+  // needs to be accessible.
+  if (Base) {
+    PreprocessorOptions BaseOpts;
+    setupPreambleStorage(Base->Storage, BaseOpts, VFS);
+  }
+  std::lock_guard<std::mutex> Lock(*StorageMutex);
   setupPreambleStorage(Storage, PreprocessorOpts, VFS);
 }
 
 PrecompiledPreamble::PrecompiledPreamble(
     PCHStorage Storage, std::vector<char> PreambleBytes,
     bool PreambleEndsAtStartOfLine,
-    llvm::StringMap<PreambleFileHash> FilesInPreamble)
-    : Storage(std::move(Storage)), FilesInPreamble(std::move(FilesInPreamble)),
+    llvm::StringMap<PreambleFileHash> FilesInPreamble,
+    std::vector<unsigned> IncludeEnds,
+    llvm::StringMap<unsigned> FileIncludeCounts, bool EndsInConditional,
+    std::shared_ptr<const PrecompiledPreamble> Base)
+    : Storage(std::move(Storage)), StorageMutex(new std::mutex),
+      FilesInPreamble(std::move(FilesInPreamble)),
       PreambleBytes(std::move(PreambleBytes)),
-      PreambleEndsAtStartOfLine(PreambleEndsAtStartOfLine) {
+      PreambleEndsAtStartOfLine(PreambleEndsAtStartOfLine),
+      IncludeEnds(std::move(IncludeEnds)),
+      FileIncludeCounts(std::move(FileIncludeCounts)),
+      EndsInConditional(EndsInConditional), Base(std::move(Base)) {
   assert(this->Storage.getKind() != PCHStorage::Kind::Empty);
 }
 
@@ -711,7 +943,7 @@ void PrecompiledPreamble::setupPreambleStorage(
     StringRef PCHPath = getInMemoryPreamblePath();
     PreprocessorOpts.ImplicitPCHInclude = PCHPath;
 
-    auto Buf = llvm::MemoryBuffer::getMemBuffer(Storage.asMemory().Data);
+    auto Buf = llvm::make_unique<InMemoryPCHBuffer>(Storage.asMemory().Data);
     VFS = createVFSOverlayForPreamblePCH(PCHPath, std::move(Buf), VFS);
   }
 }
@@ -0,0 +1,356 @@
+//===--- TemplateInstantiationProfiler.cpp - Template instantiation cost --===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file implements a template instantiation callback that measures the
+// cost of every instantiation and writes a ranked report.
+//
+//===----------------------------------------------------------------------===//
+
+#include "clang/Frontend/Utils.h"
+#include "clang/AST/ASTContext.h"
+#include "clang/AST/DeclTemplate.h"
+#include "clang/Basic/SourceManager.h"
+#include "clang/Frontend/FrontendDiagnostic.h"
+#include "clang/Sema/TemplateInstCallback.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/raw_ostream.h"
+#include <algorithm>
+#include <chrono>
+
+using namespace clang;
+
+namespace {
+using Clock = std::chrono::steady_clock;
+
+/// The measurements of one code synthesis context.
+struct InstantiationRecord {
+  Sema::CodeSynthesisContext::SynthesisKind Kind;
+  const Decl *Entity;
+  /// The template the record is charged to in the per-template summary.
+  const Decl *Template;
+  SourceLocation PointOfInstantiation;
+  /// Wall time, including nested instantiations.
+  Clock::duration Time = Clock::duration::zero();
+  /// Wall time, excluding nested instantiations.
+  Clock::duration SelfTime = Clock::duration::zero();
+  /// Number of instantiations performed while this one was active.
+  unsigned Nested = 0;
+  /// Bytes allocated in the ASTContext, including nested instantiations.
+  size_t ASTBytes = 0;
+};
+
+/// The cost of all instantiations of one template.
+struct TemplateSummary {
+  const Decl *Template;
+  unsigned Count = 0;
+  /// Time of the outermost instantiations of the template; instantiations
+  /// nested in another instantiation of the same template are not counted
+  /// twice.
+  Clock::duration Time = Clock::duration::zero();
+  Clock::duration SelfTime = Clock::duration::zero();
+  size_t ASTBytes = 0;
+};
+
+class TemplateInstantiationProfiler : public TemplateInstantiationCallback {
+  /// An instantiation that has begun but not ended yet.
+  struct ActiveInstantiation {
+    unsigned Record;
+    Clock::time_point Start;
+    size_t StartBytes;
+    unsigned StartCount;
+    /// Time spent in directly nested instantiations.
+    Clock::duration ChildTime;
+  };
+
+  std::string OutputFile;
+  bool JSON;
+  std::vector<InstantiationRecord> Records;
+  SmallVector<ActiveInstantiation, 16> Active;
+
+public:
+  TemplateInstantiationProfiler(StringRef OutputFile, bool JSON)
+      : OutputFile(OutputFile), JSON(JSON) {}
+
+  void initialize(const Sema &TheSema) override {
+    Records.clear();
+    Active.clear();
+  }
+
+  void finalize(const Sema &TheSema) override;
+
+  void atTemplateBegin(const Sema &TheSema,
+                       const Sema::CodeSynthesisContext &Inst) override {
+    if (!Inst.isInstantiationRecord() || !Inst.Entity)
+      return;
+    InstantiationRecord R;
+    R.Kind = Inst.Kind;
+    R.Entity = Inst.Entity;
+    R.Template = getChargedTemplate(Inst);
+    R.PointOfInstantiation = Inst.PointOfInstantiation;
+    Records.push_back(R);
+    size_t Bytes = TheSema.getASTContext().getAllocator().getBytesAllocated();
+    Active.push_back({unsigned(Records.size() - 1), Clock::now(), Bytes,
+                      unsigned(Records.size()), Clock::duration::zero()});
+  }
+
+  void atTemplateEnd(const Sema &TheSema,
+                     const Sema::CodeSynthesisContext &Inst) override {
+    if (!Inst.isInstantiationRecord() || !Inst.Entity || Active.empty())
+      return;
+    ActiveInstantiation A = Active.pop_back_val();
+    InstantiationRecord &R = Records[A.Record];
+    R.Time = Clock::now() - A.Start;
+    R.SelfTime = R.Time - A.ChildTime;
+    R.Nested = Records.size() - A.StartCount;
+    R.ASTBytes =
+        TheSema.getASTContext().getAllocator().getBytesAllocated() -
+        A.StartBytes;
+    if (!Active.empty())
+      Active.back().ChildTime += R.Time;
+  }
+
+private:
+  static const Decl *
+  getChargedTemplate(const Sema::CodeSynthesisContext &Inst);
+  void writeText(raw_ostream &OS, const SourceManager &SM,
+                 const PrintingPolicy &Policy,
+                 ArrayRef<TemplateSummary> Summaries);
+  void writeJSON(raw_ostream &OS, const SourceManager &SM,
+                 const PrintingPolicy &Policy,
+                 ArrayRef<TemplateSummary> Summaries);
+};
+} // end anonymous namespace
+
+/// Returns the template an instantiation is charged to: the pattern a
+/// specialization is instantiated from, or the template whose arguments are
+/// being deduced or substituted.
+const Decl *TemplateInstantiationProfiler::getChargedTemplate(
+    const Sema::CodeSynthesisContext &Inst) {
+  if (Inst.Kind == Sema::CodeSynthesisContext::TemplateInstantiation ||
+      Inst.Kind == Sema::CodeSynthesisContext::ExceptionSpecInstantiation) {
+    const Decl *D = Inst.Entity;
+    if (const auto *FD = dyn_cast<FunctionDecl>(D)) {
+      if (FunctionTemplateDecl *FTD = FD->getPrimaryTemplate())
+        return FTD->getCanonicalDecl();
+      if (const FunctionDecl *Pattern = FD->getTemplateInstantiationPattern())
+        return Pattern->getCanonicalDecl();
+    } else if (const auto *Spec =
+                   dyn_cast<ClassTemplateSpecializationDecl>(D)) {
+      return Spec->getSpecializedTemplate()->getCanonicalDecl();
+    } else if (const auto *RD = dyn_cast<CXXRecordDecl>(D)) {
+      if (const CXXRecordDecl *Pattern = RD->getTemplateInstantiationPattern())
+        return Pattern->getCanonicalDecl();
+    } else if (const auto *Spec = dyn_cast<VarTemplateSpecializationDecl>(D)) {
+      return Spec->getSpecializedTemplate()->getCanonicalDecl();
+    }
+    return D->getCanonicalDecl();
+  }
+  if (Inst.Template)
+    return Inst.Template->getCanonicalDecl();
+  return Inst.Entity->getCanonicalDecl();
+}
+
+static StringRef getKindName(Sema::CodeSynthesisContext::SynthesisKind Kind) {
+  switch (Kind) {
+  case Sema::CodeSynthesisContext::TemplateInstantiation:
+    return "instantiation";
+  case Sema::CodeSynthesisContext::DefaultTemplateArgumentInstantiation:
+    return "default template argument";
+  case Sema::CodeSynthesisContext::DefaultFunctionArgumentInstantiation:
+    return "default function argument";
+  case Sema::CodeSynthesisContext::ExplicitTemplateArgumentSubstitution:
+    return "explicit argument substitution";
+  case Sema::CodeSynthesisContext::DeducedTemplateArgumentSubstitution:
+    return "deduction";
+  case Sema::CodeSynthesisContext::PriorTemplateArgumentSubstitution:
+    return "prior argument substitution";
+  case Sema::CodeSynthesisContext::ExceptionSpecInstantiation:
+    return "exception specification";
+  case Sema::CodeSynthesisContext::DefaultTemplateArgumentChecking:
+  case Sema::CodeSynthesisContext::DeclaringSpecialMember:
+  case Sema::CodeSynthesisContext::DefiningSynthesizedFunction:
+    break;
+  }
+  return "other";
+}
+
+static std::string getDeclName(const Decl *D, const PrintingPolicy &Policy) {
+  const auto *ND = dyn_cast<NamedDecl>(D);
+  if (!ND)
+    return "<unnamed>";
+  std::string Name;
+  llvm::raw_string_ostream OS(Name);
+  ND->getNameForDiagnostic(OS, Policy, /*Qualified=*/true);
+  return OS.str();
+}
+
+static std::string getLocation(const SourceManager &SM, SourceLocation Loc) {
+  PresumedLoc PLoc = SM.getPresumedLoc(SM.getExpansionLoc(Loc));
+  if (PLoc.isInvalid())
+    return "<unknown>";
+  return (Twine(PLoc.getFilename()) + ":" + Twine(PLoc.getLine()) + ":" +
+          Twine(PLoc.getColumn()))
+      .str();
+}
+
+static double toMilliseconds(Clock::duration D) {
+  return std::chrono::duration<double, std::milli>(D).count();
+}
+
+static void printJSONString(raw_ostream &OS, StringRef Str) {
+  OS << '"';
+  for (unsigned char C : Str) {
+    if (C == '"' || C == '\\')
+      OS << '\\' << C;
+    else if (C < 0x20)
+      OS << llvm::format("\\u%04x", C);
+    else
+      OS << C;
+  }
+  OS << '"';
+}
+
+/// The number of individual instantiations listed in the text report.
+static const unsigned MaxListedInstantiations = 50;
+
+void TemplateInstantiationProfiler::writeText(
+    raw_ostream &OS, const SourceManager &SM, const PrintingPolicy &Policy,
+    ArrayRef<TemplateSummary> Summaries) {
+  Clock::duration Total = Clock::duration::zero();
+  for (const TemplateSummary &S : Summaries)
+    Total += S.SelfTime;
+
+  OS << "*** Template instantiation report\n";
+  OS << "Instantiations: " << Records.size() << ", templates: "
+     << Summaries.size() << ", total time: "
+     << llvm::format("%.3f", toMilliseconds(Total)) << " ms\n\n";
+
+  OS << "*** Templates, by total time\n";
+  OS << llvm::format("%10s %10s %8s %12s  %s\n", "Total(ms)", "Self(ms)",
+                     "Count", "AST bytes", "Template");
+  for (const TemplateSummary &S : Summaries)
+    OS << llvm::format("%10.3f %10.3f %8u %12zu  ", toMilliseconds(S.Time),
+                       toMilliseconds(S.SelfTime), S.Count, S.ASTBytes)
+       << getDeclName(S.Template, Policy) << "\n";
+
+  std::vector<const InstantiationRecord *> Sorted;
+  for (const InstantiationRecord &R : Records)
+    Sorted.push_back(&R);
+  std::stable_sort(Sorted.begin(), Sorted.end(),
+                   [](const InstantiationRecord *A,
+                      const InstantiationRecord *B) {
+                     return A->Time > B->Time;
+                   });
+  if (Sorted.size() > MaxListedInstantiations)
+    Sorted.resize(MaxListedInstantiations);
+
+  OS << "\n*** Slowest instantiations\n";
+  OS << llvm::format("%10s %10s %8s %12s  %s\n", "Total(ms)", "Self(ms)",
+                     "Nested", "AST bytes", "Entity");
+  for (const InstantiationRecord *R : Sorted)
+    OS << llvm::format("%10.3f %10.3f %8u %12zu  ", toMilliseconds(R->Time),
+                       toMilliseconds(R->SelfTime), R->Nested, R->ASTBytes)
+       << getDeclName(R->Entity, Policy) << " (" << getKindName(R->Kind)
+       << ", " << getLocation(SM, R->PointOfInstantiation) << ")\n";
+}
+
+void TemplateInstantiationProfiler::writeJSON(
+    raw_ostream &OS, const SourceManager &SM, const PrintingPolicy &Policy,
+    ArrayRef<TemplateSummary> Summaries) {
+  OS << "{\n  \"templates\": [";
+  bool First = true;
+  for (const TemplateSummary &S : Summaries) {
+    OS << (First ? "\n" : ",\n") << "    { \"template\": ";
+    printJSONString(OS, getDeclName(S.Template, Policy));
+    OS << ", \"location\": ";
+    printJSONString(OS, getLocation(SM, S.Template->getLocation()));
+    OS << ", \"count\": " << S.Count
+       << ", \"total_ms\": " << llvm::format("%.3f", toMilliseconds(S.Time))
+       << ", \"self_ms\": " << llvm::format("%.3f", toMilliseconds(S.SelfTime))
+       << ", \"ast_bytes\": " << S.ASTBytes << " }";
+    First = false;
+  }
+  OS << "\n  ],\n  \"instantiations\": [";
+  First = true;
+  for (const InstantiationRecord &R : Records) {
+    OS << (First ? "\n" : ",\n") << "    { \"entity\": ";
+    printJSONString(OS, getDeclName(R.Entity, Policy));
+    OS << ", \"kind\": ";
+    printJSONString(OS, getKindName(R.Kind));
+    OS << ", \"template\": ";
+    printJSONString(OS, getDeclName(R.Template, Policy));
+    OS << ", \"point_of_instantiation\": ";
+    printJSONString(OS, getLocation(SM, R.PointOfInstantiation));
+    OS << ", \"total_ms\": " << llvm::format("%.3f", toMilliseconds(R.Time))
+       << ", \"self_ms\": " << llvm::format("%.3f", toMilliseconds(R.SelfTime))
+       << ", \"nested\": " << R.Nested << ", \"ast_bytes\": " << R.ASTBytes
+       << " }";
+    First = false;
+  }
+  OS << "\n  ]\n}\n";
+}
+
+void TemplateInstantiationProfiler::finalize(const Sema &TheSema) {
+  // Summarize the records per template. An instantiation nested in another
+  // instantiation of the same template is already part of the outer one's
+  // total, so only its self time is added.
+  llvm::DenseMap<const Decl *, unsigned> SummaryIndex;
+  std::vector<TemplateSummary> Summaries;
+  SmallVector<unsigned, 16> Stack;
+  for (unsigned I = 0, E = Records.size(); I != E; ++I) {
+    const InstantiationRecord &R = Records[I];
+    while (!Stack.empty() &&
+           Stack.back() + Records[Stack.back()].Nested < I)
+      Stack.pop_back();
+    bool NestedInSameTemplate =
+        llvm::any_of(Stack, [&](unsigned Outer) {
+          return Records[Outer].Template == R.Template;
+        });
+    Stack.push_back(I);
+
+    auto Inserted = SummaryIndex.insert({R.Template, Summaries.size()});
+    if (Inserted.second) {
+      Summaries.emplace_back();
+      Summaries.back().Template = R.Template;
+    }
+    TemplateSummary &S = Summaries[Inserted.first->second];
+    ++S.Count;
+    S.SelfTime += R.SelfTime;
+    if (!NestedInSameTemplate) {
+      S.Time += R.Time;
+      S.ASTBytes += R.ASTBytes;
+    }
+  }
+  std::stable_sort(Summaries.begin(), Summaries.end(),
+                   [](const TemplateSummary &A, const TemplateSummary &B) {
+                     return A.Time > B.Time;
+                   });
+
+  std::error_code EC;
+  llvm::raw_fd_ostream OS(OutputFile, EC, llvm::sys::fs::F_Text);
+  if (EC) {
+    TheSema.getDiagnostics().Report(diag::err_fe_unable_to_open_output)
+        << OutputFile << EC.message();
+    return;
+  }
+
+  const SourceManager &SM = TheSema.getSourceManager();
+  PrintingPolicy Policy = TheSema.getPrintingPolicy();
+  if (JSON)
+    writeJSON(OS, SM, Policy, Summaries);
+  else
+    writeText(OS, SM, Policy, Summaries);
+}
+
+std::unique_ptr<TemplateInstantiationCallback>
+clang::createTemplateInstantiationProfiler(StringRef OutputFile, bool JSON) {
+  return llvm::make_unique<TemplateInstantiationProfiler>(OutputFile, JSON);
+}
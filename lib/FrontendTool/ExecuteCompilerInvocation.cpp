@@ -14,6 +14,7 @@
 
 #include "clang/FrontendTool/Utils.h"
 #include "clang/ARCMigrate/ARCMTActions.h"
+#include "clang/Basic/TimeTrace.h"
 #include "clang/CodeGen/CodeGenAction.h"
 #include "clang/Config/config.h"
 #include "clang/Driver/Options.h"
@@ -29,6 +30,9 @@
 #include "llvm/Option/Option.h"
 #include "llvm/Support/DynamicLibrary.h"
 #include "llvm/Support/ErrorHandling.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/raw_ostream.h"
 using namespace clang;
 using namespace llvm::opt;
 
@@ -173,6 +177,29 @@ CreateFrontendAction(CompilerInstance &CI) {
   return Act;
 }
 
+/// Write the time trace of the calling thread next to the output file, or
+/// next to the main input file if the output goes to stdout.
+static void writeTimeTrace(CompilerInstance &Clang) {
+  const FrontendOptions &FEOpts = Clang.getFrontendOpts();
+  SmallString<128> Path;
+  if (!FEOpts.OutputFile.empty() && FEOpts.OutputFile != "-")
+    Path = FEOpts.OutputFile;
+  else if (!FEOpts.Inputs.empty() && FEOpts.Inputs[0].isFile())
+    Path = llvm::sys::path::filename(FEOpts.Inputs[0].getFile());
+  else
+    Path = "clang";
+  llvm::sys::path::replace_extension(Path, "json");
+
+  std::error_code EC;
+  llvm::raw_fd_ostream OS(Path, EC, llvm::sys::fs::F_Text);
+  if (EC) {
+    Clang.getDiagnostics().Report(diag::err_fe_unable_to_open_output)
+        << Path << EC.message();
+    return;
+  }
+  timeTraceProfilerWrite(OS);
+}
+
 bool clang::ExecuteCompilerInvocation(CompilerInstance *Clang) {
   // Honor -help.
   if (Clang->getFrontendOpts().ShowHelp) {
@@ -249,7 +276,25 @@ bool clang::ExecuteCompilerInvocation(CompilerInstance *Clang) {
   std::unique_ptr<FrontendAction> Act(CreateFrontendAction(*Clang));
   if (!Act)
     return false;
-  bool Success = Clang->ExecuteAction(*Act);
+
+  // Record a time trace of the compilation if requested. The profiler is per
+  // thread, so compilations on other threads are not affected.
+  const FrontendOptions &FEOpts = Clang->getFrontendOpts();
+  bool TimeTrace = FEOpts.TimeTrace && !timeTraceProfilerEnabled();
+  if (TimeTrace)
+    timeTraceProfilerInitialize(FEOpts.TimeTraceGranularity);
+
+  bool Success;
+  {
+    TimeTraceScope TimeScope("ExecuteCompiler", StringRef());
+    Success = Clang->ExecuteAction(*Act);
+  }
+
+  if (TimeTrace) {
+    writeTimeTrace(*Clang);
+    timeTraceProfilerCleanup();
+  }
+
   if (Clang->getFrontendOpts().DisableFree)
     BuryPointer(std::move(Act));
   return Success;
@@ -0,0 +1,268 @@
+//===--- CharScanner.cpp - Vectorized character run scanning --------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+//  This file implements the portable, SSE2 and AVX2 character run scanners.
+//  The AVX2 scanners are compiled for the AVX2 target with a function
+//  attribute and only used if the host supports it.
+//
+//===----------------------------------------------------------------------===//
+
+#include "clang/Lex/CharScanner.h"
+#include "llvm/Support/Compiler.h"
+#include "llvm/Support/ErrorHandling.h"
+#include "llvm/Support/MathExtras.h"
+#include <cassert>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#define CLANG_CHARSCAN_SSE2 1
+#if defined(__clang__) || LLVM_GNUC_PREREQ(4, 9, 0)
+#include <immintrin.h>
+#define CLANG_CHARSCAN_AVX2 1
+#define CHARSCAN_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
+using namespace clang;
+using namespace charscan;
+
+namespace {
+using ScanFn = const char *(*)(const char *Ptr, const char *End);
+} // end anonymous namespace
+
+//===----------------------------------------------------------------------===//
+// Portable scanners
+//===----------------------------------------------------------------------===//
+
+static bool isLineCommentBody(unsigned char C) {
+  return C != '\n' && C != '\r' && C != 0;
+}
+
+static bool isStringLiteralBody(unsigned char C) {
+  return C != '"' && C != '\\' && C != '?' && C != '\n' && C != '\r' &&
+         C != 0;
+}
+
+static bool isIdentifierBodyChar(unsigned char C) {
+  return isIdentifierBody(C);
+}
+
+template <bool (*InRun)(unsigned char)>
+static const char *scanPortable(const char *Ptr, const char *) {
+  while (InRun(*Ptr))
+    ++Ptr;
+  return Ptr;
+}
+
+static const ScanFn PortableScanners[] = {
+    scanPortable<isIdentifierBodyChar>, scanPortable<isHorizontalWhitespace>,
+    scanPortable<isLineCommentBody>, scanPortable<isStringLiteralBody>};
+
+//===----------------------------------------------------------------------===//
+// SSE2 scanners
+//===----------------------------------------------------------------------===//
+
+#ifdef CLANG_CHARSCAN_SSE2
+/// Returns a mask of the bytes of \p C in [Lo, Hi].
+static __m128i inRange16(__m128i C, unsigned char Lo, unsigned char Hi) {
+  // Move the range to the bottom of the signed bytes, so that a single signed
+  // comparison tests both bounds.
+  __m128i Biased = _mm_add_epi8(C, _mm_set1_epi8((char)(0x80 - Lo)));
+  return _mm_cmplt_epi8(Biased, _mm_set1_epi8((char)(0x80 + Hi - Lo + 1)));
+}
+
+static __m128i equals16(__m128i C, char Value) {
+  return _mm_cmpeq_epi8(C, _mm_set1_epi8(Value));
+}
+
+// Each of these returns a bit mask of the bytes that end the run.
+
+static unsigned identifierBodyEnds16(__m128i C) {
+  __m128i Lower = _mm_or_si128(C, _mm_set1_epi8(0x20));
+  __m128i Body = _mm_or_si128(
+      _mm_or_si128(inRange16(Lower, 'a', 'z'), inRange16(C, '0', '9')),
+      equals16(C, '_'));
+  return ~(unsigned)_mm_movemask_epi8(Body) & 0xFFFF;
+}
+
+static unsigned horizontalWhitespaceEnds16(__m128i C) {
+  __m128i Space = _mm_or_si128(
+      _mm_or_si128(equals16(C, ' '), equals16(C, '\t')),
+      _mm_or_si128(equals16(C, '\f'), equals16(C, '\v')));
+  return ~(unsigned)_mm_movemask_epi8(Space) & 0xFFFF;
+}
+
+static unsigned lineCommentBodyEnds16(__m128i C) {
+  __m128i End = _mm_or_si128(_mm_or_si128(equals16(C, '\n'),
+                                          equals16(C, '\r')),
+                             equals16(C, 0));
+  return _mm_movemask_epi8(End);
+}
+
+static unsigned stringLiteralBodyEnds16(__m128i C) {
+  __m128i End = _mm_or_si128(
+      _mm_or_si128(_mm_or_si128(equals16(C, '"'), equals16(C, '\\')),
+                   _mm_or_si128(equals16(C, '?'), equals16(C, '\n'))),
+      _mm_or_si128(equals16(C, '\r'), equals16(C, 0)));
+  return _mm_movemask_epi8(End);
+}
+
+template <bool (*InRun)(unsigned char), unsigned (*RunEnds)(__m128i)>
+static const char *scanSSE2(const char *Ptr, const char *End) {
+  while (End - Ptr >= 16) {
+    __m128i Chunk = _mm_loadu_si128((const __m128i *)Ptr);
+    if (unsigned Ends = RunEnds(Chunk))
+      return Ptr + llvm::countTrailingZeros(Ends);
+    Ptr += 16;
+  }
+  return scanPortable<InRun>(Ptr, End);
+}
+
+static const ScanFn SSE2Scanners[] = {
+    scanSSE2<isIdentifierBodyChar, identifierBodyEnds16>,
+    scanSSE2<isHorizontalWhitespace, horizontalWhitespaceEnds16>,
+    scanSSE2<isLineCommentBody, lineCommentBodyEnds16>,
+    scanSSE2<isStringLiteralBody, stringLiteralBodyEnds16>};
+#endif
+
+//===----------------------------------------------------------------------===//
+// AVX2 scanners
+//===----------------------------------------------------------------------===//
+
+#ifdef CLANG_CHARSCAN_AVX2
+CHARSCAN_TARGET_AVX2
+static __m256i inRange32(__m256i C, unsigned char Lo, unsigned char Hi) {
+  __m256i Biased = _mm256_add_epi8(C, _mm256_set1_epi8((char)(0x80 - Lo)));
+  return _mm256_cmpgt_epi8(_mm256_set1_epi8((char)(0x80 + Hi - Lo + 1)),
+                           Biased);
+}
+
+CHARSCAN_TARGET_AVX2
+static __m256i equals32(__m256i C, char Value) {
+  return _mm256_cmpeq_epi8(C, _mm256_set1_epi8(Value));
+}
+
+CHARSCAN_TARGET_AVX2
+static unsigned identifierBodyEnds32(__m256i C) {
+  __m256i Lower = _mm256_or_si256(C, _mm256_set1_epi8(0x20));
+  __m256i Body = _mm256_or_si256(
+      _mm256_or_si256(inRange32(Lower, 'a', 'z'), inRange32(C, '0', '9')),
+      equals32(C, '_'));
+  return ~(unsigned)_mm256_movemask_epi8(Body);
+}
+
+CHARSCAN_TARGET_AVX2
+static unsigned horizontalWhitespaceEnds32(__m256i C) {
+  __m256i Space = _mm256_or_si256(
+      _mm256_or_si256(equals32(C, ' '), equals32(C, '\t')),
+      _mm256_or_si256(equals32(C, '\f'), equals32(C, '\v')));
+  return ~(unsigned)_mm256_movemask_epi8(Space);
+}
+
+CHARSCAN_TARGET_AVX2
+static unsigned lineCommentBodyEnds32(__m256i C) {
+  __m256i End = _mm256_or_si256(
+      _mm256_or_si256(equals32(C, '\n'), equals32(C, '\r')), equals32(C, 0));
+  return _mm256_movemask_epi8(End);
+}
+
+CHARSCAN_TARGET_AVX2
+static unsigned stringLiteralBodyEnds32(__m256i C) {
+  __m256i End = _mm256_or_si256(
+      _mm256_or_si256(_mm256_or_si256(equals32(C, '"'), equals32(C, '\\')),
+                      _mm256_or_si256(equals32(C, '?'), equals32(C, '\n'))),
+      _mm256_or_si256(equals32(C, '\r'), equals32(C, 0)));
+  return _mm256_movemask_epi8(End);
+}
+
+template <bool (*InRun)(unsigned char), unsigned (*RunEnds32)(__m256i),
+          unsigned (*RunEnds16)(__m128i)>
+CHARSCAN_TARGET_AVX2 static const char *scanAVX2(const char *Ptr,
+                                                 const char *End) {
+  while (End - Ptr >= 32) {
+    __m256i Chunk = _mm256_loadu_si256((const __m256i *)Ptr);
+    if (unsigned Ends = RunEnds32(Chunk))
+      return Ptr + llvm::countTrailingZeros(Ends);
+    Ptr += 32;
+  }
+  // Finish the last, partial block with the SSE2 scanner.
+  return scanSSE2<InRun, RunEnds16>(Ptr, End);
+}
+
+static const ScanFn AVX2Scanners[] = {
+    scanAVX2<isIdentifierBodyChar, identifierBodyEnds32,
+             identifierBodyEnds16>,
+    scanAVX2<isHorizontalWhitespace, horizontalWhitespaceEnds32,
+             horizontalWhitespaceEnds16>,
+    scanAVX2<isLineCommentBody, lineCommentBodyEnds32, lineCommentBodyEnds16>,
+    scanAVX2<isStringLiteralBody, stringLiteralBodyEnds32,
+             stringLiteralBodyEnds16>};
+#endif
+
+//===----------------------------------------------------------------------===//
+// Dispatch
+//===----------------------------------------------------------------------===//
+
+bool charscan::isScanImplSupported(ScanImpl Impl) {
+  switch (Impl) {
+  case ScanImpl::Portable:
+    return true;
+  case ScanImpl::SSE2:
+#ifdef CLANG_CHARSCAN_SSE2
+    return true;
+#else
+    return false;
+#endif
+  case ScanImpl::AVX2:
+#ifdef CLANG_CHARSCAN_AVX2
+    return __builtin_cpu_supports("avx2");
+#else
+    return false;
+#endif
+  }
+  llvm_unreachable("unknown scanner implementation");
+}
+
+ScanImpl charscan::getBestScanImpl() {
+  if (isScanImplSupported(ScanImpl::AVX2))
+    return ScanImpl::AVX2;
+  if (isScanImplSupported(ScanImpl::SSE2))
+    return ScanImpl::SSE2;
+  return ScanImpl::Portable;
+}
+
+static const ScanFn *getScanners(ScanImpl Impl) {
+  assert(isScanImplSupported(Impl) && "scanner not supported by the host");
+  switch (Impl) {
+  case ScanImpl::Portable:
+    break;
+  case ScanImpl::SSE2:
+#ifdef CLANG_CHARSCAN_SSE2
+    return SSE2Scanners;
+#endif
+    break;
+  case ScanImpl::AVX2:
+#ifdef CLANG_CHARSCAN_AVX2
+    return AVX2Scanners;
+#endif
+    break;
+  }
+  return PortableScanners;
+}
+
+const char *charscan::skipRun(RunKind Kind, const char *Ptr, const char *End,
+                              ScanImpl Impl) {
+  return getScanners(Impl)[static_cast<unsigned>(Kind)](Ptr, End);
+}
+
+const char *charscan::skipRun(RunKind Kind, const char *Ptr,
+                              const char *End) {
+  static const ScanFn *const BestScanners = getScanners(getBestScanImpl());
+  return BestScanners[static_cast<unsigned>(Kind)](Ptr, End);
+}
@@ -22,9 +22,11 @@
 #include "clang/Lex/ExternalPreprocessorSource.h"
 #include "clang/Lex/HeaderMap.h"
 #include "clang/Lex/HeaderSearchOptions.h"
+#include "clang/Lex/IncludeGuardCache.h"
 #include "clang/Lex/LexDiagnostic.h"
 #include "clang/Lex/ModuleMap.h"
 #include "clang/Lex/Preprocessor.h"
+#include "clang/Lex/PreprocessorOptions.h"
 #include "llvm/ADT/APInt.h"
 #include "llvm/ADT/Hashing.h"
 #include "llvm/ADT/SmallString.h"
@@ -98,6 +100,8 @@ void HeaderSearch::PrintStats() {
   fprintf(stderr, "  %d #include/#include_next/#import.\n", NumIncluded);
   fprintf(stderr, "    %d #includes skipped due to"
           " the multi-include optimization.\n", NumMultiIncludeFileOptzn);
+  fprintf(stderr, "      %d of them using the include guard cache.\n",
+          NumIncludeGuardCacheOptzn);
 
   fprintf(stderr, "%d framework lookups.\n", NumFrameworkLookups);
   fprintf(stderr, "%d subframework lookups.\n", NumSubFrameworkLookups);
@@ -1172,16 +1176,31 @@ bool HeaderSearch::ShouldEnterIncludeFile(Preprocessor &PP,
       return false;
   }
 
+  // If the file has not been lexed yet, its controlling macro may be known
+  // from another translation unit.
+  const IdentifierInfo *ControllingMacro =
+      FileInfo.getControllingMacro(ExternalLookup);
+  IncludeGuardCache *Guards = PP.getPreprocessorOpts().IncludeGuards.get();
+  if (Guards && !ControllingMacro && !FileInfo.NumIncludes && !ModulesEnabled) {
+    std::string Guard = Guards->lookup(File);
+    if (!Guard.empty()) {
+      ControllingMacro = FileInfo.ControllingMacro =
+          PP.getIdentifierInfo(Guard);
+      FileInfo.ControllingMacroFromCache = true;
+    }
+  }
+
   // Next, check to see if the file is wrapped with #ifndef guards.  If so, and
   // if the macro that guards it is defined, we know the #include has no effect.
-  if (const IdentifierInfo *ControllingMacro
-      = FileInfo.getControllingMacro(ExternalLookup)) {
+  if (ControllingMacro) {
     // If the header corresponds to a module, check whether the macro is already
     // defined in that module rather than checking in the current set of visible
     // modules.
     if (M ? PP.isMacroDefinedInLocalModule(ControllingMacro, M)
           : PP.isMacroDefined(ControllingMacro)) {
       ++NumMultiIncludeFileOptzn;
+      if (FileInfo.ControllingMacroFromCache)
+        ++NumIncludeGuardCacheOptzn;
       return false;
     }
   }
@@ -1192,6 +1211,20 @@ bool HeaderSearch::ShouldEnterIncludeFile(Preprocessor &PP,
   return true;
 }
 
+void HeaderSearch::UpdateIncludeGuardCache(
+    IncludeGuardCache &Cache, const FileEntry *File,
+    const IdentifierInfo *ControllingMacro, StringRef Contents) {
+  HeaderFileInfo &FileInfo = getFileInfo(File);
+  if (FileInfo.ControllingMacroFromCache) {
+    // The file was entered because its cached guard was not defined; now we
+    // know what actually guards it.
+    FileInfo.ControllingMacroFromCache = false;
+    FileInfo.ControllingMacro = ControllingMacro;
+  }
+  Cache.fileLexed(File, ControllingMacro ? ControllingMacro->getName() : "",
+                  Contents);
+}
+
 size_t HeaderSearch::getTotalMemory() const {
   return SearchDirs.capacity()
     + llvm::capacity_in_bytes(FileInfo)
@@ -0,0 +1,77 @@
+//===--- IncludeGuardCache.cpp - Include guards shared across TUs ---------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+//  This file implements the IncludeGuardCache class.
+//
+//===----------------------------------------------------------------------===//
+
+#include "clang/Lex/IncludeGuardCache.h"
+#include "clang/Basic/FileManager.h"
+#include "llvm/ADT/Hashing.h"
+
+using namespace clang;
+
+std::shared_ptr<IncludeGuardCache> IncludeGuardCache::getGlobal() {
+  static std::shared_ptr<IncludeGuardCache> Cache =
+      std::make_shared<IncludeGuardCache>();
+  return Cache;
+}
+
+std::string IncludeGuardCache::lookup(const FileEntry *File) const {
+  std::lock_guard<std::mutex> Lock(Mutex);
+  auto Known = Entries.find(File->getUniqueID());
+  if (Known == Entries.end() || Known->second.Size != File->getSize() ||
+      Known->second.ModTime != File->getModificationTime())
+    return std::string();
+  return Known->second.ControllingMacro;
+}
+
+bool IncludeGuardCache::fileLexed(const FileEntry *File,
+                                  StringRef ControllingMacro,
+                                  StringRef Contents) {
+  uint64_t ContentHash = llvm::hash_value(Contents);
+
+  std::lock_guard<std::mutex> Lock(Mutex);
+  auto Known = Entries.find(File->getUniqueID());
+  bool Matches = true;
+  if (Known != Entries.end()) {
+    const Entry &E = Known->second;
+    // An entry for an older version of the file is simply out of date; one for
+    // the same version that disagrees with the lexer is wrong.
+    if (E.Size == File->getSize() &&
+        E.ModTime == File->getModificationTime() &&
+        (E.ContentHash != ContentHash ||
+         E.ControllingMacro != ControllingMacro)) {
+      Matches = false;
+      ++NumInvalidations;
+    }
+    Entries.erase(Known);
+  }
+
+  if (!ControllingMacro.empty())
+    Entries[File->getUniqueID()] = {File->getSize(),
+                                    File->getModificationTime(), ContentHash,
+                                    ControllingMacro.str()};
+  return Matches;
+}
+
+void IncludeGuardCache::clear() {
+  std::lock_guard<std::mutex> Lock(Mutex);
+  Entries.clear();
+}
+
+unsigned IncludeGuardCache::size() const {
+  std::lock_guard<std::mutex> Lock(Mutex);
+  return Entries.size();
+}
+
+unsigned IncludeGuardCache::getNumInvalidations() const {
+  std::lock_guard<std::mutex> Lock(Mutex);
+  return NumInvalidations;
+}
@@ -16,9 +16,11 @@
 #include "clang/Basic/FileManager.h"
 #include "clang/Basic/SourceManager.h"
 #include "clang/Lex/HeaderSearch.h"
+#include "clang/Lex/IncludeGuardCache.h"
 #include "clang/Lex/LexDiagnostic.h"
 #include "clang/Lex/MacroInfo.h"
 #include "clang/Lex/PTHManager.h"
+#include "clang/Lex/PreprocessorOptions.h"
 #include "llvm/ADT/StringSwitch.h"
 #include "llvm/Support/FileSystem.h"
 #include "llvm/Support/MemoryBuffer.h"
@@ -403,6 +405,19 @@ bool Preprocessor::HandleEndOfFile(Token &Result, bool isEndOfMacro) {
     }
   }
 
+  // Share what guards this header with the preprocessors of other translation
+  // units. The main file may only have been lexed up to the end of a
+  // preamble, and the code completion file up to the completion point.
+  if (CurLexer && PPOpts->IncludeGuards &&
+      CurLexer->getFileID() != SourceMgr.getMainFileID()) {
+    const FileEntry *FE = CurLexer->getFileEntry();
+    if (FE && FE != CodeCompletionFile)
+      HeaderInfo.UpdateIncludeGuardCache(
+          *PPOpts->IncludeGuards, FE,
+          CurLexer->MIOpt.GetControllingMacroAtEndOfFile(),
+          CurLexer->getBuffer());
+  }
+
   // Complain about reaching a true EOF within arc_cf_code_audited.
   // We don't want to complain about reaching the end of a macro
   // instantiation or a _Pragma.
@@ -777,6 +777,8 @@ void Preprocessor::Lex(Token &Result) {
     setCodeCompletionIdentifierInfo(Result.getIdentifierInfo());
 
   LastTokenWasAt = Result.is(tok::at);
+  if (OnToken)
+    OnToken(Result);
 }
 
 /// \brief Lex a token following the 'import' contextual keyword.
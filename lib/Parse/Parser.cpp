@@ -550,6 +550,12 @@ bool Parser::ParseTopLevelDecl(DeclGroupPtrTy &Result) {
   if (PP.isIncrementalProcessingEnabled() && Tok.is(tok::eof))
     ConsumeToken();
 
+  // If the client cancelled the parse, act as if we reached the end of the
+  // translation unit. Stopping between top-level declarations leaves no
+  // construct half-parsed.
+  if (PP.isCancellationRequested() && Tok.isNot(tok::eof))
+    cutOffParsing();
+
   Result = nullptr;
   switch (Tok.getKind()) {
   case tok::annot_pragma_unused:
@@ -248,7 +248,7 @@ bool Rewriter::InsertText(SourceLocation Loc, StringRef Str,
     unsigned lineNo = SourceMgr->getLineNumber(FID, StartOffs) - 1;
     const SrcMgr::ContentCache *
         Content = SourceMgr->getSLocEntry(FID).getFile().getContentCache();
-    unsigned lineOffs = Content->SourceLineCache[lineNo];
+    unsigned lineOffs = Content->LineOffsets.getLineStart(lineNo);
 
     // Find the whitespace at the start of the line.
     StringRef indentSpace;
@@ -354,8 +354,8 @@ bool Rewriter::IncreaseIndentation(CharSourceRange range,
       Content = SourceMgr->getSLocEntry(FID).getFile().getContentCache();
   
   // Find where the lines start.
-  unsigned parentLineOffs = Content->SourceLineCache[parentLineNo];
-  unsigned startLineOffs = Content->SourceLineCache[startLineNo];
+  unsigned parentLineOffs = Content->LineOffsets.getLineStart(parentLineNo);
+  unsigned startLineOffs = Content->LineOffsets.getLineStart(startLineNo);
 
   // Find the whitespace at the start of each line.
   StringRef parentSpace, startSpace;
@@ -380,7 +380,7 @@ bool Rewriter::IncreaseIndentation(CharSourceRange range,
   // Indent the lines between start/end offsets.
   RewriteBuffer &RB = getEditBuffer(FID);
   for (unsigned lineNo = startLineNo; lineNo <= endLineNo; ++lineNo) {
-    unsigned offs = Content->SourceLineCache[lineNo];
+    unsigned offs = Content->LineOffsets.getLineStart(lineNo);
     unsigned i = offs;
     while (isWhitespaceExceptNL(MB[i]))
       ++i;
@@ -423,6 +423,52 @@ CodeCompleteConsumer::OverloadCandidate::getFunctionType() const {
   llvm_unreachable("Invalid CandidateKind!");
 }
 
+//===----------------------------------------------------------------------===//
+// Bounded code completion results implementation
+//===----------------------------------------------------------------------===//
+
+void BoundedCodeCompletionResults::add(const CodeCompletionResult &R) {
+  KeptResult New{R, NumAdded++};
+  if (!MaxResults) {
+    Kept.push_back(New);
+    return;
+  }
+
+  // Lower priority values are better; earlier results win ties.
+  auto IsBetter = [](const KeptResult &X, const KeptResult &Y) {
+    if (X.Result.Priority != Y.Result.Priority)
+      return X.Result.Priority < Y.Result.Priority;
+    return X.Index < Y.Index;
+  };
+
+  if (Kept.size() < MaxResults) {
+    Kept.push_back(New);
+    if (Kept.size() == MaxResults)
+      std::make_heap(Kept.begin(), Kept.end(), IsBetter);
+    return;
+  }
+
+  if (!IsBetter(New, Kept.front()))
+    return;
+  std::pop_heap(Kept.begin(), Kept.end(), IsBetter);
+  Kept.back() = New;
+  std::push_heap(Kept.begin(), Kept.end(), IsBetter);
+}
+
+std::vector<CodeCompletionResult> BoundedCodeCompletionResults::takeResults() {
+  std::sort(Kept.begin(), Kept.end(),
+            [](const KeptResult &X, const KeptResult &Y) {
+              return X.Index < Y.Index;
+            });
+  std::vector<CodeCompletionResult> Results;
+  Results.reserve(Kept.size());
+  for (const KeptResult &K : Kept)
+    Results.push_back(K.Result);
+  Kept.clear();
+  NumAdded = 0;
+  return Results;
+}
+
 //===----------------------------------------------------------------------===//
 // Code completion consumer implementation
 //===----------------------------------------------------------------------===//
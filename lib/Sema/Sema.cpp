@@ -23,6 +23,7 @@
 #include "clang/Basic/DiagnosticOptions.h"
 #include "clang/Basic/PartialDiagnostic.h"
 #include "clang/Basic/TargetInfo.h"
+#include "clang/Basic/TimeTrace.h"
 #include "clang/Lex/HeaderSearch.h"
 #include "clang/Lex/Preprocessor.h"
 #include "clang/Sema/CXXFieldCollector.h"
@@ -37,6 +38,7 @@
 #include "clang/Sema/SemaConsumer.h"
 #include "clang/Sema/SemaInternal.h"
 #include "clang/Sema/TemplateDeduction.h"
+#include "clang/Sema/TemplateInstCallback.h"
 #include "llvm/ADT/DenseMap.h"
 #include "llvm/ADT/SmallSet.h"
 using namespace clang;
@@ -76,6 +78,9 @@ namespace sema {
 class SemaPPCallbacks : public PPCallbacks {
   Sema *S = nullptr;
   llvm::SmallVector<SourceLocation, 8> IncludeStack;
+  /// For every file that has been entered but not exited, whether a "Source"
+  /// time trace section was opened for it.
+  llvm::SmallVector<bool, 8> TimeTraceFileStack;
 
 public:
   void set(Sema &S) { this->S = &S; }
@@ -96,9 +101,19 @@ public:
         S->DiagnoseNonDefaultPragmaPack(
             Sema::PragmaPackDiagnoseKind::NonDefaultStateAtInclude, IncludeLoc);
       }
+      // Time every included file, including the files it includes itself.
+      bool TraceFile = IncludeLoc.isValid() && timeTraceProfilerEnabled();
+      if (TraceFile) {
+        const FileEntry *FE = SM.getFileEntryForID(SM.getFileID(Loc));
+        timeTraceProfilerBegin("Source",
+                               FE ? FE->getName() : StringRef("<unknown>"));
+      }
+      TimeTraceFileStack.push_back(TraceFile);
       break;
     }
     case ExitFile:
+      if (!TimeTraceFileStack.empty() && TimeTraceFileStack.pop_back_val())
+        timeTraceProfilerEnd();
       if (!IncludeStack.empty())
         S->DiagnoseNonDefaultPragmaPack(
             Sema::PragmaPackDiagnoseKind::ChangedStateAtExit,
@@ -136,8 +151,9 @@ Sema::Sema(Preprocessor &pp, ASTContext &ctxt, ASTConsumer &consumer,
       ValueWithBytesObjCTypeMethod(nullptr), NSArrayDecl(nullptr),
       ArrayWithObjectsMethod(nullptr), NSDictionaryDecl(nullptr),
       DictionaryWithObjectsMethod(nullptr), GlobalNewDeleteDeclared(false),
-      TUKind(TUKind), NumSFINAEErrors(0), AccessCheckingSFINAE(false),
-      InNonInstantiationSFINAEContext(false), NonInstantiationEntries(0),
+      NumCachedCallDeductionsReused(0), TUKind(TUKind), NumSFINAEErrors(0),
+      AccessCheckingSFINAE(false), InNonInstantiationSFINAEContext(false),
+      NonInstantiationEntries(0),
       ArgumentPackSubstitutionIndex(-1), CurrentInstantiationScope(nullptr),
       DisableTypoCorrection(false), TyposCorrected(0), AnalysisWarnings(*this),
       ThreadSafetyDeclCache(nullptr), VarDataSharingAttributesStack(nullptr),
@@ -416,6 +432,10 @@ void Sema::addExternalSource(ExternalSemaSource *E) {
 void Sema::PrintStats() const {
   llvm::errs() << "\n*** Semantic Analysis Stats:\n";
   llvm::errs() << NumSFINAEErrors << " SFINAE diagnostics trapped.\n";
+  if (getLangOpts().CacheTemplateDeduction)
+    llvm::errs() << CallDeductionCache.size()
+                 << " template argument deductions cached, "
+                 << NumCachedCallDeductionsReused << " reused.\n";
 
   BumpAlloc.PrintStats();
   AnalysisWarnings.PrintStats();
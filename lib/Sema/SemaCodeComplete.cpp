@@ -133,6 +133,10 @@ namespace {
     /// results that are not desirable.
     LookupFilter Filter;
 
+    /// \brief The identifier being completed, which the consumer may require
+    /// results to match.
+    StringRef CodeCompletionFilter;
+
     /// \brief Whether we should allow declarations as
     /// nested-name-specifiers that would otherwise be filtered out.
     bool AllowNestedNameSpecifiers;
@@ -180,6 +184,12 @@ namespace {
         CompletionContext(CompletionContext),
         ObjCImplementation(nullptr)
     { 
+      // Let the consumer filter the results as they are added rather than once
+      // they all are, to avoid the work of adding results it would drop.
+      if (SemaRef.CodeCompleter)
+        CodeCompletionFilter =
+            SemaRef.getPreprocessor().getCodeCompletionFilter();
+
       // If this is an Objective-C instance method definition, dig out the 
       // corresponding implementation.
       switch (CompletionContext.getKind()) {
@@ -202,6 +212,13 @@ namespace {
     /// \brief Determine the priority for a reference to the given declaration.
     unsigned getBasePriority(const NamedDecl *D);
 
+    /// \brief Whether the consumer filters out the given result.
+    bool isFilteredOut(const Result &R) const {
+      return !CodeCompletionFilter.empty() &&
+             SemaRef.CodeCompleter->isResultFilteredOut(CodeCompletionFilter,
+                                                        R);
+    }
+
     /// \brief Whether we should include code patterns in the completion
     /// results.
     bool includeCodePatterns() const {
@@ -841,6 +858,9 @@ void ResultBuilder::MaybeAddConstructorResults(Result R) {
 void ResultBuilder::MaybeAddResult(Result R, DeclContext *CurContext) {
   assert(!ShadowMaps.empty() && "Must enter into a results scope");
   
+  if (isFilteredOut(R))
+    return;
+
   if (R.Kind != Result::RK_Declaration) {
     // For non-declaration results, just add the result.
     Results.push_back(R);
@@ -958,6 +978,9 @@ void ResultBuilder::MaybeAddResult(Result R, DeclContext *CurContext) {
 
 void ResultBuilder::AddResult(Result R, DeclContext *CurContext, 
                               NamedDecl *Hiding, bool InBaseClass = false) {
+  if (isFilteredOut(R))
+    return;
+
   if (R.Kind != Result::RK_Declaration) {
     // For non-declaration results, just add the result.
     Results.push_back(R);
@@ -1043,6 +1066,8 @@ void ResultBuilder::AddResult(Result R, DeclContext *CurContext,
 void ResultBuilder::AddResult(Result R) {
   assert(R.Kind != Result::RK_Declaration && 
           "Declaration results need more context");
+  if (isFilteredOut(R))
+    return;
   Results.push_back(R);
 }
 
@@ -3291,8 +3316,23 @@ static void HandleCodeCompleteResults(Sema *S,
                                       CodeCompletionContext Context,
                                       CodeCompletionResult *Results,
                                       unsigned NumResults) {
-  if (CodeCompleter)
-    CodeCompleter->ProcessCodeCompleteResults(*S, Context, Results, NumResults);
+  if (!CodeCompleter)
+    return;
+
+  // The consumer builds a completion string for each result, so only hand it
+  // the ones it would show.
+  unsigned MaxResults = CodeCompleter->getMaxResults();
+  if (MaxResults && NumResults > MaxResults) {
+    BoundedCodeCompletionResults Best(MaxResults);
+    for (unsigned I = 0; I != NumResults; ++I)
+      Best.add(Results[I]);
+    std::vector<CodeCompletionResult> BestResults = Best.takeResults();
+    CodeCompleter->ProcessCodeCompleteResults(*S, Context, BestResults.data(),
+                                              BestResults.size());
+    return;
+  }
+
+  CodeCompleter->ProcessCodeCompleteResults(*S, Context, Results, NumResults);
 }
 
 static enum CodeCompletionContext::Kind mapCodeCompletionContext(Sema &S, 
@@ -3591,6 +3591,48 @@ static Sema::TemplateDeductionResult DeduceTemplateArgumentsFromCallArgument(
                                             ArgType, Info, Deduced, TDF);
 }
 
+void Sema::CachedCallDeduction::Profile(llvm::FoldingSetNodeID &ID,
+                                       FunctionTemplateDecl *Template,
+                                       ArrayRef<Argument> Args) {
+  ID.AddPointer(Template);
+  ID.AddInteger(Args.size());
+  for (const Argument &Arg : Args) {
+    ID.AddPointer(Arg.Type.getAsOpaquePtr());
+    ID.AddInteger(Arg.ValueKind);
+    ID.AddInteger(Arg.ObjectKind);
+  }
+}
+
+unsigned Sema::getCallDeductionGeneration() const {
+  unsigned Generation = Context.getDeclarationGeneration();
+  if (ExternalASTSource *Source = Context.getExternalSource())
+    Generation += Source->getGeneration();
+  return Generation;
+}
+
+/// \brief Compute the key under which a deduction from the call arguments
+/// \p Args is cached.
+///
+/// \returns false if the deduction may depend on more than the types and
+/// classifications of the arguments.
+static bool
+getCallDeductionCacheKey(ASTContext &Context, ArrayRef<Expr *> Args,
+                         SmallVectorImpl<Sema::CachedCallDeduction::Argument>
+                             &Key) {
+  for (Expr *Arg : Args) {
+    QualType ArgType = Arg->getType();
+    // Initializer lists and overload sets are deduced from their elements,
+    // and the bound of an array may be completed by a later declaration.
+    if (isa<InitListExpr>(Arg) || ArgType->isDependentType() ||
+        ArgType->isPlaceholderType() || ArgType->isIncompleteArrayType())
+      return false;
+
+    Key.push_back({Context.getCanonicalType(ArgType), Arg->getValueKind(),
+                   Arg->getObjectKind()});
+  }
+  return true;
+}
+
 /// \brief Perform template argument deduction from a function call
 /// (C++ [temp.deduct.call]).
 ///
@@ -3628,6 +3670,45 @@ Sema::TemplateDeductionResult Sema::DeduceTemplateArguments(
   FunctionDecl *Function = FunctionTemplate->getTemplatedDecl();
   unsigned NumParams = Function->getNumParams();
 
+  // Deduction from arguments with the same types and classifications produces
+  // the same specialization, as long as no new declarations become visible.
+  SmallVector<CachedCallDeduction::Argument, 4> CacheKey;
+  bool UseCache = getLangOpts().CacheTemplateDeduction &&
+                  !ExplicitTemplateArgs && !PartialOverloading &&
+                  getCallDeductionCacheKey(Context, Args, CacheKey);
+  if (UseCache) {
+    llvm::FoldingSetNodeID ID;
+    CachedCallDeduction::Profile(ID, FunctionTemplate->getCanonicalDecl(),
+                                 CacheKey);
+    void *InsertPos;
+    CachedCallDeduction *Cached =
+        CallDeductionCache.FindNodeOrInsertPos(ID, InsertPos);
+    if (Cached && Cached->Generation == getCallDeductionGeneration() &&
+        !Cached->Specialization->isInvalidDecl()) {
+      ++NumCachedCallDeductionsReused;
+
+      // The conversions of the other arguments depend on more than their
+      // types (e.g. for null pointer constants), so check them again, in the
+      // same context as FinishTemplateArgumentDeduction.
+      EnterExpressionEvaluationContext Unevaluated(
+          *this, Sema::ExpressionEvaluationContext::Unevaluated);
+      SFINAETrap Trap(*this);
+      InstantiatingTemplate Inst(
+          *this, Info.getLocation(), FunctionTemplate,
+          Cached->Specialization->getTemplateSpecializationArgs()->asArray(),
+          CodeSynthesisContext::DeducedTemplateArgumentSubstitution, Info);
+      if (Inst.isInvalid())
+        return TDK_InstantiationDepth;
+
+      ContextRAII SavedContext(*this, Function);
+      if (CheckNonDependent(Cached->ParamTypesForArgChecking))
+        return TDK_NonDependentConversionFailure;
+
+      Specialization = Cached->Specialization;
+      return TDK_Success;
+    }
+  }
+
   unsigned FirstInnerIndex = getFirstInnerIndex(FunctionTemplate);
 
   // C++ [temp.deduct.call]p1:
@@ -3757,10 +3838,41 @@ Sema::TemplateDeductionResult Sema::DeduceTemplateArguments(
       return Result;
   }
 
-  return FinishTemplateArgumentDeduction(
+  TemplateDeductionResult Result = FinishTemplateArgumentDeduction(
       FunctionTemplate, Deduced, NumExplicitlySpecified, Specialization, Info,
       &OriginalCallArgs, PartialOverloading,
       [&]() { return CheckNonDependent(ParamTypesForArgChecking); });
+  if (Result != TDK_Success || !UseCache)
+    return Result;
+
+  // Failures aren't cached: their diagnostics refer to the arguments of the
+  // call. Look the entry up again, since deduction may have added others.
+  llvm::FoldingSetNodeID ID;
+  CachedCallDeduction::Profile(ID, FunctionTemplate->getCanonicalDecl(),
+                               CacheKey);
+  void *InsertPos;
+  CachedCallDeduction *Cached =
+      CallDeductionCache.FindNodeOrInsertPos(ID, InsertPos);
+  if (!Cached) {
+    Cached = new (BumpAlloc.Allocate<CachedCallDeduction>())
+        CachedCallDeduction;
+    Cached->Template = FunctionTemplate->getCanonicalDecl();
+    auto *StoredArgs =
+        BumpAlloc.Allocate<CachedCallDeduction::Argument>(CacheKey.size());
+    std::uninitialized_copy(CacheKey.begin(), CacheKey.end(), StoredArgs);
+    Cached->Args = llvm::makeArrayRef(StoredArgs, CacheKey.size());
+    CallDeductionCache.InsertNode(Cached, InsertPos);
+  }
+
+  auto *StoredParamTypes =
+      BumpAlloc.Allocate<QualType>(ParamTypesForArgChecking.size());
+  std::uninitialized_copy(ParamTypesForArgChecking.begin(),
+                          ParamTypesForArgChecking.end(), StoredParamTypes);
+  Cached->ParamTypesForArgChecking =
+      llvm::makeArrayRef(StoredParamTypes, ParamTypesForArgChecking.size());
+  Cached->Specialization = Specialization;
+  Cached->Generation = getCallDeductionGeneration();
+  return Result;
 }
 
 QualType Sema::adjustCCAndNoReturn(QualType ArgFunctionType,
@@ -59,6 +59,7 @@
 #include "clang/Basic/Specifiers.h"
 #include "clang/Basic/TargetInfo.h"
 #include "clang/Basic/TargetOptions.h"
+#include "clang/Basic/TimeTrace.h"
 #include "clang/Basic/TokenKinds.h"
 #include "clang/Basic/Version.h"
 #include "clang/Basic/VersionTuple.h"
@@ -80,6 +81,7 @@
 #include "clang/Serialization/ContinuousRangeMap.h"
 #include "clang/Serialization/GlobalModuleIndex.h"
 #include "clang/Serialization/Module.h"
+#include "clang/Serialization/ModuleChunkStore.h"
 #include "clang/Serialization/ModuleFileExtension.h"
 #include "clang/Serialization/ModuleManager.h"
 #include "clang/Serialization/SerializationDiagnostic.h"
@@ -3836,6 +3838,8 @@ ASTReader::ASTReadResult ASTReader::ReadAST(StringRef FileName,
                                             SourceLocation ImportLoc,
                                             unsigned ClientLoadCapabilities,
                                             SmallVectorImpl<ImportedSubmodule> *Imported) {
+  TimeTraceScope TimeScope("ReadAST", FileName);
+
   llvm::SaveAndRestore<SourceLocation>
     SetCurImportLocRAII(CurrentImportLoc, ImportLoc);
 
@@ -4592,7 +4596,10 @@ std::string ASTReader::getOriginalSourceFile(
     const std::string &ASTFileName, FileManager &FileMgr,
     const PCHContainerReader &PCHContainerRdr, DiagnosticsEngine &Diags) {
   // Open the AST file.
-  auto Buffer = FileMgr.getBufferForFile(ASTFileName);
+  auto Buffer = FileMgr.getBufferForFile(ASTFileName,
+                                         /*RequiresNullTerminator=*/false);
+  if (Buffer)
+    Buffer = ModuleChunkStore::materialize(std::move(*Buffer));
   if (!Buffer) {
     Diags.Report(diag::err_fe_unable_to_read_pch_file)
         << ASTFileName << Buffer.getError().message();
@@ -4692,7 +4699,12 @@ bool ASTReader::readASTFileControlBlock(
   // Open the AST file.
   // FIXME: This allows use of the VFS; we do not allow use of the
   // VFS when actually loading a module.
-  auto Buffer = FileMgr.getBufferForFile(Filename);
+  // Map the file, so that only the control block is read from disk, unless
+  // it has to be reassembled from the chunks of a deduplicated module cache.
+  auto Buffer = FileMgr.getBufferForFile(Filename,
+                                         /*RequiresNullTerminator=*/false);
+  if (Buffer)
+    Buffer = ModuleChunkStore::materialize(std::move(*Buffer));
   if (!Buffer) {
     return true;
   }
@@ -7547,6 +7559,13 @@ void ASTReader::PrintStats() {
                  NumIdentifierLookupHits, NumIdentifierLookups,
                  (double)NumIdentifierLookupHits*100.0/NumIdentifierLookups);
 
+  MemoryBufferSizes BufferSizes(0, 0);
+  getMemoryBufferSizes(BufferSizes);
+  if (size_t TotalBytes = BufferSizes.malloc_bytes + BufferSizes.mmap_bytes)
+    std::fprintf(stderr, "  %zu/%zu bytes of AST files memory-mapped (%f%%)\n",
+                 BufferSizes.mmap_bytes, TotalBytes,
+                 ((float)BufferSizes.mmap_bytes/TotalBytes * 100));
+
   if (GlobalIndex) {
     std::fprintf(stderr, "\n");
     GlobalIndex->printStats();
@@ -7927,10 +7946,20 @@ void ASTReader::ReadMethodPool(Selector Sel) {
   Generation = getGeneration();
   SelectorOutOfDate[Sel] = false;
 
+  // If there is a global index, look there first to determine which modules
+  // provably do not have any methods for this selector.
+  GlobalModuleIndex::HitSet Hits;
+  GlobalModuleIndex::HitSet *HitsPtr = nullptr;
+  if (!loadGlobalIndex()) {
+    if (GlobalIndex->lookupSelector(Sel.getAsString(), Hits)) {
+      HitsPtr = &Hits;
+    }
+  }
+
   // Search for methods defined with this selector.
   ++NumMethodPoolLookups;
   ReadMethodPoolVisitor Visitor(*this, Sel, PriorGeneration);
-  ModuleMgr.visit(Visitor);
+  ModuleMgr.visit(Visitor, HitsPtr);
 
   if (Visitor.getInstanceMethods().empty() &&
       Visitor.getFactoryMethods().empty())
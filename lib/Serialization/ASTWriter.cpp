@@ -97,6 +97,7 @@
 #include "llvm/Support/OnDiskHashTable.h"
 #include "llvm/Support/Path.h"
 #include "llvm/Support/SHA1.h"
+#include "llvm/Support/ThreadPool.h"
 #include "llvm/Support/raw_ostream.h"
 #include <algorithm>
 #include <cassert>
@@ -1137,6 +1138,7 @@ void ASTWriter::WriteBlockInfoBlock() {
   RECORD(DELETE_EXPRS_TO_ANALYZE);
   RECORD(CUDA_PRAGMA_FORCE_HOST_DEVICE_DEPTH);
   RECORD(PP_CONDITIONAL_STACK);
+  RECORD(METHOD_POOL_NAMES);
 
   // SourceManager Block.
   BLOCK(SOURCE_MANAGER_BLOCK);
@@ -2174,24 +2176,47 @@ void ASTWriter::WriteHeaderSearch(const HeaderSearch &HS) {
     free(const_cast<char *>(SavedStrings[I]));
 }
 
+/// \brief Compress a buffer embedded in the source manager block, without
+/// its trailing null character. \p Compressed is left empty if the buffer
+/// could not be compressed.
+static void compressBlob(StringRef Blob, SmallString<0> &Compressed) {
+  if (!llvm::zlib::isAvailable())
+    return;
+  if (llvm::Error E = llvm::zlib::compress(Blob.drop_back(1), Compressed)) {
+    llvm::consumeError(std::move(E));
+    Compressed.clear();
+  }
+}
+
+/// \brief Compress the buffers embedded in the source manager block, on up to
+/// \p NumThreads threads.
+///
+/// Each buffer is compressed on its own, so the result does not depend on the
+/// number of threads.
+static std::vector<SmallString<0>> compressBlobs(ArrayRef<StringRef> Blobs,
+                                                 unsigned NumThreads) {
+  std::vector<SmallString<0>> Compressed(Blobs.size());
+  llvm::ThreadPool Pool(std::min<size_t>(NumThreads, Blobs.size()));
+  for (unsigned I = 0, N = Blobs.size(); I != N; ++I)
+    Pool.async([&, I] { compressBlob(Blobs[I], Compressed[I]); });
+  Pool.wait();
+  return Compressed;
+}
+
 static void emitBlob(llvm::BitstreamWriter &Stream, StringRef Blob,
+                     StringRef CompressedBlob,
                      unsigned SLocBufferBlobCompressedAbbrv,
                      unsigned SLocBufferBlobAbbrv) {
   using RecordDataType = ASTWriter::RecordData::value_type;
 
-  // Compress the buffer if possible. We expect that almost all PCM
+  // Write the buffer compressed if possible. We expect that almost all PCM
   // consumers will not want its contents.
-  SmallString<0> CompressedBuffer;
-  if (llvm::zlib::isAvailable()) {
-    llvm::Error E = llvm::zlib::compress(Blob.drop_back(1), CompressedBuffer);
-    if (!E) {
-      RecordDataType Record[] = {SM_SLOC_BUFFER_BLOB_COMPRESSED,
-                                 Blob.size() - 1};
-      Stream.EmitRecordWithBlob(SLocBufferBlobCompressedAbbrv, Record,
-                                CompressedBuffer);
-      return;
-    }
-    llvm::consumeError(std::move(E));
+  if (!CompressedBlob.empty()) {
+    RecordDataType Record[] = {SM_SLOC_BUFFER_BLOB_COMPRESSED,
+                               Blob.size() - 1};
+    Stream.EmitRecordWithBlob(SLocBufferBlobCompressedAbbrv, Record,
+                              CompressedBlob);
+    return;
   }
 
   RecordDataType Record[] = {SM_SLOC_BUFFER_BLOB};
@@ -2221,6 +2246,37 @@ void ASTWriter::WriteSourceManagerBlock(SourceManager &SourceMgr,
       CreateSLocBufferBlobAbbrev(Stream, true);
   unsigned SLocExpansionAbbrv = CreateSLocExpansionAbbrev(Stream);
 
+  // Returns the contents of the buffer embedded for a source location entry,
+  // including the terminating null character, or an empty string if the
+  // entry does not embed its buffer.
+  auto getEmbeddedBuffer = [&](const SrcMgr::SLocEntry &SLoc) -> StringRef {
+    if (!SLoc.isFile())
+      return StringRef();
+    const SrcMgr::ContentCache *Content = SLoc.getFile().getContentCache();
+    if (Content->OrigEntry && !Content->BufferOverridden &&
+        !Content->IsTransient)
+      return StringRef();
+    const llvm::MemoryBuffer *Buffer =
+        Content->getBuffer(PP.getDiagnostics(), PP.getSourceManager());
+    return StringRef(Buffer->getBufferStart(), Buffer->getBufferSize() + 1);
+  };
+
+  // With several threads, compress the embedded buffers up front, in
+  // parallel. The block is then written in order, exactly as if each buffer
+  // had been compressed when it was written. Otherwise each buffer is
+  // compressed when it is written, so that only one is held at a time.
+  SmallVector<StringRef, 16> Blobs;
+  std::vector<SmallString<0>> CompressedBlobs;
+  if (NumThreads > 1) {
+    for (unsigned I = 1, N = SourceMgr.local_sloc_entry_size(); I != N; ++I) {
+      StringRef Blob = getEmbeddedBuffer(SourceMgr.getLocalSLocEntry(I));
+      if (!Blob.empty())
+        Blobs.push_back(Blob);
+    }
+    CompressedBlobs = compressBlobs(Blobs, NumThreads);
+  }
+  unsigned NextBlob = 0;
+
   // Write out the source location entry table. We skip the first
   // entry, which is always the same dummy entry.
   std::vector<uint32_t> SLocEntryOffsets;
@@ -2303,10 +2359,16 @@ void ASTWriter::WriteSourceManagerBlock(SourceManager &SourceMgr,
       if (EmitBlob) {
         // Include the implicit terminating null character in the on-disk buffer
         // if we're writing it uncompressed.
-        const llvm::MemoryBuffer *Buffer =
-            Content->getBuffer(PP.getDiagnostics(), PP.getSourceManager());
-        StringRef Blob(Buffer->getBufferStart(), Buffer->getBufferSize() + 1);
-        emitBlob(Stream, Blob, SLocBufferBlobCompressedAbbrv,
+        StringRef Blob = getEmbeddedBuffer(*SLoc);
+        SmallString<0> CompressedBlob;
+        if (NumThreads > 1) {
+          assert(NextBlob < Blobs.size() && Blobs[NextBlob] == Blob &&
+                 "embedded buffers out of sync");
+          CompressedBlob = std::move(CompressedBlobs[NextBlob++]);
+        } else {
+          compressBlob(Blob, CompressedBlob);
+        }
+        emitBlob(Stream, Blob, CompressedBlob, SLocBufferBlobCompressedAbbrv,
                  SLocBufferBlobAbbrv);
       }
     } else {
@@ -3355,6 +3417,10 @@ void ASTWriter::WriteSelectors(Sema &SemaRef) {
   if (SemaRef.MethodPool.empty() && SelectorIDs.empty())
     return;
   unsigned NumTableEntries = 0;
+  // The names of the selectors with methods, NUL-terminated, and how many
+  // there are.
+  SmallString<1024> SelectorNames;
+  unsigned NumSelectorNames = 0;
   // Create and write out the blob that contains selectors and the method pool.
   {
     llvm::OnDiskChainedHashTableGenerator<ASTMethodPoolTrait> Generator;
@@ -3397,6 +3463,12 @@ void ASTWriter::WriteSelectors(Sema &SemaRef) {
         // A new method pool entry.
         ++NumTableEntries;
       }
+      if (WritingModule &&
+          (Data.Instance.getMethod() || Data.Factory.getMethod())) {
+        SelectorNames += S.getAsString();
+        SelectorNames.push_back('\0');
+        ++NumSelectorNames;
+      }
       Generator.insert(S, Data, Trait);
     }
 
@@ -3444,6 +3516,20 @@ void ASTWriter::WriteSelectors(Sema &SemaRef) {
       Stream.EmitRecordWithBlob(SelectorOffsetAbbrev, Record,
                                 bytes(SelectorOffsets));
     }
+
+    // Write the names of the selectors with methods, which lets the global
+    // module index tell which modules to search for the methods of a
+    // selector.
+    if (WritingModule) {
+      Abbrev = std::make_shared<BitCodeAbbrev>();
+      Abbrev->Add(BitCodeAbbrevOp(METHOD_POOL_NAMES));
+      Abbrev->Add(BitCodeAbbrevOp(BitCodeAbbrevOp::VBR, 6)); // # of names
+      Abbrev->Add(BitCodeAbbrevOp(BitCodeAbbrevOp::Blob));
+      unsigned NamesAbbrev = Stream.EmitAbbrev(std::move(Abbrev));
+
+      RecordData::value_type Record[] = {METHOD_POOL_NAMES, NumSelectorNames};
+      Stream.EmitRecordWithBlob(NamesAbbrev, Record, SelectorNames);
+    }
   }
 }
 
@@ -4526,9 +4612,9 @@ void ASTWriter::SetSelectorOffset(Selector Sel, uint32_t Offset) {
 ASTWriter::ASTWriter(llvm::BitstreamWriter &Stream,
                      SmallVectorImpl<char> &Buffer, MemoryBufferCache &PCMCache,
                      ArrayRef<std::shared_ptr<ModuleFileExtension>> Extensions,
-                     bool IncludeTimestamps)
+                     bool IncludeTimestamps, unsigned NumThreads)
     : Stream(Stream), Buffer(Buffer), PCMCache(PCMCache),
-      IncludeTimestamps(IncludeTimestamps) {
+      IncludeTimestamps(IncludeTimestamps), NumThreads(NumThreads) {
   for (const auto &Ext : Extensions) {
     if (auto Writer = Ext->createExtensionWriter(*this))
       ModuleFileExtensionWriters.push_back(std::move(Writer));
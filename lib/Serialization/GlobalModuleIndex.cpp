@@ -18,6 +18,7 @@
 #include "clang/Serialization/ASTBitCodes.h"
 #include "clang/Serialization/GlobalModuleIndex.h"
 #include "clang/Serialization/Module.h"
+#include "clang/Serialization/ModuleChunkStore.h"
 #include "llvm/ADT/DenseMap.h"
 #include "llvm/ADT/MapVector.h"
 #include "llvm/ADT/SmallString.h"
@@ -50,7 +51,9 @@ namespace {
     /// \brief Describes a module, including its file name and dependencies.
     MODULE,
     /// \brief The index for identifiers.
-    IDENTIFIER_INDEX
+    IDENTIFIER_INDEX,
+    /// \brief The index for Objective-C selectors.
+    SELECTOR_INDEX
   };
 }
 
@@ -66,8 +69,8 @@ static const unsigned CurrentVersion = 1;
 
 namespace {
 
-/// \brief Trait used to read the identifier index from the on-disk hash
-/// table.
+/// \brief Trait used to read the identifier and selector indexes from the
+/// on-disk hash table.
 class IdentifierIndexReaderTrait {
 public:
   typedef StringRef external_key_type;
@@ -125,8 +128,9 @@ typedef llvm::OnDiskIterableChainedHashTable<IdentifierIndexReaderTrait>
 
 GlobalModuleIndex::GlobalModuleIndex(std::unique_ptr<llvm::MemoryBuffer> Buffer,
                                      llvm::BitstreamCursor Cursor)
-    : Buffer(std::move(Buffer)), IdentifierIndex(), NumIdentifierLookups(),
-      NumIdentifierLookupHits() {
+    : Buffer(std::move(Buffer)), IdentifierIndex(), SelectorIndex(),
+      NumIdentifierLookups(), NumIdentifierLookupHits(), NumSelectorLookups(),
+      NumSelectorLookupHits() {
   // Read the global index.
   bool InGlobalIndexBlock = false;
   bool Done = false;
@@ -224,12 +228,23 @@ GlobalModuleIndex::GlobalModuleIndex(std::unique_ptr<llvm::MemoryBuffer> Buffer,
             (const unsigned char *)Blob.data(), IdentifierIndexReaderTrait());
       }
       break;
+
+    case SELECTOR_INDEX:
+      // Wire up the selector index.
+      if (Record[0]) {
+        SelectorIndex = IdentifierIndexTable::Create(
+            (const unsigned char *)Blob.data() + Record[0],
+            (const unsigned char *)Blob.data() + sizeof(uint32_t),
+            (const unsigned char *)Blob.data(), IdentifierIndexReaderTrait());
+      }
+      break;
     }
   }
 }
 
 GlobalModuleIndex::~GlobalModuleIndex() {
   delete static_cast<IdentifierIndexTable *>(IdentifierIndex);
+  delete static_cast<IdentifierIndexTable *>(SelectorIndex);
 }
 
 std::pair<GlobalModuleIndex *, GlobalModuleIndex::ErrorCode>
@@ -240,7 +255,8 @@ GlobalModuleIndex::readIndex(StringRef Path) {
   llvm::sys::path::append(IndexPath, IndexFileName);
 
   llvm::ErrorOr<std::unique_ptr<llvm::MemoryBuffer>> BufferOrErr =
-      llvm::MemoryBuffer::getFile(IndexPath.c_str());
+      llvm::MemoryBuffer::getFile(IndexPath.c_str(), /*FileSize=*/-1,
+                                  /*RequiresNullTerminator=*/false);
   if (!BufferOrErr)
     return std::make_pair(nullptr, EC_NotFound);
   std::unique_ptr<llvm::MemoryBuffer> Buffer = std::move(BufferOrErr.get());
@@ -313,6 +329,31 @@ bool GlobalModuleIndex::lookupIdentifier(StringRef Name, HitSet &Hits) {
   return true;
 }
 
+bool GlobalModuleIndex::lookupSelector(StringRef Name, HitSet &Hits) {
+  Hits.clear();
+
+  // If there's no selector index, there is nothing we can do.
+  if (!SelectorIndex)
+    return false;
+
+  // Look into the selector index.
+  ++NumSelectorLookups;
+  IdentifierIndexTable &Table
+    = *static_cast<IdentifierIndexTable *>(SelectorIndex);
+  IdentifierIndexTable::iterator Known = Table.find(Name);
+  if (Known == Table.end())
+    return true;
+
+  SmallVector<unsigned, 2> ModuleIDs = *Known;
+  for (unsigned ID : ModuleIDs) {
+    if (ModuleFile *MF = Modules[ID].File)
+      Hits.insert(MF);
+  }
+
+  ++NumSelectorLookupHits;
+  return true;
+}
+
 bool GlobalModuleIndex::loadedModuleFile(ModuleFile *File) {
   // Look for the module in the global module index based on the module name.
   StringRef Name = File->ModuleName;
@@ -347,6 +388,11 @@ void GlobalModuleIndex::printStats() {
             NumIdentifierLookupHits, NumIdentifierLookups,
             (double)NumIdentifierLookupHits*100.0/NumIdentifierLookups);
   }
+  if (NumSelectorLookups) {
+    fprintf(stderr, "  %u / %u selector lookups succeeded (%f%%)\n",
+            NumSelectorLookupHits, NumSelectorLookups,
+            (double)NumSelectorLookupHits*100.0/NumSelectorLookups);
+  }
   std::fprintf(stderr, "\n");
 }
 
@@ -413,7 +459,15 @@ namespace {
     /// \brief A mapping from all interesting identifiers to the set of module
     /// files in which those identifiers are considered interesting.
     InterestingIdentifierMap InterestingIdentifiers;
-    
+
+    /// \brief A mapping from the names of selectors to the set of module
+    /// files with methods for them.
+    InterestingIdentifierMap Selectors;
+
+    /// \brief Whether all module files with a method pool recorded the names
+    /// of its selectors, so that the selector index is complete.
+    bool HaveAllSelectors = true;
+
     /// \brief Write the block-info block for the global module index file.
     void emitBlockInfoBlock(llvm::BitstreamWriter &Stream);
 
@@ -443,6 +497,12 @@ namespace {
     /// \brief Write the index to the given bitstream.
     /// \returns true if an error occurred, false otherwise.
     bool writeIndex(llvm::BitstreamWriter &Stream);
+
+  private:
+    /// \brief Write a mapping from names to module file IDs as an on-disk
+    /// hash table, in a record with the given code.
+    void emitNameIndex(llvm::BitstreamWriter &Stream, IndexRecordTypes Code,
+                       InterestingIdentifierMap &Names);
   };
 }
 
@@ -482,6 +542,7 @@ GlobalModuleIndexBuilder::emitBlockInfoBlock(llvm::BitstreamWriter &Stream) {
   RECORD(INDEX_METADATA);
   RECORD(MODULE);
   RECORD(IDENTIFIER_INDEX);
+  RECORD(SELECTOR_INDEX);
 #undef RECORD
 #undef BLOCK
 
@@ -513,6 +574,8 @@ bool GlobalModuleIndexBuilder::loadModuleFile(const FileEntry *File) {
   // Open the module file.
 
   auto Buffer = FileMgr.getBufferForFile(File, /*isVolatile=*/true);
+  if (Buffer)
+    Buffer = ModuleChunkStore::materialize(std::move(*Buffer));
   if (!Buffer) {
     return true;
   }
@@ -534,6 +597,7 @@ bool GlobalModuleIndexBuilder::loadModuleFile(const FileEntry *File) {
 
   // Search for the blocks and records we care about.
   enum { Other, ControlBlock, ASTBlock, DiagnosticOptionsBlock } State = Other;
+  bool HasMethodPool = false, HasMethodPoolNames = false;
   bool Done = false;
   while (!Done) {
     llvm::BitstreamEntry Entry = InStream.advance();
@@ -671,6 +735,19 @@ bool GlobalModuleIndexBuilder::loadModuleFile(const FileEntry *File) {
       }
     }
 
+    // Handle the names of the selectors with methods.
+    if (State == ASTBlock && Code == METHOD_POOL)
+      HasMethodPool = true;
+    if (State == ASTBlock && Code == METHOD_POOL_NAMES) {
+      HasMethodPoolNames = true;
+      StringRef Names = Blob;
+      for (unsigned I = 0, N = Record[0]; I != N; ++I) {
+        std::pair<StringRef, StringRef> Split = Names.split('\0');
+        Selectors[Split.first].push_back(ID);
+        Names = Split.second;
+      }
+    }
+
     // Get Signature.
     if (State == DiagnosticOptionsBlock && Code == SIGNATURE)
       getModuleFileInfo(File).Signature = {
@@ -680,6 +757,11 @@ bool GlobalModuleIndexBuilder::loadModuleFile(const FileEntry *File) {
     // We don't care about this record.
   }
 
+  // Module files written before selector names were recorded make the
+  // selector index unusable.
+  if (HasMethodPool && !HasMethodPoolNames)
+    HaveAllSelectors = false;
+
   return false;
 }
 
@@ -725,6 +807,44 @@ public:
 
 }
 
+void GlobalModuleIndexBuilder::emitNameIndex(llvm::BitstreamWriter &Stream,
+                                             IndexRecordTypes Code,
+                                             InterestingIdentifierMap &Names) {
+  using namespace llvm;
+
+  llvm::OnDiskChainedHashTableGenerator<IdentifierIndexWriterTrait> Generator;
+  IdentifierIndexWriterTrait Trait;
+
+  // Populate the hash table.
+  for (InterestingIdentifierMap::iterator I = Names.begin(),
+                                          IEnd = Names.end();
+       I != IEnd; ++I) {
+    Generator.insert(I->first(), I->second, Trait);
+  }
+
+  // Create the on-disk hash table in a buffer.
+  SmallString<4096> Table;
+  uint32_t BucketOffset;
+  {
+    using namespace llvm::support;
+    llvm::raw_svector_ostream Out(Table);
+    // Make sure that no bucket is at offset 0
+    endian::Writer<little>(Out).write<uint32_t>(0);
+    BucketOffset = Generator.Emit(Out, Trait);
+  }
+
+  // Create a blob abbreviation
+  auto Abbrev = std::make_shared<BitCodeAbbrev>();
+  Abbrev->Add(BitCodeAbbrevOp(Code));
+  Abbrev->Add(BitCodeAbbrevOp(BitCodeAbbrevOp::Fixed, 32));
+  Abbrev->Add(BitCodeAbbrevOp(BitCodeAbbrevOp::Blob));
+  unsigned TableAbbrev = Stream.EmitAbbrev(std::move(Abbrev));
+
+  // Write the table
+  uint64_t Record[] = {Code, BucketOffset};
+  Stream.EmitRecordWithBlob(TableAbbrev, Record, Table);
+}
+
 bool GlobalModuleIndexBuilder::writeIndex(llvm::BitstreamWriter &Stream) {
   for (auto MapEntry : ImportedModuleFiles) {
     auto *File = MapEntry.first;
@@ -779,39 +899,11 @@ bool GlobalModuleIndexBuilder::writeIndex(llvm::BitstreamWriter &Stream) {
   }
 
   // Write the identifier -> module file mapping.
-  {
-    llvm::OnDiskChainedHashTableGenerator<IdentifierIndexWriterTrait> Generator;
-    IdentifierIndexWriterTrait Trait;
-
-    // Populate the hash table.
-    for (InterestingIdentifierMap::iterator I = InterestingIdentifiers.begin(),
-                                            IEnd = InterestingIdentifiers.end();
-         I != IEnd; ++I) {
-      Generator.insert(I->first(), I->second, Trait);
-    }
-    
-    // Create the on-disk hash table in a buffer.
-    SmallString<4096> IdentifierTable;
-    uint32_t BucketOffset;
-    {
-      using namespace llvm::support;
-      llvm::raw_svector_ostream Out(IdentifierTable);
-      // Make sure that no bucket is at offset 0
-      endian::Writer<little>(Out).write<uint32_t>(0);
-      BucketOffset = Generator.Emit(Out, Trait);
-    }
-
-    // Create a blob abbreviation
-    auto Abbrev = std::make_shared<BitCodeAbbrev>();
-    Abbrev->Add(BitCodeAbbrevOp(IDENTIFIER_INDEX));
-    Abbrev->Add(BitCodeAbbrevOp(BitCodeAbbrevOp::Fixed, 32));
-    Abbrev->Add(BitCodeAbbrevOp(BitCodeAbbrevOp::Blob));
-    unsigned IDTableAbbrev = Stream.EmitAbbrev(std::move(Abbrev));
+  emitNameIndex(Stream, IDENTIFIER_INDEX, InterestingIdentifiers);
 
-    // Write the identifier table
-    uint64_t Record[] = {IDENTIFIER_INDEX, BucketOffset};
-    Stream.EmitRecordWithBlob(IDTableAbbrev, Record, IdentifierTable);
-  }
+  // Write the selector -> module file mapping.
+  if (HaveAllSelectors)
+    emitNameIndex(Stream, SELECTOR_INDEX, Selectors);
 
   Stream.ExitBlock();
   return false;
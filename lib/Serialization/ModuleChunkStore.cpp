@@ -0,0 +1,452 @@
+//===--- ModuleChunkStore.cpp - Deduplicated module cache storage ---------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+//  This file implements the ModuleChunkStore class.
+//
+//  A manifest consists of, with all integers in little endian:
+//
+//    "CLANGCHK"          magic
+//    uint32              version
+//    uint32, bytes       the chunk directory, relative to the manifest's
+//                        directory unless it is absolute
+//    uint64              the size of the module file
+//    uint32              the number of chunks
+//    { 20 bytes, uint32 } the SHA1 and size of each chunk
+//
+//  A chunk file is named after the hex SHA1 of its contents, and holds 'R'
+//  followed by the contents, or 'Z' followed by the zlib compressed contents.
+//
+//===----------------------------------------------------------------------===//
+
+#include "clang/Serialization/ModuleChunkStore.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/ADT/StringSet.h"
+#include "llvm/Support/Compression.h"
+#include "llvm/Support/Endian.h"
+#include "llvm/Support/Errc.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/Process.h"
+#include "llvm/Support/SHA1.h"
+#include "llvm/Support/raw_ostream.h"
+#include <chrono>
+
+using namespace clang;
+using namespace llvm::support;
+
+static const char ManifestMagic[] = "CLANGCHK";
+static const unsigned ManifestMagicSize = sizeof(ManifestMagic) - 1;
+static const uint32_t ManifestVersion = 1;
+static const unsigned HashSize = 20;
+
+static const char ChunkDirName[] = "chunks";
+static const char ChunkExtension[] = ".chunk";
+
+// Chunks are cut where the rolling hash of the last 64 bytes has its top
+// ChunkBits bits clear, but are never smaller than MinChunkSize or larger than
+// MaxChunkSize, which gives chunks of about 10KB.
+static const unsigned MinChunkSize = 2 * 1024;
+static const unsigned MaxChunkSize = 64 * 1024;
+static const unsigned ChunkBits = 13;
+
+namespace {
+/// \brief A parsed manifest.
+struct Manifest {
+  StringRef ChunkDir;
+  uint64_t Size = 0;
+  /// The SHA1 and size of each chunk.
+  SmallVector<std::pair<StringRef, uint32_t>, 64> Chunks;
+};
+
+/// \brief A module file stored as a single uncompressed chunk, backed by the
+/// mapping of that chunk.
+class MappedModuleFile : public llvm::MemoryBuffer {
+  std::unique_ptr<llvm::MemoryBuffer> Chunk;
+  std::string Name;
+
+public:
+  MappedModuleFile(std::unique_ptr<llvm::MemoryBuffer> Chunk, StringRef Name)
+      : Chunk(std::move(Chunk)), Name(Name) {
+    // Skip the kind of the chunk.
+    StringRef Data = this->Chunk->getBuffer().drop_front();
+    init(Data.begin(), Data.end(), /*RequiresNullTerminator=*/false);
+  }
+
+  StringRef getBufferIdentifier() const override { return Name; }
+
+  BufferKind getBufferKind() const override { return Chunk->getBufferKind(); }
+};
+} // end anonymous namespace
+
+/// \brief The random values of the rolling hash, one per byte value.
+static const uint64_t *getGearTable() {
+  struct GearTable {
+    uint64_t Values[256];
+    GearTable() {
+      // splitmix64, so that the chunk boundaries never change.
+      uint64_t State = 0x636c616e67636873ULL;
+      for (uint64_t &V : Values) {
+        uint64_t Z = (State += 0x9e3779b97f4a7c15ULL);
+        Z = (Z ^ (Z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        Z = (Z ^ (Z >> 27)) * 0x94d049bb133111ebULL;
+        V = Z ^ (Z >> 31);
+      }
+    }
+  };
+  static const GearTable Table;
+  return Table.Values;
+}
+
+/// \brief Returns the size of the chunk at the start of \p Data.
+static size_t findChunkEnd(StringRef Data) {
+  if (Data.size() <= MinChunkSize)
+    return Data.size();
+  const uint64_t *Gear = getGearTable();
+  size_t End = std::min<size_t>(Data.size(), MaxChunkSize);
+  uint64_t Hash = 0;
+  for (size_t I = 0; I != End; ++I) {
+    Hash = (Hash << 1) + Gear[(unsigned char)Data[I]];
+    if (I >= MinChunkSize && (Hash >> (64 - ChunkBits)) == 0)
+      return I + 1;
+  }
+  return End;
+}
+
+static void appendLE(std::string &Out, uint64_t Value, unsigned Bytes) {
+  for (unsigned I = 0; I != Bytes; ++I)
+    Out.push_back(char(Value >> (8 * I)));
+}
+
+static bool parseManifest(StringRef Contents, Manifest &M) {
+  if (!ModuleChunkStore::isManifest(Contents))
+    return false;
+  const char *Ptr = Contents.data() + ManifestMagicSize;
+  const char *End = Contents.data() + Contents.size();
+  auto Have = [&](size_t Bytes) { return size_t(End - Ptr) >= Bytes; };
+
+  if (!Have(8) || endian::read32le(Ptr) != ManifestVersion)
+    return false;
+  uint32_t DirLength = endian::read32le(Ptr + 4);
+  Ptr += 8;
+  if (!Have(DirLength))
+    return false;
+  M.ChunkDir = StringRef(Ptr, DirLength);
+  Ptr += DirLength;
+
+  if (!Have(12))
+    return false;
+  M.Size = endian::read64le(Ptr);
+  uint32_t NumChunks = endian::read32le(Ptr + 8);
+  Ptr += 12;
+  if (!Have(uint64_t(NumChunks) * (HashSize + 4)))
+    return false;
+  uint64_t Total = 0;
+  for (uint32_t I = 0; I != NumChunks; ++I) {
+    uint32_t Size = endian::read32le(Ptr + HashSize);
+    M.Chunks.push_back({StringRef(Ptr, HashSize), Size});
+    Total += Size;
+    Ptr += HashSize + 4;
+  }
+  return Ptr == End && Total == M.Size;
+}
+
+static std::string getChunkFileName(StringRef ChunkDir, StringRef Hash) {
+  SmallString<128> Path(ChunkDir);
+  llvm::sys::path::append(Path, llvm::toHex(Hash) + ChunkExtension);
+  return Path.str();
+}
+
+/// \brief Write a chunk to the store, unless it's already there, in which
+/// case \p AlreadyStored is set.
+///
+/// \param AllowCompression Whether the chunk may be compressed. A module file
+/// that is a single uncompressed chunk can be mapped in place.
+static std::error_code writeChunk(StringRef ChunkDir, StringRef Hash,
+                                  StringRef Data, bool AllowCompression,
+                                  bool &AlreadyStored) {
+  std::string Path = getChunkFileName(ChunkDir, Hash);
+  AlreadyStored = false;
+
+  // If the chunk is already stored, make it look recently written, so that a
+  // concurrent prune doesn't remove it before our manifest is in place.
+  int FD;
+  if (!llvm::sys::fs::openFileForRead(Path, FD)) {
+    std::error_code EC = llvm::sys::fs::setLastModificationAndAccessTime(
+        FD, std::chrono::system_clock::now());
+    llvm::sys::Process::SafelyCloseFileDescriptor(FD);
+    AlreadyStored = !EC;
+    return EC;
+  }
+
+  // Compress the chunk if that's worth it, favoring decompression speed.
+  char Kind = 'R';
+  SmallString<0> Compressed;
+  if (AllowCompression && llvm::zlib::isAvailable()) {
+    if (llvm::Error E = llvm::zlib::compress(
+            Data, Compressed, llvm::zlib::BestSpeedCompression))
+      llvm::consumeError(std::move(E));
+    else if (Compressed.size() < Data.size() - Data.size() / 8) {
+      Kind = 'Z';
+      Data = Compressed;
+    }
+  }
+
+  // Write it to a temporary file and move it into place, so that readers
+  // never see a partial chunk.
+  SmallString<128> TempPath;
+  if (std::error_code EC = llvm::sys::fs::createUniqueFile(
+          Path + "-%%%%%%%%.tmp", FD, TempPath))
+    return EC;
+  {
+    llvm::raw_fd_ostream OS(FD, /*shouldClose=*/true);
+    OS << Kind << Data;
+    OS.close();
+    if (OS.has_error()) {
+      OS.clear_error();
+      llvm::sys::fs::remove(TempPath);
+      return llvm::make_error_code(llvm::errc::io_error);
+    }
+  }
+  if (std::error_code EC = llvm::sys::fs::rename(TempPath, Path)) {
+    llvm::sys::fs::remove(TempPath);
+    return EC;
+  }
+  return std::error_code();
+}
+
+/// \brief Returns the chunk directory as written in the manifest of
+/// \p ModuleFileName: relative to the directory of the module file if that
+/// is within the module cache, absolute otherwise.
+static std::string getManifestChunkDir(StringRef ModuleFileName,
+                                       StringRef ModuleCachePath) {
+  SmallString<128> Cache(ModuleCachePath);
+  SmallString<128> Dir(llvm::sys::path::parent_path(ModuleFileName));
+  llvm::sys::fs::make_absolute(Cache);
+  llvm::sys::fs::make_absolute(Dir);
+  llvm::sys::path::remove_dots(Cache, /*remove_dot_dot=*/true);
+  llvm::sys::path::remove_dots(Dir, /*remove_dot_dot=*/true);
+
+  StringRef Rest = Dir.str();
+  if (Rest.consume_front(Cache.str()) &&
+      (Rest.empty() || llvm::sys::path::is_separator(Rest.front()))) {
+    std::string Relative;
+    for (auto I = llvm::sys::path::begin(Rest),
+              E = llvm::sys::path::end(Rest);
+         I != E; ++I)
+      if (!I->empty() && !llvm::sys::path::is_separator((*I)[0]))
+        Relative += "../";
+    return Relative + ChunkDirName;
+  }
+
+  llvm::sys::path::append(Cache, ChunkDirName);
+  return Cache.str();
+}
+
+bool ModuleChunkStore::isManifest(StringRef Contents) {
+  return Contents.startswith(StringRef(ManifestMagic, ManifestMagicSize));
+}
+
+std::error_code
+ModuleChunkStore::storeModuleFile(StringRef ModuleFileName,
+                                  StringRef ModuleCachePath,
+                                  StoreStatistics *Stats) {
+  auto Buffer = llvm::MemoryBuffer::getFile(
+      ModuleFileName, /*FileSize=*/-1, /*RequiresNullTerminator=*/false);
+  if (!Buffer)
+    return Buffer.getError();
+  StringRef Contents = (*Buffer)->getBuffer();
+  if (isManifest(Contents))
+    return std::error_code();
+
+  SmallString<128> ChunkDir(ModuleCachePath);
+  llvm::sys::path::append(ChunkDir, ChunkDirName);
+  if (std::error_code EC = llvm::sys::fs::create_directories(ChunkDir))
+    return EC;
+
+  std::string ManifestChunkDir =
+      getManifestChunkDir(ModuleFileName, ModuleCachePath);
+  std::string Manifest(ManifestMagic, ManifestMagicSize);
+  appendLE(Manifest, ManifestVersion, 4);
+  appendLE(Manifest, ManifestChunkDir.size(), 4);
+  Manifest += ManifestChunkDir;
+  appendLE(Manifest, Contents.size(), 8);
+  size_t NumChunksOffset = Manifest.size();
+  appendLE(Manifest, 0, 4);
+
+  uint32_t NumChunks = 0;
+  unsigned NumSharedChunks = 0;
+  for (StringRef Rest = Contents; !Rest.empty(); ++NumChunks) {
+    StringRef Chunk = Rest.take_front(findChunkEnd(Rest));
+    Rest = Rest.drop_front(Chunk.size());
+
+    llvm::SHA1 Hasher;
+    Hasher.update(Chunk);
+    StringRef Hash = Hasher.final();
+    assert(Hash.size() == HashSize && "unexpected hash size");
+    bool AlreadyStored;
+    if (std::error_code EC =
+            writeChunk(ChunkDir, Hash, Chunk,
+                       /*AllowCompression=*/Chunk.size() != Contents.size(),
+                       AlreadyStored))
+      return EC;
+    if (AlreadyStored)
+      ++NumSharedChunks;
+    Manifest += Hash;
+    appendLE(Manifest, Chunk.size(), 4);
+  }
+  endian::write32le(&Manifest[NumChunksOffset], NumChunks);
+
+  // Replace the module file atomically.
+  int FD;
+  SmallString<128> TempPath;
+  if (std::error_code EC = llvm::sys::fs::createUniqueFile(
+          ModuleFileName + "-%%%%%%%%.tmp", FD, TempPath))
+    return EC;
+  {
+    llvm::raw_fd_ostream OS(FD, /*shouldClose=*/true);
+    OS << Manifest;
+    OS.close();
+    if (OS.has_error()) {
+      OS.clear_error();
+      llvm::sys::fs::remove(TempPath);
+      return llvm::make_error_code(llvm::errc::io_error);
+    }
+  }
+  Buffer->reset();
+  if (std::error_code EC = llvm::sys::fs::rename(TempPath, ModuleFileName)) {
+    llvm::sys::fs::remove(TempPath);
+    return EC;
+  }
+  if (Stats) {
+    Stats->NumChunks = NumChunks;
+    Stats->NumSharedChunks = NumSharedChunks;
+  }
+  return std::error_code();
+}
+
+llvm::ErrorOr<std::unique_ptr<llvm::MemoryBuffer>>
+ModuleChunkStore::materialize(std::unique_ptr<llvm::MemoryBuffer> Buffer) {
+  if (!isManifest(Buffer->getBuffer()))
+    return std::move(Buffer);
+
+  Manifest M;
+  if (!parseManifest(Buffer->getBuffer(), M))
+    return llvm::make_error_code(llvm::errc::invalid_argument);
+
+  StringRef FileName = Buffer->getBufferIdentifier();
+  SmallString<128> ChunkDir;
+  if (!llvm::sys::path::is_absolute(M.ChunkDir))
+    ChunkDir = llvm::sys::path::parent_path(FileName);
+  llvm::sys::path::append(ChunkDir, M.ChunkDir);
+
+  // A module file that is a single uncompressed chunk is used in place, so
+  // that it is mapped rather than read, like any other module file.
+  if (M.Chunks.size() == 1) {
+    auto ChunkBuffer = llvm::MemoryBuffer::getFile(
+        getChunkFileName(ChunkDir, M.Chunks[0].first), /*FileSize=*/-1,
+        /*RequiresNullTerminator=*/false);
+    if (!ChunkBuffer)
+      return ChunkBuffer.getError();
+    StringRef Data = (*ChunkBuffer)->getBuffer();
+    if (Data.size() == M.Size + 1 && Data.front() == 'R')
+      return std::unique_ptr<llvm::MemoryBuffer>(
+          new MappedModuleFile(std::move(*ChunkBuffer), FileName));
+  }
+
+  // Otherwise the chunks have to be made contiguous. Each chunk is mapped and
+  // copied, or decompressed, straight to its place in the module file.
+  std::unique_ptr<llvm::WritableMemoryBuffer> Contents =
+      llvm::WritableMemoryBuffer::getNewUninitMemBuffer(M.Size, FileName);
+  if (!Contents)
+    return llvm::make_error_code(llvm::errc::not_enough_memory);
+  char *Out = Contents->getBufferStart();
+  for (const auto &Chunk : M.Chunks) {
+    auto ChunkBuffer =
+        llvm::MemoryBuffer::getFile(getChunkFileName(ChunkDir, Chunk.first),
+                                    /*FileSize=*/-1,
+                                    /*RequiresNullTerminator=*/false);
+    if (!ChunkBuffer)
+      return ChunkBuffer.getError();
+    StringRef Data = (*ChunkBuffer)->getBuffer();
+    if (Data.empty())
+      return llvm::make_error_code(llvm::errc::invalid_argument);
+
+    char Kind = Data.front();
+    Data = Data.drop_front();
+    if (Kind == 'Z') {
+      if (!llvm::zlib::isAvailable())
+        return llvm::make_error_code(llvm::errc::not_supported);
+      size_t Size = Chunk.second;
+      if (llvm::Error E = llvm::zlib::uncompress(Data, Out, Size)) {
+        llvm::consumeError(std::move(E));
+        return llvm::make_error_code(llvm::errc::invalid_argument);
+      }
+      if (Size != Chunk.second)
+        return llvm::make_error_code(llvm::errc::invalid_argument);
+    } else if (Kind == 'R') {
+      if (Data.size() != Chunk.second)
+        return llvm::make_error_code(llvm::errc::invalid_argument);
+      memcpy(Out, Data.data(), Data.size());
+    } else {
+      return llvm::make_error_code(llvm::errc::invalid_argument);
+    }
+    Out += Chunk.second;
+  }
+
+  return std::unique_ptr<llvm::MemoryBuffer>(std::move(Contents));
+}
+
+void ModuleChunkStore::pruneUnusedChunks(StringRef ModuleCachePath,
+                                         time_t CurrentTime,
+                                         time_t GracePeriod) {
+  SmallString<128> ChunkDir(ModuleCachePath);
+  llvm::sys::path::append(ChunkDir, ChunkDirName);
+  if (!llvm::sys::fs::is_directory(ChunkDir))
+    return;
+
+  // Mark the chunks used by the manifests in the module cache.
+  llvm::StringSet<> Used;
+  std::error_code EC;
+  for (llvm::sys::fs::recursive_directory_iterator File(ModuleCachePath, EC),
+       FileEnd;
+       File != FileEnd && !EC; File.increment(EC)) {
+    if (File->path() == ChunkDir) {
+      File.no_push();
+      continue;
+    }
+    if (llvm::sys::path::extension(File->path()) != ".pcm")
+      continue;
+    auto Buffer = llvm::MemoryBuffer::getFile(
+        File->path(), /*FileSize=*/-1, /*RequiresNullTerminator=*/false);
+    Manifest M;
+    if (!Buffer || !parseManifest((*Buffer)->getBuffer(), M))
+      continue;
+    for (const auto &Chunk : M.Chunks)
+      Used.insert(llvm::toHex(Chunk.first) + ChunkExtension);
+  }
+  // Don't remove anything if we could not see all the manifests.
+  if (EC)
+    return;
+
+  // Sweep the others, as well as temporary files left behind by crashes.
+  for (llvm::sys::fs::directory_iterator File(ChunkDir, EC), FileEnd;
+       File != FileEnd && !EC; File.increment(EC)) {
+    StringRef Name = llvm::sys::path::filename(File->path());
+    if (Used.count(Name))
+      continue;
+    llvm::sys::fs::file_status Status;
+    if (llvm::sys::fs::status(File->path(), Status))
+      continue;
+    time_t ModTime = llvm::sys::toTimeT(Status.getLastModificationTime());
+    if (CurrentTime - ModTime > GracePeriod)
+      llvm::sys::fs::remove(File->path());
+  }
+}
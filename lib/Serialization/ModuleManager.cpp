@@ -22,6 +22,7 @@
 #include "clang/Lex/ModuleMap.h"
 #include "clang/Serialization/GlobalModuleIndex.h"
 #include "clang/Serialization/Module.h"
+#include "clang/Serialization/ModuleChunkStore.h"
 #include "llvm/ADT/STLExtras.h"
 #include "llvm/ADT/SetVector.h"
 #include "llvm/ADT/SmallPtrSet.h"
@@ -173,9 +174,21 @@ ModuleManager::addModule(StringRef FileName, ModuleKind Type,
       // ModuleManager it must be the same underlying file.
       // FIXME: Because FileManager::getFile() doesn't guarantee that it will
       // give us an open file, this may not be 100% reliable.
+      //
+      // The bitstream reader doesn't need a null terminator, and asking for
+      // one would force a copy of page-aligned files. Without it, the file is
+      // mapped read-only: only the pages of the blocks we actually read are
+      // faulted in, and they are shared with the other processes using the
+      // same module file. Module files are replaced by renaming, never
+      // rewritten in place, so the mapping stays valid.
       Buf = FileMgr.getBufferForFile(NewModule->File,
                                      /*IsVolatile=*/false,
-                                     /*ShouldClose=*/false);
+                                     /*ShouldClose=*/false,
+                                     /*RequiresNullTerminator=*/false);
+      // A module file of a deduplicated module cache has to be reassembled
+      // from its chunks.
+      if (Buf)
+        Buf = ModuleChunkStore::materialize(std::move(*Buf));
     }
 
     if (!Buf) {
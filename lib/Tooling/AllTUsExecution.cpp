@@ -0,0 +1,206 @@
+//===- lib/Tooling/AllTUsExecution.cpp - Execute actions on all TUs. ------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "clang/Tooling/AllTUsExecution.h"
+#include "clang/Tooling/ToolExecutorPluginRegistry.h"
+#include "llvm/Support/Compiler.h"
+#include "llvm/Support/ThreadPool.h"
+#include "llvm/Support/Threading.h"
+#include <algorithm>
+#include <atomic>
+
+namespace clang {
+namespace tooling {
+
+static llvm::Error make_string_error(const llvm::Twine &Message) {
+  return llvm::make_error<llvm::StringError>(Message,
+                                             llvm::inconvertibleErrorCode());
+}
+
+const char *AllTUsToolExecutor::ExecutorName = "AllTUsToolExecutor";
+
+static ArgumentsAdjuster getDefaultArgumentsAdjusters() {
+  return combineAdjusters(
+      getClangStripOutputAdjuster(),
+      combineAdjusters(getClangSyntaxOnlyAdjuster(),
+                       getClangStripDependencyFileAdjuster()));
+}
+
+/// The index of the translation unit the current worker thread is processing,
+/// or ~0 if the thread is not processing one.
+static LLVM_THREAD_LOCAL size_t CurrentTUIndex = ~size_t(0);
+/// The path of the translation unit the current worker thread is processing.
+static LLVM_THREAD_LOCAL const std::string *CurrentTUPath = nullptr;
+
+namespace {
+/// RAII object that marks the calling thread as processing a translation unit.
+class CurrentTUScope {
+public:
+  CurrentTUScope(size_t Index, const std::string &Path) {
+    CurrentTUIndex = Index;
+    CurrentTUPath = &Path;
+  }
+  ~CurrentTUScope() {
+    CurrentTUIndex = ~size_t(0);
+    CurrentTUPath = nullptr;
+  }
+};
+} // end anonymous namespace
+
+void AllTUsToolResults::reset(size_t NumTUs) {
+  std::lock_guard<std::mutex> Lock(Mutex);
+  PerTUResults.clear();
+  PerTUResults.resize(NumTUs);
+  OtherResults.clear();
+}
+
+void AllTUsToolResults::addResult(StringRef Key, StringRef Value) {
+  std::lock_guard<std::mutex> Lock(Mutex);
+  auto &Bucket = CurrentTUIndex < PerTUResults.size()
+                     ? PerTUResults[CurrentTUIndex]
+                     : OtherResults;
+  Bucket.push_back({Key.str(), Value.str()});
+}
+
+std::vector<std::pair<std::string, std::string>>
+AllTUsToolResults::AllKVResults() {
+  std::lock_guard<std::mutex> Lock(Mutex);
+  std::vector<std::pair<std::string, std::string>> KVs;
+  for (const auto &TUResults : PerTUResults)
+    KVs.insert(KVs.end(), TUResults.begin(), TUResults.end());
+  KVs.insert(KVs.end(), OtherResults.begin(), OtherResults.end());
+  return KVs;
+}
+
+void AllTUsToolResults::forEachResult(
+    llvm::function_ref<void(StringRef Key, StringRef Value)> Callback) {
+  for (const auto &KV : AllKVResults())
+    Callback(KV.first, KV.second);
+}
+
+std::string
+AllTUsToolExecutor::AllTUsExecutionContext::getCurrentCompilationUnit() {
+  return CurrentTUPath ? *CurrentTUPath : std::string();
+}
+
+AllTUsToolExecutor::AllTUsToolExecutor(
+    const CompilationDatabase &Compilations, unsigned ThreadCount,
+    std::shared_ptr<PCHContainerOperations> PCHContainerOps)
+    : Compilations(Compilations), PCHContainerOps(std::move(PCHContainerOps)),
+      Context(&Results), ThreadCount(ThreadCount) {}
+
+AllTUsToolExecutor::AllTUsToolExecutor(
+    CommonOptionsParser Options, unsigned ThreadCount,
+    std::shared_ptr<PCHContainerOperations> PCHContainerOps)
+    : OptionsParser(std::move(Options)),
+      Compilations(OptionsParser->getCompilations()),
+      PCHContainerOps(std::move(PCHContainerOps)), Context(&Results),
+      ThreadCount(ThreadCount) {}
+
+llvm::Error AllTUsToolExecutor::execute(
+    llvm::ArrayRef<
+        std::pair<std::unique_ptr<FrontendActionFactory>, ArgumentsAdjuster>>
+        Actions) {
+  if (Actions.empty())
+    return make_string_error("No action to execute.");
+
+  if (Actions.size() != 1)
+    return make_string_error(
+        "Only support executing exactly 1 action at this point.");
+
+  // Process the files in a stable order so that the merged results do not
+  // depend on the iteration order of the compilation database.
+  std::vector<std::string> Files = Compilations.getAllFiles();
+  std::sort(Files.begin(), Files.end());
+  Files.erase(std::unique(Files.begin(), Files.end()), Files.end());
+  Results.reset(Files.size());
+  // Files may have changed since a previous execution in this process.
+  vfs::SharedFileCache::getGlobal()->invalidate();
+
+  std::string ErrorMsg;
+  std::mutex LogMutex;
+  auto AppendError = [&](const llvm::Twine &Err) {
+    std::lock_guard<std::mutex> Lock(LogMutex);
+    ErrorMsg += Err.str();
+  };
+
+  const std::string TotalNumStr = std::to_string(Files.size());
+  std::atomic<unsigned> Counter(0);
+  auto Log = [&](const llvm::Twine &Msg) {
+    std::lock_guard<std::mutex> Lock(LogMutex);
+    llvm::errs() << Msg.str() << "\n";
+  };
+
+  auto &Action = Actions.front();
+  {
+    llvm::ThreadPool Pool(ThreadCount == 0 ? llvm::hardware_concurrency()
+                                           : ThreadCount);
+    for (size_t I = 0, E = Files.size(); I != E; ++I) {
+      Pool.async([&, I] {
+        const std::string &Path = Files[I];
+        Log("[" + std::to_string(++Counter) + "/" + TotalNumStr +
+            "] Processing file " + Path);
+        CurrentTUScope TUScope(I, Path);
+        // Each translation unit gets its own tool, and therefore its own
+        // FileManager, on top of a physical file system with a private working
+        // directory; ClangTool changes the working directory for every compile
+        // command, which must not leak into other workers.
+        // Status results and file contents are shared between all workers
+        // through the process-wide file cache.
+        ClangTool Tool(Compilations, {Path}, PCHContainerOps,
+                       vfs::createCachingFileSystem(
+                           vfs::createPhysicalFileSystem().release()));
+        Tool.clearArgumentsAdjusters();
+        Tool.appendArgumentsAdjuster(Action.second);
+        Tool.appendArgumentsAdjuster(getDefaultArgumentsAdjusters());
+        for (const auto &FileAndContent : OverlayFiles)
+          Tool.mapVirtualFile(FileAndContent.first(), FileAndContent.second);
+        if (Tool.run(Action.first.get()))
+          AppendError(llvm::Twine("Failed to run action on ") + Path + "\n");
+      });
+    }
+    // Make sure all tasks have finished before the results are read.
+    Pool.wait();
+  }
+
+  if (!ErrorMsg.empty())
+    return make_string_error(ErrorMsg);
+
+  return llvm::Error::success();
+}
+
+static llvm::cl::opt<unsigned> ExecutorConcurrency(
+    "execute-concurrency",
+    llvm::cl::desc("The number of threads used to process all files in "
+                   "parallel. Set to 0 for hardware concurrency."),
+    llvm::cl::init(0));
+
+class AllTUsToolExecutorPlugin : public ToolExecutorPlugin {
+public:
+  llvm::Expected<std::unique_ptr<ToolExecutor>>
+  create(CommonOptionsParser &OptionsParser) override {
+    if (OptionsParser.getSourcePathList().empty())
+      return make_string_error(
+          "[AllTUsToolExecutorPlugin] Please provide a directory/file path in "
+          "the compilation database.");
+    return llvm::make_unique<AllTUsToolExecutor>(std::move(OptionsParser),
+                                                 ExecutorConcurrency);
+  }
+};
+
+static ToolExecutorPluginRegistry::Add<AllTUsToolExecutorPlugin>
+    X("all-TUs", "Runs FrontendActions on all TUs in the compilation database. "
+                 "Translation units are processed in parallel.");
+
+// This anchor is used to force the linker to link in the generated object file
+// and thus register the plugin.
+volatile int AllTUsToolExecutorAnchorSource = 0;
+
+} // end namespace tooling
+} // end namespace clang
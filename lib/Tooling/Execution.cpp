@@ -101,5 +101,11 @@ extern volatile int StandaloneToolExecutorAnchorSource;
 static int LLVM_ATTRIBUTE_UNUSED StandaloneToolExecutorAnchorDest =
     StandaloneToolExecutorAnchorSource;
 
+// This anchor is used to force the linker to link in the generated object file
+// and thus register the AllTUsToolExecutorPlugin.
+extern volatile int AllTUsToolExecutorAnchorSource;
+static int LLVM_ATTRIBUTE_UNUSED AllTUsToolExecutorAnchorDest =
+    AllTUsToolExecutorAnchorSource;
+
 } // end namespace tooling
 } // end namespace clang
@@ -0,0 +1,17 @@
+int global_value;
+int global_other;
+void test(int param) {
+  int local_value;
+  glo
+}
+
+// RUN: %clang_cc1 -fsyntax-only -code-completion-at=%s:5:1 -code-completion-max-results=2 %s -o - | FileCheck -check-prefix=CHECK-MAX %s
+// CHECK-MAX: COMPLETION: local_value : [#int#]local_value
+// CHECK-MAX-NEXT: COMPLETION: param : [#int#]param
+// CHECK-MAX-NOT: COMPLETION:
+
+// RUN: %clang_cc1 -fsyntax-only -code-completion-at=%s:5:6 %s -o - | FileCheck -check-prefix=CHECK-FILTER %s
+// RUN: %clang_cc1 -fsyntax-only -code-completion-at=%s:5:6 -code-completion-max-results=2 %s -o - | FileCheck -check-prefix=CHECK-FILTER %s
+// CHECK-FILTER: COMPLETION: global_other : [#int#]global_other
+// CHECK-FILTER-NEXT: COMPLETION: global_value : [#int#]global_value
+// CHECK-FILTER-NOT: COMPLETION:
@@ -0,0 +1,42 @@
+// RUN: %clang_cc1 -triple x86_64-unknown-linux-gnu -O2 -disable-llvm-verifier -emit-llvm -o %t.serial.ll %s
+// RUN: %clang_cc1 -triple x86_64-unknown-linux-gnu -O2 -disable-llvm-verifier -fpipelined-codegen -emit-llvm -o %t.pipelined.ll %s -Rpipelined-codegen 2> %t.pipelined.txt
+// RUN: diff %t.serial.ll %t.pipelined.ll
+// RUN: FileCheck %s < %t.pipelined.ll
+// RUN: FileCheck --check-prefix=REMARK %s < %t.pipelined.txt
+// RUN: %clang_cc1 -triple x86_64-unknown-linux-gnu -O2 -disable-llvm-verifier -fpipelined-codegen -emit-llvm -o /dev/null %s -Rpipelined-codegen -Rpass=inline 2>&1 | FileCheck --check-prefix=DISABLED %s
+// RUN: %clang_cc1 -triple x86_64-unknown-linux-gnu -O2 -disable-llvm-verifier -fpipelined-codegen -emit-llvm -o /dev/null %s -Rpipelined-codegen -fbackend-threads=2 2>&1 | count 0
+// RUN: %clang_cc1 -triple x86_64-unknown-linux-gnu -O2 -fpipelined-codegen -emit-llvm -o /dev/null %s -Rpipelined-codegen 2>&1 | count 0
+
+// Optimizing the functions as they are generated gives the same module. The
+// pipeline isn't used with remark patterns, whose remarks would be reported
+// while parsing goes on, with -fbackend-threads, whose partitions run the
+// per-function passes again, or while the verifier runs.
+
+struct point { int x, y; };
+
+static struct point scale(struct point p, int k) {
+  struct point r = { p.x * k, p.y * k };
+  return r;
+}
+
+int later(int);
+
+int dot(int a, int b) {
+  struct point p = scale((struct point){ a, b }, 2);
+  return p.x * p.y + later(a);
+}
+
+int later(int a) { return __builtin_expect(a, 0) ? a + 1 : 0; }
+
+// CHECK-LABEL: define i32 @dot(
+// CHECK-NOT: alloca
+// CHECK: ret i32
+// CHECK-LABEL: define i32 @later(
+// CHECK-NOT: llvm.expect
+// CHECK: ret i32
+
+// REMARK: remark: ran the per-function passes on {{[1-9][0-9]*}} functions as they were generated
+
+// DISABLED-NOT: per-function passes
+// DISABLED: remark: {{.*}}scale{{.*}} inlined into {{.*}}dot
+// DISABLED-NOT: per-function passes
@@ -0,0 +1,22 @@
+// RUN: %clang_cc1 -triple x86_64-unknown-linux-gnu -O2 -emit-llvm -o %t.serial.ll %s
+// RUN: %clang_cc1 -triple x86_64-unknown-linux-gnu -O2 -fbackend-threads=4 -emit-llvm -o %t.threads.ll %s
+// RUN: cmp %t.serial.ll %t.threads.ll
+// RUN: FileCheck %s < %t.threads.ll
+// RUN: %clang_cc1 -triple x86_64-unknown-linux-gnu -O2 -fbackend-threads=4 -emit-llvm -o /dev/null %s -Rbackend-threads 2>&1 | count 0
+
+// Every definition refers to the internal counter or calls the always-inline
+// helper, so they all have to be optimized together. The module isn't split,
+// and is optimized as without -fbackend-threads.
+
+static int counter;
+
+__attribute__((always_inline)) int bump(int x) { return counter += x; }
+
+int f1(int x) { return bump(x); }
+int f2(int x) { return bump(x + 1) * 2; }
+int f3(int x) { return counter * x; }
+
+// CHECK: define {{.*}}i32 @_Z4bumpi(
+// CHECK: define {{.*}}i32 @_Z2f1i(
+// CHECK: define {{.*}}i32 @_Z2f2i(
+// CHECK: define {{.*}}i32 @_Z2f3i(
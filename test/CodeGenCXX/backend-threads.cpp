@@ -0,0 +1,38 @@
+// RUN: %clang_cc1 -triple x86_64-unknown-linux-gnu -O2 -fbackend-threads=4 -emit-llvm -o %t.1.ll %s
+// RUN: %clang_cc1 -triple x86_64-unknown-linux-gnu -O2 -fbackend-threads=4 -emit-llvm -o %t.2.ll %s
+// RUN: cmp %t.1.ll %t.2.ll
+// RUN: FileCheck %s < %t.1.ll
+// RUN: FileCheck --check-prefix=NOTWICE %s < %t.1.ll
+// RUN: %clang_cc1 -triple x86_64-unknown-linux-gnu -O2 -fbackend-threads=4 -emit-llvm -o /dev/null %s -Rbackend-threads 2>&1 | FileCheck --check-prefix=REMARK %s
+
+// The partitions are optimized separately, but the result keeps the order of
+// the definitions and refers to the same globals.
+
+asm(".globl backend_threads_marker");
+
+int counter;
+static int init() { return ++counter; }
+int initialized = init();
+
+inline int twice(int x) { return 2 * x; }
+
+int f1(int x) { return twice(x) + counter; }
+int f2(int x) { return twice(x + 1); }
+int f3(int x) { return f1(x) * f2(x); }
+int f4(int x) { counter += x; return f3(x); }
+
+// REMARK: remark: optimized the module as 4 partitions in parallel
+
+// CHECK: module asm ".globl backend_threads_marker"
+// CHECK-NOT: module asm
+// CHECK-DAG: @counter = {{(local_unnamed_addr )?}}global i32
+// CHECK-DAG: @llvm.global_ctors = appending global
+// CHECK: define {{.*}}i32 @_Z2f1i(
+// CHECK: define {{.*}}i32 @_Z2f2i(
+// CHECK: define {{.*}}i32 @_Z2f3i(
+// CHECK: define {{.*}}i32 @_Z2f4i(
+// CHECK: define internal void @_GLOBAL__sub_I_backend_threads.cpp()
+// CHECK: !llvm.ident = !{!{{[0-9]+}}}
+// CHECK-NOT: !llvm.ident
+
+// NOTWICE-NOT: define {{.*}}@_Z5twicei
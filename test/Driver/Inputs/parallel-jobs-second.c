@@ -0,0 +1 @@
+#error second input
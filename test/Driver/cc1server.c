@@ -0,0 +1,25 @@
+// Check that 'clang -cc1' forwards compiles to a running -cc1server, and that
+// the server's socket is private to the user who started it. Starting the
+// server in the background needs a real shell.
+//
+// REQUIRES: shell
+// RUN: rm -rf %t && mkdir -p %t && cd %t
+// RUN: %clang -cc1server -socket s.sock -v > /dev/null 2> server.log & \
+// RUN:   pid=$!; \
+// RUN:   for i in 1 2 3 4 5 6 7 8 9 10; do test -S s.sock && break; sleep 1; done; \
+// RUN:   ls -l s.sock > socket.txt; \
+// RUN:   env CLANG_CC1_SERVER=s.sock %clang_cc1 -emit-llvm %s -o served.ll; \
+// RUN:   status=$?; kill $pid; wait $pid; exit $status
+// RUN: FileCheck --check-prefix=SERVER %s < server.log
+// RUN: FileCheck --check-prefix=SOCKET %s < socket.txt
+// RUN: FileCheck --check-prefix=IR %s < served.ll
+//
+// Without a server, the compile happens in-process.
+// RUN: env CLANG_CC1_SERVER=%t/missing.sock %clang_cc1 -emit-llvm %s -o local.ll
+// RUN: FileCheck --check-prefix=IR %s < local.ll
+
+// SERVER: clang -cc1server: compiled request in '{{.*}}' (exit code 0)
+// SOCKET: {{^}}srw-------
+// IR: define {{.*}}i32 @served(
+
+int served(int x) { return x + 1; }
@@ -0,0 +1,22 @@
+// RUN: %clangxx -S -emit-llvm -ftime-trace -ftime-trace-granularity=0 \
+// RUN:   -o %t.ll %s
+// RUN: FileCheck --input-file=%t.json %s
+
+// CHECK: "traceEvents": [
+// CHECK-DAG: "name": "InstantiateFunction", "args": { "detail": "foo<int>" }
+// CHECK-DAG: "name": "EmitGlobalDefinition", "args": { "detail": "bar" }
+// CHECK-DAG: "name": "Frontend"
+// CHECK-DAG: "name": "Backend"
+// CHECK-DAG: "name": "ExecuteCompiler"
+// CHECK-DAG: "name": "Total InstantiateFunction", "args": { "count": 1,
+// CHECK: "name": "process_name"
+
+// RUN: %clang -### -c -ftime-trace -ftime-trace-granularity=10 %s 2>&1 \
+// RUN:   | FileCheck -check-prefix=DRIVER %s
+// DRIVER: "-cc1"
+// DRIVER-SAME: "-ftime-trace"
+// DRIVER-SAME: "-ftime-trace-granularity=10"
+
+template <typename T> T foo(T t) { return t + 1; }
+
+int bar() { return foo(1); }
@@ -0,0 +1,14 @@
+// Independent compilations may run concurrently, but their diagnostics are
+// still printed in the order of the inputs.
+// RUN: not %clang -parallel-jobs=4 -fsyntax-only %s \
+// RUN:   %S/Inputs/parallel-jobs-second.c 2>&1 | FileCheck %s
+// RUN: not %clang -parallel-jobs=0 -fsyntax-only %s \
+// RUN:   %S/Inputs/parallel-jobs-second.c 2>&1 | FileCheck %s
+// CHECK: parallel-jobs.c:{{[0-9]+}}:2: error: first input
+// CHECK: parallel-jobs-second.c:{{[0-9]+}}:2: error: second input
+
+// RUN: not %clang -parallel-jobs=x -fsyntax-only %s 2>&1 \
+// RUN:   | FileCheck -check-prefix=INVALID %s
+// INVALID: error: invalid integral value 'x' in '-parallel-jobs=x'
+
+#error first input
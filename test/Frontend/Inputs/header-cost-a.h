@@ -0,0 +1,4 @@
+#include "header-cost-b.h"
+
+int a1(void);
+int a2(void);
@@ -0,0 +1,4 @@
+struct B {
+  int x;
+  int y;
+};
@@ -0,0 +1,16 @@
+// RUN: %clang_cc1 -fsyntax-only -I %S/Inputs %s \
+// RUN:   -fheader-cost-report=%t.json
+// RUN: FileCheck --input-file=%t.json %s
+
+#include "header-cost-a.h"
+
+int main(void) { return a1() + a2(); }
+
+// CHECK: "main_file": "{{.*}}header-cost-report.c",
+// CHECK: "files": [
+// The files are sorted by inclusive time, which is larger for the includer.
+// CHECK: "file": "{{.*}}header-cost-a.h", "inclusions": 1,
+// CHECK-NEXT: "self": { "time_ms": {{[0-9.]+}}, "decl_time_ms": {{[0-9.]+}}, "tokens": {{[0-9]+}}, "bytes": 56, "decls": 2 },
+// CHECK-NEXT: "total": { "time_ms": {{[0-9.]+}}, "decl_time_ms": {{[0-9.]+}}, "tokens": {{[0-9]+}}, "bytes": 88, "decls": 5 } }
+// CHECK: "file": "{{.*}}header-cost-b.h", "inclusions": 1,
+// CHECK-NEXT: "self": { "time_ms": {{[0-9.]+}}, "decl_time_ms": {{[0-9.]+}}, "tokens": {{[0-9]+}}, "bytes": 32, "decls": 3 },
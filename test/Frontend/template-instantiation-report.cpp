@@ -0,0 +1,37 @@
+// RUN: %clang_cc1 -std=c++11 -fsyntax-only %s \
+// RUN:   -ftemplate-instantiation-report=%t.txt
+// RUN: FileCheck -check-prefix=TEXT --input-file=%t.txt %s
+// RUN: %clang_cc1 -std=c++11 -fsyntax-only %s \
+// RUN:   -ftemplate-instantiation-report=%t.json \
+// RUN:   -ftemplate-instantiation-report-format=json
+// RUN: FileCheck -check-prefix=JSON --input-file=%t.json %s
+// RUN: not %clang_cc1 -fsyntax-only %s \
+// RUN:   -ftemplate-instantiation-report=%t.txt \
+// RUN:   -ftemplate-instantiation-report-format=xml 2>&1 \
+// RUN:   | FileCheck -check-prefix=INVALID %s
+
+template <int N> struct Fib {
+  static const int Value = Fib<N - 1>::Value + Fib<N - 2>::Value;
+};
+template <> struct Fib<1> { static const int Value = 1; };
+template <> struct Fib<0> { static const int Value = 0; };
+
+template <typename T> T twice(T t) { return t + t; }
+
+int x = Fib<5>::Value + twice(1);
+
+// TEXT: *** Template instantiation report
+// TEXT: *** Templates, by total time
+// TEXT-DAG: Fib
+// TEXT-DAG: twice
+// TEXT: *** Slowest instantiations
+// TEXT-DAG: Fib<5> (instantiation, {{.*}}template-instantiation-report.cpp:21:{{[0-9]+}})
+// TEXT-DAG: twice<int> (instantiation, {{.*}}template-instantiation-report.cpp:21:{{[0-9]+}})
+
+// JSON: "templates": [
+// JSON-DAG: "template": "Fib", "location": "{{.*}}template-instantiation-report.cpp:13:25", "count": 4,
+// JSON: "instantiations": [
+// JSON-DAG: "entity": "Fib<5>", "kind": "instantiation", "template": "Fib", "point_of_instantiation": "{{.*}}template-instantiation-report.cpp:21:{{[0-9]+}}", {{.*}} "nested": 3,
+// JSON-DAG: "entity": "twice", "kind": "deduction", "template": "twice"
+
+// INVALID: error: invalid value 'xml' in '-ftemplate-instantiation-report-format=xml'
@@ -0,0 +1,17 @@
+int global_value;
+int global_other;
+void test(int param) {
+  int local_value;
+  glo
+}
+
+// The limit given on the command line of the translation unit applies to the
+// results of libclang, including the cached global ones.
+// RUN: c-index-test -code-completion-at=%s:5:1 %s -Xclang -code-completion-max-results=2 | FileCheck %s
+// RUN: env CINDEXTEST_EDITING=1 CINDEXTEST_COMPLETION_CACHING=1 c-index-test -code-completion-at=%s:5:1 %s -Xclang -code-completion-max-results=2 | FileCheck %s
+// CHECK: VarDecl:{ResultType int}{TypedText local_value} ({{[0-9]+}})
+// CHECK-NEXT: ParmDecl:{ResultType int}{TypedText param} ({{[0-9]+}})
+// CHECK-NEXT: Completion contexts:
+
+// RUN: c-index-test -code-completion-at=%s:5:1 %s | FileCheck -check-prefix=CHECK-ALL %s
+// CHECK-ALL: VarDecl:{ResultType int}{TypedText global_value} ({{[0-9]+}})
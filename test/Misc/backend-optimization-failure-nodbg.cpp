@@ -1,4 +1,6 @@
 // RUN: %clang_cc1 -triple x86_64-unknown-unknown %s -O3 -emit-llvm -S -verify -o /dev/null
+// RUN: %clang_cc1 -triple x86_64-unknown-unknown %s -O3 -emit-llvm -S -verify -o /dev/null -fbackend-threads=2
+// RUN: %clang_cc1 -triple x86_64-unknown-unknown %s -O3 -emit-llvm -S -Werror -Wno-pass-failed -o /dev/null -fbackend-threads=2
 // REQUIRES: x86-registered-target
 
 // Test verifies optimization failures generated by the backend are handled
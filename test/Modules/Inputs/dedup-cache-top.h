@@ -0,0 +1,404 @@
+#include "Base.h"
+
+// Enough declarations for the module file to be split into several chunks.
+struct top_0 { int a, b; double c; };
+int top_0(struct top_0 *p, int x);
+struct top_1 { int a, b; double c; };
+int top_1(struct top_1 *p, int x);
+struct top_2 { int a, b; double c; };
+int top_2(struct top_2 *p, int x);
+struct top_3 { int a, b; double c; };
+int top_3(struct top_3 *p, int x);
+struct top_4 { int a, b; double c; };
+int top_4(struct top_4 *p, int x);
+struct top_5 { int a, b; double c; };
+int top_5(struct top_5 *p, int x);
+struct top_6 { int a, b; double c; };
+int top_6(struct top_6 *p, int x);
+struct top_7 { int a, b; double c; };
+int top_7(struct top_7 *p, int x);
+struct top_8 { int a, b; double c; };
+int top_8(struct top_8 *p, int x);
+struct top_9 { int a, b; double c; };
+int top_9(struct top_9 *p, int x);
+struct top_10 { int a, b; double c; };
+int top_10(struct top_10 *p, int x);
+struct top_11 { int a, b; double c; };
+int top_11(struct top_11 *p, int x);
+struct top_12 { int a, b; double c; };
+int top_12(struct top_12 *p, int x);
+struct top_13 { int a, b; double c; };
+int top_13(struct top_13 *p, int x);
+struct top_14 { int a, b; double c; };
+int top_14(struct top_14 *p, int x);
+struct top_15 { int a, b; double c; };
+int top_15(struct top_15 *p, int x);
+struct top_16 { int a, b; double c; };
+int top_16(struct top_16 *p, int x);
+struct top_17 { int a, b; double c; };
+int top_17(struct top_17 *p, int x);
+struct top_18 { int a, b; double c; };
+int top_18(struct top_18 *p, int x);
+struct top_19 { int a, b; double c; };
+int top_19(struct top_19 *p, int x);
+struct top_20 { int a, b; double c; };
+int top_20(struct top_20 *p, int x);
+struct top_21 { int a, b; double c; };
+int top_21(struct top_21 *p, int x);
+struct top_22 { int a, b; double c; };
+int top_22(struct top_22 *p, int x);
+struct top_23 { int a, b; double c; };
+int top_23(struct top_23 *p, int x);
+struct top_24 { int a, b; double c; };
+int top_24(struct top_24 *p, int x);
+struct top_25 { int a, b; double c; };
+int top_25(struct top_25 *p, int x);
+struct top_26 { int a, b; double c; };
+int top_26(struct top_26 *p, int x);
+struct top_27 { int a, b; double c; };
+int top_27(struct top_27 *p, int x);
+struct top_28 { int a, b; double c; };
+int top_28(struct top_28 *p, int x);
+struct top_29 { int a, b; double c; };
+int top_29(struct top_29 *p, int x);
+struct top_30 { int a, b; double c; };
+int top_30(struct top_30 *p, int x);
+struct top_31 { int a, b; double c; };
+int top_31(struct top_31 *p, int x);
+struct top_32 { int a, b; double c; };
+int top_32(struct top_32 *p, int x);
+struct top_33 { int a, b; double c; };
+int top_33(struct top_33 *p, int x);
+struct top_34 { int a, b; double c; };
+int top_34(struct top_34 *p, int x);
+struct top_35 { int a, b; double c; };
+int top_35(struct top_35 *p, int x);
+struct top_36 { int a, b; double c; };
+int top_36(struct top_36 *p, int x);
+struct top_37 { int a, b; double c; };
+int top_37(struct top_37 *p, int x);
+struct top_38 { int a, b; double c; };
+int top_38(struct top_38 *p, int x);
+struct top_39 { int a, b; double c; };
+int top_39(struct top_39 *p, int x);
+struct top_40 { int a, b; double c; };
+int top_40(struct top_40 *p, int x);
+struct top_41 { int a, b; double c; };
+int top_41(struct top_41 *p, int x);
+struct top_42 { int a, b; double c; };
+int top_42(struct top_42 *p, int x);
+struct top_43 { int a, b; double c; };
+int top_43(struct top_43 *p, int x);
+struct top_44 { int a, b; double c; };
+int top_44(struct top_44 *p, int x);
+struct top_45 { int a, b; double c; };
+int top_45(struct top_45 *p, int x);
+struct top_46 { int a, b; double c; };
+int top_46(struct top_46 *p, int x);
+struct top_47 { int a, b; double c; };
+int top_47(struct top_47 *p, int x);
+struct top_48 { int a, b; double c; };
+int top_48(struct top_48 *p, int x);
+struct top_49 { int a, b; double c; };
+int top_49(struct top_49 *p, int x);
+struct top_50 { int a, b; double c; };
+int top_50(struct top_50 *p, int x);
+struct top_51 { int a, b; double c; };
+int top_51(struct top_51 *p, int x);
+struct top_52 { int a, b; double c; };
+int top_52(struct top_52 *p, int x);
+struct top_53 { int a, b; double c; };
+int top_53(struct top_53 *p, int x);
+struct top_54 { int a, b; double c; };
+int top_54(struct top_54 *p, int x);
+struct top_55 { int a, b; double c; };
+int top_55(struct top_55 *p, int x);
+struct top_56 { int a, b; double c; };
+int top_56(struct top_56 *p, int x);
+struct top_57 { int a, b; double c; };
+int top_57(struct top_57 *p, int x);
+struct top_58 { int a, b; double c; };
+int top_58(struct top_58 *p, int x);
+struct top_59 { int a, b; double c; };
+int top_59(struct top_59 *p, int x);
+struct top_60 { int a, b; double c; };
+int top_60(struct top_60 *p, int x);
+struct top_61 { int a, b; double c; };
+int top_61(struct top_61 *p, int x);
+struct top_62 { int a, b; double c; };
+int top_62(struct top_62 *p, int x);
+struct top_63 { int a, b; double c; };
+int top_63(struct top_63 *p, int x);
+struct top_64 { int a, b; double c; };
+int top_64(struct top_64 *p, int x);
+struct top_65 { int a, b; double c; };
+int top_65(struct top_65 *p, int x);
+struct top_66 { int a, b; double c; };
+int top_66(struct top_66 *p, int x);
+struct top_67 { int a, b; double c; };
+int top_67(struct top_67 *p, int x);
+struct top_68 { int a, b; double c; };
+int top_68(struct top_68 *p, int x);
+struct top_69 { int a, b; double c; };
+int top_69(struct top_69 *p, int x);
+struct top_70 { int a, b; double c; };
+int top_70(struct top_70 *p, int x);
+struct top_71 { int a, b; double c; };
+int top_71(struct top_71 *p, int x);
+struct top_72 { int a, b; double c; };
+int top_72(struct top_72 *p, int x);
+struct top_73 { int a, b; double c; };
+int top_73(struct top_73 *p, int x);
+struct top_74 { int a, b; double c; };
+int top_74(struct top_74 *p, int x);
+struct top_75 { int a, b; double c; };
+int top_75(struct top_75 *p, int x);
+struct top_76 { int a, b; double c; };
+int top_76(struct top_76 *p, int x);
+struct top_77 { int a, b; double c; };
+int top_77(struct top_77 *p, int x);
+struct top_78 { int a, b; double c; };
+int top_78(struct top_78 *p, int x);
+struct top_79 { int a, b; double c; };
+int top_79(struct top_79 *p, int x);
+struct top_80 { int a, b; double c; };
+int top_80(struct top_80 *p, int x);
+struct top_81 { int a, b; double c; };
+int top_81(struct top_81 *p, int x);
+struct top_82 { int a, b; double c; };
+int top_82(struct top_82 *p, int x);
+struct top_83 { int a, b; double c; };
+int top_83(struct top_83 *p, int x);
+struct top_84 { int a, b; double c; };
+int top_84(struct top_84 *p, int x);
+struct top_85 { int a, b; double c; };
+int top_85(struct top_85 *p, int x);
+struct top_86 { int a, b; double c; };
+int top_86(struct top_86 *p, int x);
+struct top_87 { int a, b; double c; };
+int top_87(struct top_87 *p, int x);
+struct top_88 { int a, b; double c; };
+int top_88(struct top_88 *p, int x);
+struct top_89 { int a, b; double c; };
+int top_89(struct top_89 *p, int x);
+struct top_90 { int a, b; double c; };
+int top_90(struct top_90 *p, int x);
+struct top_91 { int a, b; double c; };
+int top_91(struct top_91 *p, int x);
+struct top_92 { int a, b; double c; };
+int top_92(struct top_92 *p, int x);
+struct top_93 { int a, b; double c; };
+int top_93(struct top_93 *p, int x);
+struct top_94 { int a, b; double c; };
+int top_94(struct top_94 *p, int x);
+struct top_95 { int a, b; double c; };
+int top_95(struct top_95 *p, int x);
+struct top_96 { int a, b; double c; };
+int top_96(struct top_96 *p, int x);
+struct top_97 { int a, b; double c; };
+int top_97(struct top_97 *p, int x);
+struct top_98 { int a, b; double c; };
+int top_98(struct top_98 *p, int x);
+struct top_99 { int a, b; double c; };
+int top_99(struct top_99 *p, int x);
+struct top_100 { int a, b; double c; };
+int top_100(struct top_100 *p, int x);
+struct top_101 { int a, b; double c; };
+int top_101(struct top_101 *p, int x);
+struct top_102 { int a, b; double c; };
+int top_102(struct top_102 *p, int x);
+struct top_103 { int a, b; double c; };
+int top_103(struct top_103 *p, int x);
+struct top_104 { int a, b; double c; };
+int top_104(struct top_104 *p, int x);
+struct top_105 { int a, b; double c; };
+int top_105(struct top_105 *p, int x);
+struct top_106 { int a, b; double c; };
+int top_106(struct top_106 *p, int x);
+struct top_107 { int a, b; double c; };
+int top_107(struct top_107 *p, int x);
+struct top_108 { int a, b; double c; };
+int top_108(struct top_108 *p, int x);
+struct top_109 { int a, b; double c; };
+int top_109(struct top_109 *p, int x);
+struct top_110 { int a, b; double c; };
+int top_110(struct top_110 *p, int x);
+struct top_111 { int a, b; double c; };
+int top_111(struct top_111 *p, int x);
+struct top_112 { int a, b; double c; };
+int top_112(struct top_112 *p, int x);
+struct top_113 { int a, b; double c; };
+int top_113(struct top_113 *p, int x);
+struct top_114 { int a, b; double c; };
+int top_114(struct top_114 *p, int x);
+struct top_115 { int a, b; double c; };
+int top_115(struct top_115 *p, int x);
+struct top_116 { int a, b; double c; };
+int top_116(struct top_116 *p, int x);
+struct top_117 { int a, b; double c; };
+int top_117(struct top_117 *p, int x);
+struct top_118 { int a, b; double c; };
+int top_118(struct top_118 *p, int x);
+struct top_119 { int a, b; double c; };
+int top_119(struct top_119 *p, int x);
+struct top_120 { int a, b; double c; };
+int top_120(struct top_120 *p, int x);
+struct top_121 { int a, b; double c; };
+int top_121(struct top_121 *p, int x);
+struct top_122 { int a, b; double c; };
+int top_122(struct top_122 *p, int x);
+struct top_123 { int a, b; double c; };
+int top_123(struct top_123 *p, int x);
+struct top_124 { int a, b; double c; };
+int top_124(struct top_124 *p, int x);
+struct top_125 { int a, b; double c; };
+int top_125(struct top_125 *p, int x);
+struct top_126 { int a, b; double c; };
+int top_126(struct top_126 *p, int x);
+struct top_127 { int a, b; double c; };
+int top_127(struct top_127 *p, int x);
+struct top_128 { int a, b; double c; };
+int top_128(struct top_128 *p, int x);
+struct top_129 { int a, b; double c; };
+int top_129(struct top_129 *p, int x);
+struct top_130 { int a, b; double c; };
+int top_130(struct top_130 *p, int x);
+struct top_131 { int a, b; double c; };
+int top_131(struct top_131 *p, int x);
+struct top_132 { int a, b; double c; };
+int top_132(struct top_132 *p, int x);
+struct top_133 { int a, b; double c; };
+int top_133(struct top_133 *p, int x);
+struct top_134 { int a, b; double c; };
+int top_134(struct top_134 *p, int x);
+struct top_135 { int a, b; double c; };
+int top_135(struct top_135 *p, int x);
+struct top_136 { int a, b; double c; };
+int top_136(struct top_136 *p, int x);
+struct top_137 { int a, b; double c; };
+int top_137(struct top_137 *p, int x);
+struct top_138 { int a, b; double c; };
+int top_138(struct top_138 *p, int x);
+struct top_139 { int a, b; double c; };
+int top_139(struct top_139 *p, int x);
+struct top_140 { int a, b; double c; };
+int top_140(struct top_140 *p, int x);
+struct top_141 { int a, b; double c; };
+int top_141(struct top_141 *p, int x);
+struct top_142 { int a, b; double c; };
+int top_142(struct top_142 *p, int x);
+struct top_143 { int a, b; double c; };
+int top_143(struct top_143 *p, int x);
+struct top_144 { int a, b; double c; };
+int top_144(struct top_144 *p, int x);
+struct top_145 { int a, b; double c; };
+int top_145(struct top_145 *p, int x);
+struct top_146 { int a, b; double c; };
+int top_146(struct top_146 *p, int x);
+struct top_147 { int a, b; double c; };
+int top_147(struct top_147 *p, int x);
+struct top_148 { int a, b; double c; };
+int top_148(struct top_148 *p, int x);
+struct top_149 { int a, b; double c; };
+int top_149(struct top_149 *p, int x);
+struct top_150 { int a, b; double c; };
+int top_150(struct top_150 *p, int x);
+struct top_151 { int a, b; double c; };
+int top_151(struct top_151 *p, int x);
+struct top_152 { int a, b; double c; };
+int top_152(struct top_152 *p, int x);
+struct top_153 { int a, b; double c; };
+int top_153(struct top_153 *p, int x);
+struct top_154 { int a, b; double c; };
+int top_154(struct top_154 *p, int x);
+struct top_155 { int a, b; double c; };
+int top_155(struct top_155 *p, int x);
+struct top_156 { int a, b; double c; };
+int top_156(struct top_156 *p, int x);
+struct top_157 { int a, b; double c; };
+int top_157(struct top_157 *p, int x);
+struct top_158 { int a, b; double c; };
+int top_158(struct top_158 *p, int x);
+struct top_159 { int a, b; double c; };
+int top_159(struct top_159 *p, int x);
+struct top_160 { int a, b; double c; };
+int top_160(struct top_160 *p, int x);
+struct top_161 { int a, b; double c; };
+int top_161(struct top_161 *p, int x);
+struct top_162 { int a, b; double c; };
+int top_162(struct top_162 *p, int x);
+struct top_163 { int a, b; double c; };
+int top_163(struct top_163 *p, int x);
+struct top_164 { int a, b; double c; };
+int top_164(struct top_164 *p, int x);
+struct top_165 { int a, b; double c; };
+int top_165(struct top_165 *p, int x);
+struct top_166 { int a, b; double c; };
+int top_166(struct top_166 *p, int x);
+struct top_167 { int a, b; double c; };
+int top_167(struct top_167 *p, int x);
+struct top_168 { int a, b; double c; };
+int top_168(struct top_168 *p, int x);
+struct top_169 { int a, b; double c; };
+int top_169(struct top_169 *p, int x);
+struct top_170 { int a, b; double c; };
+int top_170(struct top_170 *p, int x);
+struct top_171 { int a, b; double c; };
+int top_171(struct top_171 *p, int x);
+struct top_172 { int a, b; double c; };
+int top_172(struct top_172 *p, int x);
+struct top_173 { int a, b; double c; };
+int top_173(struct top_173 *p, int x);
+struct top_174 { int a, b; double c; };
+int top_174(struct top_174 *p, int x);
+struct top_175 { int a, b; double c; };
+int top_175(struct top_175 *p, int x);
+struct top_176 { int a, b; double c; };
+int top_176(struct top_176 *p, int x);
+struct top_177 { int a, b; double c; };
+int top_177(struct top_177 *p, int x);
+struct top_178 { int a, b; double c; };
+int top_178(struct top_178 *p, int x);
+struct top_179 { int a, b; double c; };
+int top_179(struct top_179 *p, int x);
+struct top_180 { int a, b; double c; };
+int top_180(struct top_180 *p, int x);
+struct top_181 { int a, b; double c; };
+int top_181(struct top_181 *p, int x);
+struct top_182 { int a, b; double c; };
+int top_182(struct top_182 *p, int x);
+struct top_183 { int a, b; double c; };
+int top_183(struct top_183 *p, int x);
+struct top_184 { int a, b; double c; };
+int top_184(struct top_184 *p, int x);
+struct top_185 { int a, b; double c; };
+int top_185(struct top_185 *p, int x);
+struct top_186 { int a, b; double c; };
+int top_186(struct top_186 *p, int x);
+struct top_187 { int a, b; double c; };
+int top_187(struct top_187 *p, int x);
+struct top_188 { int a, b; double c; };
+int top_188(struct top_188 *p, int x);
+struct top_189 { int a, b; double c; };
+int top_189(struct top_189 *p, int x);
+struct top_190 { int a, b; double c; };
+int top_190(struct top_190 *p, int x);
+struct top_191 { int a, b; double c; };
+int top_191(struct top_191 *p, int x);
+struct top_192 { int a, b; double c; };
+int top_192(struct top_192 *p, int x);
+struct top_193 { int a, b; double c; };
+int top_193(struct top_193 *p, int x);
+struct top_194 { int a, b; double c; };
+int top_194(struct top_194 *p, int x);
+struct top_195 { int a, b; double c; };
+int top_195(struct top_195 *p, int x);
+struct top_196 { int a, b; double c; };
+int top_196(struct top_196 *p, int x);
+struct top_197 { int a, b; double c; };
+int top_197(struct top_197 *p, int x);
+struct top_198 { int a, b; double c; };
+int top_198(struct top_198 *p, int x);
+struct top_199 { int a, b; double c; };
+int top_199(struct top_199 *p, int x);
+int top(void);
@@ -0,0 +1,19 @@
+// RUN: rm -rf %t
+// RUN: mkdir %t
+// RUN: echo '#include "N.h"' > %t/M.h
+// RUN: echo '#include "D.h"' > %t/N.h
+// RUN: echo '#include "M.h"' > %t/D.h
+// RUN: echo 'module M { header "M.h" }' > %t/module.modulemap
+// RUN: echo 'module N { header "N.h" use D }' >> %t/module.modulemap
+// RUN: echo 'module D { header "D.h" }' >> %t/module.modulemap
+
+// While M is being built, D is prebuilt on another thread as a dependency of
+// N. D imports M without declaring it, so the thread building D must not wait
+// for M, whose builder is waiting for D. The cycle is diagnosed instead.
+// RUN: not %clang_cc1 -fmodules -fimplicit-module-maps \
+// RUN:                -fmodules-cache-path=%t/cache -fmodules-build-threads=2 \
+// RUN:                -fsyntax-only %s -I %t 2>&1 | FileCheck %s
+
+@import M;
+
+// CHECK: cyclic dependency in module
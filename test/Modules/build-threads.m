@@ -0,0 +1,33 @@
+// RUN: rm -rf %t
+// RUN: mkdir %t
+// RUN: echo 'int base(void);' > %t/Base.h
+// RUN: echo '#include "Base.h"' > %t/Left.h
+// RUN: echo '#include "Base.h"' > %t/Right.h
+// RUN: echo '#include "Left.h"' > %t/Top.h
+// RUN: echo '#include "Right.h"' >> %t/Top.h
+// RUN: echo 'module Base { header "Base.h" }' > %t/module.modulemap
+// RUN: echo 'module Left { header "Left.h" use Base export Base }' >> %t/module.modulemap
+// RUN: echo 'module Right { header "Right.h" use Base }' >> %t/module.modulemap
+// RUN: echo 'module Top { header "Top.h" use Left use Right export Left }' >> %t/module.modulemap
+
+// The modules Top depends on are built before Top itself, and only once.
+// RUN: %clang_cc1 -fmodules -fimplicit-module-maps -fmodules-cache-path=%t/cache \
+// RUN:            -fmodules-build-threads=4 -fsyntax-only %s -I %t -Rmodule-build \
+// RUN:            2>&1 | FileCheck %s
+
+// RUN: %clang_cc1 -fmodules -fimplicit-module-maps -fmodules-cache-path=%t/cache \
+// RUN:            -fmodules-build-threads=4 -fsyntax-only %s -I %t -Rmodule-build \
+// RUN:            2>&1 | FileCheck -allow-empty -check-prefix=CACHED %s
+
+@import Top;
+
+int f(void) { return base(); }
+
+// CHECK-DAG: building module 'Base'
+// CHECK-DAG: building module 'Left'
+// CHECK-DAG: building module 'Right'
+// CHECK: building module 'Top'
+// CHECK-NOT: building module
+// CHECK: finished building module 'Top'
+
+// CACHED-NOT: building module
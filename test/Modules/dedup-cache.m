@@ -0,0 +1,41 @@
+// RUN: rm -rf %t
+// RUN: mkdir %t
+// RUN: echo 'int base(void);' > %t/Base.h
+// RUN: cp %S/Inputs/dedup-cache-top.h %t/Top.h
+// RUN: echo 'module Base { header "Base.h" }' > %t/module.modulemap
+// RUN: echo 'module Top { header "Top.h" export * }' >> %t/module.modulemap
+
+// Build the modules in two configurations that share most of their contents.
+// The module files of the second configuration reuse the chunks of the first.
+// RUN: %clang_cc1 -fmodules -fimplicit-module-maps -fmodules-cache-path=%t/cache \
+// RUN:            -fmodules-dedup-cache -fsyntax-only %s -I %t -DCONFIG=1 \
+// RUN:            -Rmodule-build 2>&1 | FileCheck -check-prefix=STORED %s
+// RUN: %clang_cc1 -fmodules -fimplicit-module-maps -fmodules-cache-path=%t/cache \
+// RUN:            -fmodules-dedup-cache -fsyntax-only %s -I %t -DCONFIG=2 \
+// RUN:            -Rmodule-build 2>&1 | FileCheck -check-prefix=SHARED %s
+// STORED: remark: stored module 'Top' as {{[0-9]+}} chunks, 0 of them already in the module cache
+// SHARED: remark: stored module 'Top' as {{[0-9]+}} chunks, {{[1-9][0-9]*}} of them already in the module cache
+
+// The module files are manifests, and their chunks are in the chunk store.
+// RUN: find %t/cache -name 'Top-*.pcm' | count 2
+// RUN: cat %t/cache/*/Top-*.pcm | FileCheck -check-prefix=MANIFEST %s
+// RUN: ls %t/cache/chunks | FileCheck -check-prefix=CHUNKS %s
+// MANIFEST: CLANGCHK
+// CHUNKS: {{[0-9A-F]+}}.chunk
+
+// They are loaded from the cache without being rebuilt.
+// RUN: %clang_cc1 -fmodules -fimplicit-module-maps -fmodules-cache-path=%t/cache \
+// RUN:            -fmodules-dedup-cache -fsyntax-only %s -I %t -DCONFIG=1 \
+// RUN:            -Rmodule-build 2>&1 | FileCheck -allow-empty -check-prefix=CACHED %s
+// CACHED-NOT: building module
+
+// Module files whose chunks are gone are rebuilt.
+// RUN: rm -rf %t/cache/chunks
+// RUN: %clang_cc1 -fmodules -fimplicit-module-maps -fmodules-cache-path=%t/cache \
+// RUN:            -fmodules-dedup-cache -fsyntax-only %s -I %t -DCONFIG=1 \
+// RUN:            -Rmodule-build 2>&1 | FileCheck -check-prefix=REBUILT %s
+// REBUILT: building module 'Top'
+
+@import Top;
+
+int f(void) { return base() + top() + CONFIG; }
@@ -0,0 +1,29 @@
+// RUN: rm -rf %t
+// RUN: mkdir %t
+// RUN: echo '@interface First - (void)first; + (id)make:(int)x with:(int)y; @end' > %t/First.h
+// RUN: echo '@interface Second - (void)second; @end' > %t/Second.h
+// RUN: echo 'module First { header "First.h" }' > %t/module.modulemap
+// RUN: echo 'module Second { header "Second.h" }' >> %t/module.modulemap
+
+// Build the modules and the global module index.
+// RUN: %clang_cc1 -fmodules -fimplicit-module-maps -fmodules-cache-path=%t/cache \
+// RUN:            -fdisable-module-hash -fsyntax-only -I %t %s -verify
+// RUN: llvm-bcanalyzer -dump %t/cache/modules.idx | FileCheck -check-prefix=INDEX %s
+// INDEX: <SELECTOR_INDEX
+
+// Method pool lookups go through the selector index.
+// RUN: %clang_cc1 -fmodules -fimplicit-module-maps -fmodules-cache-path=%t/cache \
+// RUN:            -fdisable-module-hash -fsyntax-only -I %t %s -verify \
+// RUN:            -print-stats 2>&1 | FileCheck %s
+// CHECK: *** Global Module Index Statistics:
+// CHECK: selector lookups succeeded
+
+// expected-no-diagnostics
+@import First;
+@import Second;
+
+void f(id obj) {
+  [obj first];
+  [obj second];
+  [obj make:1 with:2];
+}
@@ -0,0 +1,22 @@
+// RUN: rm -rf %t
+// RUN: mkdir %t
+// RUN: echo 'int a(void);' > %t/a.h
+// RUN: echo 'int b(void);' > %t/b.h
+// RUN: echo 'int c(void);' > %t/c.h
+// RUN: echo 'module M { header "a.h" header "b.h" header "c.h" }' > %t/module.modulemap
+
+// Writing the module file with several threads gives the same module file.
+// RUN: %clang_cc1 -fmodules -emit-module -fmodule-name=M -x objective-c \
+// RUN:            -fmodules-embed-all-files %t/module.modulemap -o %t/serial.pcm
+// RUN: %clang_cc1 -fmodules -emit-module -fmodule-name=M -x objective-c \
+// RUN:            -fmodules-embed-all-files %t/module.modulemap -o %t/parallel.pcm \
+// RUN:            -fserialization-threads=4
+// RUN: cmp %t/serial.pcm %t/parallel.pcm
+
+// RUN: rm %t/a.h %t/b.h %t/c.h
+// RUN: %clang_cc1 -fmodules -fmodule-file=%t/parallel.pcm -fsyntax-only %s -verify
+
+// expected-no-diagnostics
+@import M;
+
+int f(void) { return a() + b() + c(); }
@@ -0,0 +1,2 @@
+#define SHARE_INCLUDE_GUARDS_H
+#include "share-include-guards.h"
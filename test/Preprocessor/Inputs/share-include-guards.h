@@ -0,0 +1,4 @@
+#ifndef SHARE_INCLUDE_GUARDS_H
+#define SHARE_INCLUDE_GUARDS_H
+int share_include_guards;
+#endif
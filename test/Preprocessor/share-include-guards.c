@@ -0,0 +1,31 @@
+// The second translation unit preprocessed by the process has already
+// defined the guard of the header when it includes it for the first time.
+// With -fshare-include-guards it skips the header without entering it,
+// using the guard recorded while preprocessing the first translation unit,
+// but the header must still show up in -H and -MD output.
+//
+// RUN: %clang_cc1 -fsyntax-only -fshare-include-guards -I %S/Inputs \
+// RUN:   -print-stats -H -dependency-file %t.d -MT out.o \
+// RUN:   %s %S/Inputs/share-include-guards-defined.c 2>&1 \
+// RUN:   | FileCheck --check-prefix=SHARED %s
+// RUN: FileCheck --check-prefix=DEPS %s < %t.d
+//
+// RUN: %clang_cc1 -fsyntax-only -I %S/Inputs -print-stats -H \
+// RUN:   %s %S/Inputs/share-include-guards-defined.c 2>&1 \
+// RUN:   | FileCheck --check-prefix=UNSHARED %s
+
+#include "share-include-guards.h"
+
+// SHARED: . {{.*}}share-include-guards.h
+// SHARED: 0 of them using the include guard cache.
+// SHARED: . {{.*}}share-include-guards.h
+// SHARED: 1 of them using the include guard cache.
+
+// DEPS: out.o:
+// DEPS-SAME: share-include-guards-defined.c
+// DEPS-NEXT: share-include-guards.h
+
+// UNSHARED: . {{.*}}share-include-guards.h
+// UNSHARED: 0 of them using the include guard cache.
+// UNSHARED: . {{.*}}share-include-guards.h
+// UNSHARED: 0 of them using the include guard cache.
@@ -0,0 +1,74 @@
+// RUN: %clang_cc1 -std=c++14 -fsyntax-only -verify %s
+// RUN: %clang_cc1 -std=c++14 -fsyntax-only -verify %s -fconstexpr-bytecode
+// RUN: %clang_cc1 -std=c++14 -fsyntax-only -verify %s -fconstexpr-bytecode-verify
+// RUN: %clang -std=c++14 -fsyntax-only -Xclang -verify %s -fconstexpr-bytecode
+
+// Calls evaluated from bytecode must have the same results, and the same
+// diagnostics, as calls evaluated from the AST.
+
+constexpr int fib(int n) { return n < 2 ? n : fib(n - 1) + fib(n - 2); }
+static_assert(fib(20) == 6765, "");
+
+constexpr unsigned gcd(unsigned a, unsigned b) {
+  while (b) {
+    unsigned t = a % b;
+    a = b;
+    b = t;
+  }
+  return a;
+}
+static_assert(gcd(1071, 462) == 21, "");
+
+constexpr long sum(int n) {
+  long s = 0;
+  for (int i = 0; i != n; ++i) {
+    if (i % 3 == 0)
+      continue;
+    if (i > 100)
+      break;
+    s += i;
+  }
+  return s;
+}
+static_assert(sum(10) == 27, "");
+static_assert(sum(1000) == 3367, "");
+
+constexpr unsigned char wrap(unsigned char c) {
+  c += 200;
+  c <<= 1;
+  unsigned char d = c++;
+  return d * 2 + ~c;
+}
+static_assert(wrap(100) == 86, "");
+
+constexpr bool all(int a, int b) { return a && b && !(a == b); }
+static_assert(all(1, 2) && !all(1, 1) && !all(0, 1), "");
+
+enum E { A = 3, B = 5 };
+constexpr int k = 7;
+constexpr int enums(E e) {
+  int n = 0;
+  do
+    n += e * k;
+  while (n < 100);
+  return n;
+}
+static_assert(enums(B) == 105, "");
+
+constexpr int twice(int n) {
+  return n * 2; // expected-note {{value 4294967294 is outside the range of representable values of type 'int'}}
+}
+constexpr int overflow = twice(2147483647); // expected-error {{must be initialized by a constant expression}} expected-note {{in call to 'twice(2147483647)'}}
+
+constexpr int quotient(int a, int b) {
+  return a / b; // expected-note {{division by zero}}
+}
+constexpr int q = quotient(1, 0); // expected-error {{must be initialized by a constant expression}} expected-note {{in call to 'quotient(1, 0)'}}
+
+// Reading a variable in a branch that isn't taken must not disturb the
+// variable, even while its own initializer is being evaluated.
+struct S { static const int k; };
+constexpr int pick(int n) { return n ? S::k : 1; }
+const int S::k = pick(0);
+static_assert(S::k == 1, "");
+static_assert(pick(1) == 1, "");
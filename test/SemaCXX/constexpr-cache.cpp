@@ -0,0 +1,80 @@
+// RUN: %clang_cc1 -std=c++14 -fsyntax-only -verify %s -fconstexpr-steps 1000
+// RUN: %clang_cc1 -std=c++14 -fsyntax-only -verify %s -fconstexpr-steps 1000 -fconstexpr-cache-size 64
+// RUN: %clang_cc1 -std=c++14 -fsyntax-only -verify %s -fconstexpr-steps 1000 -fconstexpr-cache-size 1
+// RUN: %clang -std=c++14 -fsyntax-only -Xclang -verify %s -fconstexpr-steps=1000 -fconstexpr-cache-size=64
+// RUN: %clang_cc1 -std=c++14 -fsyntax-only %s -fconstexpr-steps 1000 -fconstexpr-cache-size 64 -print-stats 2>&1 | FileCheck %s
+
+// Cached calls must produce the same results, and the same diagnostics, as
+// calls which are evaluated again.
+
+template<typename T, T V> struct integral_constant { static constexpr T value = V; };
+
+constexpr int square(int n) { return n * n; }
+static_assert(integral_constant<int, square(12)>::value == 144, "");
+static_assert(integral_constant<int, square(12) + square(12)>::value == 288, "");
+
+struct Pair { int a, b; };
+constexpr Pair swap(Pair p) {
+  int t = p.a;
+  p.a = p.b;
+  p.b = t;
+  return p;
+}
+constexpr Pair p1 = swap({1, 2});
+constexpr Pair p2 = swap({1, 2});
+static_assert(p1.a == 2 && p2.a == 2 && p2.b == 1, "");
+
+// The parameter is modified by the call, but the result is keyed on the
+// argument.
+constexpr int countdown(int n) {
+  while (n > 10)
+    --n;
+  return n;
+}
+static_assert(countdown(20) == 10, "");
+static_assert(countdown(20) == 10, "");
+
+// Calls whose arguments refer to objects aren't cached.
+constexpr int increment(int &n) { return ++n; }
+constexpr int twice() {
+  int n = 0;
+  increment(n);
+  return increment(n);
+}
+static_assert(twice() == 2, "");
+
+// Reused calls still count against the step limit.
+constexpr bool steps(int n) {
+  for (int k = 0; k != n; ++k) {} // expected-note {{step limit}}
+  return true;
+}
+static_assert(steps(400), "");
+static_assert(steps(400) && steps(400), "");
+static_assert(steps(400) && steps(400) && steps(400), ""); // expected-error {{constant}} expected-note {{call}}
+
+// Calls which overflow aren't cached.
+constexpr int add(int a, int b) {
+  return a + b; // expected-note 2{{value 4294967294 is outside the range}}
+}
+constexpr int sum1 = add(2147483647, 2147483647); // expected-error {{constant expression}} expected-note {{in call to 'add(2147483647, 2147483647)'}}
+constexpr int sum2 = add(2147483647, 2147483647); // expected-error {{constant expression}} expected-note {{in call to 'add(2147483647, 2147483647)'}}
+
+// Calls which read the object being initialized, which may have changed since
+// the last call, aren't cached, and neither are the calls around them.
+template<typename T> constexpr int peek() { return T::s.n; }
+template<typename T> constexpr int peekTwice() { return peek<T>() * 10; }
+struct Peeked;
+struct Peeker { static const Peeked s; };
+struct Peeked {
+  int n = 1;
+  int a, b, c, d;
+  constexpr Peeked()
+      : a(peek<Peeker>()), b((n = 2, peek<Peeker>())), c(peekTwice<Peeker>()),
+        d((n = 3, peekTwice<Peeker>())) {}
+};
+constexpr Peeked Peeker::s;
+static_assert(Peeker::s.a == 1 && Peeker::s.b == 2, "");
+static_assert(Peeker::s.c == 20 && Peeker::s.d == 30, "");
+
+// CHECK: *** Constexpr Call Cache Stats:
+// CHECK: {{[1-9][0-9]*}} hits, {{[0-9]+}} misses, 0 evictions.
@@ -0,0 +1,28 @@
+// RUN: %clang_cc1 -fsyntax-only -verify -std=c++11 -fcache-template-deduction %s
+// RUN: %clang_cc1 -fsyntax-only -std=c++11 -fcache-template-deduction -print-stats %s 2>&1 | FileCheck %s
+
+template<typename T> T id(T t) { return t; }
+template<typename T> int g(T, int *); // expected-note {{no known conversion from 'int' to 'int *' for 2nd argument}}
+
+void test() {
+  int i = 0;
+  int &r1 = id(i); // expected-error {{cannot bind to a temporary}}
+  long l = id(i);
+  id(i);
+
+  // The non-dependent argument is checked again when the deduction is reused.
+  g(i, nullptr);
+  g(i, 0);
+  g(i, 1); // expected-error {{no matching function for call to 'g'}}
+}
+
+// New declarations invalidate the deductions done before.
+void later();
+
+void test2() {
+  int j = 0;
+  int *p = id(j); // expected-error {{cannot initialize a variable of type 'int *' with an rvalue of type 'int'}}
+  id(j);
+}
+
+// CHECK: 3 template argument deductions cached, 4 reused.
@@ -0,0 +1,599 @@
+//===-- cc1server_main.cpp - Persistent Clang CC1 compile server ----------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This is the entry point to the clang -cc1server functionality, a long-lived
+// process that accepts -cc1 command lines over a local socket and runs them
+// in-process. It avoids paying process startup, target registration and
+// header file I/O for every compile:
+//
+//   clang -cc1server -socket /tmp/cc1.sock [-jobs N] [-status-lifetime-ms N]
+//                    [-v]
+//
+// A plain 'clang -cc1' forwards its command line to the server when the
+// CLANG_CC1_SERVER environment variable names the server's socket, and falls
+// back to compiling in-process if the server cannot be reached, declines the
+// request, or dies while serving it. CLANG_CC1_SERVER_TIMEOUT bounds, in
+// seconds, how long the client waits for an accepted request to finish.
+//
+// The client passes its working directory and its stdin, stdout and stderr
+// file descriptors along with the command line, so the compile behaves as if
+// it had run in the client process. The socket is only accessible to the user
+// that started the server. Requests are compiled by forked workers (one unless
+// -jobs says otherwise) that share the listening socket and handle one request
+// at a time.
+//
+//===----------------------------------------------------------------------===//
+
+#include "clang/Basic/VirtualFileSystem.h"
+#include "clang/CodeGen/ObjectFilePCHContainerOperations.h"
+#include "clang/Frontend/CompilerInstance.h"
+#include "clang/Frontend/CompilerInvocation.h"
+#include "clang/Frontend/FrontendDiagnostic.h"
+#include "clang/Frontend/TextDiagnosticBuffer.h"
+#include "clang/FrontendTool/Utils.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/Compiler.h"
+#include "llvm/Support/ErrorHandling.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Signals.h"
+#include "llvm/Support/TargetSelect.h"
+#include "llvm/Support/Timer.h"
+#include "llvm/Support/raw_ostream.h"
+#include <algorithm>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#ifdef LLVM_ON_UNIX
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+using namespace clang;
+
+#ifdef LLVM_ON_UNIX
+
+namespace {
+/// The reply sent as soon as a request has been received.
+enum : uint32_t {
+  /// The request is being compiled; its exit code follows once it is done.
+  ReplyAccepted = 0,
+  /// The server cannot run the request in-process; the client should compile
+  /// it itself.
+  ReplyDeclined = 1
+};
+} // end anonymous namespace
+
+/// How long the client waits for the server to accept a request, in seconds.
+/// A server that is alive accepts requests almost immediately, even while it
+/// is busy with others.
+static const unsigned AcceptTimeout = 10;
+
+/// How long the client waits for an accepted request to be compiled, in
+/// seconds, unless CLANG_CC1_SERVER_TIMEOUT says otherwise.
+static const unsigned DefaultCompileTimeout = 600;
+
+/// Whether -v was given: log every compiled request to the server's stderr.
+static bool Verbose = false;
+
+/// Write all of \p Data to the socket \p FD. A peer that went away is reported
+/// as an error rather than by SIGPIPE where the platform allows it.
+static bool writeAll(int FD, const void *Data, size_t Size) {
+#ifdef MSG_NOSIGNAL
+  const int Flags = MSG_NOSIGNAL;
+#else
+  const int Flags = 0;
+#endif
+  const char *P = static_cast<const char *>(Data);
+  while (Size) {
+    ssize_t N = ::send(FD, P, Size, Flags);
+    if (N < 0 && errno == EINTR)
+      continue;
+    if (N <= 0)
+      return false;
+    P += N;
+    Size -= N;
+  }
+  return true;
+}
+
+static bool readAll(int FD, void *Data, size_t Size) {
+  char *P = static_cast<char *>(Data);
+  while (Size) {
+    ssize_t N = ::read(FD, P, Size);
+    if (N < 0 && errno == EINTR)
+      continue;
+    if (N <= 0)
+      return false;
+    P += N;
+    Size -= N;
+  }
+  return true;
+}
+
+/// Send the standard file descriptors of this process over \p Socket.
+static bool sendStandardFDs(int Socket) {
+  int FDs[3] = {STDIN_FILENO, STDOUT_FILENO, STDERR_FILENO};
+  char Byte = 0;
+  struct iovec IOV = {&Byte, 1};
+  char Control[CMSG_SPACE(sizeof(FDs))];
+  memset(Control, 0, sizeof(Control));
+
+  struct msghdr Msg;
+  memset(&Msg, 0, sizeof(Msg));
+  Msg.msg_iov = &IOV;
+  Msg.msg_iovlen = 1;
+  Msg.msg_control = Control;
+  Msg.msg_controllen = sizeof(Control);
+
+  struct cmsghdr *CMsg = CMSG_FIRSTHDR(&Msg);
+  CMsg->cmsg_level = SOL_SOCKET;
+  CMsg->cmsg_type = SCM_RIGHTS;
+  CMsg->cmsg_len = CMSG_LEN(sizeof(FDs));
+  memcpy(CMSG_DATA(CMsg), FDs, sizeof(FDs));
+
+#ifdef MSG_NOSIGNAL
+  const int Flags = MSG_NOSIGNAL;
+#else
+  const int Flags = 0;
+#endif
+  ssize_t N;
+  do
+    N = ::sendmsg(Socket, &Msg, Flags);
+  while (N < 0 && errno == EINTR);
+  return N == 1;
+}
+
+/// Receive the client's standard file descriptors from \p Socket. Any
+/// descriptors received from a malformed message are closed.
+static bool receiveStandardFDs(int Socket, int (&FDs)[3]) {
+  char Byte;
+  struct iovec IOV = {&Byte, 1};
+  // Leave room for a peer that sends more descriptors than expected, so they
+  // are received (and closed) rather than silently truncated.
+  char Control[CMSG_SPACE(2 * sizeof(FDs))];
+
+  struct msghdr Msg;
+  memset(&Msg, 0, sizeof(Msg));
+  Msg.msg_iov = &IOV;
+  Msg.msg_iovlen = 1;
+  Msg.msg_control = Control;
+  Msg.msg_controllen = sizeof(Control);
+
+  ssize_t N;
+  do
+    N = ::recvmsg(Socket, &Msg, 0);
+  while (N < 0 && errno == EINTR);
+  if (N < 0)
+    return false;
+
+  // Collect every descriptor the message carried, whatever its shape.
+  std::vector<int> Received;
+  for (struct cmsghdr *CMsg = CMSG_FIRSTHDR(&Msg); CMsg;
+       CMsg = CMSG_NXTHDR(&Msg, CMsg)) {
+    if (CMsg->cmsg_level != SOL_SOCKET || CMsg->cmsg_type != SCM_RIGHTS ||
+        CMsg->cmsg_len < CMSG_LEN(0))
+      continue;
+    size_t Count = (CMsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+    const unsigned char *Data = CMSG_DATA(CMsg);
+    for (size_t I = 0; I != Count; ++I) {
+      int FD;
+      memcpy(&FD, Data + I * sizeof(int), sizeof(int));
+      Received.push_back(FD);
+    }
+  }
+
+  if (N != 1 || (Msg.msg_flags & MSG_CTRUNC) || Received.size() != 3) {
+    for (int FD : Received)
+      ::close(FD);
+    return false;
+  }
+  std::copy(Received.begin(), Received.end(), FDs);
+  return true;
+}
+
+/// Bound how long reads from and writes to \p Socket may block.
+static void setSocketTimeout(int Socket, unsigned Seconds) {
+  struct timeval TV;
+  TV.tv_sec = Seconds;
+  TV.tv_usec = 0;
+  ::setsockopt(Socket, SOL_SOCKET, SO_RCVTIMEO, &TV, sizeof(TV));
+  ::setsockopt(Socket, SOL_SOCKET, SO_SNDTIMEO, &TV, sizeof(TV));
+}
+
+static int connectToServer(StringRef SocketPath) {
+  struct sockaddr_un Addr;
+  if (SocketPath.size() >= sizeof(Addr.sun_path))
+    return -1;
+  memset(&Addr, 0, sizeof(Addr));
+  Addr.sun_family = AF_UNIX;
+  memcpy(Addr.sun_path, SocketPath.data(), SocketPath.size());
+
+  int Socket = ::socket(AF_UNIX, SOCK_STREAM, 0);
+  if (Socket < 0)
+    return -1;
+  // Don't block on a server whose backlog is full.
+  setSocketTimeout(Socket, AcceptTimeout);
+  if (::connect(Socket, reinterpret_cast<struct sockaddr *>(&Addr),
+                sizeof(Addr)) != 0) {
+    ::close(Socket);
+    return -1;
+  }
+  return Socket;
+}
+
+/// Returns true if the -cc1 command line \p Args depends on process-global
+/// state that must not leak into later requests, such as LLVM options or
+/// loaded plugins.
+static bool requiresPrivateProcess(ArrayRef<const char *> Args) {
+  for (const char *Arg : Args) {
+    StringRef A(Arg);
+    if (A == "-mllvm" || A == "-load" || A == "-help" || A == "--help" ||
+        A == "-version" || A == "--version" || A.startswith("-fplugin") ||
+        A == "-plugin" || A.startswith("-plugin-arg-") ||
+        A == "-add-plugin")
+      return true;
+  }
+  return false;
+}
+
+/// Forward the -cc1 command line \p Args to the compile server listening on
+/// \p SocketPath. Returns true and sets \p ExitCode if the server compiled
+/// the request.
+bool cc1_forward_to_server(ArrayRef<const char *> Args, StringRef SocketPath,
+                           int &ExitCode) {
+  if (requiresPrivateProcess(Args))
+    return false;
+
+  SmallString<256> CWD;
+  if (llvm::sys::fs::current_path(CWD))
+    return false;
+
+  // The request is the working directory followed by the arguments, each
+  // terminated by a null character.
+  std::string Payload = CWD.str().str();
+  Payload.push_back('\0');
+  for (const char *Arg : Args) {
+    Payload += Arg;
+    Payload.push_back('\0');
+  }
+
+  int Socket = connectToServer(SocketPath);
+  if (Socket < 0)
+    return false;
+
+  unsigned CompileTimeout = DefaultCompileTimeout;
+  if (const char *Timeout = ::getenv("CLANG_CC1_SERVER_TIMEOUT"))
+    if (StringRef(Timeout).getAsInteger(10, CompileTimeout) ||
+        CompileTimeout == 0)
+      CompileTimeout = DefaultCompileTimeout;
+
+  // A server that stops responding (e.g. because it is stopped or wedged)
+  // makes the client compile the request itself once a timeout expires; a
+  // server that dies closes the connection.
+  uint32_t Size = Payload.size();
+  uint32_t Reply;
+  uint32_t Result;
+  bool Success = sendStandardFDs(Socket) &&
+                 writeAll(Socket, &Size, sizeof(Size)) &&
+                 writeAll(Socket, Payload.data(), Payload.size()) &&
+                 readAll(Socket, &Reply, sizeof(Reply)) &&
+                 Reply == ReplyAccepted;
+  if (Success) {
+    setSocketTimeout(Socket, CompileTimeout);
+    Success = readAll(Socket, &Result, sizeof(Result));
+  }
+  ::close(Socket);
+
+  if (!Success)
+    return false;
+  ExitCode = Result;
+  return true;
+}
+
+static void LLVMErrorHandler(void *UserData, const std::string &Message,
+                             bool GenCrashDiag) {
+  DiagnosticsEngine &Diags = *static_cast<DiagnosticsEngine*>(UserData);
+
+  Diags.Report(diag::err_fe_error_backend) << Message;
+
+  // Run the interrupt handlers to make sure any special cleanups get done, in
+  // particular that we remove files registered with RemoveFileOnSignal.
+  llvm::sys::RunInterruptHandlers();
+
+  // We cannot recover from llvm errors. Requests are only ever compiled in
+  // forked workers, so this takes down the worker but not the server: the
+  // worker exits without replying, the client compiles the request itself and
+  // reports the error, and the server starts a new worker.
+  _exit(GenCrashDiag ? 70 : 1);
+}
+
+/// Compile the -cc1 command line \p Args in this process.
+static int runCC1Request(ArrayRef<const char *> Args, const char *Argv0,
+                         void *MainAddr) {
+  std::unique_ptr<CompilerInstance> Clang(new CompilerInstance());
+  IntrusiveRefCntPtr<DiagnosticIDs> DiagID(new DiagnosticIDs());
+
+  auto PCHOps = Clang->getPCHContainerOperations();
+  PCHOps->registerWriter(llvm::make_unique<ObjectFilePCHContainerWriter>());
+  PCHOps->registerReader(llvm::make_unique<ObjectFilePCHContainerReader>());
+
+  IntrusiveRefCntPtr<DiagnosticOptions> DiagOpts = new DiagnosticOptions();
+  TextDiagnosticBuffer *DiagsBuffer = new TextDiagnosticBuffer;
+  DiagnosticsEngine Diags(DiagID, &*DiagOpts, DiagsBuffer);
+  bool Success = CompilerInvocation::CreateFromArgs(
+      Clang->getInvocation(), Args.begin(), Args.end(), Diags);
+
+  if (Clang->getHeaderSearchOpts().UseBuiltinIncludes &&
+      Clang->getHeaderSearchOpts().ResourceDir.empty())
+    Clang->getHeaderSearchOpts().ResourceDir =
+      CompilerInvocation::GetResourcesPath(Argv0, MainAddr);
+
+  // The server outlives the compile, so memory must actually be released.
+  Clang->getFrontendOpts().DisableFree = false;
+  Clang->getCodeGenOpts().DisableFree = false;
+
+  Clang->createDiagnostics();
+  if (!Clang->hasDiagnostics())
+    return 1;
+
+  llvm::install_fatal_error_handler(LLVMErrorHandler,
+                                  static_cast<void*>(&Clang->getDiagnostics()));
+
+  DiagsBuffer->FlushDiagnostics(Clang->getDiagnostics());
+  if (Success) {
+    // Read files through the process-wide file cache, so headers shared by
+    // many requests are read only once.
+    IntrusiveRefCntPtr<vfs::FileSystem> VFS = createVFSFromCompilerInvocation(
+        Clang->getInvocation(), Clang->getDiagnostics(),
+        vfs::createCachingFileSystem(vfs::getRealFileSystem()));
+    if (VFS) {
+      Clang->setVirtualFileSystem(VFS);
+      Success = ExecuteCompilerInvocation(Clang.get());
+    } else {
+      Success = false;
+    }
+  }
+
+  llvm::TimerGroup::printAll(llvm::errs());
+  llvm::remove_fatal_error_handler();
+  return !Success;
+}
+
+/// Serve the request on connection \p Conn.
+static void serveRequest(int Conn, const char *Argv0, void *MainAddr) {
+  int ClientFDs[3];
+  if (!receiveStandardFDs(Conn, ClientFDs))
+    return;
+
+  uint32_t Size;
+  std::string Payload;
+  bool Received = readAll(Conn, &Size, sizeof(Size));
+  if (Received) {
+    Payload.resize(Size);
+    Received = readAll(Conn, &Payload[0], Size);
+  }
+
+  // Split the payload into the working directory and the arguments.
+  std::vector<const char *> Args;
+  for (size_t I = 0; Received && I < Payload.size();
+       I += strlen(&Payload[I]) + 1)
+    Args.push_back(&Payload[I]);
+
+  if (Args.empty() || requiresPrivateProcess(makeArrayRef(Args).slice(1)) ||
+      ::chdir(Args[0]) != 0) {
+    for (int FD : ClientFDs)
+      ::close(FD);
+    uint32_t Reply = ReplyDeclined;
+    writeAll(Conn, &Reply, sizeof(Reply));
+    return;
+  }
+
+  uint32_t Reply = ReplyAccepted;
+  if (!writeAll(Conn, &Reply, sizeof(Reply))) {
+    for (int FD : ClientFDs)
+      ::close(FD);
+    return;
+  }
+
+  // Compile as if running in the client: with its standard streams.
+  int SavedFDs[3];
+  for (int I = 0; I != 3; ++I) {
+    SavedFDs[I] = ::dup(I);
+    ::dup2(ClientFDs[I], I);
+  }
+
+  uint32_t Result =
+      runCC1Request(makeArrayRef(Args).slice(1), Argv0, MainAddr);
+
+  llvm::outs().flush();
+  llvm::errs().flush();
+  for (int I = 0; I != 3; ++I) {
+    ::dup2(SavedFDs[I], I);
+    ::close(SavedFDs[I]);
+  }
+  for (int FD : ClientFDs)
+    ::close(FD);
+
+  if (Verbose)
+    llvm::errs() << "clang -cc1server: compiled request in '" << Args[0]
+                 << "' (exit code " << Result << ")\n";
+
+  writeAll(Conn, &Result, sizeof(Result));
+}
+
+LLVM_ATTRIBUTE_NORETURN
+static void runWorker(int Listener, const char *Argv0, void *MainAddr) {
+  for (;;) {
+    int Conn = ::accept(Listener, nullptr, nullptr);
+    if (Conn < 0) {
+      if (errno == EINTR || errno == ECONNABORTED)
+        continue;
+      _exit(1);
+    }
+    serveRequest(Conn, Argv0, MainAddr);
+    ::close(Conn);
+  }
+}
+
+int cc1server_main(ArrayRef<const char *> Argv, const char *Argv0,
+                   void *MainAddr) {
+  std::string SocketPath;
+  unsigned Jobs = 1;
+  // Unless asked otherwise, don't trust cached status results across
+  // requests; file contents are still shared and validated on every open.
+  unsigned StatusLifetime = 0;
+  for (size_t I = 0; I < Argv.size(); ++I) {
+    StringRef Arg(Argv[I]);
+    if (Arg == "-socket" && I + 1 < Argv.size()) {
+      SocketPath = Argv[++I];
+    } else if (Arg == "-jobs" && I + 1 < Argv.size()) {
+      if (StringRef(Argv[++I]).getAsInteger(10, Jobs) || Jobs == 0) {
+        llvm::errs() << "error: invalid value for -jobs\n";
+        return 1;
+      }
+    } else if (Arg == "-v") {
+      Verbose = true;
+    } else if (Arg == "-status-lifetime-ms" && I + 1 < Argv.size()) {
+      // Trusting cached status results for longer saves stat() calls, but
+      // delays noticing newly created headers by at most this much.
+      if (StringRef(Argv[++I]).getAsInteger(10, StatusLifetime)) {
+        llvm::errs() << "error: invalid value for -status-lifetime-ms\n";
+        return 1;
+      }
+    } else {
+      llvm::errs() << "error: unknown argument '" << Arg << "'\n";
+      return 1;
+    }
+  }
+  if (SocketPath.empty()) {
+    llvm::errs() << "usage: clang -cc1server -socket <path> [-jobs <n>] "
+                    "[-status-lifetime-ms <n>] [-v]\n";
+    return 1;
+  }
+
+  vfs::SharedFileCache::getGlobal()->setStatusLifetime(
+      std::chrono::milliseconds(StatusLifetime));
+
+  // A client that goes away must not take the server down with it.
+  ::signal(SIGPIPE, SIG_IGN);
+
+  // Do the expensive process-wide initialization once, before forking the
+  // workers.
+  llvm::InitializeAllTargets();
+  llvm::InitializeAllTargetMCs();
+  llvm::InitializeAllAsmPrinters();
+  llvm::InitializeAllAsmParsers();
+
+  struct sockaddr_un Addr;
+  if (SocketPath.size() >= sizeof(Addr.sun_path)) {
+    llvm::errs() << "error: socket path too long: " << SocketPath << "\n";
+    return 1;
+  }
+  memset(&Addr, 0, sizeof(Addr));
+  Addr.sun_family = AF_UNIX;
+  memcpy(Addr.sun_path, SocketPath.data(), SocketPath.size());
+
+  // Anyone who can connect can run compiles as the user running the server,
+  // so only that user may use the socket. Create it without permissions for
+  // anyone else, so there is no window before the chmod.
+  int Listener = ::socket(AF_UNIX, SOCK_STREAM, 0);
+  ::unlink(SocketPath.c_str());
+  mode_t OldMask = ::umask(0077);
+  bool Bound = Listener >= 0 &&
+               ::bind(Listener, reinterpret_cast<struct sockaddr *>(&Addr),
+                      sizeof(Addr)) == 0;
+  ::umask(OldMask);
+  if (!Bound || ::chmod(SocketPath.c_str(), 0600) != 0 ||
+      ::listen(Listener, SOMAXCONN) != 0) {
+    llvm::errs() << "error: cannot listen on '" << SocketPath
+                 << "': " << strerror(errno) << "\n";
+    return 1;
+  }
+
+  // Requests are always compiled in forked workers that share the listening
+  // socket, never in this process, so a fatal backend error in a request only
+  // takes down its worker. Replace any worker that dies, and take the workers
+  // down with the server when it is terminated.
+  static volatile sig_atomic_t Terminating = 0;
+  struct sigaction Action;
+  memset(&Action, 0, sizeof(Action));
+  Action.sa_handler = [](int) { Terminating = 1; };
+  sigemptyset(&Action.sa_mask);
+  ::sigaction(SIGTERM, &Action, nullptr);
+  ::sigaction(SIGINT, &Action, nullptr);
+  ::sigaction(SIGHUP, &Action, nullptr);
+
+  std::vector<pid_t> Workers;
+  auto SpawnWorker = [&] {
+    pid_t Pid = ::fork();
+    if (Pid == 0) {
+      ::signal(SIGTERM, SIG_DFL);
+      ::signal(SIGINT, SIG_DFL);
+      ::signal(SIGHUP, SIG_DFL);
+      runWorker(Listener, Argv0, MainAddr);
+    }
+    if (Pid > 0)
+      Workers.push_back(Pid);
+    return Pid;
+  };
+  auto StopWorkers = [&] {
+    for (pid_t Pid : Workers)
+      ::kill(Pid, SIGTERM);
+    while (::waitpid(-1, nullptr, 0) > 0 || errno == EINTR)
+      ;
+  };
+
+  for (unsigned I = 0; I != Jobs; ++I)
+    if (SpawnWorker() < 0) {
+      llvm::errs() << "error: cannot start worker: " << strerror(errno)
+                   << "\n";
+      StopWorkers();
+      return 1;
+    }
+  while (!Terminating) {
+    int Status;
+    pid_t Pid = ::waitpid(-1, &Status, 0);
+    if (Pid < 0) {
+      if (errno == EINTR)
+        continue;
+      break;
+    }
+    Workers.erase(std::remove(Workers.begin(), Workers.end(), Pid),
+                  Workers.end());
+    if (!Terminating)
+      SpawnWorker();
+  }
+  StopWorkers();
+  ::unlink(SocketPath.c_str());
+  return Terminating ? 0 : 1;
+}
+
+#else
+
+bool cc1_forward_to_server(ArrayRef<const char *> Args, StringRef SocketPath,
+                           int &ExitCode) {
+  return false;
+}
+
+int cc1server_main(ArrayRef<const char *> Argv, const char *Argv0,
+                   void *MainAddr) {
+  llvm::errs() << "error: -cc1server is not supported on this platform\n";
+  return 1;
+}
+
+#endif
@@ -205,6 +205,10 @@ extern int cc1_main(ArrayRef<const char *> Argv, const char *Argv0,
                     void *MainAddr);
 extern int cc1as_main(ArrayRef<const char *> Argv, const char *Argv0,
                       void *MainAddr);
+extern int cc1server_main(ArrayRef<const char *> Argv, const char *Argv0,
+                          void *MainAddr);
+extern bool cc1_forward_to_server(ArrayRef<const char *> Args,
+                                  StringRef SocketPath, int &ExitCode);
 
 static void insertTargetAndModeArgs(const ParsedClangName &NameParts,
                                     SmallVectorImpl<const char *> &ArgVector,
@@ -305,10 +309,19 @@ static void SetInstallDir(SmallVectorImpl<const char *> &argv,
 
 static int ExecuteCC1Tool(ArrayRef<const char *> argv, StringRef Tool) {
   void *GetExecutablePathVP = (void *)(intptr_t) GetExecutablePath;
-  if (Tool == "")
+  if (Tool == "") {
+    // Let a running compile server do the work, if there is one.
+    if (const char *Socket = ::getenv("CLANG_CC1_SERVER")) {
+      int ExitCode;
+      if (cc1_forward_to_server(argv.slice(2), Socket, ExitCode))
+        return ExitCode;
+    }
     return cc1_main(argv.slice(2), argv[0], GetExecutablePathVP);
+  }
   if (Tool == "as")
     return cc1as_main(argv.slice(2), argv[0], GetExecutablePathVP);
+  if (Tool == "server")
+    return cc1server_main(argv.slice(2), argv[0], GetExecutablePathVP);
 
   // Reject unknown tools.
   llvm::errs() << "error: unknown integrated tool '" << Tool << "'\n";
@@ -31,6 +31,7 @@
 #include "clang/Frontend/ASTUnit.h"
 #include "clang/Frontend/CompilerInstance.h"
 #include "clang/Frontend/FrontendDiagnostic.h"
+#include "clang/Frontend/PreambleStore.h"
 #include "clang/Index/CodegenNameGenerator.h"
 #include "clang/Index/CommentToXML.h"
 #include "clang/Lex/HeaderSearch.h"
@@ -3279,6 +3280,13 @@ void clang_CXIndex_setInvocationEmissionPathOption(CXIndex CIdx,
     static_cast<CIndexer *>(CIdx)->setInvocationEmissionPath(Path ? Path : "");
 }
 
+void clang_setSharedPreambleLimits(unsigned long long MemoryBudget,
+                                   unsigned MaxPreambles) {
+  std::size_t Budget = std::min<unsigned long long>(
+      MemoryBudget, std::numeric_limits<std::size_t>::max());
+  PreambleStore::getShared().setLimits(Budget, MaxPreambles);
+}
+
 void clang_toggleCrashRecovery(unsigned isEnabled) {
   if (isEnabled)
     llvm::CrashRecoveryContext::Enable();
@@ -4371,6 +4379,126 @@ unsigned clang_visitChildrenWithBlock(CXCursor parent,
   return clang_visitChildren(parent, visitWithBlock, block);
 }
 
+} // end extern "C"
+
+namespace {
+/// \brief A flattened subtree and the arena holding its arrays.
+struct FlattenedCursors : CXFlattenedCursors {
+  llvm::BumpPtrAllocator Arena;
+
+  template <typename T> const T *copy(ArrayRef<T> Values) {
+    T *Copy = Arena.Allocate<T>(Values.size());
+    std::uninitialized_copy(Values.begin(), Values.end(), Copy);
+    return Copy;
+  }
+};
+
+/// \brief Gathers the data of a subtree as it is visited.
+struct CursorFlattener {
+  unsigned Options;
+  std::vector<CXCursor> Cursors;
+  std::vector<CXCursorKind> Kinds;
+  std::vector<int> Parents;
+  std::vector<int> FileIndices;
+  std::vector<unsigned> StartOffsets;
+  std::vector<unsigned> EndOffsets;
+  std::vector<unsigned> USROffsets;
+  // Cursors without a USR share the empty string at offset 0.
+  std::vector<char> USRData{'\0'};
+  std::vector<CXFile> Files;
+  llvm::DenseMap<CXFile, int> FileIndexMap;
+
+  /// \brief The cursors from the root to the last visited one, with their
+  /// indices.
+  SmallVector<std::pair<CXCursor, int>, 32> Ancestors;
+
+  explicit CursorFlattener(unsigned Options) : Options(Options) {}
+
+  int add(CXCursor C, int Parent) {
+    int Index = Cursors.size();
+    Cursors.push_back(C);
+    Kinds.push_back(C.kind);
+    Parents.push_back(Parent);
+
+    CXSourceRange Extent = clang_getCursorExtent(C);
+    CXFile File = nullptr;
+    unsigned StartOffset = 0, EndOffset = 0;
+    clang_getExpansionLocation(clang_getRangeStart(Extent), &File, nullptr,
+                               nullptr, &StartOffset);
+    clang_getExpansionLocation(clang_getRangeEnd(Extent), nullptr, nullptr,
+                               nullptr, &EndOffset);
+    int FileIndex = -1;
+    if (File) {
+      auto Known = FileIndexMap.insert(std::make_pair(File, Files.size()));
+      if (Known.second)
+        Files.push_back(File);
+      FileIndex = Known.first->second;
+    }
+    FileIndices.push_back(FileIndex);
+    StartOffsets.push_back(StartOffset);
+    EndOffsets.push_back(EndOffset);
+
+    unsigned USROffset = 0;
+    if (Options & CXFlattenCursors_IncludeUSRs) {
+      CXString USR = clang_getCursorUSR(C);
+      StringRef Text = clang_getCString(USR);
+      if (!Text.empty()) {
+        USROffset = USRData.size();
+        USRData.insert(USRData.end(), Text.begin(), Text.end());
+        USRData.push_back('\0');
+      }
+      clang_disposeString(USR);
+    }
+    USROffsets.push_back(USROffset);
+    return Index;
+  }
+
+  static CXChildVisitResult visit(CXCursor C, CXCursor Parent,
+                                  CXClientData ClientData) {
+    CursorFlattener &F = *static_cast<CursorFlattener *>(ClientData);
+    // The traversal is preorder, so the parent is on the stack.
+    while (F.Ancestors.size() > 1 &&
+           !clang_equalCursors(F.Ancestors.back().first, Parent))
+      F.Ancestors.pop_back();
+    int Index = F.add(C, F.Ancestors.back().second);
+    F.Ancestors.push_back(std::make_pair(C, Index));
+    return CXChildVisit_Recurse;
+  }
+};
+} // end anonymous namespace
+
+extern "C" {
+
+CXFlattenedCursors *clang_flattenCursorSubtree(CXCursor Root,
+                                               unsigned Options) {
+  if (clang_Cursor_isNull(Root) || clang_isInvalid(Root.kind))
+    return nullptr;
+
+  CursorFlattener F(Options);
+  F.Ancestors.push_back(std::make_pair(Root, F.add(Root, -1)));
+  clang_visitChildren(Root, CursorFlattener::visit, &F);
+
+  // Gather the arrays in one arena, so that they are freed in one go.
+  auto *Result = new FlattenedCursors();
+  Result->NumCursors = F.Cursors.size();
+  Result->Cursors = Result->copy<CXCursor>(F.Cursors);
+  Result->Kinds = Result->copy<CXCursorKind>(F.Kinds);
+  Result->Parents = Result->copy<int>(F.Parents);
+  Result->FileIndices = Result->copy<int>(F.FileIndices);
+  Result->StartOffsets = Result->copy<unsigned>(F.StartOffsets);
+  Result->EndOffsets = Result->copy<unsigned>(F.EndOffsets);
+  Result->USROffsets = Result->copy<unsigned>(F.USROffsets);
+  Result->USRData = Result->copy<char>(F.USRData);
+  Result->USRDataSize = F.USRData.size();
+  Result->NumFiles = F.Files.size();
+  Result->Files = Result->copy<CXFile>(F.Files);
+  return Result;
+}
+
+void clang_disposeFlattenedCursors(CXFlattenedCursors *Cursors) {
+  delete static_cast<FlattenedCursors *>(Cursors);
+}
+
 static CXString getDeclSpelling(const Decl *D) {
   if (!D)
     return cxstring::createEmpty();
@@ -0,0 +1,293 @@
+//===- CIndexAsync.cpp - Asynchronous reparse and code completion ---------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file implements the asynchronous, cancellable variants of
+// clang_reparseTranslationUnit and clang_codeCompleteAt.
+//
+//===----------------------------------------------------------------------===//
+
+#include "CIndexer.h"
+#include "CXTranslationUnit.h"
+#include "clang/Frontend/ASTUnit.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/Config/llvm-config.h"
+#include "llvm/Support/ManagedStatic.h"
+#include "llvm/Support/ThreadPool.h"
+#include <atomic>
+#include <condition_variable>
+#include <cstdlib>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <vector>
+
+using namespace clang;
+
+struct CXAsyncOperationImpl {
+  enum OperationKind { Reparse, CodeComplete };
+
+  CXAsyncOperationImpl(OperationKind Kind, CXTranslationUnit TU,
+                       ArrayRef<CXUnsavedFile> UnsavedFiles, unsigned Options)
+      : Kind(Kind), TU(TU), Options(Options) {
+    // The client may free the unsaved files as soon as the operation is
+    // started.
+    for (const CXUnsavedFile &UF : UnsavedFiles) {
+      UnsavedFilenames.push_back(UF.Filename);
+      UnsavedContents.push_back(std::string(UF.Contents, UF.Length));
+    }
+  }
+
+  /// \brief Perform the operation on the calling thread.
+  void run();
+
+  /// \brief Mark the operation as finished and wake up its waiters. The
+  /// operation may be freed as soon as this returns.
+  void finish();
+
+  const OperationKind Kind;
+  const CXTranslationUnit TU;
+  const unsigned Options;
+  std::vector<std::string> UnsavedFilenames;
+  std::vector<std::string> UnsavedContents;
+
+  std::string CompleteFilename;
+  unsigned CompleteLine = 0;
+  unsigned CompleteColumn = 0;
+
+  std::atomic<bool> Canceled{false};
+
+  std::mutex Mutex;
+  std::condition_variable FinishedCondition;
+  bool Finished = false;
+  CXErrorCode Result = CXError_Success;
+  CXCodeCompleteResults *CompletionResults = nullptr;
+};
+
+void CXAsyncOperationImpl::run() {
+  if (Canceled) {
+    Result = CXError_Canceled;
+    return;
+  }
+
+  std::vector<CXUnsavedFile> UnsavedFiles;
+  for (unsigned I = 0, N = UnsavedFilenames.size(); I != N; ++I)
+    UnsavedFiles.push_back({UnsavedFilenames[I].c_str(),
+                            UnsavedContents[I].data(),
+                            static_cast<unsigned long>(
+                                UnsavedContents[I].size())});
+
+  ASTUnit *AST = cxtu::getASTUnit(TU);
+  if (AST)
+    AST->setCancellationFlag(&Canceled);
+
+  switch (Kind) {
+  case Reparse:
+    Result = static_cast<CXErrorCode>(clang_reparseTranslationUnit(
+        TU, UnsavedFiles.size(), UnsavedFiles.data(), Options));
+    break;
+
+  case CodeComplete:
+    CompletionResults = clang_codeCompleteAt(
+        TU, CompleteFilename.c_str(), CompleteLine, CompleteColumn,
+        UnsavedFiles.data(), UnsavedFiles.size(), Options);
+    if (!CompletionResults)
+      Result = CXError_Failure;
+    break;
+  }
+
+  if (AST)
+    AST->setCancellationFlag(nullptr);
+
+  // Results computed after a cancellation are incomplete. Errors are still
+  // reported as such, since they may mean that the translation unit is no
+  // longer usable.
+  if (Canceled && (Result == CXError_Success || Kind == CodeComplete)) {
+    clang_disposeCodeCompleteResults(CompletionResults);
+    CompletionResults = nullptr;
+    Result = CXError_Canceled;
+  }
+}
+
+void CXAsyncOperationImpl::finish() {
+  std::lock_guard<std::mutex> Lock(Mutex);
+  Finished = true;
+  // Notify while holding the lock: a waiter may free the operation as soon as
+  // it gets hold of it.
+  FinishedCondition.notify_all();
+}
+
+namespace {
+/// \brief Runs the asynchronous operations on a pool of threads, one at a time
+/// and in order for each translation unit.
+///
+/// Without threads, because libclang was built without them or because
+/// LIBCLANG_NOTHREADS is set, the operations run on the threads that wait for
+/// them instead.
+class AsyncOperationQueue {
+  llvm::ThreadPool Pool;
+
+  std::mutex Mutex;
+
+  /// \brief The operations started on each translation unit, in order. The
+  /// first one is running.
+  llvm::DenseMap<CXTranslationUnit, std::deque<CXAsyncOperation>> Operations;
+
+  /// \brief Without threads, the operations that are first in line for their
+  /// translation unit and wait for someone to run them.
+  std::deque<CXAsyncOperation> Deferred;
+
+  void schedule(CXAsyncOperation Op);
+  void runAndScheduleNext(CXAsyncOperation Op);
+
+public:
+  void enqueue(CXAsyncOperation Op);
+
+  /// \brief Without threads, run the deferred operations until \p Op has
+  /// finished or is running on another thread.
+  void runDeferred(CXAsyncOperation Op);
+};
+} // end anonymous namespace
+
+static llvm::ManagedStatic<AsyncOperationQueue> Queue;
+
+void AsyncOperationQueue::enqueue(CXAsyncOperation Op) {
+  {
+    std::lock_guard<std::mutex> Lock(Mutex);
+    std::deque<CXAsyncOperation> &Ops = Operations[Op->TU];
+    Ops.push_back(Op);
+    // Otherwise, the operation is started once the ones before it finish.
+    if (Ops.size() != 1)
+      return;
+  }
+  schedule(Op);
+}
+
+void AsyncOperationQueue::schedule(CXAsyncOperation Op) {
+  if (!LLVM_ENABLE_THREADS || getenv("LIBCLANG_NOTHREADS")) {
+    std::lock_guard<std::mutex> Lock(Mutex);
+    Deferred.push_back(Op);
+    return;
+  }
+  Pool.async([this, Op] { runAndScheduleNext(Op); });
+}
+
+void AsyncOperationQueue::runDeferred(CXAsyncOperation Op) {
+  while (!clang_AsyncOperation_isFinished(Op)) {
+    CXAsyncOperation Next;
+    {
+      std::lock_guard<std::mutex> Lock(Mutex);
+      if (Deferred.empty())
+        return;
+      Next = Deferred.front();
+      Deferred.pop_front();
+    }
+    runAndScheduleNext(Next);
+  }
+}
+
+void AsyncOperationQueue::runAndScheduleNext(CXAsyncOperation Op) {
+  Op->run();
+
+  CXAsyncOperation Next = nullptr;
+  {
+    std::lock_guard<std::mutex> Lock(Mutex);
+    auto Known = Operations.find(Op->TU);
+    assert(Known != Operations.end() && Known->second.front() == Op &&
+           "running an operation that isn't first in line");
+    Known->second.pop_front();
+    if (Known->second.empty())
+      Operations.erase(Known);
+    else
+      Next = Known->second.front();
+  }
+
+  Op->finish();
+  if (Next)
+    schedule(Next);
+}
+
+extern "C" {
+
+CXAsyncOperation
+clang_reparseTranslationUnitAsync(CXTranslationUnit TU,
+                                  unsigned num_unsaved_files,
+                                  struct CXUnsavedFile *unsaved_files,
+                                  unsigned options) {
+  if (cxtu::isNotUsableTU(TU) || (num_unsaved_files && !unsaved_files))
+    return nullptr;
+
+  CXAsyncOperation Op = new CXAsyncOperationImpl(
+      CXAsyncOperationImpl::Reparse, TU,
+      llvm::makeArrayRef(unsaved_files, num_unsaved_files), options);
+  Queue->enqueue(Op);
+  return Op;
+}
+
+CXAsyncOperation clang_codeCompleteAtAsync(CXTranslationUnit TU,
+                                           const char *complete_filename,
+                                           unsigned complete_line,
+                                           unsigned complete_column,
+                                           struct CXUnsavedFile *unsaved_files,
+                                           unsigned num_unsaved_files,
+                                           unsigned options) {
+  if (cxtu::isNotUsableTU(TU) || !complete_filename ||
+      (num_unsaved_files && !unsaved_files))
+    return nullptr;
+
+  CXAsyncOperation Op = new CXAsyncOperationImpl(
+      CXAsyncOperationImpl::CodeComplete, TU,
+      llvm::makeArrayRef(unsaved_files, num_unsaved_files), options);
+  Op->CompleteFilename = complete_filename;
+  Op->CompleteLine = complete_line;
+  Op->CompleteColumn = complete_column;
+  Queue->enqueue(Op);
+  return Op;
+}
+
+void clang_AsyncOperation_cancel(CXAsyncOperation Op) {
+  if (Op)
+    Op->Canceled = true;
+}
+
+unsigned clang_AsyncOperation_isFinished(CXAsyncOperation Op) {
+  if (!Op)
+    return 1;
+  std::lock_guard<std::mutex> Lock(Op->Mutex);
+  return Op->Finished;
+}
+
+enum CXErrorCode clang_AsyncOperation_wait(CXAsyncOperation Op) {
+  if (!Op)
+    return CXError_InvalidArguments;
+  Queue->runDeferred(Op);
+  std::unique_lock<std::mutex> Lock(Op->Mutex);
+  Op->FinishedCondition.wait(Lock, [Op] { return Op->Finished; });
+  return Op->Result;
+}
+
+CXCodeCompleteResults *
+clang_AsyncOperation_takeCodeCompleteResults(CXAsyncOperation Op) {
+  if (!Op)
+    return nullptr;
+  clang_AsyncOperation_wait(Op);
+  CXCodeCompleteResults *Results = Op->CompletionResults;
+  Op->CompletionResults = nullptr;
+  return Results;
+}
+
+void clang_AsyncOperation_dispose(CXAsyncOperation Op) {
+  if (!Op)
+    return;
+  clang_AsyncOperation_cancel(Op);
+  clang_AsyncOperation_wait(Op);
+  clang_disposeCodeCompleteResults(Op->CompletionResults);
+  delete Op;
+}
+
+} // end extern "C"
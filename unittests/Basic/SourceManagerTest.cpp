@@ -155,6 +155,131 @@ TEST_F(SourceManagerTest, getColumnNumber) {
   EXPECT_EQ(1U, SourceMgr.getColumnNumber(MainFileID, 0, nullptr));
 }
 
+// Returns the 1-based line of every offset of Source, and one past its end,
+// treating "\r\n" and "\n\r" as a single newline.
+static std::vector<unsigned> computeLineNumbers(StringRef Source) {
+  std::vector<unsigned> LineNumbers;
+  unsigned Line = 1;
+  for (size_t I = 0; I < Source.size(); ++I) {
+    LineNumbers.push_back(Line);
+    if (Source[I] != '\n' && Source[I] != '\r')
+      continue;
+    if (I + 1 < Source.size() &&
+        (Source[I + 1] == '\n' || Source[I + 1] == '\r') &&
+        Source[I + 1] != Source[I]) {
+      LineNumbers.push_back(Line);
+      ++I;
+    }
+    ++Line;
+  }
+  LineNumbers.push_back(Line);
+  return LineNumbers;
+}
+
+TEST(LineOffsetIndexTest, ExtendsLazily) {
+  // 200 lines of 10 bytes, spanning several chunks of the index.
+  std::string Source;
+  for (unsigned I = 0; I != 200; ++I)
+    Source += "abcdefghi\n";
+
+  SrcMgr::LineOffsetIndex Lines;
+  EXPECT_TRUE(Lines.empty());
+  Lines.extendToOffset(Source.data(), Source.size(), 25);
+  EXPECT_TRUE(Lines.covers(25));
+  EXPECT_FALSE(Lines.covers(Source.size()));
+  EXPECT_LT(Lines.getNumKnownLines(), 10U);
+
+  unsigned Start;
+  EXPECT_EQ(3U, Lines.getLineNumber(25, &Start));
+  EXPECT_EQ(20U, Start);
+
+  // Extending to a line only scans up to that line.
+  Lines.extendToLine(Source.data(), Source.size(), 100);
+  EXPECT_TRUE(Lines.coversLine(100));
+  EXPECT_FALSE(Lines.coversLine(201));
+  EXPECT_EQ(990U, Lines.getLineStart(99));
+
+  unsigned Next;
+  EXPECT_EQ(65U, Lines.getLineNumber(645, &Start, &Next));
+  EXPECT_EQ(640U, Start);
+  EXPECT_EQ(650U, Next);
+
+  // Extending to the end makes the index complete; the last line starts after
+  // the final newline.
+  Lines.extendToOffset(Source.data(), Source.size(), Source.size());
+  EXPECT_TRUE(Lines.coversLine(1000));
+  EXPECT_EQ(201U, Lines.getNumKnownLines());
+  EXPECT_EQ(201U, Lines.getLineNumber(Source.size()));
+  EXPECT_GT(Lines.getMemorySize(), 0U);
+
+  Lines.clear();
+  EXPECT_TRUE(Lines.empty());
+  EXPECT_FALSE(Lines.covers(0));
+}
+
+TEST(LineOffsetIndexTest, NewlinePairsAcrossBlocks) {
+  // Put "\r\n" and "\n\r" pairs, and lone "\r"s, at every position relative to
+  // the 16 byte blocks scanned at once.
+  std::string Source;
+  for (unsigned I = 0; I != 40; ++I) {
+    Source += std::string(I % 17, 'x');
+    Source += (I % 3 == 0) ? "\r\n" : (I % 3 == 1) ? "\n\r" : "\r";
+  }
+  std::vector<unsigned> Expected = computeLineNumbers(Source);
+
+  // Build the index in one go, and in small steps that may stop between the
+  // two characters of a pair.
+  SrcMgr::LineOffsetIndex Whole;
+  Whole.extendToOffset(Source.data(), Source.size(), Source.size());
+  SrcMgr::LineOffsetIndex Stepwise;
+  for (unsigned Offset = 0; Offset <= Source.size(); ++Offset) {
+    Stepwise.extendToOffset(Source.data(), Source.size(), Offset);
+    EXPECT_EQ(Expected[Offset], Stepwise.getLineNumber(Offset)) << Offset;
+    EXPECT_EQ(Expected[Offset], Whole.getLineNumber(Offset)) << Offset;
+  }
+  EXPECT_EQ(Expected.back(), Whole.getNumKnownLines());
+}
+
+TEST_F(SourceManagerTest, translateLineCol) {
+  const char *Source =
+    "int x;\r\n"
+    "\n"
+    "int yy;\r\n"
+    "int z;";
+
+  std::unique_ptr<llvm::MemoryBuffer> Buf =
+      llvm::MemoryBuffer::getMemBuffer(Source);
+  FileID MainFileID = SourceMgr.createFileID(std::move(Buf));
+  SourceMgr.setMainFileID(MainFileID);
+  size_t SizeWithoutLineTable = SourceMgr.getDataStructureSizes();
+
+  auto Offset = [&](unsigned Line, unsigned Col) {
+    SourceLocation Loc = SourceMgr.translateLineCol(MainFileID, Line, Col);
+    return SourceMgr.getFileOffset(Loc);
+  };
+
+  EXPECT_EQ(0U, Offset(1, 1));
+  EXPECT_EQ(4U, Offset(1, 5));
+  EXPECT_EQ(8U, Offset(2, 1));
+  EXPECT_EQ(13U, Offset(3, 5));
+  EXPECT_EQ(18U, Offset(4, 1));
+
+  // A column past the end of a line stops at its newline.
+  EXPECT_EQ(6U, Offset(1, 100));
+  EXPECT_EQ(8U, Offset(2, 2));
+
+  // A line past the end of the file maps to its last character.
+  EXPECT_EQ(strlen(Source) - 1, Offset(10, 1));
+
+  // Translating back gives the same line and column.
+  SourceLocation Loc = SourceMgr.translateLineCol(MainFileID, 3, 5);
+  EXPECT_EQ(3U, SourceMgr.getSpellingLineNumber(Loc));
+  EXPECT_EQ(5U, SourceMgr.getSpellingColumnNumber(Loc));
+
+  // The line table is accounted for.
+  EXPECT_GT(SourceMgr.getDataStructureSizes(), SizeWithoutLineTable);
+}
+
 #if defined(LLVM_ON_UNIX)
 
 TEST_F(SourceManagerTest, getMacroArgExpandedLocation) {
@@ -10,8 +10,10 @@
 #include "clang/Basic/VirtualFileSystem.h"
 #include "llvm/ADT/Triple.h"
 #include "llvm/Support/Errc.h"
+#include "llvm/Support/FileSystem.h"
 #include "llvm/Support/Host.h"
 #include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Path.h"
 #include "llvm/Support/SourceMgr.h"
 #include "gtest/gtest.h"
 #include <map>
@@ -352,6 +354,110 @@ TEST(VirtualFileSystemTest, BasicRealFSIteration) {
   EXPECT_EQ(vfs::directory_iterator(), I);
 }
 
+TEST(VirtualFileSystemTest, PhysicalFSWorkingDirectory) {
+  ScopedDir TestDirectory("virtual-file-system-test", /*Unique*/ true);
+  ScopedDir _a(TestDirectory + "/a");
+  std::unique_ptr<vfs::FileSystem> FS = vfs::createPhysicalFileSystem();
+
+  SmallString<128> ProcessCWD;
+  ASSERT_FALSE(llvm::sys::fs::current_path(ProcessCWD));
+  auto CWD = FS->getCurrentWorkingDirectory();
+  ASSERT_FALSE(CWD.getError());
+  EXPECT_EQ(ProcessCWD.str(), *CWD);
+
+  ASSERT_FALSE(FS->setCurrentWorkingDirectory(TestDirectory));
+  CWD = FS->getCurrentWorkingDirectory();
+  ASSERT_FALSE(CWD.getError());
+  EXPECT_EQ(TestDirectory.Path.str(), *CWD);
+
+  // Relative paths are resolved against the private working directory.
+  ErrorOr<vfs::Status> Status = FS->status("a");
+  ASSERT_FALSE(Status.getError());
+  EXPECT_TRUE(Status->isDirectory());
+  ASSERT_FALSE(FS->setCurrentWorkingDirectory("a/../a"));
+  CWD = FS->getCurrentWorkingDirectory();
+  ASSERT_FALSE(CWD.getError());
+  EXPECT_EQ(_a.Path.str(), *CWD);
+  EXPECT_TRUE(FS->setCurrentWorkingDirectory("no_such_dir"));
+
+  // The process's working directory is left alone.
+  SmallString<128> NewProcessCWD;
+  ASSERT_FALSE(llvm::sys::fs::current_path(NewProcessCWD));
+  EXPECT_EQ(ProcessCWD, NewProcessCWD);
+}
+
+static void writeTestFile(const Twine &Path, StringRef Content) {
+  std::error_code EC;
+  llvm::raw_fd_ostream OS(Path.str(), EC, llvm::sys::fs::F_None);
+  ASSERT_FALSE(EC);
+  OS << Content;
+}
+
+TEST(VirtualFileSystemTest, CachingFSSharesBuffers) {
+  ScopedDir TestDirectory("virtual-file-system-test", /*Unique*/ true);
+  SmallString<128> FilePath(TestDirectory.Path);
+  llvm::sys::path::append(FilePath, "a.h");
+  writeTestFile(FilePath, "int a;");
+
+  IntrusiveRefCntPtr<vfs::SharedFileCache> Cache(new vfs::SharedFileCache());
+  IntrusiveRefCntPtr<vfs::FileSystem> FS1 =
+      vfs::createCachingFileSystem(vfs::getRealFileSystem(), Cache);
+  IntrusiveRefCntPtr<vfs::FileSystem> FS2 =
+      vfs::createCachingFileSystem(vfs::getRealFileSystem(), Cache);
+
+  auto Buf1 = FS1->getBufferForFile(FilePath);
+  ASSERT_FALSE(Buf1.getError());
+  auto Buf2 = FS2->getBufferForFile(FilePath);
+  ASSERT_FALSE(Buf2.getError());
+  EXPECT_EQ("int a;", (*Buf2)->getBuffer());
+  // Both file systems see the same storage.
+  EXPECT_EQ((*Buf1)->getBufferStart(), (*Buf2)->getBufferStart());
+  EXPECT_EQ(1u, Cache->getStatistics().BufferMisses);
+  EXPECT_EQ(1u, Cache->getStatistics().BufferHits);
+
+  // A modified file is re-read; buffers handed out earlier stay valid.
+  writeTestFile(FilePath, "int a; int b;");
+  auto Buf3 = FS1->getBufferForFile(FilePath);
+  ASSERT_FALSE(Buf3.getError());
+  EXPECT_EQ("int a; int b;", (*Buf3)->getBuffer());
+  EXPECT_EQ("int a;", (*Buf1)->getBuffer());
+  EXPECT_EQ(1u, Cache->getStatistics().BufferInvalidations);
+
+  EXPECT_FALSE(llvm::sys::fs::remove(FilePath));
+}
+
+TEST(VirtualFileSystemTest, CachingFSStatus) {
+  ScopedDir TestDirectory("virtual-file-system-test", /*Unique*/ true);
+  SmallString<128> FilePath(TestDirectory.Path);
+  llvm::sys::path::append(FilePath, "b.h");
+  writeTestFile(FilePath, "int b;");
+
+  IntrusiveRefCntPtr<vfs::SharedFileCache> Cache(new vfs::SharedFileCache());
+  IntrusiveRefCntPtr<vfs::FileSystem> FS =
+      vfs::createCachingFileSystem(vfs::getRealFileSystem(), Cache);
+
+  ErrorOr<vfs::Status> Status = FS->status(FilePath);
+  ASSERT_FALSE(Status.getError());
+  EXPECT_TRUE(Status->isRegularFile());
+  Status = FS->status(FilePath);
+  ASSERT_FALSE(Status.getError());
+  EXPECT_EQ(1u, Cache->getStatistics().StatusMisses);
+  EXPECT_EQ(1u, Cache->getStatistics().StatusHits);
+
+  // Cached results are trusted until the cache is invalidated.
+  EXPECT_FALSE(llvm::sys::fs::remove(FilePath));
+  EXPECT_TRUE(FS->exists(FilePath));
+  Cache->invalidate();
+  EXPECT_FALSE(FS->exists(FilePath));
+
+  // A zero lifetime disables status caching altogether.
+  Cache->setStatusLifetime(std::chrono::milliseconds(0));
+  writeTestFile(FilePath, "int b;");
+  EXPECT_TRUE(FS->exists(FilePath));
+  EXPECT_FALSE(llvm::sys::fs::remove(FilePath));
+  EXPECT_FALSE(FS->exists(FilePath));
+}
+
 #ifdef LLVM_ON_UNIX
 TEST(VirtualFileSystemTest, BrokenSymlinkRealFSIteration) {
   ScopedDir TestDirectory("virtual-file-system-test", /*Unique*/ true);
@@ -20,6 +20,7 @@
 #include "llvm/ADT/Triple.h"
 #include "llvm/Support/MemoryBuffer.h"
 #include "gtest/gtest.h"
+#include <atomic>
 
 using namespace llvm;
 using namespace clang;
@@ -254,4 +255,89 @@ TEST(ASTFrontendAction, ExternalSemaSource) {
   EXPECT_EQ("This is a note", TDC->Note.str().str());
 }
 
+
+/// Cancels the parse once it saw the declaration named \p Last, and records
+/// the names of the top-level declarations.
+class CancellingASTConsumer : public ASTConsumer {
+public:
+  CancellingASTConsumer(std::atomic<bool> &Cancel, StringRef Last,
+                        std::vector<std::string> &Names)
+      : Cancel(Cancel), Last(Last), Names(Names) {}
+
+  bool HandleTopLevelDecl(DeclGroupRef DG) override {
+    for (Decl *D : DG) {
+      if (auto *ND = dyn_cast<NamedDecl>(D)) {
+        Names.push_back(ND->getNameAsString());
+        if (ND->getName() == Last)
+          Cancel = true;
+      }
+    }
+    return true;
+  }
+
+private:
+  std::atomic<bool> &Cancel;
+  StringRef Last;
+  std::vector<std::string> &Names;
+};
+
+class CancellingASTFrontendAction : public ASTFrontendAction {
+public:
+  std::atomic<bool> Cancel{false};
+  std::vector<std::string> Names;
+  const FunctionDecl *Instantiation = nullptr;
+
+  std::unique_ptr<ASTConsumer> CreateASTConsumer(CompilerInstance &CI,
+                                                 StringRef InFile) override {
+    CI.getPreprocessor().setCancellationFlag(&Cancel);
+    return llvm::make_unique<CancellingASTConsumer>(Cancel, "b", Names);
+  }
+
+  void EndSourceFileAction() override {
+    // Find the instantiation of identity<int>, which is only defined once the
+    // pending instantiations were performed.
+    for (Decl *D : getCompilerInstance()
+                       .getASTContext()
+                       .getTranslationUnitDecl()
+                       ->decls())
+      if (auto *FTD = dyn_cast<FunctionTemplateDecl>(D))
+        for (FunctionDecl *Spec : FTD->specializations())
+          Instantiation = Spec;
+    ASTFrontendAction::EndSourceFileAction();
+  }
+};
+
+TEST(ASTFrontendAction, CancelledParse) {
+  auto Invocation = std::make_shared<CompilerInvocation>();
+  Invocation->getLangOpts()->CPlusPlus = true;
+  Invocation->getPreprocessorOpts().addRemappedFile(
+      "test.cc",
+      MemoryBuffer::getMemBuffer("template <typename T> T identity(T t) {\n"
+                                 "  return t;\n"
+                                 "}\n"
+                                 "int a = identity(1);\n"
+                                 "int b = 2;\n"
+                                 "int c = 3;\n"
+                                 "int d = 4;\n")
+          .release());
+  Invocation->getFrontendOpts().Inputs.push_back(
+      FrontendInputFile("test.cc", InputKind::CXX));
+  Invocation->getFrontendOpts().ProgramAction = frontend::ParseSyntaxOnly;
+  Invocation->getTargetOpts().Triple = "i386-unknown-linux-gnu";
+  CompilerInstance Compiler;
+  Compiler.setInvocation(std::move(Invocation));
+  Compiler.createDiagnostics();
+
+  CancellingASTFrontendAction TestAction;
+  ASSERT_TRUE(Compiler.ExecuteAction(TestAction));
+  // The parser stopped after the declaration that cancelled it, and the use
+  // of identity<int> wasn't instantiated.
+  ASSERT_EQ(3U, TestAction.Names.size());
+  EXPECT_EQ("identity", TestAction.Names[0]);
+  EXPECT_EQ("a", TestAction.Names[1]);
+  EXPECT_EQ("b", TestAction.Names[2]);
+  ASSERT_TRUE(TestAction.Instantiation);
+  EXPECT_FALSE(TestAction.Instantiation->isDefined());
+}
+
 } // anonymous namespace
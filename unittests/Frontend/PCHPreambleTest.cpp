@@ -12,6 +12,7 @@
 #include "clang/Frontend/CompilerInstance.h"
 #include "clang/Frontend/FrontendActions.h"
 #include "clang/Frontend/FrontendOptions.h"
+#include "clang/Frontend/PreambleStore.h"
 #include "clang/Lex/PreprocessorOptions.h"
 #include "clang/Basic/Diagnostic.h"
 #include "clang/Basic/FileManager.h"
@@ -65,6 +66,8 @@ public:
   }
 
   void TearDown() override {
+    PreambleStore::getShared().setLimits(0, 0);
+    PreambleStore::getShared().clear();
   }
 
   void AddFile(const std::string &Filename, const std::string &Contents) {
@@ -197,4 +200,244 @@ TEST_F(PCHPreambleTest, ParseWithBom) {
   ASSERT_LE(HeaderReadCount, GetFileReadCount(Header));
 }
 
+TEST_F(PCHPreambleTest, ReparseAfterHeaderChangeKeepsIncludesBeforeIt) {
+  std::string Header1 = "//./header1.h";
+  std::string Header2 = "//./header2.h";
+  std::string MainName = "//./main.cpp";
+  AddFile(Header1, "static const int ONE = 1;\n");
+  AddFile(Header2, "");
+  AddFile(MainName,
+    "#include \"//./header1.h\"\n"
+    "#include \"//./header2.h\"\n"
+    "int main() { return ONE + TWO; }");
+  RemapFile(Header2, "static const int TWO = 2;\n");
+
+  std::unique_ptr<ASTUnit> AST(ParseAST(MainName));
+  ASSERT_TRUE(AST.get());
+  ASSERT_FALSE(AST->getDiagnostics().hasErrorOccurred());
+
+  // The first change builds a base preamble for header1.h...
+  RemapFile(Header2, "static const int TWO = 3;\n");
+  ASSERT_TRUE(ReparseAST(AST));
+  ASSERT_FALSE(AST->getDiagnostics().hasErrorOccurred());
+
+  unsigned Header1ReadCount = GetFileReadCount(Header1);
+
+  // ...which the next ones reuse.
+  RemapFile(Header2, "static const int TWO = 4;\n");
+  ASSERT_TRUE(ReparseAST(AST));
+  ASSERT_FALSE(AST->getDiagnostics().hasErrorOccurred());
+  ASSERT_EQ(Header1ReadCount, GetFileReadCount(Header1));
+
+  // Changing header1.h invalidates the base preamble too.
+  RemapFile(Header1, "static const int ONE = 5;\n");
+  ASSERT_TRUE(ReparseAST(AST));
+  ASSERT_FALSE(AST->getDiagnostics().hasErrorOccurred());
+}
+
+TEST_F(PCHPreambleTest, ReparseAfterHeaderChangeInsideIncludeGuard) {
+  std::string Header1 = "//./header1.h";
+  std::string Header2 = "//./header2.h";
+  std::string MainName = "//./main.cpp";
+  AddFile(Header1, "static const int ONE = 1;\n");
+  AddFile(Header2, "");
+  AddFile(MainName,
+    "#ifndef MAIN_H\n"
+    "#define MAIN_H\n"
+    "#include \"//./header1.h\"\n"
+    "#include \"//./header2.h\"\n"
+    "static const int THREE = ONE + TWO;\n"
+    "#endif\n");
+  RemapFile(Header2, "static const int TWO = 2;\n");
+
+  std::unique_ptr<ASTUnit> AST(ParseAST(MainName));
+  ASSERT_TRUE(AST.get());
+  ASSERT_FALSE(AST->getDiagnostics().hasErrorOccurred());
+
+  // The preamble ends inside the include guard, so none of its prefixes can
+  // be reused; the whole preamble is built again, still inside the guard.
+  unsigned Header1ReadCount = GetFileReadCount(Header1);
+  RemapFile(Header2, "static const int TWO = 3;\n");
+  ASSERT_TRUE(ReparseAST(AST));
+  ASSERT_FALSE(AST->getDiagnostics().hasErrorOccurred());
+  ASSERT_LT(Header1ReadCount, GetFileReadCount(Header1));
+
+  Header1ReadCount = GetFileReadCount(Header1);
+  RemapFile(Header2, "static const int TWO = 4;\n");
+  ASSERT_TRUE(ReparseAST(AST));
+  ASSERT_FALSE(AST->getDiagnostics().hasErrorOccurred());
+  ASSERT_LT(Header1ReadCount, GetFileReadCount(Header1));
+}
+
+TEST_F(PCHPreambleTest, SharedPreambleIsReusedByOtherUnits) {
+  PreambleStore &Store = PreambleStore::getShared();
+  Store.setLimits(/*MemoryBudget=*/1 << 30, /*MaxPreambles=*/8);
+
+  std::string Header = "//./header.h";
+  std::string Main = "//./main.cpp";
+  AddFile(Header, "int random() { return 4; }");
+  AddFile(Main,
+    "#include \"//./header.h\"\n"
+    "int main() { return random() -2; }");
+
+  std::unique_ptr<ASTUnit> AST1(ParseAST(Main));
+  ASSERT_TRUE(AST1.get());
+  ASSERT_FALSE(AST1->getDiagnostics().hasErrorOccurred());
+
+  unsigned HeaderReadCount = GetFileReadCount(Header);
+
+  std::unique_ptr<ASTUnit> AST2(ParseAST(Main));
+  ASSERT_TRUE(AST2.get());
+  ASSERT_FALSE(AST2->getDiagnostics().hasErrorOccurred());
+
+  // The second unit used the preamble of the first one.
+  ASSERT_EQ(HeaderReadCount, GetFileReadCount(Header));
+  PreambleStore::Statistics Stats = Store.getStatistics();
+  ASSERT_EQ(1u, Stats.NumPreambles);
+  ASSERT_EQ(1u, Stats.NumHits);
+  ASSERT_EQ(0u, Stats.NumSpills);
+}
+
+TEST_F(PCHPreambleTest, SharedPreambleIsReusedByOtherMainFiles) {
+  PreambleStore &Store = PreambleStore::getShared();
+  Store.setLimits(/*MemoryBudget=*/1 << 30, /*MaxPreambles=*/8);
+
+  std::string Header = "//./header.h";
+  std::string Main1 = "//./main1.cpp";
+  std::string Main2 = "//./main2.cpp";
+  AddFile(Header, "int random() { return 4; }");
+  AddFile(Main1,
+    "#include \"//./header.h\"\n"
+    "int main() { return random() -2; }");
+  AddFile(Main2,
+    "#include \"//./header.h\"\n"
+    "int other() { return random(); }");
+
+  std::unique_ptr<ASTUnit> AST1(ParseAST(Main1));
+  ASSERT_TRUE(AST1.get());
+  ASSERT_FALSE(AST1->getDiagnostics().hasErrorOccurred());
+
+  unsigned HeaderReadCount = GetFileReadCount(Header);
+
+  std::unique_ptr<ASTUnit> AST2(ParseAST(Main2));
+  ASSERT_TRUE(AST2.get());
+  ASSERT_FALSE(AST2->getDiagnostics().hasErrorOccurred());
+
+  // The preambles have the same text, so the second file used the preamble
+  // of the first one.
+  ASSERT_EQ(HeaderReadCount, GetFileReadCount(Header));
+  PreambleStore::Statistics Stats = Store.getStatistics();
+  ASSERT_EQ(1u, Stats.NumPreambles);
+  ASSERT_EQ(1u, Stats.NumHits);
+}
+
+TEST_F(PCHPreambleTest, SharedPreambleIsNotReusedIfItUsesMainFileName) {
+  PreambleStore &Store = PreambleStore::getShared();
+  Store.setLimits(/*MemoryBudget=*/1 << 30, /*MaxPreambles=*/8);
+
+  std::string Header = "//./header.h";
+  std::string Main1 = "//./main1.cpp";
+  std::string Main2 = "//./main22.cpp";
+  AddFile(Header, "extern char Base[sizeof(__BASE_FILE__)];");
+  AddFile(Main1,
+    "#include \"//./header.h\"\n"
+    "char Base[sizeof(__BASE_FILE__)];");
+  AddFile(Main2,
+    "#include \"//./header.h\"\n"
+    "char Base[sizeof(__BASE_FILE__)];");
+
+  std::unique_ptr<ASTUnit> AST1(ParseAST(Main1));
+  ASSERT_TRUE(AST1.get());
+  ASSERT_FALSE(AST1->getDiagnostics().hasErrorOccurred());
+
+  std::unique_ptr<ASTUnit> AST2(ParseAST(Main2));
+  ASSERT_TRUE(AST2.get());
+  ASSERT_FALSE(AST2->getDiagnostics().hasErrorOccurred());
+
+  // The preamble holds the name of the first file, which has another length
+  // than the second one, so it wasn't shared.
+  PreambleStore::Statistics Stats = Store.getStatistics();
+  ASSERT_EQ(0u, Stats.NumPreambles);
+  ASSERT_EQ(0u, Stats.NumHits);
+}
+
+TEST_F(PCHPreambleTest, SharedPreambleIsBuiltOnDiskWhenBudgetIsUsed) {
+  PreambleStore &Store = PreambleStore::getShared();
+  Store.setLimits(/*MemoryBudget=*/1 << 30, /*MaxPreambles=*/8);
+
+  std::string Header1 = "//./header1.h";
+  std::string Header2 = "//./header2.h";
+  std::string Main1 = "//./main1.cpp";
+  std::string Main2 = "//./main2.cpp";
+  AddFile(Header1, "int random() { return 4; }");
+  AddFile(Header2, "int other() { return 2; }");
+  AddFile(Main1,
+    "#include \"//./header1.h\"\n"
+    "int main() { return random() -2; }");
+  AddFile(Main2,
+    "#include \"//./header2.h\"\n"
+    "int main() { return other() -2; }");
+
+  std::unique_ptr<ASTUnit> AST1(ParseAST(Main1));
+  ASSERT_TRUE(AST1.get());
+  ASSERT_FALSE(AST1->getDiagnostics().hasErrorOccurred());
+  PreambleStore::Statistics Stats = Store.getStatistics();
+  std::size_t MemoryUsage = Stats.MemoryUsage;
+  ASSERT_LT(0u, MemoryUsage);
+
+  // The first preamble uses up the budget, so the second one is built on disk
+  // instead of moving the first one there.
+  Store.setLimits(MemoryUsage, /*MaxPreambles=*/8);
+  std::unique_ptr<ASTUnit> AST2(ParseAST(Main2));
+  ASSERT_TRUE(AST2.get());
+  ASSERT_FALSE(AST2->getDiagnostics().hasErrorOccurred());
+
+  Stats = Store.getStatistics();
+  ASSERT_EQ(2u, Stats.NumPreambles);
+  ASSERT_EQ(0u, Stats.NumSpills);
+  ASSERT_EQ(MemoryUsage, Stats.MemoryUsage);
+}
+
+TEST_F(PCHPreambleTest, SharedPreambleIsMovedToDiskWhileInUse) {
+  PreambleStore &Store = PreambleStore::getShared();
+  Store.setLimits(/*MemoryBudget=*/1 << 30, /*MaxPreambles=*/8);
+
+  std::string Header = "//./header.h";
+  std::string Main = "//./main.cpp";
+  AddFile(Header, "int random() { return 4; }");
+  AddFile(Main,
+    "#include \"//./header.h\"\n"
+    "int main() { return random() -2; }");
+
+  std::unique_ptr<ASTUnit> AST1(ParseAST(Main));
+  ASSERT_TRUE(AST1.get());
+  ASSERT_FALSE(AST1->getDiagnostics().hasErrorOccurred());
+  PreambleStore::Statistics Stats = Store.getStatistics();
+  ASSERT_LT(0u, Stats.MemoryUsage);
+  ASSERT_EQ(0u, Stats.NumSpills);
+
+  // Going over budget moves the preamble to disk, although it's in use.
+  Store.setLimits(/*MemoryBudget=*/1, /*MaxPreambles=*/8);
+  Stats = Store.getStatistics();
+  ASSERT_EQ(1u, Stats.NumSpills);
+  ASSERT_EQ(0u, Stats.MemoryUsage);
+
+  // The unit using it goes on, from the file.
+  unsigned HeaderReadCount = GetFileReadCount(Header);
+  ASSERT_TRUE(ReparseAST(AST1));
+  ASSERT_FALSE(AST1->getDiagnostics().hasErrorOccurred());
+  ASSERT_EQ(HeaderReadCount, GetFileReadCount(Header));
+
+  std::unique_ptr<ASTUnit> AST2(ParseAST(Main));
+  ASSERT_TRUE(AST2.get());
+  ASSERT_FALSE(AST2->getDiagnostics().hasErrorOccurred());
+
+  ASSERT_EQ(HeaderReadCount, GetFileReadCount(Header));
+  Stats = Store.getStatistics();
+  ASSERT_EQ(1u, Stats.NumPreambles);
+  ASSERT_EQ(1u, Stats.NumHits);
+  ASSERT_EQ(1u, Stats.NumSpills);
+  ASSERT_EQ(0u, Stats.MemoryUsage);
+}
+
 } // anonymous namespace
@@ -0,0 +1,91 @@
+//===- unittests/Lex/CharScannerTest.cpp - Character scanner tests --------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "clang/Lex/CharScanner.h"
+#include "gtest/gtest.h"
+#include <string>
+
+using namespace clang;
+using namespace clang::charscan;
+
+namespace {
+
+const RunKind AllKinds[] = {RunKind::IdentifierBody,
+                            RunKind::HorizontalWhitespace,
+                            RunKind::LineCommentBody,
+                            RunKind::StringLiteralBody};
+
+const ScanImpl AllImpls[] = {ScanImpl::Portable, ScanImpl::SSE2,
+                             ScanImpl::AVX2};
+
+// Return the offset into Str at which a run of Kind starting at Offset ends.
+size_t skip(RunKind Kind, const std::string &Str, size_t Offset,
+            ScanImpl Impl) {
+  const char *Start = Str.c_str();
+  return skipRun(Kind, Start + Offset, Start + Str.size(), Impl) - Start;
+}
+
+TEST(CharScannerTest, FindsEndOfRun) {
+  for (ScanImpl Impl : AllImpls) {
+    if (!isScanImplSupported(Impl))
+      continue;
+    EXPECT_EQ(3u, skip(RunKind::IdentifierBody, "a_1+b", 0, Impl));
+    EXPECT_EQ(2u, skip(RunKind::IdentifierBody, "ab$", 0, Impl));
+    EXPECT_EQ(3u, skip(RunKind::HorizontalWhitespace, " \t\fx", 0, Impl));
+    EXPECT_EQ(1u, skip(RunKind::HorizontalWhitespace, "\v\n", 0, Impl));
+    EXPECT_EQ(4u, skip(RunKind::LineCommentBody, "abc \r\n", 0, Impl));
+    EXPECT_EQ(3u, skip(RunKind::StringLiteralBody, "abc\\\"", 0, Impl));
+    EXPECT_EQ(1u, skip(RunKind::StringLiteralBody, "a?\?/", 0, Impl));
+
+    // Long runs end at the terminating nul.
+    std::string Long(100, 'x');
+    EXPECT_EQ(100u, skip(RunKind::IdentifierBody, Long, 0, Impl));
+    EXPECT_EQ(100u, skip(RunKind::LineCommentBody, Long, 0, Impl));
+    EXPECT_EQ(100u, skip(RunKind::StringLiteralBody, Long, 37, Impl));
+    std::string Spaces(70, ' ');
+    EXPECT_EQ(70u, skip(RunKind::HorizontalWhitespace, Spaces, 3, Impl));
+  }
+}
+
+TEST(CharScannerTest, NonASCIIEndsIdentifier) {
+  std::string Str = std::string(40, 'a') + "\xc3\xa9" + std::string(40, 'a');
+  for (ScanImpl Impl : AllImpls)
+    if (isScanImplSupported(Impl)) {
+      EXPECT_EQ(40u, skip(RunKind::IdentifierBody, Str, 0, Impl));
+      EXPECT_EQ(Str.size(), skip(RunKind::LineCommentBody, Str, 0, Impl));
+    }
+}
+
+// Every implementation must agree with the portable one at every offset and
+// for every position of the end of the run within a block.
+TEST(CharScannerTest, MatchesPortableScanner) {
+  const char Chars[] = "aZ_09 \t\f\v\n\r\"\\?$/`{@[\x80\xff";
+  for (unsigned Length = 0; Length != 80; ++Length) {
+    for (unsigned Stop = 0; Stop != sizeof(Chars) - 1; ++Stop) {
+      for (unsigned Fill = 0; Fill != 6; ++Fill) {
+        std::string Str(Length, Chars[Fill]);
+        if (Length)
+          Str[Stop % Length] = Chars[Stop];
+        for (RunKind Kind : AllKinds)
+          for (size_t Offset = 0; Offset <= Str.size(); ++Offset) {
+            size_t Expected = skip(Kind, Str, Offset, ScanImpl::Portable);
+            for (ScanImpl Impl : AllImpls)
+              if (isScanImplSupported(Impl))
+                EXPECT_EQ(Expected, skip(Kind, Str, Offset, Impl));
+            const char *Start = Str.c_str();
+            EXPECT_EQ(Expected, size_t(skipRun(Kind, Start + Offset,
+                                               Start + Str.size()) -
+                                       Start));
+          }
+      }
+    }
+  }
+}
+
+} // anonymous namespace
@@ -0,0 +1,159 @@
+//===- unittests/Lex/IncludeGuardCacheTest.cpp - Include guard cache ------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "clang/Lex/IncludeGuardCache.h"
+#include "clang/Basic/Diagnostic.h"
+#include "clang/Basic/DiagnosticOptions.h"
+#include "clang/Basic/FileManager.h"
+#include "clang/Basic/LangOptions.h"
+#include "clang/Basic/MemoryBufferCache.h"
+#include "clang/Basic/SourceManager.h"
+#include "clang/Basic/TargetInfo.h"
+#include "clang/Basic/TargetOptions.h"
+#include "clang/Lex/HeaderSearch.h"
+#include "clang/Lex/HeaderSearchOptions.h"
+#include "clang/Lex/ModuleLoader.h"
+#include "clang/Lex/Preprocessor.h"
+#include "clang/Lex/PreprocessorOptions.h"
+#include "gtest/gtest.h"
+
+using namespace clang;
+
+namespace {
+
+// Counts the headers that were entered and skipped.
+class IncludeCallbacks : public PPCallbacks {
+  SourceManager &SM;
+
+public:
+  explicit IncludeCallbacks(SourceManager &SM) : SM(SM) {}
+
+  void FileChanged(SourceLocation Loc, FileChangeReason Reason,
+                   SrcMgr::CharacteristicKind FileType,
+                   FileID PrevFID) override {
+    // The main file and the predefines are memory buffers.
+    if (Reason == EnterFile && SM.getFileEntryForID(SM.getFileID(Loc)))
+      ++NumEntered;
+  }
+
+  void FileSkipped(const FileEntry &SkippedFile, const Token &FilenameTok,
+                   SrcMgr::CharacteristicKind FileType) override {
+    ++NumSkipped;
+  }
+
+  unsigned NumEntered = 0;
+  unsigned NumSkipped = 0;
+};
+
+class IncludeGuardCacheTest : public ::testing::Test {
+protected:
+  IncludeGuardCacheTest()
+      : InMemoryFileSystem(new vfs::InMemoryFileSystem),
+        FileMgr(FileSystemOptions(), InMemoryFileSystem),
+        DiagID(new DiagnosticIDs()), DiagOpts(new DiagnosticOptions()),
+        Diags(DiagID, DiagOpts.get(), new IgnoringDiagConsumer()),
+        TargetOpts(new TargetOptions()),
+        Guards(std::make_shared<IncludeGuardCache>()) {
+    TargetOpts->Triple = "x86_64-apple-darwin11.1.0";
+    Target = TargetInfo::CreateTargetInfo(Diags, TargetOpts);
+  }
+
+  void addHeader(StringRef Path, StringRef Contents) {
+    InMemoryFileSystem->addFile(Path, 0,
+                                llvm::MemoryBuffer::getMemBuffer(Contents));
+  }
+
+  // Preprocess a translation unit with the shared cache and return how many
+  // headers it entered and skipped.
+  std::pair<unsigned, unsigned> preprocess(StringRef Source) {
+    SourceManager SourceMgr(Diags, FileMgr);
+    SourceMgr.setMainFileID(
+        SourceMgr.createFileID(llvm::MemoryBuffer::getMemBuffer(Source)));
+
+    TrivialModuleLoader ModLoader;
+    MemoryBufferCache PCMCache;
+    HeaderSearch HeaderInfo(std::make_shared<HeaderSearchOptions>(), SourceMgr,
+                            Diags, LangOpts, Target.get());
+    DirectoryLookup DL(FileMgr.getDirectory("/"), SrcMgr::C_User, false);
+    HeaderInfo.AddSearchPath(DL, /*isAngled=*/false);
+
+    auto PPOpts = std::make_shared<PreprocessorOptions>();
+    PPOpts->IncludeGuards = Guards;
+    Preprocessor PP(PPOpts, Diags, LangOpts, SourceMgr, PCMCache, HeaderInfo,
+                    ModLoader, /*IILookup =*/nullptr,
+                    /*OwnsHeaderSearch =*/false);
+    PP.Initialize(*Target);
+    auto *Callbacks = new IncludeCallbacks(SourceMgr);
+    PP.addPPCallbacks(std::unique_ptr<PPCallbacks>(Callbacks));
+
+    PP.EnterMainSourceFile();
+    Token Tok;
+    do
+      PP.Lex(Tok);
+    while (Tok.isNot(tok::eof));
+    return {Callbacks->NumEntered, Callbacks->NumSkipped};
+  }
+
+  IntrusiveRefCntPtr<vfs::InMemoryFileSystem> InMemoryFileSystem;
+  FileManager FileMgr;
+  IntrusiveRefCntPtr<DiagnosticIDs> DiagID;
+  IntrusiveRefCntPtr<DiagnosticOptions> DiagOpts;
+  DiagnosticsEngine Diags;
+  LangOptions LangOpts;
+  std::shared_ptr<TargetOptions> TargetOpts;
+  IntrusiveRefCntPtr<TargetInfo> Target;
+  std::shared_ptr<IncludeGuardCache> Guards;
+};
+
+TEST_F(IncludeGuardCacheTest, SkipsFirstIncludeInLaterTU) {
+  addHeader("/guarded.h", "#ifndef GUARDED_H\n#define GUARDED_H\n"
+                          "int x;\n#endif\n");
+  const char *Source = "#include \"guarded.h\"\n#include \"guarded.h\"\n";
+
+  // The first translation unit has to lex the header to learn its guard.
+  EXPECT_EQ(std::make_pair(1u, 1u), preprocess(Source));
+  EXPECT_EQ("GUARDED_H", Guards->lookup(FileMgr.getFile("/guarded.h")));
+
+  // Later ones do not even enter it if the guard is already defined.
+  EXPECT_EQ(std::make_pair(0u, 1u),
+            preprocess("#define GUARDED_H\n#include \"guarded.h\"\n"));
+  EXPECT_EQ(std::make_pair(1u, 1u), preprocess(Source));
+  EXPECT_EQ(0u, Guards->getNumInvalidations());
+}
+
+TEST_F(IncludeGuardCacheTest, UnguardedHeaders) {
+  addHeader("/unguarded.h", "int y;\n#ifndef UNGUARDED_H\n"
+                            "#define UNGUARDED_H\n#endif\n");
+  addHeader("/once.h", "#pragma once\nint z;\n");
+  const char *Source = "#define UNGUARDED_H\n#include \"unguarded.h\"\n"
+                       "#include \"once.h\"\n";
+
+  EXPECT_EQ(std::make_pair(2u, 0u), preprocess(Source));
+  EXPECT_EQ(0u, Guards->size());
+  EXPECT_EQ(std::make_pair(2u, 0u), preprocess(Source));
+}
+
+TEST_F(IncludeGuardCacheTest, DropsContradictedEntries) {
+  addHeader("/header.h", "int w;\n");
+  const FileEntry *Header = FileMgr.getFile("/header.h");
+
+  // Pretend an earlier version of the header with the same identity, size
+  // and modification time was guarded.
+  Guards->fileLexed(Header, "HEADER_H", "#ifndef HEADER_H\n");
+  ASSERT_EQ("HEADER_H", Guards->lookup(Header));
+
+  // The header is entered because the guard is not defined, and the cache
+  // learns that it is not guarded after all.
+  EXPECT_EQ(std::make_pair(2u, 0u),
+            preprocess("#include \"header.h\"\n#include \"header.h\"\n"));
+  EXPECT_EQ("", Guards->lookup(Header));
+  EXPECT_EQ(1u, Guards->getNumInvalidations());
+}
+
+} // anonymous namespace
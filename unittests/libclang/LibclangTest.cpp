@@ -13,11 +13,13 @@
 #include "llvm/Support/Path.h"
 #include "llvm/Support/raw_ostream.h"
 #include "gtest/gtest.h"
+#include <cstdlib>
 #include <fstream>
 #include <functional>
 #include <map>
 #include <memory>
 #include <set>
+#include <string>
 #define DEBUG_TYPE "libclang-test"
 
 TEST(libclang, clang_parseTranslationUnit2_InvalidArgs) {
@@ -546,6 +548,120 @@ TEST_F(LibclangReparseTest, ReparseWithModule) {
   EXPECT_EQ(0U, clang_getNumDiagnostics(ClangTU));
 }
 
+/// Set the environment variable \p Name to \p Value, or unset it if \p Value is
+/// null.
+static void setEnvironmentVariable(const char *Name, const char *Value) {
+#ifdef _WIN32
+  _putenv_s(Name, Value ? Value : "");
+#else
+  if (Value)
+    ::setenv(Name, Value, /*overwrite=*/1);
+  else
+    ::unsetenv(Name);
+#endif
+}
+
+TEST_F(LibclangReparseTest, ReparseAsync) {
+  const char *HeaderTop = "#ifndef H\n#define H\nstruct Foo { int bar;";
+  const char *HeaderBottom = "\n};\n#endif\n";
+  const char *CppFile = "#include \"HeaderFile.h\"\nint main() {"
+                         " Foo foo; foo.bar = 7; foo.baz = 8; }\n";
+  std::string HeaderName = "HeaderFile.h";
+  std::string CppName = "CppFile.cpp";
+  WriteFile(CppName, CppFile);
+  WriteFile(HeaderName, std::string(HeaderTop) + HeaderBottom);
+
+  ClangTU = clang_parseTranslationUnit(Index, CppName.c_str(), nullptr, 0,
+                                       nullptr, 0, TUFlags);
+  EXPECT_EQ(1U, clang_getNumDiagnostics(ClangTU));
+
+  // Without threads, an operation runs when it is waited for, so one
+  // cancelled before that never starts, and leaves the translation unit
+  // usable.
+  setEnvironmentVariable("LIBCLANG_NOTHREADS", "1");
+  CXAsyncOperation Op = clang_reparseTranslationUnitAsync(
+      ClangTU, 0, nullptr, clang_defaultReparseOptions(ClangTU));
+  setEnvironmentVariable("LIBCLANG_NOTHREADS", nullptr);
+  ASSERT_TRUE(Op);
+  EXPECT_FALSE(clang_AsyncOperation_isFinished(Op));
+  clang_AsyncOperation_cancel(Op);
+  EXPECT_EQ(CXError_Canceled, clang_AsyncOperation_wait(Op));
+  EXPECT_TRUE(clang_AsyncOperation_isFinished(Op));
+  clang_AsyncOperation_dispose(Op);
+  EXPECT_EQ(1U, clang_getNumDiagnostics(ClangTU));
+
+  WriteFile(HeaderName, std::string(HeaderTop) + "int baz;" + HeaderBottom);
+
+  // Operations on the same translation unit run in order.
+  CXAsyncOperation First = clang_reparseTranslationUnitAsync(
+      ClangTU, 0, nullptr, clang_defaultReparseOptions(ClangTU));
+  CXAsyncOperation Second = clang_codeCompleteAtAsync(
+      ClangTU, CppName.c_str(), 2, 27, nullptr, 0,
+      clang_defaultCodeCompleteOptions());
+  ASSERT_TRUE(First && Second);
+  EXPECT_EQ(CXError_Success, clang_AsyncOperation_wait(Second));
+  EXPECT_TRUE(clang_AsyncOperation_isFinished(First));
+  EXPECT_EQ(CXError_Success, clang_AsyncOperation_wait(First));
+  EXPECT_EQ(0U, clang_getNumDiagnostics(ClangTU));
+
+  CXCodeCompleteResults *Results =
+      clang_AsyncOperation_takeCodeCompleteResults(Second);
+  ASSERT_TRUE(Results);
+  bool FoundBaz = false;
+  for (unsigned I = 0; I != Results->NumResults; ++I) {
+    CXCompletionString Completion = Results->Results[I].CompletionString;
+    for (unsigned J = 0, N = clang_getNumCompletionChunks(Completion); J != N;
+         ++J) {
+      if (clang_getCompletionChunkKind(Completion, J) !=
+          CXCompletionChunk_TypedText)
+        continue;
+      CXString Text = clang_getCompletionChunkText(Completion, J);
+      FoundBaz |= llvm::StringRef(clang_getCString(Text)) == "baz";
+      clang_disposeString(Text);
+    }
+  }
+  EXPECT_TRUE(FoundBaz);
+  clang_disposeCodeCompleteResults(Results);
+  EXPECT_EQ(nullptr, clang_AsyncOperation_takeCodeCompleteResults(Second));
+
+  clang_AsyncOperation_dispose(First);
+  clang_AsyncOperation_dispose(Second);
+}
+
+TEST_F(LibclangReparseTest, ReparseAsyncCanceledWhileParsing) {
+  std::string CppName = "CppFile.cpp";
+  WriteFile(CppName, "int v0;\n");
+  ClangTU = clang_parseTranslationUnit(Index, CppName.c_str(), nullptr, 0,
+                                       nullptr, 0, TUFlags);
+  ASSERT_TRUE(ClangTU);
+
+  // Parsing this takes far longer than cancelling it right after it was
+  // started, so the parser and the template instantiation see the
+  // cancellation.
+  const unsigned NumDecls = 20000;
+  std::string Contents = "template <int N> int get() { return N; }\n";
+  for (unsigned I = 0; I != NumDecls; ++I)
+    Contents += "int v" + std::to_string(I) + " = get<" + std::to_string(I) +
+                ">();\n";
+  CXUnsavedFile Unsaved = {CppName.c_str(), Contents.data(),
+                           static_cast<unsigned long>(Contents.size())};
+
+  CXAsyncOperation Op = clang_reparseTranslationUnitAsync(
+      ClangTU, 1, &Unsaved, clang_defaultReparseOptions(ClangTU));
+  ASSERT_TRUE(Op);
+  clang_AsyncOperation_cancel(Op);
+  EXPECT_EQ(CXError_Canceled, clang_AsyncOperation_wait(Op));
+  clang_AsyncOperation_dispose(Op);
+
+  unsigned NumVars = 0;
+  Traverse([&](CXCursor Cursor, CXCursor) {
+    if (clang_getCursorKind(Cursor) == CXCursor_VarDecl)
+      ++NumVars;
+    return CXChildVisit_Continue;
+  });
+  EXPECT_LT(NumVars, NumDecls);
+}
+
 TEST_F(LibclangReparseTest, clang_parseTranslationUnit2FullArgv) {
   // Provide a fake GCC 99.9.9 standard library that always overrides any local
   // GCC installation.
@@ -0,0 +1,132 @@
+#!/usr/bin/env python
+
+"""
+Merge the reports written by -fheader-cost-report=<file> for the translation
+units of a build, and rank the headers by their cost to the whole build.
+
+Usage:
+  header-cost-report.py [options] <report or directory>...
+
+Directories are searched recursively for files ending in the report suffix
+(.header-cost.json by default). For example, build with
+  CFLAGS='-fheader-cost-report=$@.header-cost.json'
+or with a per-file report path from the build system, then run
+  header-cost-report.py build/
+
+Every header is charged with the sums over all translation units of its
+inclusions, time, parse and analysis time of its declarations, tokens, bytes
+and declarations, both for the header itself ("self") and including
+everything it includes ("total"). Headers with a large total cost that are
+included by many translation units are the best candidates for modularizing
+or splitting.
+"""
+
+from __future__ import print_function
+
+import argparse
+import json
+import os
+import sys
+
+METRICS = ['time_ms', 'decl_time_ms', 'tokens', 'bytes', 'decls']
+
+
+def find_reports(paths, suffix):
+    for path in paths:
+        if os.path.isdir(path):
+            for root, _, files in os.walk(path):
+                for name in sorted(files):
+                    if name.endswith(suffix):
+                        yield os.path.join(root, name)
+        else:
+            yield path
+
+
+def merge(report_files):
+    headers = {}
+    num_tus = 0
+    for report_file in report_files:
+        try:
+            with open(report_file) as f:
+                report = json.load(f)
+        except (IOError, ValueError) as e:
+            print('warning: ignoring %s: %s' % (report_file, e),
+                  file=sys.stderr)
+            continue
+        num_tus += 1
+        main_file = report.get('main_file')
+        for entry in report.get('files', []):
+            name = entry['file']
+            header = headers.setdefault(name, {
+                'file': name,
+                'translation_units': 0,
+                'inclusions': 0,
+                'self': dict((m, 0) for m in METRICS),
+                'total': dict((m, 0) for m in METRICS),
+            })
+            if name != main_file:
+                header['translation_units'] += 1
+            header['inclusions'] += entry.get('inclusions', 0)
+            for kind in ('self', 'total'):
+                for m in METRICS:
+                    header[kind][m] += entry.get(kind, {}).get(m, 0)
+    return num_tus, headers
+
+
+def print_table(num_tus, headers, limit, out):
+    print('Merged %d translation units; %d files ranked.' %
+          (num_tus, len(headers)),
+          file=out)
+    print('%10s %10s %10s %6s %6s %12s %10s  %s' %
+          ('total ms', 'self ms', 'decl ms', 'TUs', 'incl', 'tokens',
+           'decls', 'file'), file=out)
+    for header in headers[:limit]:
+        print('%10.1f %10.1f %10.1f %6d %6d %12d %10d  %s' %
+              (header['total']['time_ms'], header['self']['time_ms'],
+               header['self']['decl_time_ms'], header['translation_units'],
+               header['inclusions'], header['total']['tokens'],
+               header['total']['decls'], header['file']), file=out)
+
+
+def main():
+    parser = argparse.ArgumentParser(
+        description=__doc__,
+        formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument('paths', nargs='+',
+                        help='report files or directories containing them')
+    parser.add_argument('--suffix', default='.header-cost.json',
+                        help='suffix of the report files in directories')
+    parser.add_argument('--sort', default='total.time_ms',
+                        help='the metric to rank by, as self.<metric> or '
+                             'total.<metric>, where <metric> is one of ' +
+                             ', '.join(METRICS) + ' (default: %(default)s)')
+    parser.add_argument('--limit', type=int, default=50,
+                        help='the number of files to print (default: '
+                             '%(default)s, 0 for all)')
+    parser.add_argument('--json', action='store_true',
+                        help='write the merged report as JSON')
+    parser.add_argument('--include-main-files', action='store_true',
+                        help='also rank the main files of the translation '
+                             'units')
+    args = parser.parse_args()
+
+    kind, _, metric = args.sort.partition('.')
+    if kind not in ('self', 'total') or metric not in METRICS:
+        parser.error('invalid --sort value: %s' % args.sort)
+
+    num_tus, headers = merge(find_reports(args.paths, args.suffix))
+    ranked = [h for h in headers.values()
+              if args.include_main_files or h['translation_units'] > 0]
+    ranked.sort(key=lambda h: (-h[kind][metric], h['file']))
+    limit = args.limit if args.limit > 0 else len(ranked)
+
+    if args.json:
+        json.dump({'translation_units': num_tus, 'files': ranked[:limit]},
+                  sys.stdout, indent=2, sort_keys=True)
+        sys.stdout.write('\n')
+    else:
+        print_table(num_tus, ranked, limit, sys.stdout)
+
+
+if __name__ == '__main__':
+    main()